@@ -11,6 +11,20 @@ enum class ERemoteSessionChannelMode
 };
 
 class FBackChannelOSCConnection;
+class IRemoteSessionChannel;
+
+/* Passed to channel factories when a channel is needed for a connection */
+struct FRemoteSessionChannelCreationContext
+{
+	/** True when creating the host's end of the channel, false for the client's */
+	bool bIsHost;
+
+	/** Connection the channel should send and receive on */
+	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> Connection;
+};
+
+/* Creates a channel. Called on the game thread, only once a peer asks for the channel type */
+DECLARE_DELEGATE_RetVal_OneParam(TSharedPtr<IRemoteSessionChannel>, FOnRemoteSessionChannelCreate, const FRemoteSessionChannelCreationContext&);
 
 class REMOTESESSION_API IRemoteSessionChannel
 {
@@ -25,4 +39,7 @@ public:
 
 	virtual FString GetType() const = 0;
 
+	/** Moves the channel to a new connection when a session is resumed. Returns false if the channel should be recreated instead */
+	virtual bool SetConnection(TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection) { return false; }
+
 };
@@ -4,16 +4,62 @@
 
 #include "RemoteSessionChannel.h"
 #include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Async/TaskGraphInterfaces.h"
 
 
 class FBackChannelOSCMessage;
 class FBackChannelOSCDispatch;
-class FFrameGrabber;
+class IRemoteSessionFrameSource;
+class FRemoteSessionSender;
+class FRemoteSessionReceiver;
+class FRemoteSessionReceivedMessage;
+class FRemoteSessionBlobView;
+class FRemoteSessionUDPFrameSender;
+class FRemoteSessionUDPFrameReceiver;
+class FRemoteSessionFrameTimeline;
+class FInternetAddr;
 class FSceneViewport;
 class UTexture2D;
+struct FRemoteSessionFrameStats;
+enum class EImageFormat : int8;
+
+/* How long a frame spent at each stage of the channel. Times are from FPlatformTime::Seconds() */
+struct FRemoteSessionFrameTiming
+{
+	int32	ImageIndex = 0;
+	int32	Width = 0;
+	int32	Height = 0;
+
+	/** Size of the frame once encoded */
+	int32	EncodedBytes = 0;
+
+	/** Host: when the frame was taken from the source, how long that took, and how long it took to encode */
+	double	CaptureTime = 0;
+	float	CaptureMS = 0;
+	float	EncodeMS = 0;
+
+	/** Host: when the frame was written to the socket, or 0 if it hasn't been (yet) */
+	double	SendTime = 0;
+
+	/** Client: when the frame arrived, how long it took to decode and upload, and when the upload finished */
+	double	ReceiveTime = 0;
+	float	DecodeMS = 0;
+	float	UploadMS = 0;
+	double	DisplayTime = 0;
+
+	/** Client: the frame was replaced by a newer one, or couldn't be decoded, so was never shown */
+	bool	bDropped = false;
+
+	/** Client: the latency probe marker found in the frame, or -1 if none was looked for or found */
+	int32	ProbeId = -1;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnRemoteSessionFrameTiming, const FRemoteSessionFrameTiming&);
 
 /*
 	A channel that captures the framebuffer on the host, encodes it as a jpg as an async task, then sends it to the client.
+	Frames can come from somewhere other than a viewport by giving the host channel a frame source.
 
 	On the client images are decoded into a double-buffered texture that can be accessed via GetHostScreen.
 */
@@ -25,20 +71,104 @@ public:
 
 	~FRemoteSessionFrameBufferChannel();
 
-	/** Specifies which viewport to capture */
-	void SetCaptureViewport(TSharedRef<FSceneViewport> Viewport);
+	/** Specifies which viewport to capture, and optionally the size to capture it at */
+	void SetCaptureViewport(TSharedRef<FSceneViewport> Viewport, FIntPoint InCaptureSize = FIntPoint::ZeroValue);
+
+	/** Specifies where frames come from. Null stops capturing */
+	void SetFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource);
+
+	/** Returns true if we've been given a viewport or frame source to capture */
+	bool IsCapturing() const { return FrameSource.IsValid(); }
+
+	/** Returns the size frames are captured at */
+	FIntPoint GetCaptureSize() const { return CaptureSize; }
+
+	/** Codecs we can encode and decode, in order of preference */
+	static TArray<FString> GetSupportedCodecs();
+
+	/** Sets the codec frames are encoded/decoded with. Returns false if it isn't supported */
+	bool SetCodec(const FString& InCodec);
+
+	/** Returns the codec frames are encoded/decoded with */
+	FString GetCodec() const;
+
+	/** Encodes BGRA pixels with a codec, exactly as frames are before they're sent. Quality is 1-100 and ignored by lossless codecs */
+	static bool EncodeImage(const FString& InCodec, int32 InQuality, int32 Width, int32 Height, const TArray<FColor>& ImageData, TArray<uint8>& OutData);
+
+	/** Decodes a frame to BGRA pixels, exactly as a client does */
+	static bool DecodeImage(const FString& InCodec, const uint8* Data, int32 Size, TArray<uint8>& OutData);
+
+	/** Specifies the sender used to send frames without copying them into an OSC message. Nothing is sent until it is set */
+	void SetSender(TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> InSender);
+
+	/** Specifies a receiver that lets us decode frames straight from the receive buffer */
+	void SetReceiver(TSharedPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> InReceiver);
+
+	/** Host: lets the client at ClientAddress ask for frames to be sent over UDP */
+	void AllowUDPFrames(TSharedRef<FInternetAddr> ClientAddress, int32 FragmentSize, int32 GroupSize);
+
+	/** Client: starts receiving frames over UDP from HostAddress and asks the host to send them there */
+	bool RequestUDPFrames(TSharedRef<FInternetAddr> HostAddress);
 
 	/** Specifies the quality and framerate to capture at */
 	void SetCaptureQuality(int32 InQuality, int32 InFramerate);
 
+	/** A frame as it was sent, kept so it can be sent again without capturing or encoding it */
+	struct FEncodedFrame
+	{
+		int32					Width = 0;
+		int32					Height = 0;
+		int32					ImageIndex = 0;
+		FString					Codec;
+		TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe>	Data;
+		/** When the frame was encoded */
+		double					EncodeTime = 0;
+	};
+
+	/** Host: how many recently sent frames to keep. 0 to keep none */
+	void SetFrameHistorySize(int32 InSize);
+
+	/** Host: frames we've sent, oldest first */
+	TArray<FEncodedFrame> GetRecentFrames() const;
+
+	/** Host: takes over another channel's recent frames, dropping any we couldn't have sent */
+	void SeedRecentFrames(const TArray<FEncodedFrame>& InFrames);
+
+	/** Host: sends our latest frame, if it's newer than MaxAgeSeconds, so a client has a picture while the next is captured. Returns true if one was sent */
+	bool SendLatestFrame(double MaxAgeSeconds);
+
+	/** Host: draws a latency probe marker with this id into frames captured from now on. -1 for none */
+	void SetProbeMarker(int32 InId) { ProbeMarkerId = InId; }
+
+	/** Client: looks for latency probe markers in decoded frames and reports them in their timing */
+	void SetReadProbeMarkers(bool bInRead) { bReadProbeMarkers = bInRead; }
+
 	/** Tick this channel */
 	virtual void Tick(const float InDeltaTime) override;
 
 	UTexture2D* GetHostScreen() const;
 
+	/** Host: Handler is called on the encoding thread once a frame has been sent. Handlers can be added and removed on any thread */
+	FDelegateHandle AddFrameSentHandler(const FOnRemoteSessionFrameTiming::FDelegate& Handler);
+	void RemoveFrameSentHandler(FDelegateHandle Handle);
+
+	/** Client: Handler is called on the render thread once a frame's texture has been updated. Handlers can be added and removed on any thread */
+	FDelegateHandle AddFrameDisplayedHandler(const FOnRemoteSessionFrameTiming::FDelegate& Handler);
+	void RemoveFrameDisplayedHandler(FDelegateHandle Handle);
+
+	/** Returns how many frames have been captured, encoded, received, decoded, uploaded and dropped */
+	void GetFrameStats(FRemoteSessionFrameStats& OutStats) const;
+
+	/** Returns timings for the most recent frames (see remote.timelinesize), oldest first */
+	TArray<FRemoteSessionFrameTiming> GetTimeline() const;
+
+	/** Writes GetTimeline to Filename as CSV. Returns false if there were no frames or it couldn't be saved */
+	bool DumpTimeline(const FString& Filename) const;
+
 	/* Begin IRemoteSessionChannel implementation */
 	static FString StaticType();
 	virtual FString GetType() const override { return StaticType(); }
+	virtual bool SetConnection(TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection) override;
 	/* End IRemoteSessionChannel implementation */
 
 protected:
@@ -46,20 +176,49 @@ protected:
 	/** Underlying connection */
 	TWeakPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> Connection;
 
+	/** Sends frames on Connection */
+	TWeakPtr<FRemoteSessionSender, ESPMode::ThreadSafe> Sender;
+
+	/** Receives frames on Connection without copying them */
+	TWeakPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> Receiver;
+
 	/** Our role */
 	ERemoteSessionChannelMode Role;
 
-	/** Send an image to connected clients */
-	void		SendImageToClients(int32 Width, int32 Height, const TArray<FColor>& ImageData);
+	/** Send an image to connected clients. Timing has the index and capture times filled in */
+	void		SendImageToClients(int32 Width, int32 Height, const TArray<FColor>& ImageData, FRemoteSessionFrameTiming Timing);
+
+	/** Sends an encoded frame over UDP, the sender, or the connection, whichever we have */
+	void		SendEncodedFrame(const FEncodedFrame& Frame);
+
+	/** Adds a frame to RecentFrames, replacing the oldest once it's full */
+	void		AddRecentFrame(const FEncodedFrame& Frame);
 
 	/** Bound to receive incoming images */
 	void	ReceiveHostImage(FBackChannelOSCMessage & Message, FBackChannelOSCDispatch & Dispatch);
 
+	/** Bound to receive incoming images in place when we have a receiver */
+	void	ReceiveHostImageInPlace(FRemoteSessionReceivedMessage& Message);
+
+	/** Bound to receive the client's request for UDP frames */
+	void	ReceiveUDPFrameRequest(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch);
+
+	/** Called on the UDP thread when a frame has been reassembled */
+	void	ReceiveUDPFrame(int32 FrameIndex, int32 Width, int32 Height, const FRemoteSessionBlobView& Data);
+
+	/** Runs Func as a task on the provided thread. The channel will wait for it to complete before being destroyed */
+	void LaunchTask(ENamedThreads::Type Thread, TFunction<void()>&& Func);
+
+	/** Returns the image format for a codec */
+	static EImageFormat GetImageFormat(const FString& InCodec);
 
 	/** Creates a texture to receive images into */
 	void CreateTexture(const int32 InSlot, const int32 InWidth, const int32 InHeight);
 
-	TSharedPtr<FFrameGrabber>				FrameGrabber;
+	TSharedPtr<IRemoteSessionFrameSource>	FrameSource;
+
+	/** Size of the frames FrameSource produces */
+	FIntPoint								CaptureSize;
 	
 	struct FImageData
 	{
@@ -72,19 +231,76 @@ protected:
 		int32				Width;
 		int32				Height;
 		TArray<uint8>		ImageData;
+		/** Encoded data that's still in the receive buffer, used instead of ImageData if set */
+		TSharedPtr<FRemoteSessionBlobView, ESPMode::ThreadSafe>	EncodedView;
 		int32				ImageIndex;
+		/** Receive and decode times, passed on to OnFrameDisplayed */
+		FRemoteSessionFrameTiming	Timing;
 	};
 
-	FCriticalSection										IncomingImageMutex;
+	/** Client: records a frame that will never be shown in our timeline */
+	void AddDroppedFrame(const FRemoteSessionFrameTiming& InTiming);
+
+	/** Queues an encoded image and kicks a decode task if one isn't running */
+	void QueueEncodedImage(TSharedPtr<FImageData, ESPMode::ThreadSafe> InImage);
+
+	mutable FCriticalSection								IncomingImageMutex;
 	TArray<TSharedPtr<FImageData, ESPMode::ThreadSafe>>		IncomingEncodedImages;
 
-	FCriticalSection										DecodedImageMutex;
+	mutable FCriticalSection								DecodedImageMutex;
 	TArray<TSharedPtr<FImageData>>							IncomingDecodedImages;
 	FThreadSafeCounter										NumDecodingTasks;
 
+	/** Timings of recent frames, for GetTimeline */
+	TSharedPtr<FRemoteSessionFrameTimeline, ESPMode::ThreadSafe>	Timeline;
+
+	/** Totals for GetFrameStats, updated on whichever thread the frame is on */
+	FThreadSafeCounter										FramesCaptured;
+	FThreadSafeCounter										FramesEncoded;
+	FThreadSafeCounter										FramesReceived;
+	FThreadSafeCounter										FramesDecoded;
+	FThreadSafeCounter										FramesUploaded;
+	FThreadSafeCounter										FramesDropped;
+
+	/** Host: where and how to send UDP frames once the client asks */
+	TSharedPtr<FInternetAddr>								UDPClientAddress;
+	int32													UDPFragmentSize;
+	int32													UDPGroupSize;
+
+	FCriticalSection										UDPSenderMutex;
+	TSharedPtr<FRemoteSessionUDPFrameSender, ESPMode::ThreadSafe>	UDPSender;
+
+	/** Client: receives UDP frames */
+	TUniquePtr<FRemoteSessionUDPFrameReceiver>				UDPReceiver;
+
+	/** Host: ring of recently sent frames. NextRecentFrame is where the next one goes */
+	mutable FCriticalSection								RecentFramesMutex;
+	TArray<FEncodedFrame>									RecentFrames;
+	int32													NextRecentFrame;
+	int32													FrameHistorySize;
+
+	/** Encode/decode tasks that may still reference us */
+	FCriticalSection										PendingTasksMutex;
+	FGraphEventArray										PendingTasks;
+
+	/** Codec in use, can be set on the receive thread while the game thread is encoding */
+	mutable FCriticalSection								CodecMutex;
+	FString													Codec;
+
 	UTexture2D*												DecodedTextures[2];
 	int32													DecodedTextureIndex;
 
+	/** Host: marker drawn into captured frames, set and read on the game thread */
+	int32													ProbeMarkerId;
+
+	/** Client: read on decode tasks */
+	FThreadSafeBool											bReadProbeMarkers;
+
+	/** Held while broadcasting, so a handler that's been removed is never called again */
+	FCriticalSection										TimingDelegateMutex;
+	FOnRemoteSessionFrameTiming								FrameSentDelegate;
+	FOnRemoteSessionFrameTiming								FrameDisplayedDelegate;
+
 	/** Time we last sent an image */
 	double LastSentImageTime;
 	int KickedTaskCount;
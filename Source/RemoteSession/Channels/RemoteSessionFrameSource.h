@@ -0,0 +1,45 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSceneViewport;
+class UTextureRenderTarget2D;
+
+/*
+	Provides the pixels the framebuffer channel encodes and sends. Everything is called on the game thread.
+
+	The channel ticks its source every frame and only takes a frame from it when one is due at the current framerate,
+	so sources that have to render or read back can start that work in Tick and hand over the result in TakeFrame.
+*/
+class REMOTESESSION_API IRemoteSessionFrameSource
+{
+public:
+
+	virtual ~IRemoteSessionFrameSource() {}
+
+	/** Called every tick while the source is in use */
+	virtual void Tick() {}
+
+	/** Moves the newest frame that hasn't been taken into OutPixels. Returns false if there isn't one */
+	virtual bool TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize) = 0;
+
+	/** Size of the frames this source produces */
+	virtual FIntPoint GetSize() const = 0;
+
+	/** Describes the source for logging */
+	virtual FString GetDescription() const = 0;
+
+	/** Captures a viewport's backbuffer, scaled to CaptureSize (or the viewport's size if zero) */
+	static TSharedRef<IRemoteSessionFrameSource> CreateForViewport(TSharedRef<FSceneViewport> Viewport, FIntPoint CaptureSize = FIntPoint::ZeroValue);
+
+	/** Reads back a render target each frame, e.g. a scene capture that should be streamed instead of the whole screen. The target must be kept alive by the caller */
+	static TSharedRef<IRemoteSessionFrameSource> CreateForRenderTarget(UTextureRenderTarget2D* RenderTarget);
+
+	/**
+		Generates a moving test pattern without rendering anything, for -nullrhi runs and benchmarks. Complexity is 0-1, at 0
+		frames are smooth gradients that compress well and at 1 they're noise that barely compresses at all
+	*/
+	static TSharedRef<IRemoteSessionFrameSource> CreateSynthetic(FIntPoint Size, float Complexity = 0.5f);
+};
@@ -7,6 +7,8 @@
 
 class FBackChannelOSCMessage;
 class FBackChannelOSCDispatch;
+class FRemoteSessionSender;
+class FRemoteSessionInputRecorder;
 
 class REMOTESESSION_API FRemoteSessionInputChannel : public IRemoteSessionChannel, public IRecordingMessageHandlerWriter
 {
@@ -26,11 +28,31 @@ public:
 
 	void SetInputRect(const FVector2D& TopLeft, const FVector2D& Extents);
 
+	/** Specifies the sender to use for outgoing messages. Nothing is sent until it is set */
+	void SetSender(TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> InSender);
+
+	/** Also writes every input message we send or receive to InRecorder. Null stops */
+	void SetRecorder(TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> InRecorder);
+
+	/** Client: sends a latency probe with this id, after any input already sent */
+	void SendLatencyProbe(int32 InId);
+
+	/** Host: the id of the last latency probe received, or -1 if there hasn't been one for longer than the client waits */
+	int32 GetLatencyProbe() const;
+
 	static FString StaticType();
 	virtual FString GetType() const override { return StaticType(); }
 
+	virtual bool SetConnection(TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection) override;
+
 protected:
 
+	/** Sends a message to the other end's message handler */
+	void SendMessage(const TCHAR* MsgName, const TArray<uint8>& Data);
+
+	/** Host: called on the game thread when a probe is played, after the input that was sent before it */
+	void OnLatencyProbe(int32 InId);
+
 	TWeakPtr<FGenericApplicationMessageHandler> DefaultHandler;
 
 	TSharedPtr<FRecordingMessageHandler> RecordingHandler;
@@ -40,6 +62,16 @@ protected:
 
 	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> Connection;
 
+	TWeakPtr<FRemoteSessionSender, ESPMode::ThreadSafe> Sender;
+
+	/** Received messages arrive on the receive thread */
+	FCriticalSection RecorderMutex;
+	TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> Recorder;
+
+	/** Set on the game thread, read when frames are captured */
+	mutable FCriticalSection LatencyProbeMutex;
+	int32 LatencyProbeId;
+	double LatencyProbeTime;
 
 	ERemoteSessionChannelMode Role;
 };
\ No newline at end of file
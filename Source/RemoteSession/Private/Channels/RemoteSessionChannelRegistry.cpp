@@ -0,0 +1,74 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Channels/RemoteSessionChannelRegistry.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "RemoteSession.h"
+
+FRemoteSessionChannelRegistry& FRemoteSessionChannelRegistry::Get()
+{
+	static FRemoteSessionChannelRegistry Instance;
+	return Instance;
+}
+
+FRemoteSessionChannelRegistry::FRemoteSessionChannelRegistry()
+{
+	// host plays back input the client records
+	AddFactory(*FRemoteSessionInputChannel::StaticType(), FOnRemoteSessionChannelCreate::CreateLambda([](const FRemoteSessionChannelCreationContext& Context) {
+		return TSharedPtr<IRemoteSessionChannel>(MakeShareable(new FRemoteSessionInputChannel(Context.bIsHost ? ERemoteSessionChannelMode::Receive : ERemoteSessionChannelMode::Send, Context.Connection)));
+	}));
+
+	// host captures frames the client displays
+	AddFactory(*FRemoteSessionFrameBufferChannel::StaticType(), FOnRemoteSessionChannelCreate::CreateLambda([](const FRemoteSessionChannelCreationContext& Context) {
+		return TSharedPtr<IRemoteSessionChannel>(MakeShareable(new FRemoteSessionFrameBufferChannel(Context.bIsHost ? ERemoteSessionChannelMode::Send : ERemoteSessionChannelMode::Receive, Context.Connection)));
+	}));
+}
+
+void FRemoteSessionChannelRegistry::AddFactory(const FName& InType, FOnRemoteSessionChannelCreate InFactory)
+{
+	FScopeLock Lock(&FactoryMutex);
+
+	if (Factories.Contains(InType))
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Replacing existing factory for channel %s"), *InType.ToString());
+	}
+
+	Factories.Add(InType, InFactory);
+}
+
+void FRemoteSessionChannelRegistry::RemoveFactory(const FName& InType)
+{
+	FScopeLock Lock(&FactoryMutex);
+	Factories.Remove(InType);
+}
+
+bool FRemoteSessionChannelRegistry::IsRegistered(const FName& InType) const
+{
+	FScopeLock Lock(&FactoryMutex);
+	return Factories.Contains(InType);
+}
+
+TSharedPtr<IRemoteSessionChannel> FRemoteSessionChannelRegistry::CreateChannel(const FName& InType, const FRemoteSessionChannelCreationContext& InContext) const
+{
+	FOnRemoteSessionChannelCreate Factory;
+
+	{
+		FScopeLock Lock(&FactoryMutex);
+		Factory = Factories.FindRef(InType);
+	}
+
+	if (Factory.IsBound() == false)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("No factory registered for channel %s"), *InType.ToString());
+		return nullptr;
+	}
+
+	TSharedPtr<IRemoteSessionChannel> Channel = Factory.Execute(InContext);
+
+	if (Channel.IsValid() && FName(*Channel->GetType()) != InType)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Factory for channel %s created a channel of type %s"), *InType.ToString(), *Channel->GetType());
+	}
+
+	return Channel;
+}
@@ -0,0 +1,33 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Channels/RemoteSessionChannel.h"
+
+/*
+	Maps channel types to the factories that create them. The built-in input and framebuffer channels are
+	registered here too, games can add their own through IRemoteSessionModule::AddChannelFactory.
+*/
+class FRemoteSessionChannelRegistry
+{
+public:
+
+	static FRemoteSessionChannelRegistry& Get();
+
+	void AddFactory(const FName& InType, FOnRemoteSessionChannelCreate InFactory);
+
+	void RemoveFactory(const FName& InType);
+
+	bool IsRegistered(const FName& InType) const;
+
+	/** Creates a channel of InType, or returns null if there's no factory for it */
+	TSharedPtr<IRemoteSessionChannel> CreateChannel(const FName& InType, const FRemoteSessionChannelCreationContext& InContext) const;
+
+protected:
+
+	FRemoteSessionChannelRegistry();
+
+	mutable FCriticalSection						FactoryMutex;
+	TMap<FName, FOnRemoteSessionChannelCreate>		Factories;
+};
@@ -1,24 +1,31 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 #include "Channels/RemoteSessionFrameBufferChannel.h"
 #include "RemoteSession.h"
+#include "RemoteSession/RemoteSessionRole.h"
 #include "Protocol/OSC/BackChannelOSCConnection.h"
 #include "Protocol/OSC/BackChannelOSCMessage.h"
 #include "HAL/IConsoleManager.h"
-#include "FrameGrabber.h"
+#include "Channels/RemoteSessionFrameSource.h"
 #include "Async/Async.h"
 #include "IImageWrapper.h"
 #include "IImageWrapperModule.h"
 #include "Engine/Texture2D.h"
 #include "Modules/ModuleManager.h"
-
-DECLARE_CYCLE_STAT(TEXT("RSFrameBufferCap"), STAT_FrameBufferCapture, STATGROUP_Game);
-DECLARE_CYCLE_STAT(TEXT("RSImageCompression"), STAT_ImageCompression, STATGROUP_Game);
-
-DECLARE_CYCLE_STAT(TEXT("RSTextureUpdate"), STAT_TextureUpdate, STATGROUP_Game);
-DECLARE_CYCLE_STAT(TEXT("RSImageDecompression"), STAT_ImageDecompression, STATGROUP_Game);
-DECLARE_CYCLE_STAT(TEXT("RSNumTicks"), STAT_RSNumTicks, STATGROUP_Game);
-DECLARE_CYCLE_STAT(TEXT("RSReadyFrameCount"), STAT_RSNumFrames, STATGROUP_Game);
-DECLARE_CYCLE_STAT(TEXT("RSDecodingFrameCount"), STAT_RSDecodingFrames, STATGROUP_Game);
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Transport/RemoteSessionUDPFrameTransport.h"
+#include "IPAddress.h"
+#include "RemoteSessionStats.h"
+#include "RemoteSessionTrace.h"
+#include "Channels/RemoteSessionFrameTimeline.h"
+#include "Channels/RemoteSessionLatencyProbe.h"
+
+DECLARE_CYCLE_STAT(TEXT("Frame Capture"), STAT_FrameBufferCapture, STATGROUP_RemoteSession);
+DECLARE_CYCLE_STAT(TEXT("Frame Encode"), STAT_ImageCompression, STATGROUP_RemoteSession);
+
+DECLARE_CYCLE_STAT(TEXT("Texture Update"), STAT_TextureUpdate, STATGROUP_RemoteSession);
+DECLARE_CYCLE_STAT(TEXT("Frame Decode"), STAT_ImageDecompression, STATGROUP_RemoteSession);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Framebuffer Ticks"), STAT_RSNumTicks, STATGROUP_RemoteSession);
 
 static int32 FramerateMasterSetting = 0;
 static FAutoConsoleVariableRef CVarFramerateOverride(
@@ -43,7 +50,16 @@ FRemoteSessionFrameBufferChannel::FRemoteSessionFrameBufferChannel(ERemoteSessio
 	DecodedTextureIndex = 0;
 	NumSentImages = 0;
 	KickedTaskCount = 0;
+	UDPFragmentSize = 0;
+	UDPGroupSize = 0;
+	NextRecentFrame = 0;
+	FrameHistorySize = 0;
+	CaptureSize = FIntPoint::ZeroValue;
+	ProbeMarkerId = -1;
+	Timeline = MakeShareable(new FRemoteSessionFrameTimeline());
 	Role = InRole;
+	// what every version of the protocol has used
+	Codec = TEXT("jpg");
 
 	if (Role == ERemoteSessionChannelMode::Receive)
 	{
@@ -54,17 +70,34 @@ FRemoteSessionFrameBufferChannel::FRemoteSessionFrameBufferChannel(ERemoteSessio
 
 FRemoteSessionFrameBufferChannel::~FRemoteSessionFrameBufferChannel()
 {
-	while (NumDecodingTasks.GetValue() > 0)
+	// stop the UDP thread before it can call us
+	UDPReceiver = nullptr;
+
+	TSharedPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> LocalReceiver = Receiver.Pin();
+
+	if (LocalReceiver.IsValid())
 	{
-		FPlatformProcess::SleepNoStats(0);
+		LocalReceiver->UnbindHandler(TEXT("/Screen"));
 	}
 
-	if (FrameGrabber.IsValid())
+	// wait for any in-flight encode/decode tasks since they reference us
+	FGraphEventArray TasksToWaitFor;
+
 	{
-		FrameGrabber->StopCapturingFrames();
-		FrameGrabber = nullptr;
+		FScopeLock Lock(&PendingTasksMutex);
+		TasksToWaitFor = MoveTemp(PendingTasks);
 	}
 
+	if (TasksToWaitFor.Num())
+	{
+		FTaskGraphInterface::Get().WaitUntilTasksComplete(TasksToWaitFor);
+	}
+
+	FrameSource = nullptr;
+
+	// anything still queued is never shown
+	DEC_DWORD_STAT_BY(STAT_RSDecodeQueue, IncomingEncodedImages.Num() + IncomingDecodedImages.Num());
+
 	for (int32 i = 0; i < 2; i++)
 	{
 		if (DecodedTextures[i])
@@ -94,10 +127,172 @@ void FRemoteSessionFrameBufferChannel::SetCaptureQuality(int32 InQuality, int32
 	}
 }
 
-void FRemoteSessionFrameBufferChannel::SetCaptureViewport(TSharedRef<FSceneViewport> Viewport)
+bool FRemoteSessionFrameBufferChannel::SetConnection(TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection)
+{
+	// UDP is negotiated again on the new connection
+	{
+		FScopeLock Lock(&UDPSenderMutex);
+		UDPSender = nullptr;
+	}
+
+	UDPReceiver = nullptr;
+	UDPClientAddress = nullptr;
+
+	Connection = InConnection;
+
+	if (Role == ERemoteSessionChannelMode::Receive)
+	{
+		InConnection->GetDispatchMap().GetAddressHandler(TEXT("/Screen")).AddRaw(this, &FRemoteSessionFrameBufferChannel::ReceiveHostImage);
+		InConnection->SetMessageOptions(TEXT("/Screen"), 1);
+	}
+
+	// our textures and the capture are kept, send a frame right away rather than waiting for the next interval
+	LastSentImageTime = 0;
+
+	return true;
+}
+
+void FRemoteSessionFrameBufferChannel::SetSender(TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> InSender)
+{
+	Sender = InSender;
+}
+
+void FRemoteSessionFrameBufferChannel::SetReceiver(TSharedPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> InReceiver)
+{
+	Receiver = InReceiver;
+
+	if (Role == ERemoteSessionChannelMode::Receive && InReceiver.IsValid())
+	{
+		// images will now arrive here instead of via the OSC dispatch map
+		InReceiver->BindHandler(TEXT("/Screen"), FRemoteSessionMessageHandler::CreateRaw(this, &FRemoteSessionFrameBufferChannel::ReceiveHostImageInPlace));
+	}
+}
+
+void FRemoteSessionFrameBufferChannel::AllowUDPFrames(TSharedRef<FInternetAddr> ClientAddress, int32 FragmentSize, int32 GroupSize)
+{
+	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> LocalConnection = Connection.Pin();
+
+	if (Role == ERemoteSessionChannelMode::Send && LocalConnection.IsValid())
+	{
+		UDPClientAddress = ClientAddress;
+		UDPFragmentSize = FragmentSize;
+		UDPGroupSize = GroupSize;
+
+		LocalConnection->GetDispatchMap().GetAddressHandler(TEXT("/ScreenTransport")).AddRaw(this, &FRemoteSessionFrameBufferChannel::ReceiveUDPFrameRequest);
+	}
+}
+
+bool FRemoteSessionFrameBufferChannel::RequestUDPFrames(TSharedRef<FInternetAddr> HostAddress)
+{
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> LocalSender = Sender.Pin();
+
+	if (Role != ERemoteSessionChannelMode::Receive || LocalSender.IsValid() == false)
+	{
+		return false;
+	}
+
+	UDPReceiver = MakeUnique<FRemoteSessionUDPFrameReceiver>(HostAddress);
+
+	if (UDPReceiver->IsValid() == false)
+	{
+		UDPReceiver = nullptr;
+		return false;
+	}
+
+	UDPReceiver->OnFrameReceived().BindRaw(this, &FRemoteSessionFrameBufferChannel::ReceiveUDPFrame);
+
+	// host will send to the address our TCP connection comes from, on this port
+	FBackChannelOSCMessage Msg(TEXT("/ScreenTransport"));
+	Msg.Write(UDPReceiver->GetPort());
+	LocalSender->SendPacket(Msg, StaticType());
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Requested frames over UDP on port %d"), UDPReceiver->GetPort());
+
+	return true;
+}
+
+void FRemoteSessionFrameBufferChannel::ReceiveUDPFrameRequest(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
+	int32 Port = 0;
+	Message << Port;
+
+	if (UDPClientAddress.IsValid() == false || Port <= 0)
+	{
+		return;
+	}
+
+	TSharedRef<FInternetAddr> Destination = UDPClientAddress->Clone();
+	Destination->SetPort(Port);
+
+	TSharedPtr<FRemoteSessionUDPFrameSender, ESPMode::ThreadSafe> NewSender = MakeShareable(new FRemoteSessionUDPFrameSender(Destination, UDPFragmentSize, UDPGroupSize));
+
+	if (NewSender->IsValid())
+	{
+		FScopeLock Lock(&UDPSenderMutex);
+		UDPSender = NewSender;
+
+		UE_LOG(LogRemoteSession, Log, TEXT("Sending frames over UDP to %s"), *Destination->ToString(true));
+	}
+}
+
+void FRemoteSessionFrameBufferChannel::ReceiveUDPFrame(int32 FrameIndex, int32 Width, int32 Height, const FRemoteSessionBlobView& Data)
+{
+	TSharedPtr<FImageData, ESPMode::ThreadSafe> ReceivedImage = MakeShareable(new FImageData);
+	ReceivedImage->Width = Width;
+	ReceivedImage->Height = Height;
+	ReceivedImage->EncodedView = MakeShareable(new FRemoteSessionBlobView(Data));
+	ReceivedImage->ImageIndex = FrameIndex;
+
+	QueueEncodedImage(ReceivedImage);
+}
+
+void FRemoteSessionFrameBufferChannel::SetCaptureViewport(TSharedRef<FSceneViewport> Viewport, FIntPoint InCaptureSize)
+{
+	SetFrameSource(IRemoteSessionFrameSource::CreateForViewport(Viewport, InCaptureSize));
+}
+
+void FRemoteSessionFrameBufferChannel::SetFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource)
+{
+	FrameSource = InSource;
+	CaptureSize = FrameSource.IsValid() ? FrameSource->GetSize() : FIntPoint::ZeroValue;
+
+	if (FrameSource.IsValid())
+	{
+		UE_LOG(LogRemoteSession, Log, TEXT("Capturing frames from %s"), *FrameSource->GetDescription());
+	}
+}
+
+TArray<FString> FRemoteSessionFrameBufferChannel::GetSupportedCodecs()
+{
+	TArray<FString> Codecs;
+	Codecs.Add(TEXT("jpg"));
+	// lossless and much larger, but useful over shared memory or for capturing reference images
+	Codecs.Add(TEXT("png"));
+	return Codecs;
+}
+
+bool FRemoteSessionFrameBufferChannel::SetCodec(const FString& InCodec)
+{
+	if (GetSupportedCodecs().Contains(InCodec) == false)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Codec %s is not supported"), *InCodec);
+		return false;
+	}
+
+	FScopeLock Lock(&CodecMutex);
+	Codec = InCodec;
+	return true;
+}
+
+FString FRemoteSessionFrameBufferChannel::GetCodec() const
 {
-	FrameGrabber = MakeShareable(new FFrameGrabber(Viewport, Viewport->GetSize()));
-	FrameGrabber->StartCapturingFrames();
+	FScopeLock Lock(&CodecMutex);
+	return Codec;
+}
+
+EImageFormat FRemoteSessionFrameBufferChannel::GetImageFormat(const FString& InCodec)
+{
+	return InCodec == TEXT("png") ? EImageFormat::PNG : EImageFormat::JPEG;
 }
 
 UTexture2D* FRemoteSessionFrameBufferChannel::GetHostScreen() const
@@ -109,47 +304,64 @@ void FRemoteSessionFrameBufferChannel::Tick(const float InDeltaTime)
 {
 	INC_DWORD_STAT(STAT_RSNumTicks);
 
-	if (FrameGrabber.IsValid())
+	if (FrameSource.IsValid())
 	{
 		SCOPE_CYCLE_COUNTER(STAT_FrameBufferCapture);
 
-		FrameGrabber->CaptureThisFrame(FFramePayloadPtr());
+		// the index this frame will have if it's taken
+		SCOPE_REMOTESESSION_TRACE("Capture", NumSentImages + 1);
+
+		const double CaptureStartTime = FPlatformTime::Seconds();
+
+		FrameSource->Tick();
+
+		const double ElapsedImageTimeMS = (FPlatformTime::Seconds() - LastSentImageTime) * 1000;
+		const int32 DesiredFrameTimeMS = 1000 / FramerateMasterSetting;
 
-		TArray<FCapturedFrameData> Frames = FrameGrabber->GetCapturedFrames();
+		TArray<FColor> Pixels;
+		FIntPoint Size;
 
-		if (Frames.Num())
+		if (ElapsedImageTimeMS >= DesiredFrameTimeMS && FrameSource->TakeFrame(Pixels, Size))
 		{
-			const double ElapsedImageTimeMS = (FPlatformTime::Seconds() - LastSentImageTime) * 1000;
-			const int32 DesiredFrameTimeMS = 1000 / FramerateMasterSetting;
+			FramesCaptured.Increment();
+			INC_DWORD_STAT(STAT_RSFramesCaptured);
 
-			if (ElapsedImageTimeMS >= DesiredFrameTimeMS)
-			{
-				FCapturedFrameData& LastFrame = Frames.Last();
+			TArray<FColor>* ColorData = new TArray<FColor>(MoveTemp(Pixels));
+
+			// numbered here rather than once encoded, so traces of every stage agree on the index
+			FRemoteSessionFrameTiming Timing;
+			Timing.ImageIndex = ++NumSentImages;
+			Timing.CaptureTime = FPlatformTime::Seconds();
+			Timing.CaptureMS = (Timing.CaptureTime - CaptureStartTime) * 1000.0;
 
-				TArray<FColor>* ColorData = new TArray<FColor>(MoveTemp(LastFrame.ColorBuffer));
+			// decided now so only frames captured after a probe arrived carry its marker
+			const int32 MarkerId = ProbeMarkerId;
 
-				FIntPoint Size = LastFrame.BufferSize;
+			NumDecodingTasks.Increment();
 
-				NumDecodingTasks.Increment();
+			LaunchTask(ENamedThreads::AnyBackgroundHiPriTask, [this, Size, ColorData, Timing, MarkerId]()
+			{
+				SCOPE_CYCLE_COUNTER(STAT_ImageCompression);
+				SCOPE_REMOTESESSION_TRACE("Encode", Timing.ImageIndex);
 
-				AsyncTask(ENamedThreads::AnyBackgroundHiPriTask, [this, Size, ColorData]()
+				for (FColor& Color : *ColorData)
 				{
-					SCOPE_CYCLE_COUNTER(STAT_ImageCompression);
+					Color.A = 255;
+				}
 
-					for (FColor& Color : *ColorData)
-					{
-						Color.A = 255;
-					}
+				if (MarkerId >= 0)
+				{
+					FRemoteSessionProbeMarker::Draw(*ColorData, Size.X, Size.Y, MarkerId);
+				}
 
-					SendImageToClients(Size.X, Size.Y, *ColorData);
+				SendImageToClients(Size.X, Size.Y, *ColorData, Timing);
 
-					delete ColorData;
+				delete ColorData;
 
-					NumDecodingTasks.Decrement();
-				});
+				NumDecodingTasks.Decrement();
+			});
 
-				LastSentImageTime = FPlatformTime::Seconds();
-			}
+			LastSentImageTime = FPlatformTime::Seconds();
 		}
 	}
 	
@@ -164,12 +376,22 @@ void FRemoteSessionFrameBufferChannel::Tick(const float InDeltaTime)
 			FScopeLock ImageLock(&DecodedImageMutex);
 			if (IncomingDecodedImages.Num())
 			{
-				INC_DWORD_STAT(STAT_RSNumFrames);
 				QueuedImage = IncomingDecodedImages.Last();
 
 				UE_LOG(LogRemoteSession, Verbose, TEXT("GT: Image %d is ready, discarding %d earlier images"),
 					QueuedImage->ImageIndex, IncomingDecodedImages.Num()-1);
 
+				for (int32 i = 0; i < IncomingDecodedImages.Num() - 1; i++)
+				{
+					AddDroppedFrame(IncomingDecodedImages[i]->Timing);
+				}
+
+				FramesUploaded.Increment();
+				FramesDropped.Add(IncomingDecodedImages.Num() - 1);
+				INC_DWORD_STAT(STAT_RSFramesUploaded);
+				INC_DWORD_STAT_BY(STAT_RSFramesDropped, IncomingDecodedImages.Num() - 1);
+				DEC_DWORD_STAT_BY(STAT_RSDecodeQueue, IncomingDecodedImages.Num());
+
 				IncomingDecodedImages.Empty();
 			}
 		}
@@ -189,8 +411,24 @@ void FRemoteSessionFrameBufferChannel::Tick(const float InDeltaTime)
 			FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(0, 0, 0, 0, QueuedImage->Width, QueuedImage->Height);
 			TArray<uint8>* TextureData = new TArray<uint8>(MoveTemp(QueuedImage->ImageData));
 
-			DecodedTextures[NextImage]->UpdateTextureRegions(0, 1, Region, 4 * QueuedImage->Width, 8, TextureData->GetData(), [this, NextImage, TextureData](auto InTextureData, auto InRegions) {
+			const double UploadStartTime = FPlatformTime::Seconds();
+			FRemoteSessionFrameTiming Timing = QueuedImage->Timing;
+			TSharedPtr<FRemoteSessionFrameTimeline, ESPMode::ThreadSafe> LocalTimeline = Timeline;
+
+			SCOPE_REMOTESESSION_TRACE("Upload", QueuedImage->ImageIndex);
+
+			DecodedTextures[NextImage]->UpdateTextureRegions(0, 1, Region, 4 * QueuedImage->Width, 8, TextureData->GetData(), [this, NextImage, TextureData, UploadStartTime, Timing, LocalTimeline](auto InTextureData, auto InRegions) mutable {
 				DecodedTextureIndex = NextImage;
+
+				Timing.DisplayTime = FPlatformTime::Seconds();
+				Timing.UploadMS = (Timing.DisplayTime - UploadStartTime) * 1000.0;
+				LocalTimeline->Add(Timing);
+
+				{
+					FScopeLock Lock(&TimingDelegateMutex);
+					FrameDisplayedDelegate.Broadcast(Timing);
+				}
+
 				delete TextureData; // delete array, not underlying data that UpdateTextureRegions passes us
 				delete InRegions;
 			});
@@ -201,46 +439,293 @@ void FRemoteSessionFrameBufferChannel::Tick(const float InDeltaTime)
 	}
 }
 
-void FRemoteSessionFrameBufferChannel::SendImageToClients(int32 Width, int32 Height, const TArray<FColor>& ImageData)
+FDelegateHandle FRemoteSessionFrameBufferChannel::AddFrameSentHandler(const FOnRemoteSessionFrameTiming::FDelegate& Handler)
+{
+	FScopeLock Lock(&TimingDelegateMutex);
+	return FrameSentDelegate.Add(Handler);
+}
+
+void FRemoteSessionFrameBufferChannel::RemoveFrameSentHandler(FDelegateHandle Handle)
+{
+	FScopeLock Lock(&TimingDelegateMutex);
+	FrameSentDelegate.Remove(Handle);
+}
+
+FDelegateHandle FRemoteSessionFrameBufferChannel::AddFrameDisplayedHandler(const FOnRemoteSessionFrameTiming::FDelegate& Handler)
+{
+	FScopeLock Lock(&TimingDelegateMutex);
+	return FrameDisplayedDelegate.Add(Handler);
+}
+
+void FRemoteSessionFrameBufferChannel::RemoveFrameDisplayedHandler(FDelegateHandle Handle)
+{
+	FScopeLock Lock(&TimingDelegateMutex);
+	FrameDisplayedDelegate.Remove(Handle);
+}
+
+void FRemoteSessionFrameBufferChannel::SendImageToClients(int32 Width, int32 Height, const TArray<FColor>& ImageData, FRemoteSessionFrameTiming Timing)
 {
 	static bool SkipImages = FParse::Param(FCommandLine::Get(), TEXT("remote.noimage"));
 
 	// Can be released on the main thread at anytime so hold onto it
 	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> LocalConnection = Connection.Pin();
 
-	if (LocalConnection.IsValid() && SkipImages == false)
+	if (LocalConnection.IsValid() == false || SkipImages)
+	{
+		FramesDropped.Increment();
+		INC_DWORD_STAT(STAT_RSFramesDropped);
+	}
+	else
 	{
 		const double TimeNow = FPlatformTime::Seconds();
 
-		// created on demand because there can be multiple SendImage requests in flight
-		IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(FName("ImageWrapper"));
+		// encoded into a shared array so it can be sent by reference rather than copied into the message,
+		// and kept for clients that join later
+		FEncodedFrame Frame;
+		Frame.Codec = GetCodec();
+		Frame.Data = MakeShareable(new TArray<uint8>());
 
-		if (ImageWrapperModule != nullptr)
+		if (EncodeImage(Frame.Codec, QualityMasterSetting, Width, Height, ImageData, *Frame.Data))
 		{
-			TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule->CreateImageWrapper(EImageFormat::JPEG);
+			Frame.Width = Width;
+			Frame.Height = Height;
+			Frame.ImageIndex = Timing.ImageIndex;
+			Frame.EncodeTime = FPlatformTime::Seconds();
+
+			FramesEncoded.Increment();
+			INC_DWORD_STAT(STAT_RSFramesEncoded);
 
-			ImageWrapper->SetRaw(ImageData.GetData(), ImageData.GetAllocatedSize(), Width, Height, ERGBFormat::BGRA, 8);
+			Timing.Width = Width;
+			Timing.Height = Height;
+			Timing.EncodedBytes = Frame.Data->Num();
+			Timing.EncodeMS = (Frame.EncodeTime - TimeNow) * 1000.0;
 
-			TArray<uint8> JPGData = ImageWrapper->GetCompressed(QualityMasterSetting);
+			// added before sending so the send time can be filled in
+			Timeline->Add(Timing);
 
-			FBackChannelOSCMessage Msg(TEXT("/Screen"));
-			Msg.Write(Width);
-			Msg.Write(Height);
-			Msg.Write(JPGData);
-			Msg.Write(++NumSentImages);
-			LocalConnection->SendPacket(Msg);
+			SendEncodedFrame(Frame);
+			AddRecentFrame(Frame);
+
+			{
+				FScopeLock Lock(&TimingDelegateMutex);
+				FrameSentDelegate.Broadcast(Timing);
+			}
 
 			UE_LOG(LogRemoteSession, Verbose, TEXT("Sent image %d in %.02f ms"),
-				NumSentImages, (FPlatformTime::Seconds() - TimeNow) * 1000.0);
+				Frame.ImageIndex, (FPlatformTime::Seconds() - TimeNow) * 1000.0);
+		}
+		else
+		{
+			FramesDropped.Increment();
+			INC_DWORD_STAT(STAT_RSFramesDropped);
 		}
 	}
 }
 
-void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+bool FRemoteSessionFrameBufferChannel::EncodeImage(const FString& InCodec, int32 InQuality, int32 Width, int32 Height, const TArray<FColor>& ImageData, TArray<uint8>& OutData)
+{
+	// created on demand because there can be multiple encodes in flight
+	IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(FName("ImageWrapper"));
+
+	if (ImageWrapperModule == nullptr)
+	{
+		return false;
+	}
+
+	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule->CreateImageWrapper(GetImageFormat(InCodec));
+
+	ImageWrapper->SetRaw(ImageData.GetData(), ImageData.GetAllocatedSize(), Width, Height, ERGBFormat::BGRA, 8);
+
+	const TArray<uint8>& CompressedData = ImageWrapper->GetCompressed(InQuality);
+
+	// steal the compressed data from the wrapper, which we're about to release
+	OutData = MoveTemp(*((TArray<uint8>*)&CompressedData));
+
+	return OutData.Num() > 0;
+}
+
+bool FRemoteSessionFrameBufferChannel::DecodeImage(const FString& InCodec, const uint8* Data, int32 Size, TArray<uint8>& OutData)
+{
+	IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(FName("ImageWrapper"));
+
+	if (ImageWrapperModule == nullptr)
+	{
+		return false;
+	}
+
+	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule->CreateImageWrapper(GetImageFormat(InCodec));
+
+	// takes a copy, so Data can be released as soon as we return
+	ImageWrapper->SetCompressed(Data, Size);
+
+	const TArray<uint8>* RawData = nullptr;
+
+	if (ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawData) == false)
+	{
+		return false;
+	}
+
+	OutData = MoveTemp(*((TArray<uint8>*)RawData));
+	return true;
+}
+
+void FRemoteSessionFrameBufferChannel::SendEncodedFrame(const FEncodedFrame& Frame)
+{
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> LocalSender = Sender.Pin();
+	TSharedPtr<FRemoteSessionUDPFrameSender, ESPMode::ThreadSafe> LocalUDPSender;
+
+	{
+		FScopeLock Lock(&UDPSenderMutex);
+		LocalUDPSender = UDPSender;
+	}
+
+	// the sender may still have the frame queued after we're gone
+	TWeakPtr<FRemoteSessionFrameTimeline, ESPMode::ThreadSafe> WeakTimeline = Timeline;
+	const int32 ImageIndex = Frame.ImageIndex;
+
+	auto OnSent = [WeakTimeline, ImageIndex](double SentTime)
+	{
+		TSharedPtr<FRemoteSessionFrameTimeline, ESPMode::ThreadSafe> LocalTimeline = WeakTimeline.Pin();
+
+		if (LocalTimeline.IsValid())
+		{
+			// a kept frame sent again to a new client keeps its original time
+			LocalTimeline->Update(ImageIndex, [SentTime](FRemoteSessionFrameTiming& Timing) {
+				Timing.SendTime = Timing.SendTime > 0 ? Timing.SendTime : SentTime;
+			});
+		}
+	};
+
+	if (LocalUDPSender.IsValid())
+	{
+		SCOPE_REMOTESESSION_TRACE("Send", ImageIndex);
+
+		// lost fragments are either rebuilt from parity or the frame is dropped, never retransmitted
+		LocalUDPSender->SendFrame(Frame.ImageIndex, Frame.Width, Frame.Height, Frame.Data);
+		OnSent(FPlatformTime::Seconds());
+	}
+	else if (LocalSender.IsValid())
+	{
+		FRemoteSessionBlobMessage Msg(TEXT("/Screen"));
+		Msg.Write(Frame.Width);
+		Msg.Write(Frame.Height);
+		Msg.WriteBlob(Frame.Data);
+		Msg.Write(Frame.ImageIndex);
+		LocalSender->SendMessage(Msg, StaticType(), ImageIndex, OnSent);
+	}
+	else
+	{
+		// writing to the connection directly could split the sender's packets, and we aren't configured yet anyway
+		UE_LOG(LogRemoteSession, Verbose, TEXT("No sender for frame %d, dropping it"), ImageIndex);
+	}
+}
+
+void FRemoteSessionFrameBufferChannel::SetFrameHistorySize(int32 InSize)
+{
+	FScopeLock Lock(&RecentFramesMutex);
+
+	// keep what we have, in order, up to the new size
+	TArray<FEncodedFrame> Frames = GetRecentFrames();
+	const int32 NumToKeep = FMath::Min(Frames.Num(), FMath::Max(0, InSize));
+
+	FrameHistorySize = FMath::Max(0, InSize);
+	RecentFrames.Reset();
+	RecentFrames.Append(Frames.GetData() + Frames.Num() - NumToKeep, NumToKeep);
+	NextRecentFrame = 0;
+}
+
+void FRemoteSessionFrameBufferChannel::AddRecentFrame(const FEncodedFrame& Frame)
+{
+	FScopeLock Lock(&RecentFramesMutex);
+
+	if (FrameHistorySize <= 0)
+	{
+		return;
+	}
+
+	if (RecentFrames.Num() < FrameHistorySize)
+	{
+		RecentFrames.Add(Frame);
+	}
+	else
+	{
+		RecentFrames[NextRecentFrame] = Frame;
+		NextRecentFrame = (NextRecentFrame + 1) % FrameHistorySize;
+	}
+}
+
+TArray<FRemoteSessionFrameBufferChannel::FEncodedFrame> FRemoteSessionFrameBufferChannel::GetRecentFrames() const
+{
+	FScopeLock Lock(&RecentFramesMutex);
+
+	// until the ring is full NextRecentFrame is 0 and this is just a copy
+	TArray<FEncodedFrame> Frames;
+	Frames.Reserve(RecentFrames.Num());
+
+	for (int32 i = 0; i < RecentFrames.Num(); i++)
+	{
+		Frames.Add(RecentFrames[(NextRecentFrame + i) % RecentFrames.Num()]);
+	}
+
+	return Frames;
+}
+
+void FRemoteSessionFrameBufferChannel::SeedRecentFrames(const TArray<FEncodedFrame>& InFrames)
+{
+	const FString OurCodec = GetCodec();
+
+	for (const FEncodedFrame& Frame : InFrames)
+	{
+		// the client can't decode frames from a codec it didn't agree to
+		if (Frame.Codec == OurCodec)
+		{
+			AddRecentFrame(Frame);
+
+			// our own frames should follow on from these
+			NumSentImages = FMath::Max(NumSentImages, Frame.ImageIndex);
+		}
+	}
+}
+
+bool FRemoteSessionFrameBufferChannel::SendLatestFrame(double MaxAgeSeconds)
 {
-	int32 Width(0);
-	int32 Height(0);
+	if (Role != ERemoteSessionChannelMode::Send)
+	{
+		return false;
+	}
+
+	FEncodedFrame Latest;
+
+	{
+		FScopeLock Lock(&RecentFramesMutex);
+
+		if (RecentFrames.Num() == 0)
+		{
+			return false;
+		}
+
+		// the slot before the next one to be written is the newest
+		Latest = RecentFrames[(NextRecentFrame + RecentFrames.Num() - 1) % RecentFrames.Num()];
+	}
+
+	const double Age = FPlatformTime::Seconds() - Latest.EncodeTime;
+
+	// better to wait a frame interval than show something from long ago
+	if (Latest.Codec != GetCodec() || Age > MaxAgeSeconds)
+	{
+		return false;
+	}
+
+	SendEncodedFrame(Latest);
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Sent image %d (%dx%d, %.02f secs old) while the first new frame is captured"),
+		Latest.ImageIndex, Latest.Width, Latest.Height, Age);
+
+	return true;
+}
 
+void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
 	TSharedPtr<FImageData, ESPMode::ThreadSafe> ReceivedImage = MakeShareable(new FImageData);
 
 	Message << ReceivedImage->Width;
@@ -248,8 +733,41 @@ void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage&
 	Message << ReceivedImage->ImageData;
 	Message << ReceivedImage->ImageIndex;
 
+	QueueEncodedImage(ReceivedImage);
+}
+
+void FRemoteSessionFrameBufferChannel::ReceiveHostImageInPlace(FRemoteSessionReceivedMessage& Message)
+{
+	TSharedPtr<FImageData, ESPMode::ThreadSafe> ReceivedImage = MakeShareable(new FImageData);
+	ReceivedImage->EncodedView = MakeShareable(new FRemoteSessionBlobView());
+
+	// the encoded data stays in the receive buffer until it's been decoded
+	if (!Message.Read(ReceivedImage->Width)
+		|| !Message.Read(ReceivedImage->Height)
+		|| !Message.Read(*ReceivedImage->EncodedView)
+		|| !Message.Read(ReceivedImage->ImageIndex))
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Received malformed image message"));
+		return;
+	}
+
+	QueueEncodedImage(ReceivedImage);
+}
+
+void FRemoteSessionFrameBufferChannel::QueueEncodedImage(TSharedPtr<FImageData, ESPMode::ThreadSafe> ReceivedImage)
+{
+	ReceivedImage->Timing.ImageIndex = ReceivedImage->ImageIndex;
+	ReceivedImage->Timing.Width = ReceivedImage->Width;
+	ReceivedImage->Timing.Height = ReceivedImage->Height;
+	ReceivedImage->Timing.EncodedBytes = ReceivedImage->EncodedView.IsValid() ? ReceivedImage->EncodedView->Num() : ReceivedImage->ImageData.Num();
+	ReceivedImage->Timing.ReceiveTime = FPlatformTime::Seconds();
+
+	FramesReceived.Increment();
+	INC_DWORD_STAT(STAT_RSFramesReceived);
+
 	FScopeLock Lock(&IncomingImageMutex);
 	IncomingEncodedImages.Add(ReceivedImage);
+	INC_DWORD_STAT(STAT_RSDecodeQueue);
 
 	UE_LOG(LogRemoteSession, Verbose, TEXT("Received Image %d, %d pending"), 
 		ReceivedImage->ImageIndex, IncomingEncodedImages.Num());
@@ -259,7 +777,7 @@ void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage&
 		NumDecodingTasks.Increment();
 		KickedTaskCount++;
 
-		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this]()
+		LaunchTask(ENamedThreads::AnyBackgroundThreadNormalTask, [this]()
 		{
 			SCOPE_CYCLE_COUNTER(STAT_ImageDecompression);
 
@@ -287,38 +805,62 @@ void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage&
 					UE_LOG(LogRemoteSession, Verbose, TEXT("Processing Image %d, discarding %d other pending images"),
 						Image->ImageIndex, IncomingEncodedImages.Num()-1);
 
+					for (int32 i = 0; i < IncomingEncodedImages.Num() - 1; i++)
+					{
+						AddDroppedFrame(IncomingEncodedImages[i]->Timing);
+					}
+
+					FramesDropped.Add(IncomingEncodedImages.Num() - 1);
+					INC_DWORD_STAT_BY(STAT_RSFramesDropped, IncomingEncodedImages.Num() - 1);
+					DEC_DWORD_STAT_BY(STAT_RSDecodeQueue, IncomingEncodedImages.Num());
+
 					IncomingEncodedImages.Empty();
 				}
 
-				IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(FName("ImageWrapper"));
+				TSharedPtr<FImageData> QueuedImage = MakeShareable(new FImageData);
+
+				SCOPE_REMOTESESSION_TRACE("Decode", Image->ImageIndex);
+
+				const bool bDecoded = Image->EncodedView.IsValid()
+					? DecodeImage(GetCodec(), Image->EncodedView->GetData(), Image->EncodedView->Num(), QueuedImage->ImageData)
+					: DecodeImage(GetCodec(), Image->ImageData.GetData(), Image->ImageData.Num(), QueuedImage->ImageData);
+
+				// decoding takes a copy so the receive buffer can go back to the pool
+				Image->EncodedView.Reset();
 
-				if (ImageWrapperModule != nullptr)
+				if (bDecoded)
 				{
-					TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule->CreateImageWrapper(EImageFormat::JPEG);
+					QueuedImage->Width = Image->Width;
+					QueuedImage->Height = Image->Height;
+					QueuedImage->ImageIndex = Image->ImageIndex;
+					QueuedImage->Timing = Image->Timing;
+					QueuedImage->Timing.DecodeMS = (FPlatformTime::Seconds() - StartTime) * 1000.0;
 
-					ImageWrapper->SetCompressed(Image->ImageData.GetData(), Image->ImageData.Num());
+					if (bReadProbeMarkers)
+					{
+						QueuedImage->Timing.ProbeId = FRemoteSessionProbeMarker::Read(QueuedImage->ImageData, QueuedImage->Width, QueuedImage->Height);
+					}
 
-					const TArray<uint8>* RawData = nullptr;
+					FramesDecoded.Increment();
+					INC_DWORD_STAT(STAT_RSFramesDecoded);
 
-					if (ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawData))
 					{
-						TSharedPtr<FImageData> QueuedImage = MakeShareable(new FImageData);
-						QueuedImage->Width = Image->Width;
-						QueuedImage->Height = Image->Height;
-						QueuedImage->ImageData = MoveTemp(*((TArray<uint8>*)RawData));
-						QueuedImage->ImageIndex = Image->ImageIndex;
-
-						{
-							FScopeLock ImageLock(&DecodedImageMutex);
-							IncomingDecodedImages.Add(QueuedImage);
-
-							UE_LOG(LogRemoteSession, Verbose, TEXT("finished decompressing image %d in %.02f ms (%d in queue)"),
-								Image->ImageIndex,
-								(FPlatformTime::Seconds() - StartTime) * 1000.0,
-								IncomingEncodedImages.Num());
-						}
+						FScopeLock ImageLock(&DecodedImageMutex);
+						IncomingDecodedImages.Add(QueuedImage);
+						INC_DWORD_STAT(STAT_RSDecodeQueue);
+
+						UE_LOG(LogRemoteSession, Verbose, TEXT("finished decompressing image %d in %.02f ms (%d in queue)"),
+							Image->ImageIndex,
+							(FPlatformTime::Seconds() - StartTime) * 1000.0,
+							IncomingEncodedImages.Num());
 					}
 				}
+				else
+				{
+					AddDroppedFrame(Image->Timing);
+					FramesDropped.Increment();
+					INC_DWORD_STAT(STAT_RSFramesDropped);
+				}
 
 			} while (true);
 
@@ -328,6 +870,55 @@ void FRemoteSessionFrameBufferChannel::ReceiveHostImage(FBackChannelOSCMessage&
 	}
 }
 
+void FRemoteSessionFrameBufferChannel::GetFrameStats(FRemoteSessionFrameStats& OutStats) const
+{
+	OutStats.FramesCaptured = FramesCaptured.GetValue();
+	OutStats.FramesEncoded = FramesEncoded.GetValue();
+	OutStats.FramesReceived = FramesReceived.GetValue();
+	OutStats.FramesDecoded = FramesDecoded.GetValue();
+	OutStats.FramesUploaded = FramesUploaded.GetValue();
+	OutStats.FramesDropped = FramesDropped.GetValue();
+
+	{
+		FScopeLock Lock(&IncomingImageMutex);
+		OutStats.DecodeQueueDepth = IncomingEncodedImages.Num();
+	}
+
+	FScopeLock Lock(&DecodedImageMutex);
+	OutStats.DecodeQueueDepth += IncomingDecodedImages.Num();
+}
+
+void FRemoteSessionFrameBufferChannel::AddDroppedFrame(const FRemoteSessionFrameTiming& InTiming)
+{
+	FRemoteSessionFrameTiming Timing = InTiming;
+	Timing.bDropped = true;
+	Timeline->Add(Timing);
+}
+
+TArray<FRemoteSessionFrameTiming> FRemoteSessionFrameBufferChannel::GetTimeline() const
+{
+	return Timeline->GetFrames();
+}
+
+bool FRemoteSessionFrameBufferChannel::DumpTimeline(const FString& Filename) const
+{
+	return Timeline->WriteCSV(Filename);
+}
+
+void FRemoteSessionFrameBufferChannel::LaunchTask(ENamedThreads::Type Thread, TFunction<void()>&& Func)
+{
+	FGraphEventRef Task = FFunctionGraphTask::CreateAndDispatchWhenReady(MoveTemp(Func), TStatId(), nullptr, Thread);
+
+	FScopeLock Lock(&PendingTasksMutex);
+
+	// forget about anything that's already finished
+	PendingTasks.RemoveAll([](const FGraphEventRef& Event) {
+		return Event->IsComplete();
+	});
+
+	PendingTasks.Add(Task);
+}
+
 void FRemoteSessionFrameBufferChannel::CreateTexture(const int32 InSlot, const int32 InWidth, const int32 InHeight)
 {
 	if (DecodedTextures[InSlot])
@@ -0,0 +1,230 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Channels/RemoteSessionFrameSources.h"
+#include "RemoteSession.h"
+#include "FrameGrabber.h"
+#include "Slate/SceneViewport.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+#include "RenderCommandFence.h"
+#include "TextureResource.h"
+#include "RHICommandList.h"
+
+TSharedRef<IRemoteSessionFrameSource> IRemoteSessionFrameSource::CreateForViewport(TSharedRef<FSceneViewport> Viewport, FIntPoint CaptureSize)
+{
+	return MakeShareable(new FRemoteSessionViewportFrameSource(Viewport, CaptureSize));
+}
+
+TSharedRef<IRemoteSessionFrameSource> IRemoteSessionFrameSource::CreateForRenderTarget(UTextureRenderTarget2D* RenderTarget)
+{
+	return MakeShareable(new FRemoteSessionRenderTargetFrameSource(RenderTarget));
+}
+
+TSharedRef<IRemoteSessionFrameSource> IRemoteSessionFrameSource::CreateSynthetic(FIntPoint Size, float Complexity)
+{
+	return MakeShareable(new FRemoteSessionSyntheticFrameSource(Size, Complexity));
+}
+
+FRemoteSessionViewportFrameSource::FRemoteSessionViewportFrameSource(TSharedRef<FSceneViewport> InViewport, FIntPoint InCaptureSize)
+{
+	// the grabber scales the viewport into a target of this size
+	CaptureSize = InCaptureSize;
+
+	if (CaptureSize.X <= 0 || CaptureSize.Y <= 0)
+	{
+		CaptureSize = InViewport->GetSize();
+	}
+
+	LatestSize = FIntPoint::ZeroValue;
+	bHaveFrame = false;
+
+	FrameGrabber = MakeShareable(new FFrameGrabber(InViewport, CaptureSize));
+	FrameGrabber->StartCapturingFrames();
+}
+
+FRemoteSessionViewportFrameSource::~FRemoteSessionViewportFrameSource()
+{
+	FrameGrabber->StopCapturingFrames();
+	FrameGrabber = nullptr;
+}
+
+void FRemoteSessionViewportFrameSource::Tick()
+{
+	FrameGrabber->CaptureThisFrame(FFramePayloadPtr());
+
+	TArray<FCapturedFrameData> Frames = FrameGrabber->GetCapturedFrames();
+
+	// only the newest is of any use
+	if (Frames.Num())
+	{
+		FCapturedFrameData& LastFrame = Frames.Last();
+		LatestPixels = MoveTemp(LastFrame.ColorBuffer);
+		LatestSize = LastFrame.BufferSize;
+		bHaveFrame = true;
+	}
+}
+
+bool FRemoteSessionViewportFrameSource::TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize)
+{
+	if (bHaveFrame == false)
+	{
+		return false;
+	}
+
+	OutPixels = MoveTemp(LatestPixels);
+	OutSize = LatestSize;
+	bHaveFrame = false;
+	return true;
+}
+
+FString FRemoteSessionViewportFrameSource::GetDescription() const
+{
+	return FString::Printf(TEXT("Viewport (%dx%d)"), CaptureSize.X, CaptureSize.Y);
+}
+
+FRemoteSessionRenderTargetFrameSource::FRemoteSessionRenderTargetFrameSource(UTextureRenderTarget2D* InRenderTarget)
+	: RenderTarget(InRenderTarget)
+{
+	ReadSize = FIntPoint::ZeroValue;
+	ReadFence = MakeUnique<FRenderCommandFence>();
+	bReadPending = false;
+	bHaveFrame = false;
+}
+
+FRemoteSessionRenderTargetFrameSource::~FRemoteSessionRenderTargetFrameSource()
+{
+	// the render thread may still be writing into ReadPixels
+	if (bReadPending)
+	{
+		ReadFence->Wait();
+	}
+}
+
+void FRemoteSessionRenderTargetFrameSource::Tick()
+{
+	if (bReadPending)
+	{
+		if (ReadFence->IsFenceComplete() == false)
+		{
+			return;
+		}
+
+		bReadPending = false;
+		bHaveFrame = true;
+	}
+
+	// don't read again until the last one is taken, the channel wants at most one frame per interval
+	if (bHaveFrame)
+	{
+		return;
+	}
+
+	UTextureRenderTarget2D* Target = RenderTarget.Get();
+	FTextureRenderTargetResource* Resource = Target ? Target->GameThread_GetRenderTargetResource() : nullptr;
+
+	if (Resource == nullptr)
+	{
+		return;
+	}
+
+	TArray<FColor>* Pixels = &ReadPixels;
+	FIntPoint* Size = &ReadSize;
+
+	// blocks the render thread until the GPU has drawn the target, but never the game thread
+	ENQUEUE_RENDER_COMMAND(RemoteSessionReadRenderTarget)(
+		[Resource, Pixels, Size](FRHICommandListImmediate& RHICmdList)
+	{
+		*Size = Resource->GetSizeXY();
+		RHICmdList.ReadSurfaceData(Resource->GetRenderTargetTexture(), FIntRect(0, 0, Size->X, Size->Y), *Pixels, FReadSurfaceDataFlags());
+	});
+
+	ReadFence->BeginFence();
+	bReadPending = true;
+}
+
+bool FRemoteSessionRenderTargetFrameSource::TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize)
+{
+	if (bHaveFrame == false)
+	{
+		return false;
+	}
+
+	OutPixels = MoveTemp(ReadPixels);
+	OutSize = ReadSize;
+	bHaveFrame = false;
+	return true;
+}
+
+FIntPoint FRemoteSessionRenderTargetFrameSource::GetSize() const
+{
+	UTextureRenderTarget2D* Target = RenderTarget.Get();
+	return Target ? FIntPoint(Target->SizeX, Target->SizeY) : FIntPoint::ZeroValue;
+}
+
+FString FRemoteSessionRenderTargetFrameSource::GetDescription() const
+{
+	UTextureRenderTarget2D* Target = RenderTarget.Get();
+	return FString::Printf(TEXT("RenderTarget %s (%dx%d)"), Target ? *Target->GetName() : TEXT("None"), GetSize().X, GetSize().Y);
+}
+
+FRemoteSessionSyntheticFrameSource::FRemoteSessionSyntheticFrameSource(FIntPoint InSize, float InComplexity)
+{
+	// keep dimensions even, some encoders insist on it
+	Size.X = FMath::Max(2, InSize.X & ~1);
+	Size.Y = FMath::Max(2, InSize.Y & ~1);
+	Complexity = FMath::Clamp(InComplexity, 0.0f, 1.0f);
+	FrameNumber = 0;
+}
+
+bool FRemoteSessionSyntheticFrameSource::TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize)
+{
+	const uint32 Frame = FrameNumber++;
+	const uint32 NoiseWeight = (uint32)(Complexity * 256.0f);
+	const uint32 PatternWeight = 256 - NoiseWeight;
+
+	// a square moving across a scrolling gradient, so every frame differs from the last
+	const int32 SquareSize = FMath::Max(1, Size.Y / 4);
+	const int32 SquareX = (Frame * 8) % FMath::Max(1, Size.X - SquareSize);
+	const int32 SquareY = (Size.Y - SquareSize) / 2;
+
+	OutPixels.SetNumUninitialized(Size.X * Size.Y);
+	OutSize = Size;
+
+	FColor* Pixel = OutPixels.GetData();
+
+	for (int32 Y = 0; Y < Size.Y; Y++)
+	{
+		const uint32 G = (Y * 255) / Size.Y;
+		const bool bSquareRow = Y >= SquareY && Y < SquareY + SquareSize;
+
+		for (int32 X = 0; X < Size.X; X++, Pixel++)
+		{
+			if (bSquareRow && X >= SquareX && X < SquareX + SquareSize)
+			{
+				*Pixel = FColor::White;
+				continue;
+			}
+
+			const uint32 R = ((X * 255) / Size.X + Frame * 2) & 255;
+			const uint32 B = ((X + Y) / 2 + Frame) & 255;
+
+			// cheap per-pixel hash, a random stream would cost more than the encode at high resolutions
+			uint32 Noise = (X * 73856093u) ^ (Y * 19349663u) ^ (Frame * 83492791u);
+			Noise ^= Noise >> 13;
+			Noise *= 0x5bd1e995u;
+			Noise ^= Noise >> 15;
+
+			Pixel->R = (uint8)((R * PatternWeight + (Noise & 255) * NoiseWeight) >> 8);
+			Pixel->G = (uint8)((G * PatternWeight + ((Noise >> 8) & 255) * NoiseWeight) >> 8);
+			Pixel->B = (uint8)((B * PatternWeight + ((Noise >> 16) & 255) * NoiseWeight) >> 8);
+			Pixel->A = 255;
+		}
+	}
+
+	return true;
+}
+
+FString FRemoteSessionSyntheticFrameSource::GetDescription() const
+{
+	return FString::Printf(TEXT("Synthetic (%dx%d, complexity %.02f)"), Size.X, Size.Y, Complexity);
+}
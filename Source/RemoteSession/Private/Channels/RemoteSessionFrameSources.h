@@ -0,0 +1,79 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Channels/RemoteSessionFrameSource.h"
+#include "UObject/WeakObjectPtr.h"
+
+class FFrameGrabber;
+class FRenderCommandFence;
+
+/* Captures a viewport with a frame grabber */
+class FRemoteSessionViewportFrameSource : public IRemoteSessionFrameSource
+{
+public:
+
+	FRemoteSessionViewportFrameSource(TSharedRef<FSceneViewport> InViewport, FIntPoint InCaptureSize);
+
+	virtual ~FRemoteSessionViewportFrameSource();
+
+	virtual void Tick() override;
+	virtual bool TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize) override;
+	virtual FIntPoint GetSize() const override { return CaptureSize; }
+	virtual FString GetDescription() const override;
+
+protected:
+
+	TSharedPtr<FFrameGrabber>	FrameGrabber;
+	FIntPoint					CaptureSize;
+
+	/** Newest frame the grabber has given us */
+	TArray<FColor>				LatestPixels;
+	FIntPoint					LatestSize;
+	bool						bHaveFrame;
+};
+
+/* Reads a render target back on the render thread, one read in flight at a time */
+class FRemoteSessionRenderTargetFrameSource : public IRemoteSessionFrameSource
+{
+public:
+
+	FRemoteSessionRenderTargetFrameSource(UTextureRenderTarget2D* InRenderTarget);
+
+	virtual ~FRemoteSessionRenderTargetFrameSource();
+
+	virtual void Tick() override;
+	virtual bool TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize) override;
+	virtual FIntPoint GetSize() const override;
+	virtual FString GetDescription() const override;
+
+protected:
+
+	TWeakObjectPtr<UTextureRenderTarget2D>	RenderTarget;
+
+	/** Written on the render thread, only touched here once ReadFence has passed */
+	TArray<FColor>							ReadPixels;
+	FIntPoint								ReadSize;
+
+	TUniquePtr<FRenderCommandFence>			ReadFence;
+	bool									bReadPending;
+	bool									bHaveFrame;
+};
+
+/* Draws a moving pattern into memory */
+class FRemoteSessionSyntheticFrameSource : public IRemoteSessionFrameSource
+{
+public:
+
+	FRemoteSessionSyntheticFrameSource(FIntPoint InSize, float InComplexity);
+
+	virtual bool TakeFrame(TArray<FColor>& OutPixels, FIntPoint& OutSize) override;
+	virtual FIntPoint GetSize() const override { return Size; }
+	virtual FString GetDescription() const override;
+
+protected:
+
+	FIntPoint	Size;
+	float		Complexity;
+	uint32		FrameNumber;
+};
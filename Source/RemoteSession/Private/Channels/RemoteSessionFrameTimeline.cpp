@@ -0,0 +1,102 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Channels/RemoteSessionFrameTimeline.h"
+#include "RemoteSession.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+static int32 TimelineSize = 300;
+static FAutoConsoleVariableRef CVarTimelineSize(
+	TEXT("remote.timelinesize"), TimelineSize,
+	TEXT("How many frames each end of a session keeps timings for, for remote.dumptimeline. Applies to new channels"),
+	ECVF_Default);
+
+FRemoteSessionFrameTimeline::FRemoteSessionFrameTimeline()
+	: NextFrame(0)
+	, MaxFrames(FMath::Max(0, TimelineSize))
+{
+}
+
+void FRemoteSessionFrameTimeline::Add(const FRemoteSessionFrameTiming& Timing)
+{
+	FScopeLock Lock(&Mutex);
+
+	if (MaxFrames == 0)
+	{
+		return;
+	}
+
+	if (Frames.Num() < MaxFrames)
+	{
+		Frames.Add(Timing);
+	}
+	else
+	{
+		Frames[NextFrame] = Timing;
+		NextFrame = (NextFrame + 1) % MaxFrames;
+	}
+}
+
+void FRemoteSessionFrameTimeline::Update(int32 ImageIndex, TFunctionRef<void(FRemoteSessionFrameTiming&)> Func)
+{
+	FScopeLock Lock(&Mutex);
+
+	// almost always the newest, so search backwards from there
+	for (int32 i = Frames.Num() - 1; i >= 0; i--)
+	{
+		FRemoteSessionFrameTiming& Frame = Frames[(NextFrame + i) % Frames.Num()];
+
+		if (Frame.ImageIndex == ImageIndex)
+		{
+			Func(Frame);
+			return;
+		}
+	}
+}
+
+TArray<FRemoteSessionFrameTiming> FRemoteSessionFrameTimeline::GetFrames() const
+{
+	FScopeLock Lock(&Mutex);
+
+	// until the ring is full NextFrame is 0 and this is just a copy
+	TArray<FRemoteSessionFrameTiming> Result;
+	Result.Reserve(Frames.Num());
+
+	for (int32 i = 0; i < Frames.Num(); i++)
+	{
+		Result.Add(Frames[(NextFrame + i) % Frames.Num()]);
+	}
+
+	return Result;
+}
+
+bool FRemoteSessionFrameTimeline::WriteCSV(const FString& Filename) const
+{
+	const TArray<FRemoteSessionFrameTiming> Timeline = GetFrames();
+
+	if (Timeline.Num() == 0)
+	{
+		return false;
+	}
+
+	// the first time either end recorded for the oldest frame
+	const FRemoteSessionFrameTiming& First = Timeline[0];
+	const double BaseTime = First.CaptureTime > 0 ? First.CaptureTime : First.ReceiveTime;
+
+	auto RelativeMS = [BaseTime](double Time) {
+		return Time > 0 ? (Time - BaseTime) * 1000.0 : 0.0;
+	};
+
+	FString CSV = TEXT("Frame,Width,Height,EncodedBytes,CaptureTime,CaptureMS,EncodeMS,SendTime,ReceiveTime,DecodeMS,UploadMS,DisplayTime,Dropped\n");
+
+	for (const FRemoteSessionFrameTiming& Timing : Timeline)
+	{
+		CSV += FString::Printf(TEXT("%d,%d,%d,%d,%.03f,%.03f,%.03f,%.03f,%.03f,%.03f,%.03f,%.03f,%d\n"),
+			Timing.ImageIndex, Timing.Width, Timing.Height, Timing.EncodedBytes,
+			RelativeMS(Timing.CaptureTime), Timing.CaptureMS, Timing.EncodeMS, RelativeMS(Timing.SendTime),
+			RelativeMS(Timing.ReceiveTime), Timing.DecodeMS, Timing.UploadMS, RelativeMS(Timing.DisplayTime),
+			Timing.bDropped ? 1 : 0);
+	}
+
+	return FFileHelper::SaveStringToFile(CSV, *Filename);
+}
@@ -0,0 +1,37 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+
+/*
+	A ring of the most recent frame timings on one end of a session, so that a stutter in the field can be looked at
+	after the fact. Safe to use from any thread.
+*/
+class FRemoteSessionFrameTimeline
+{
+public:
+
+	/** Keeps the last remote.timelinesize frames */
+	FRemoteSessionFrameTimeline();
+
+	/** Adds a frame, replacing the oldest once we're full */
+	void Add(const FRemoteSessionFrameTiming& Timing);
+
+	/** Calls Func on the frame with ImageIndex if we still have it */
+	void Update(int32 ImageIndex, TFunctionRef<void(FRemoteSessionFrameTiming&)> Func);
+
+	/** Returns our frames, oldest first */
+	TArray<FRemoteSessionFrameTiming> GetFrames() const;
+
+	/** Writes our frames to Filename as CSV, with times in ms from the first frame. Returns false if there was nothing to write or it couldn't be saved */
+	bool WriteCSV(const FString& Filename) const;
+
+protected:
+
+	mutable FCriticalSection				Mutex;
+	TArray<FRemoteSessionFrameTiming>		Frames;
+	int32									NextFrame;
+	int32									MaxFrames;
+};
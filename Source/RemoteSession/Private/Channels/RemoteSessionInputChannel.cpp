@@ -5,7 +5,9 @@
 #include "Protocol/OSC/BackChannelOSCConnection.h"
 #include "Protocol/OSC/BackChannelOSCMessage.h"
 #include "MessageHandler/RecordingMessageHandler.h"
-
+#include "MessageHandler/RemoteSessionInputRecording.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Channels/RemoteSessionLatencyProbe.h"
 
 
 FRemoteSessionInputChannel::FRemoteSessionInputChannel(ERemoteSessionChannelMode InRole, TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection)
@@ -14,6 +16,8 @@ FRemoteSessionInputChannel::FRemoteSessionInputChannel(ERemoteSessionChannelMode
 
 	Connection = InConnection;
 	Role = InRole;
+	LatencyProbeId = -1;
+	LatencyProbeTime = 0;
 
 	// if sending input replace the default message handler with a recording version, and set us as the
 	// handler for that data 
@@ -32,6 +36,7 @@ FRemoteSessionInputChannel::FRemoteSessionInputChannel(ERemoteSessionChannelMode
 		TSharedRef<FGenericApplicationMessageHandler> DestinationHandler = FSlateApplication::Get().GetPlatformApplication()->GetMessageHandler();
 
 		PlaybackHandler = MakeShareable(new FRecordingMessageHandler(DestinationHandler));
+		PlaybackHandler->OnPlayLatencyProbe().BindRaw(this, &FRemoteSessionInputChannel::OnLatencyProbe);
 
 		Connection->GetDispatchMap().GetAddressHandler(TEXT("/MessageHandler/")).AddRaw(this, &FRemoteSessionInputChannel::OnRemoteMessage);
 	}
@@ -64,6 +69,36 @@ void FRemoteSessionInputChannel::SetPlaybackWindow(TWeakPtr<SWindow> InWindow, T
 	PlaybackHandler->SetPlaybackWindow(InWindow, InViewport);
 }
 
+void FRemoteSessionInputChannel::SetSender(TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> InSender)
+{
+	Sender = InSender;
+}
+
+void FRemoteSessionInputChannel::SetRecorder(TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> InRecorder)
+{
+	FScopeLock Lock(&RecorderMutex);
+	Recorder = InRecorder;
+}
+
+bool FRemoteSessionInputChannel::SetConnection(TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> InConnection)
+{
+	Connection = InConnection;
+
+	// a probe from the last connection isn't going to be answered
+	{
+		FScopeLock Lock(&LatencyProbeMutex);
+		LatencyProbeId = -1;
+	}
+
+	// our recording handler stays installed, only playback needs binding to the new connection
+	if (Role == ERemoteSessionChannelMode::Receive)
+	{
+		Connection->GetDispatchMap().GetAddressHandler(TEXT("/MessageHandler/")).AddRaw(this, &FRemoteSessionInputChannel::OnRemoteMessage);
+	}
+
+	return true;
+}
+
 void FRemoteSessionInputChannel::SetInputRect(const FVector2D& TopLeft, const FVector2D& Extents)
 {
 	if (RecordingHandler.IsValid())
@@ -74,12 +109,56 @@ void FRemoteSessionInputChannel::SetInputRect(const FVector2D& TopLeft, const FV
 
 void FRemoteSessionInputChannel::Tick(const float InDeltaTime)
 {
-	// everything happens via messaging.
+	// everything happens via messaging, but analog & mouse movement that was held back by
+	// the rate limit needs to go out eventually
+	if (RecordingHandler.IsValid())
+	{
+		RecordingHandler->FlushPendingInput();
+	}
 }
 
 void FRemoteSessionInputChannel::RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data)
 {
-	if (Connection.IsValid())
+	{
+		FScopeLock Lock(&RecorderMutex);
+
+		if (Recorder.IsValid())
+		{
+			Recorder->RecordMessage(MsgName, Data);
+		}
+	}
+
+	SendMessage(MsgName, Data);
+}
+
+void FRemoteSessionInputChannel::SendLatencyProbe(int32 InId)
+{
+	// sent the same way as a touch so it queues behind real input, but never recorded or played
+	TArray<uint8> Data;
+	Data.Add((uint8)InId);
+
+	SendMessage(FRemoteSessionProbeMarker::MessageName, Data);
+}
+
+int32 FRemoteSessionInputChannel::GetLatencyProbe() const
+{
+	FScopeLock Lock(&LatencyProbeMutex);
+
+	// drawn for as long as the client waits for it, so frames stop carrying it once probing stops
+	if (LatencyProbeId >= 0 && FPlatformTime::Seconds() - LatencyProbeTime > FRemoteSessionProbeMarker::kTimeoutSeconds)
+	{
+		return -1;
+	}
+
+	return LatencyProbeId;
+}
+
+void FRemoteSessionInputChannel::SendMessage(const TCHAR* MsgName, const TArray<uint8>& Data)
+{
+	// only through the sender, the connection has its own lock so writing to it directly could split the sender's packets
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> LocalSender = Sender.Pin();
+
+	if (LocalSender.IsValid())
 	{
 		// send as blobs
 		FString Path = FString::Printf(TEXT("/MessageHandler/%s"), MsgName);
@@ -87,7 +166,7 @@ void FRemoteSessionInputChannel::RecordMessage(const TCHAR* MsgName, const TArra
 
 		Msg.Write(Data);
 
-		Connection->SendPacket(Msg);
+		LocalSender->SendPacket(Msg, StaticType());
 	}
 }
 
@@ -99,5 +178,29 @@ void FRemoteSessionInputChannel::OnRemoteMessage(FBackChannelOSCMessage& Message
 	TArray<uint8> MsgData;
 	Message << MsgData;
 
+	// played like input so it takes effect after whatever was sent before it, but never recorded
+	if (MessageName == FRemoteSessionProbeMarker::MessageName)
+	{
+		PlaybackHandler->PlayMessage(*MessageName, MsgData);
+		return;
+	}
+
+	{
+		FScopeLock Lock(&RecorderMutex);
+
+		// before playing, which takes the data
+		if (Recorder.IsValid())
+		{
+			Recorder->RecordMessage(*MessageName, MsgData);
+		}
+	}
+
 	PlaybackHandler->PlayMessage(*MessageName, MsgData);
 }
+
+void FRemoteSessionInputChannel::OnLatencyProbe(int32 InId)
+{
+	FScopeLock Lock(&LatencyProbeMutex);
+	LatencyProbeId = InId;
+	LatencyProbeTime = FPlatformTime::Seconds();
+}
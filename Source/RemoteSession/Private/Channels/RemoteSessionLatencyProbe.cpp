@@ -0,0 +1,242 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Channels/RemoteSessionLatencyProbe.h"
+#include "RemoteSession.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "RemoteSessionStats.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Touch To Photon (ms)"), STAT_RSTouchToPhoton, STATGROUP_RemoteSession);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Touch To Photon P90 (ms)"), STAT_RSTouchToPhotonP90, STATGROUP_RemoteSession);
+
+float GRemoteSessionProbeIntervalSeconds = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionProbeInterval(
+	TEXT("remote.probe.interval"), GRemoteSessionProbeIntervalSeconds,
+	TEXT("Client: seconds between touch to photon latency probes, 0 for none. The host draws a marker in the top left of frames while probed"),
+	ECVF_Default);
+
+const TCHAR* FRemoteSessionProbeMarker::MessageName = TEXT("LatencyProbe");
+
+const double FRemoteSessionProbeMarker::kTimeoutSeconds = 2.0;
+
+/* Size of each cell in pixels */
+static const int32 kProbeCellSize = 16;
+
+/* A white and a black cell so a marker can be told from whatever the game drew, then the id's bits */
+static const int32 kProbeIdBits = 4;
+static const int32 kProbeNumCells = 2 + kProbeIdBits;
+
+/* How many latencies the distribution covers, and how often it's logged */
+static const int32 kProbeMaxSamples = 200;
+static const int32 kProbeLogInterval = 50;
+
+static_assert((1 << kProbeIdBits) == FRemoteSessionProbeMarker::kNumIds, "Marker must hold every id");
+
+void FRemoteSessionProbeMarker::Draw(TArray<FColor>& Pixels, int32 Width, int32 Height, int32 Id)
+{
+	if (Width < kProbeCellSize * kProbeNumCells || Height < kProbeCellSize || Pixels.Num() < Width * Height)
+	{
+		return;
+	}
+
+	for (int32 Cell = 0; Cell < kProbeNumCells; Cell++)
+	{
+		bool bWhite = Cell == 0;
+
+		if (Cell >= 2)
+		{
+			bWhite = (Id & (1 << (kProbeNumCells - 1 - Cell))) != 0;
+		}
+
+		const FColor Color = bWhite ? FColor::White : FColor::Black;
+
+		for (int32 Y = 0; Y < kProbeCellSize; Y++)
+		{
+			FColor* Row = Pixels.GetData() + Y * Width + Cell * kProbeCellSize;
+
+			for (int32 X = 0; X < kProbeCellSize; X++)
+			{
+				Row[X] = Color;
+			}
+		}
+	}
+}
+
+int32 FRemoteSessionProbeMarker::Read(const TArray<uint8>& Pixels, int32 Width, int32 Height)
+{
+	if (Width < kProbeCellSize * kProbeNumCells || Height < kProbeCellSize || Pixels.Num() < Width * Height * 4)
+	{
+		return -1;
+	}
+
+	// average the middle of each cell, where compression is kindest
+	const int32 Inset = kProbeCellSize / 4;
+	int32 Brightness[kProbeNumCells];
+
+	for (int32 Cell = 0; Cell < kProbeNumCells; Cell++)
+	{
+		int32 Total = 0;
+		int32 Count = 0;
+
+		for (int32 Y = Inset; Y < kProbeCellSize - Inset; Y++)
+		{
+			const uint8* Pixel = Pixels.GetData() + (Y * Width + Cell * kProbeCellSize + Inset) * 4;
+
+			for (int32 X = Inset; X < kProbeCellSize - Inset; X++, Pixel += 4)
+			{
+				Total += Pixel[0] + Pixel[1] + Pixel[2];
+				Count += 3;
+			}
+		}
+
+		Brightness[Cell] = Total / Count;
+	}
+
+	if (Brightness[0] < 192 || Brightness[1] > 64)
+	{
+		return -1;
+	}
+
+	int32 Id = 0;
+
+	for (int32 Cell = 2; Cell < kProbeNumCells; Cell++)
+	{
+		Id = (Id << 1) | (Brightness[Cell] > 128 ? 1 : 0);
+	}
+
+	return Id;
+}
+
+FRemoteSessionLatencyProbe::FRemoteSessionLatencyProbe()
+	: OutstandingId(-1)
+	, OutstandingSendTime(0)
+	, NextId(1)
+	, LastSendTime(0)
+	, NextSample(0)
+	, SamplesSinceLog(0)
+	, LastLatencyMS(0)
+	, LastP90MS(0)
+	, ProbesSent(0)
+	, ProbesLost(0)
+{
+}
+
+FRemoteSessionLatencyProbe::~FRemoteSessionLatencyProbe()
+{
+	Unbind();
+}
+
+void FRemoteSessionLatencyProbe::Unbind()
+{
+	TSharedPtr<FRemoteSessionFrameBufferChannel> Channel = BoundChannel.Pin();
+
+	if (Channel.IsValid())
+	{
+		Channel->SetReadProbeMarkers(false);
+		Channel->RemoveFrameDisplayedHandler(DisplayedHandle);
+	}
+
+	BoundChannel = nullptr;
+	DisplayedHandle.Reset();
+}
+
+void FRemoteSessionLatencyProbe::Tick(const TSharedPtr<FRemoteSessionInputChannel>& InputChannel, const TSharedPtr<FRemoteSessionFrameBufferChannel>& FramebufferChannel)
+{
+	if (GRemoteSessionProbeIntervalSeconds <= 0 || InputChannel.IsValid() == false || FramebufferChannel.IsValid() == false)
+	{
+		Unbind();
+		return;
+	}
+
+	// channels are recreated when a session doesn't resume
+	if (BoundChannel.Pin() != FramebufferChannel)
+	{
+		Unbind();
+
+		FramebufferChannel->SetReadProbeMarkers(true);
+		DisplayedHandle = FramebufferChannel->AddFrameDisplayedHandler(FOnRemoteSessionFrameTiming::FDelegate::CreateThreadSafeSP(this, &FRemoteSessionLatencyProbe::OnFrameDisplayed));
+		BoundChannel = FramebufferChannel;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	int32 IdToSend = -1;
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		if (OutstandingId >= 0 && Now - OutstandingSendTime > FRemoteSessionProbeMarker::kTimeoutSeconds)
+		{
+			UE_LOG(LogRemoteSession, Verbose, TEXT("Latency probe %d wasn't seen within %.0f seconds"), OutstandingId, FRemoteSessionProbeMarker::kTimeoutSeconds);
+			OutstandingId = -1;
+			ProbesLost++;
+		}
+
+		if (OutstandingId < 0 && Now - LastSendTime >= GRemoteSessionProbeIntervalSeconds)
+		{
+			IdToSend = NextId;
+			NextId = (NextId % (FRemoteSessionProbeMarker::kNumIds - 1)) + 1;
+
+			OutstandingId = IdToSend;
+			OutstandingSendTime = Now;
+			LastSendTime = Now;
+			ProbesSent++;
+		}
+
+		if (Samples.Num())
+		{
+			SET_FLOAT_STAT(STAT_RSTouchToPhoton, LastLatencyMS);
+			SET_FLOAT_STAT(STAT_RSTouchToPhotonP90, LastP90MS);
+		}
+	}
+
+	if (IdToSend >= 0)
+	{
+		InputChannel->SendLatencyProbe(IdToSend);
+	}
+}
+
+void FRemoteSessionLatencyProbe::OnFrameDisplayed(const FRemoteSessionFrameTiming& Timing)
+{
+	if (Timing.ProbeId < 0)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&Mutex);
+
+	if (Timing.ProbeId != OutstandingId)
+	{
+		return;
+	}
+
+	LastLatencyMS = (Timing.DisplayTime - OutstandingSendTime) * 1000.0;
+	OutstandingId = -1;
+
+	if (Samples.Num() < kProbeMaxSamples)
+	{
+		Samples.Add(LastLatencyMS);
+	}
+	else
+	{
+		Samples[NextSample] = LastLatencyMS;
+		NextSample = (NextSample + 1) % kProbeMaxSamples;
+	}
+
+	const FRemoteSessionDistribution Distribution = FRemoteSessionDistribution::FromValues(Samples);
+	LastP90MS = Distribution.P90;
+
+	if (++SamplesSinceLog >= kProbeLogInterval)
+	{
+		SamplesSinceLog = 0;
+
+		UE_LOG(LogRemoteSession, Log, TEXT("Touch to photon latency (ms): %s, %d of %d probes lost"),
+			*Distribution.ToString(), ProbesLost, ProbesSent);
+	}
+}
+
+FRemoteSessionDistribution FRemoteSessionLatencyProbe::GetDistribution() const
+{
+	FScopeLock Lock(&Mutex);
+	return FRemoteSessionDistribution::FromValues(Samples);
+}
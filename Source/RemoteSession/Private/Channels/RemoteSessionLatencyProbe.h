@@ -0,0 +1,90 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RemoteSessionDistribution.h"
+
+class FRemoteSessionInputChannel;
+class FRemoteSessionFrameBufferChannel;
+struct FRemoteSessionFrameTiming;
+
+/* Interval between latency probes, 0 when probing is off */
+extern float GRemoteSessionProbeIntervalSeconds;
+
+/*
+	A block of black and white cells drawn into the top left of a frame that carries a probe id through encoding.
+	Cells are 16 pixels so each covers whole blocks of a jpg and survives low quality settings.
+*/
+struct FRemoteSessionProbeMarker
+{
+	/** Ids wrap at this, 0 is never used so an unmarked frame can't match the first probe */
+	static const int32 kNumIds = 16;
+
+	/** Name probes are sent under on the input channel */
+	static const TCHAR* MessageName;
+
+	/** How long the host draws a probe's id for, and so how long the client waits before counting it lost */
+	static const double kTimeoutSeconds;
+
+	/** Draws Id into BGRA pixels. Does nothing if the frame is too small to hold the marker */
+	static void Draw(TArray<FColor>& Pixels, int32 Width, int32 Height, int32 Id);
+
+	/** Reads a marker from decoded BGRA pixels. Returns the id, or -1 if there's no marker */
+	static int32 Read(const TArray<uint8>& Pixels, int32 Width, int32 Height);
+};
+
+/*
+	Client: times a tap on the device until it shows up as changed pixels on the device. Every
+	remote.probe.interval seconds a probe is sent on the input channel, the host draws its id into the frames
+	it captures for the next two seconds, and the time from sending until the first frame with that id is displayed is
+	recorded. Only one probe is out at a time.
+*/
+class FRemoteSessionLatencyProbe : public TSharedFromThis<FRemoteSessionLatencyProbe, ESPMode::ThreadSafe>
+{
+public:
+
+	FRemoteSessionLatencyProbe();
+
+	~FRemoteSessionLatencyProbe();
+
+	/** Sends the next probe when it's due and watches FramebufferChannel for it. Game thread */
+	void Tick(const TSharedPtr<FRemoteSessionInputChannel>& InputChannel, const TSharedPtr<FRemoteSessionFrameBufferChannel>& FramebufferChannel);
+
+	/** Latency of the most recent probes */
+	FRemoteSessionDistribution GetDistribution() const;
+
+	/** Probes sent, and those not seen within the timeout */
+	int32 GetProbesSent() const { return ProbesSent; }
+	int32 GetProbesLost() const { return ProbesLost; }
+
+protected:
+
+	/** Called on the render thread once a frame is on screen */
+	void OnFrameDisplayed(const FRemoteSessionFrameTiming& Timing);
+
+	/** Stops reading markers from the channel we're watching */
+	void Unbind();
+
+	TWeakPtr<FRemoteSessionFrameBufferChannel>	BoundChannel;
+	FDelegateHandle								DisplayedHandle;
+
+	mutable FCriticalSection	Mutex;
+
+	/** The probe we're waiting on, or -1, and when it was sent */
+	int32						OutstandingId;
+	double						OutstandingSendTime;
+	int32						NextId;
+	double						LastSendTime;
+
+	/** Ring of recent latencies */
+	TArray<float>				Samples;
+	int32						NextSample;
+	int32						SamplesSinceLog;
+
+	/** Shown by "stat remotesession" */
+	float						LastLatencyMS;
+	float						LastP90MS;
+	int32						ProbesSent;
+	int32						ProbesLost;
+};
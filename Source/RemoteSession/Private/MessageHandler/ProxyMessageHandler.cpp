@@ -164,16 +164,31 @@ bool FProxyMessageHandler::OnCursorSet()
 
 bool FProxyMessageHandler::OnControllerAnalog(FGamepadKeyNames::Type KeyName, int32 ControllerId, float AnalogValue)
 {
+	if (TargetHandler.IsValid())
+	{
+		return TargetHandler->OnControllerAnalog(KeyName, ControllerId, AnalogValue);
+	}
+
 	return false;
 }
 
 bool FProxyMessageHandler::OnControllerButtonPressed(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat)
 {
+	if (TargetHandler.IsValid())
+	{
+		return TargetHandler->OnControllerButtonPressed(KeyName, ControllerId, IsRepeat);
+	}
+
 	return false;
 }
 
 bool FProxyMessageHandler::OnControllerButtonReleased(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat)
 {
+	if (TargetHandler.IsValid())
+	{
+		return TargetHandler->OnControllerButtonReleased(KeyName, ControllerId, IsRepeat);
+	}
+
 	return false;
 }
 
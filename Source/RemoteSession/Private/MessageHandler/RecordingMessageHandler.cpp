@@ -7,6 +7,30 @@
 #include "Engine/GameEngine.h"
 #include "Engine/GameViewportClient.h"
 #include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Channels/RemoteSessionLatencyProbe.h"
+
+static float AnalogChangeThreshold = 0.02f;
+static FAutoConsoleVariableRef CVarAnalogChangeThreshold(
+	TEXT("remote.input.analogthreshold"), AnalogChangeThreshold,
+	TEXT("Minimum change in a controller axis before it is sent to the host"),
+	ECVF_Default);
+
+static int32 RawMouseThreshold = 1;
+static FAutoConsoleVariableRef CVarRawMouseThreshold(
+	TEXT("remote.input.rawmousethreshold"), RawMouseThreshold,
+	TEXT("Minimum accumulated raw mouse movement before it is sent to the host"),
+	ECVF_Default);
+
+static int32 MaxInputSampleRate = 60;
+static FAutoConsoleVariableRef CVarMaxInputSampleRate(
+	TEXT("remote.input.maxsamplerate"), MaxInputSampleRate,
+	TEXT("Max times per second that each analog axis and the mouse position are sent (0 = no limit)"),
+	ECVF_Default);
+
+/* Set while playing back remote input. A client in the same process (e.g. the loopback benchmark) would otherwise record it and send it straight back */
+static bool GIsPlayingRemoteInput = false;
 
 // helper to serialize out const params
 template <typename S, typename T>
@@ -35,7 +59,12 @@ FRecordingMessageHandler::FRecordingMessageHandler(const TSharedPtr<FGenericAppl
     bIsTouching = false;
     InputRect = FRect(EForceInit::ForceInitToZero);
     LastTouchLocation = FVector2D(EForceInit::ForceInitToZero);
-    
+	LastSentMousePosition = FVector2D(EForceInit::ForceInitToZero);
+	PendingMousePosition = FVector2D(EForceInit::ForceInitToZero);
+	LastMouseMoveTime = 0.0;
+	bMouseMovePending = false;
+	PendingRawMouseDelta = FIntPoint::ZeroValue;
+	LastRawMouseMoveTime = 0.0;
 
 	BIND_PLAYBACK_HANDLER(TEXT("OnKeyChar"), PlayOnKeyChar);
 	BIND_PLAYBACK_HANDLER(TEXT("OnKeyUp"), PlayOnKeyUp);
@@ -48,6 +77,19 @@ FRecordingMessageHandler::FRecordingMessageHandler(const TSharedPtr<FGenericAppl
 	BIND_PLAYBACK_HANDLER(TEXT("OnBeginGesture"), PlayOnBeginGesture);
 	BIND_PLAYBACK_HANDLER(TEXT("OnTouchGesture"), PlayOnTouchGesture);
 	BIND_PLAYBACK_HANDLER(TEXT("OnEndGesture"), PlayOnEndGesture);
+
+	BIND_PLAYBACK_HANDLER(TEXT("OnMouseDown"), PlayOnMouseDown);
+	BIND_PLAYBACK_HANDLER(TEXT("OnMouseUp"), PlayOnMouseUp);
+	BIND_PLAYBACK_HANDLER(TEXT("OnMouseDoubleClick"), PlayOnMouseDoubleClick);
+	BIND_PLAYBACK_HANDLER(TEXT("OnMouseWheel"), PlayOnMouseWheel);
+	BIND_PLAYBACK_HANDLER(TEXT("OnMouseMove"), PlayOnMouseMove);
+	BIND_PLAYBACK_HANDLER(TEXT("OnRawMouseMove"), PlayOnRawMouseMove);
+
+	BIND_PLAYBACK_HANDLER(TEXT("OnControllerAnalog"), PlayOnControllerAnalog);
+	BIND_PLAYBACK_HANDLER(TEXT("OnControllerButtonPressed"), PlayOnControllerButtonPressed);
+	BIND_PLAYBACK_HANDLER(TEXT("OnControllerButtonReleased"), PlayOnControllerButtonReleased);
+
+	BIND_PLAYBACK_HANDLER(FRemoteSessionProbeMarker::MessageName, PlayLatencyProbe);
 }
 
 #undef BIND_PLAYBACK_HANDLER
@@ -59,7 +101,7 @@ void FRecordingMessageHandler::SetRecordingHandler(IRecordingMessageHandlerWrite
 
 void FRecordingMessageHandler::RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data)
 {
-	if (IsRecording())
+	if (IsRecording() && GIsPlayingRemoteInput == false)
 	{
 		OutputWriter->RecordMessage(MsgName, Data);
 	}
@@ -129,6 +171,7 @@ bool FRecordingMessageHandler::PlayMessage(const TCHAR* Message, const TArray<ui
 
 		AsyncTask(ENamedThreads::GameThread, [Dispatch, DataCopy] {
 			FMemoryReader Ar(*DataCopy);
+			TGuardValue<bool> PlayingGuard(GIsPlayingRemoteInput, true);
 			Dispatch->ExecuteIfBound(Ar);
 		});
 		
@@ -141,6 +184,25 @@ bool FRecordingMessageHandler::PlayMessage(const TCHAR* Message, const TArray<ui
 	return true;
 }
 
+bool FRecordingMessageHandler::PlayMessageImmediately(const TCHAR* Message, const TArray<uint8>& Data)
+{
+	check(IsInGameThread());
+
+	FRecordedMessageDispatch* Dispatch = DispatchTable.Find(Message);
+
+	if (Dispatch == nullptr)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("No Playback Handler registered for message %s"), Message);
+		return false;
+	}
+
+	FMemoryReader Ar(Data);
+	TGuardValue<bool> PlayingGuard(GIsPlayingRemoteInput, true);
+	Dispatch->ExecuteIfBound(Ar);
+
+	return true;
+}
+
 bool FRecordingMessageHandler::OnKeyChar(const TCHAR Character, const bool IsRepeat)
 {
 	if (IsRecording())
@@ -281,7 +343,7 @@ bool FRecordingMessageHandler::OnTouchMoved(const FVector2D& Location, int32 Tou
 		{
 			// note - force is serialized last for backwards compat - force was introduced in 4.20
 			FourParamMsg<FVector2D, int32, int32, float> Msg(Normalized, TouchIndex, ControllerId, Force);
-			OutputWriter->RecordMessage(TEXT("OnTouchMoved"), Msg.AsData());
+			RecordMessage(TEXT("OnTouchMoved"), Msg.AsData());
 			bIsTouching = true;
 			LastTouchLocation = Location;
 		}
@@ -324,7 +386,7 @@ bool FRecordingMessageHandler::OnTouchEnded(const FVector2D& Location, int32 Tou
         }
 		
         ThreeParamMsg<FVector2D, int32, int32> Msg(Normalized, TouchIndex, ControllerId);
-        OutputWriter->RecordMessage(TEXT("OnTouchEnded"), Msg.AsData());
+        RecordMessage(TEXT("OnTouchEnded"), Msg.AsData());
         bIsTouching = false;
 	}
 
@@ -348,7 +410,7 @@ void FRecordingMessageHandler::OnBeginGesture()
 	if (IsRecording())
 	{
 		NoParamMsg Msg;
-		OutputWriter->RecordMessage(TEXT("OnBeginGesture"), Msg.AsData());
+		RecordMessage(TEXT("OnBeginGesture"), Msg.AsData());
 	}
 
 	if (ConsumeInput)
@@ -369,7 +431,7 @@ bool FRecordingMessageHandler::OnTouchGesture(EGestureEvent GestureType, const F
 	if (IsRecording())
 	{
 		FourParamMsg<uint32, FVector2D, float, bool> Msg((uint32)GestureType, Delta, WheelDelta, bIsDirectionInvertedFromDevice);
-		OutputWriter->RecordMessage(TEXT("OnTouchGesture"), Msg.AsData());
+		RecordMessage(TEXT("OnTouchGesture"), Msg.AsData());
 	}
 
 	if (ConsumeInput)
@@ -391,7 +453,7 @@ void FRecordingMessageHandler::OnEndGesture()
 	if (IsRecording())
 	{
 		NoParamMsg Msg;
-		OutputWriter->RecordMessage(TEXT("OnEndGesture"), Msg.AsData());
+		RecordMessage(TEXT("OnEndGesture"), Msg.AsData());
 	}
 
 	if (ConsumeInput)
@@ -414,7 +476,7 @@ bool FRecordingMessageHandler::OnMotionDetected(const FVector& Tilt, const FVect
 	{
 		FiveParamMsg<FVector, FVector, FVector, FVector, int32> 
 			Msg(Tilt, RotationRate, Gravity, Acceleration, ControllerId);
-		OutputWriter->RecordMessage(TEXT("OnMotionDetected"), Msg.AsData());
+		RecordMessage(TEXT("OnMotionDetected"), Msg.AsData());
 	}
 
 	if (ConsumeInput)
@@ -430,3 +492,463 @@ void FRecordingMessageHandler::PlayOnMotionDetected(FArchive& Ar)
 	FiveParamMsg<FVector, FVector, FVector, FVector, int32 > Msg(Ar);
 	OnMotionDetected(Msg.Param1, Msg.Param2, Msg.Param3, Msg.Param4, Msg.Param5);
 }
+
+FVector2D FRecordingMessageHandler::GetCursorPosition() const
+{
+	if (FSlateApplication::IsInitialized())
+	{
+		return FSlateApplication::Get().GetCursorPos();
+	}
+
+	return FVector2D(EForceInit::ForceInitToZero);
+}
+
+bool FRecordingMessageHandler::CanSendSampleAt(double LastSentTime, double TimeNow)
+{
+	if (MaxInputSampleRate <= 0)
+	{
+		return true;
+	}
+
+	return (TimeNow - LastSentTime) >= (1.0 / MaxInputSampleRate);
+}
+
+void FRecordingMessageHandler::FlushPendingInput()
+{
+	if (IsRecording() == false)
+	{
+		return;
+	}
+
+	RecordMouseMove(false);
+	RecordRawMouseMove(false);
+
+	for (auto& ControllerKV : AnalogStates)
+	{
+		for (auto& AxisKV : ControllerKV.Value)
+		{
+			RecordControllerAnalog(AxisKV.Key, ControllerKV.Key);
+		}
+	}
+}
+
+void FRecordingMessageHandler::RecordMouseMove(bool bForce)
+{
+	if (bMouseMovePending == false)
+	{
+		return;
+	}
+
+	const double TimeNow = FPlatformTime::Seconds();
+
+	if (bForce == false && CanSendSampleAt(LastMouseMoveTime, TimeNow) == false)
+	{
+		return;
+	}
+
+	FVector2D Normalized;
+
+	if (ConvertToNormalizedScreenLocation(PendingMousePosition, Normalized))
+	{
+		OneParamMsg<FVector2D> Msg(Normalized);
+		RecordMessage(TEXT("OnMouseMove"), Msg.AsData());
+	}
+
+	LastSentMousePosition = PendingMousePosition;
+	LastMouseMoveTime = TimeNow;
+	bMouseMovePending = false;
+}
+
+void FRecordingMessageHandler::RecordRawMouseMove(bool bForce)
+{
+	if (PendingRawMouseDelta == FIntPoint::ZeroValue)
+	{
+		return;
+	}
+
+	const double TimeNow = FPlatformTime::Seconds();
+
+	if (bForce == false)
+	{
+		if (PendingRawMouseDelta.GetMax() < RawMouseThreshold && -PendingRawMouseDelta.GetMin() < RawMouseThreshold)
+		{
+			return;
+		}
+
+		if (CanSendSampleAt(LastRawMouseMoveTime, TimeNow) == false)
+		{
+			return;
+		}
+	}
+
+	TwoParamMsg<int32, int32> Msg(PendingRawMouseDelta.X, PendingRawMouseDelta.Y);
+	RecordMessage(TEXT("OnRawMouseMove"), Msg.AsData());
+
+	PendingRawMouseDelta = FIntPoint::ZeroValue;
+	LastRawMouseMoveTime = TimeNow;
+}
+
+void FRecordingMessageHandler::RecordControllerAnalog(const FName& KeyName, int32 ControllerId)
+{
+	FAnalogState& State = AnalogStates.FindOrAdd(ControllerId).FindOrAdd(KeyName);
+
+	const float Change = FMath::Abs(State.CurrentValue - State.LastSentValue);
+
+	if (Change == 0.0f)
+	{
+		return;
+	}
+
+	// always send the rest position and end stops so the host never ends up with a stick that's
+	// stuck slightly off-center
+	const bool bIsExtent = State.CurrentValue == 0.0f || FMath::Abs(State.CurrentValue) >= 1.0f;
+
+	if (Change < AnalogChangeThreshold && bIsExtent == false)
+	{
+		return;
+	}
+
+	const double TimeNow = FPlatformTime::Seconds();
+
+	// if we're over the rate then FlushPendingInput will send the latest value later
+	if (CanSendSampleAt(State.LastSentTime, TimeNow) == false)
+	{
+		return;
+	}
+
+	ThreeParamMsg<FString, int32, float> Msg(KeyName.ToString(), ControllerId, State.CurrentValue);
+	RecordMessage(TEXT("OnControllerAnalog"), Msg.AsData());
+
+	State.LastSentValue = State.CurrentValue;
+	State.LastSentTime = TimeNow;
+}
+
+void FRecordingMessageHandler::RecordMouseButton(const TCHAR* MsgName, const EMouseButtons::Type Button, const FVector2D& CursorPos, bool bAlwaysSend)
+{
+	FVector2D Normalized;
+
+	// make sure the host cursor is where we are before the click
+	RecordMouseMove(true);
+
+	if (ConvertToNormalizedScreenLocation(CursorPos, Normalized) == false)
+	{
+		if (bAlwaysSend == false)
+		{
+			return;
+		}
+
+		// if outside our bounds, use where the mouse left
+		ConvertToNormalizedScreenLocation(LastSentMousePosition, Normalized);
+	}
+
+	TwoParamMsg<int32, FVector2D> Msg((int32)Button, Normalized);
+	RecordMessage(MsgName, Msg.AsData());
+}
+
+bool FRecordingMessageHandler::OnMouseDown(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button)
+{
+	if (IsRecording())
+	{
+		RecordMouseButton(TEXT("OnMouseDown"), Button, GetCursorPosition(), false);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseDown(Window, Button);
+}
+
+bool FRecordingMessageHandler::OnMouseDown(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button, const FVector2D CursorPos)
+{
+	if (IsRecording())
+	{
+		RecordMouseButton(TEXT("OnMouseDown"), Button, CursorPos, false);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseDown(Window, Button, CursorPos);
+}
+
+void FRecordingMessageHandler::PlayOnMouseDown(FArchive& Ar)
+{
+	TwoParamMsg<int32, FVector2D> Msg(Ar);
+	FVector2D ScreenLocation = ConvertFromNormalizedScreenLocation(Msg.Param2);
+
+	TSharedPtr<FGenericWindow> Window;
+
+	if (PlaybackWindow.IsValid())
+	{
+		Window = PlaybackWindow.Pin()->GetNativeWindow();
+	}
+
+	FSlateApplication::Get().SetCursorPos(ScreenLocation);
+	OnMouseDown(Window, (EMouseButtons::Type)Msg.Param1, ScreenLocation);
+}
+
+bool FRecordingMessageHandler::OnMouseUp(const EMouseButtons::Type Button)
+{
+	if (IsRecording())
+	{
+		// always send releases so buttons can't get stuck down on the host
+		RecordMouseButton(TEXT("OnMouseUp"), Button, GetCursorPosition(), true);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseUp(Button);
+}
+
+bool FRecordingMessageHandler::OnMouseUp(const EMouseButtons::Type Button, const FVector2D CursorPos)
+{
+	if (IsRecording())
+	{
+		RecordMouseButton(TEXT("OnMouseUp"), Button, CursorPos, true);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseUp(Button, CursorPos);
+}
+
+void FRecordingMessageHandler::PlayOnMouseUp(FArchive& Ar)
+{
+	TwoParamMsg<int32, FVector2D> Msg(Ar);
+	FVector2D ScreenLocation = ConvertFromNormalizedScreenLocation(Msg.Param2);
+
+	FSlateApplication::Get().SetCursorPos(ScreenLocation);
+	OnMouseUp((EMouseButtons::Type)Msg.Param1, ScreenLocation);
+}
+
+bool FRecordingMessageHandler::OnMouseDoubleClick(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button)
+{
+	if (IsRecording())
+	{
+		RecordMouseButton(TEXT("OnMouseDoubleClick"), Button, GetCursorPosition(), false);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseDoubleClick(Window, Button);
+}
+
+bool FRecordingMessageHandler::OnMouseDoubleClick(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button, const FVector2D CursorPos)
+{
+	if (IsRecording())
+	{
+		RecordMouseButton(TEXT("OnMouseDoubleClick"), Button, CursorPos, false);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseDoubleClick(Window, Button, CursorPos);
+}
+
+void FRecordingMessageHandler::PlayOnMouseDoubleClick(FArchive& Ar)
+{
+	TwoParamMsg<int32, FVector2D> Msg(Ar);
+	FVector2D ScreenLocation = ConvertFromNormalizedScreenLocation(Msg.Param2);
+
+	TSharedPtr<FGenericWindow> Window;
+
+	if (PlaybackWindow.IsValid())
+	{
+		Window = PlaybackWindow.Pin()->GetNativeWindow();
+	}
+
+	FSlateApplication::Get().SetCursorPos(ScreenLocation);
+	OnMouseDoubleClick(Window, (EMouseButtons::Type)Msg.Param1, ScreenLocation);
+}
+
+bool FRecordingMessageHandler::OnMouseWheel(const float Delta)
+{
+	if (IsRecording())
+	{
+		FVector2D Normalized;
+
+		if (ConvertToNormalizedScreenLocation(GetCursorPosition(), Normalized))
+		{
+			TwoParamMsg<float, FVector2D> Msg(Delta, Normalized);
+			RecordMessage(TEXT("OnMouseWheel"), Msg.AsData());
+		}
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseWheel(Delta);
+}
+
+bool FRecordingMessageHandler::OnMouseWheel(const float Delta, const FVector2D CursorPos)
+{
+	if (IsRecording())
+	{
+		FVector2D Normalized;
+
+		if (ConvertToNormalizedScreenLocation(CursorPos, Normalized))
+		{
+			TwoParamMsg<float, FVector2D> Msg(Delta, Normalized);
+			RecordMessage(TEXT("OnMouseWheel"), Msg.AsData());
+		}
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseWheel(Delta, CursorPos);
+}
+
+void FRecordingMessageHandler::PlayOnMouseWheel(FArchive& Ar)
+{
+	TwoParamMsg<float, FVector2D> Msg(Ar);
+	FVector2D ScreenLocation = ConvertFromNormalizedScreenLocation(Msg.Param2);
+	OnMouseWheel(Msg.Param1, ScreenLocation);
+}
+
+bool FRecordingMessageHandler::OnMouseMove()
+{
+	if (IsRecording())
+	{
+		PendingMousePosition = GetCursorPosition();
+
+		if (PendingMousePosition != LastSentMousePosition)
+		{
+			bMouseMovePending = true;
+			RecordMouseMove(false);
+		}
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnMouseMove();
+}
+
+void FRecordingMessageHandler::PlayOnMouseMove(FArchive& Ar)
+{
+	OneParamMsg<FVector2D> Msg(Ar);
+	FVector2D ScreenLocation = ConvertFromNormalizedScreenLocation(Msg.Param1);
+
+	// Slate reads the position from the platform cursor so move that first
+	FSlateApplication::Get().SetCursorPos(ScreenLocation);
+	OnMouseMove();
+}
+
+bool FRecordingMessageHandler::OnRawMouseMove(const int32 X, const int32 Y)
+{
+	if (IsRecording())
+	{
+		PendingRawMouseDelta += FIntPoint(X, Y);
+		RecordRawMouseMove(false);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnRawMouseMove(X, Y);
+}
+
+void FRecordingMessageHandler::PlayOnRawMouseMove(FArchive& Ar)
+{
+	TwoParamMsg<int32, int32> Msg(Ar);
+	OnRawMouseMove(Msg.Param1, Msg.Param2);
+}
+
+bool FRecordingMessageHandler::OnControllerAnalog(FGamepadKeyNames::Type KeyName, int32 ControllerId, float AnalogValue)
+{
+	if (IsRecording())
+	{
+		AnalogStates.FindOrAdd(ControllerId).FindOrAdd(KeyName).CurrentValue = AnalogValue;
+		RecordControllerAnalog(KeyName, ControllerId);
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnControllerAnalog(KeyName, ControllerId, AnalogValue);
+}
+
+void FRecordingMessageHandler::PlayOnControllerAnalog(FArchive& Ar)
+{
+	ThreeParamMsg<FString, int32, float> Msg(Ar);
+	OnControllerAnalog(FName(*Msg.Param1), Msg.Param2, Msg.Param3);
+}
+
+bool FRecordingMessageHandler::OnControllerButtonPressed(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat)
+{
+	if (IsRecording())
+	{
+		ThreeParamMsg<FString, int32, bool> Msg(KeyName.ToString(), ControllerId, IsRepeat);
+		RecordMessage(TEXT("OnControllerButtonPressed"), Msg.AsData());
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnControllerButtonPressed(KeyName, ControllerId, IsRepeat);
+}
+
+void FRecordingMessageHandler::PlayOnControllerButtonPressed(FArchive& Ar)
+{
+	ThreeParamMsg<FString, int32, bool> Msg(Ar);
+	OnControllerButtonPressed(FName(*Msg.Param1), Msg.Param2, Msg.Param3);
+}
+
+bool FRecordingMessageHandler::OnControllerButtonReleased(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat)
+{
+	if (IsRecording())
+	{
+		ThreeParamMsg<FString, int32, bool> Msg(KeyName.ToString(), ControllerId, IsRepeat);
+		RecordMessage(TEXT("OnControllerButtonReleased"), Msg.AsData());
+	}
+
+	if (ConsumeInput)
+	{
+		return true;
+	}
+
+	return FProxyMessageHandler::OnControllerButtonReleased(KeyName, ControllerId, IsRepeat);
+}
+
+void FRecordingMessageHandler::PlayOnControllerButtonReleased(FArchive& Ar)
+{
+	ThreeParamMsg<FString, int32, bool> Msg(Ar);
+	OnControllerButtonReleased(FName(*Msg.Param1), Msg.Param2, Msg.Param3);
+}
+
+void FRecordingMessageHandler::PlayLatencyProbe(FArchive& Ar)
+{
+	uint8 Id = 0;
+	Ar << Id;
+
+	LatencyProbeDelegate.ExecuteIfBound(Id);
+}
@@ -16,6 +16,7 @@ public:
 };
 
 DECLARE_DELEGATE_OneParam(FRecordedMessageDispatch, FArchive&);
+DECLARE_DELEGATE_OneParam(FOnPlayLatencyProbe, int32 /*Id*/);
 
 class FRecordingMessageHandler : public FProxyMessageHandler, public TSharedFromThis<FRecordingMessageHandler>
 {
@@ -71,6 +72,9 @@ public:
 
 	void SetInputRect(const FVector2D& TopLeft, const FVector2D& Extents);
 
+	/** Sends any analog or mouse movement that was held back by the rate limit */
+	void FlushPendingInput();
+
 public:
 
 	virtual bool OnKeyChar(const TCHAR Character, const bool IsRepeat) override;
@@ -91,8 +95,29 @@ public:
 	virtual bool OnTouchEnded(const FVector2D& Location, int32 TouchIndex, int32 ControllerId) override;
 	virtual bool OnMotionDetected(const FVector& Tilt, const FVector& RotationRate, const FVector& Gravity, const FVector& Acceleration, int32 ControllerId) override;
 
+	virtual bool OnMouseDown(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button) override;
+	virtual bool OnMouseDown(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button, const FVector2D CursorPos) override;
+	virtual bool OnMouseUp(const EMouseButtons::Type Button) override;
+	virtual bool OnMouseUp(const EMouseButtons::Type Button, const FVector2D CursorPos) override;
+	virtual bool OnMouseDoubleClick(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button) override;
+	virtual bool OnMouseDoubleClick(const TSharedPtr< FGenericWindow >& Window, const EMouseButtons::Type Button, const FVector2D CursorPos) override;
+	virtual bool OnMouseWheel(const float Delta) override;
+	virtual bool OnMouseWheel(const float Delta, const FVector2D CursorPos) override;
+	virtual bool OnMouseMove() override;
+	virtual bool OnRawMouseMove(const int32 X, const int32 Y) override;
+
+	virtual bool OnControllerAnalog(FGamepadKeyNames::Type KeyName, int32 ControllerId, float AnalogValue) override;
+	virtual bool OnControllerButtonPressed(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat) override;
+	virtual bool OnControllerButtonReleased(FGamepadKeyNames::Type KeyName, int32 ControllerId, bool IsRepeat) override;
+
 	bool PlayMessage(const TCHAR* Message, const TArray<uint8>& Data);
 
+	/** Plays the message now rather than on the game thread's next task update. Game thread only */
+	bool PlayMessageImmediately(const TCHAR* Message, const TArray<uint8>& Data);
+
+	/** Called when a latency probe is played, on the game thread in order with the input around it */
+	FOnPlayLatencyProbe& OnPlayLatencyProbe() { return LatencyProbeDelegate; }
+
 protected:
 
 	bool ConvertToNormalizedScreenLocation(const FVector2D& InLocation, FVector2D& OutLocation);
@@ -112,6 +137,52 @@ protected:
 	virtual void PlayOnTouchEnded(FArchive& Ar);
 	virtual void PlayOnMotionDetected(FArchive& Ar);
 
+	virtual void PlayOnMouseDown(FArchive& Ar);
+	virtual void PlayOnMouseUp(FArchive& Ar);
+	virtual void PlayOnMouseDoubleClick(FArchive& Ar);
+	virtual void PlayOnMouseWheel(FArchive& Ar);
+	virtual void PlayOnMouseMove(FArchive& Ar);
+	virtual void PlayOnRawMouseMove(FArchive& Ar);
+
+	virtual void PlayOnControllerAnalog(FArchive& Ar);
+	virtual void PlayOnControllerButtonPressed(FArchive& Ar);
+	virtual void PlayOnControllerButtonReleased(FArchive& Ar);
+
+	virtual void PlayLatencyProbe(FArchive& Ar);
+
+	/** Returns the current cursor position, used for events that don't carry one */
+	FVector2D GetCursorPosition() const;
+
+	/** Returns true if enough time has passed since LastSentTime to send another sample */
+	static bool CanSendSampleAt(double LastSentTime, double TimeNow);
+
+	/** Sends a button event at CursorPos. If bAlwaysSend then events outside the input rect use the last position */
+	void RecordMouseButton(const TCHAR* MsgName, const EMouseButtons::Type Button, const FVector2D& CursorPos, bool bAlwaysSend);
+
+	/** Sends the mouse position if it has moved since we last sent it */
+	void RecordMouseMove(bool bForce);
+
+	/** Sends accumulated raw mouse deltas if they are large enough, or bForce is set */
+	void RecordRawMouseMove(bool bForce);
+
+	/** Sends the analog value of KeyName if it has changed enough and the rate allows */
+	void RecordControllerAnalog(const FName& KeyName, int32 ControllerId);
+
+	/** Analog state per stick/trigger axis so we only send meaningful changes */
+	struct FAnalogState
+	{
+		FAnalogState()
+			: LastSentValue(0.0f)
+			, CurrentValue(0.0f)
+			, LastSentTime(0.0)
+		{
+		}
+
+		float	LastSentValue;
+		float	CurrentValue;
+		double	LastSentTime;
+	};
+
 
 	IRecordingMessageHandlerWriter*		OutputWriter;
 	bool								ConsumeInput;
@@ -120,8 +191,21 @@ protected:
 
 	TMap<FString, FRecordedMessageDispatch> DispatchTable;
 
+	FOnPlayLatencyProbe					LatencyProbeDelegate;
+
 	FRect								InputRect;
     FVector2D                           LastTouchLocation;
     bool                                bIsTouching;
 
+	/** Keyed by ControllerId then axis name */
+	TMap<int32, TMap<FName, FAnalogState>>	AnalogStates;
+
+	FVector2D							LastSentMousePosition;
+	FVector2D							PendingMousePosition;
+	double								LastMouseMoveTime;
+	bool								bMouseMovePending;
+
+	FIntPoint							PendingRawMouseDelta;
+	double								LastRawMouseMoveTime;
+
 };
@@ -0,0 +1,245 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "MessageHandler/RemoteSessionInputRecording.h"
+#include "RemoteSession.h"
+#include "RemoteSessionDistribution.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+static int32 GRemoteSessionInputPlayByFrame = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionInputPlayByFrame(
+	TEXT("remote.input.playbyframe"),
+	GRemoteSessionInputPlayByFrame,
+	TEXT("Plays recorded input on the same engine frames it was recorded on rather than at the same times. Use with a fixed frame rate for repeatable runs"),
+	ECVF_Default);
+
+/* Events are written to disk once this much is waiting, or this long after they last were */
+static const int64 kInputRecordingFlushBytes = 64 * 1024;
+static const double kInputRecordingFlushSeconds = 1.0;
+
+TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> FRemoteSessionInputRecorder::Create(const FString& Filename)
+{
+	FArchive* Archive = IFileManager::Get().CreateFileWriter(*Filename);
+
+	if (Archive == nullptr)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Failed to create input recording %s"), *Filename);
+		return nullptr;
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Recording input to %s"), *Filename);
+
+	return MakeShareable(new FRemoteSessionInputRecorder(Filename, Archive));
+}
+
+FRemoteSessionInputRecorder::FRemoteSessionInputRecorder(const FString& InFilename, FArchive* InArchive)
+	: Filename(InFilename)
+	, Archive(InArchive)
+	, NumEvents(0)
+	, UnflushedBytes(0)
+{
+	uint32 Magic = kMagic;
+	uint32 Version = kVersion;
+	*Archive << Magic << Version;
+
+	StartTime = FPlatformTime::Seconds();
+	StartFrame = GFrameCounter;
+	LastFlushTime = StartTime;
+}
+
+FRemoteSessionInputRecorder::~FRemoteSessionInputRecorder()
+{
+	Close();
+}
+
+void FRemoteSessionInputRecorder::RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data)
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive == nullptr)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+
+	FRemoteSessionInputEvent Event;
+	Event.Time = Now - StartTime;
+	Event.Frame = (int32)(GFrameCounter - StartFrame);
+	Event.Message = MsgName;
+	Event.Data = Data;
+
+	const int64 StartOffset = Archive->Tell();
+	*Archive << Event;
+	UnflushedBytes += Archive->Tell() - StartOffset;
+
+	NumEvents++;
+
+	// a few bytes per event, so flushing each one would cost a write per touch
+	FlushIfDue(Now);
+}
+
+void FRemoteSessionInputRecorder::Tick()
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive)
+	{
+		FlushIfDue(FPlatformTime::Seconds());
+	}
+}
+
+void FRemoteSessionInputRecorder::FlushIfDue(double Now)
+{
+	if (UnflushedBytes > 0 && (UnflushedBytes >= kInputRecordingFlushBytes || Now - LastFlushTime >= kInputRecordingFlushSeconds))
+	{
+		Archive->Flush();
+		UnflushedBytes = 0;
+		LastFlushTime = Now;
+	}
+}
+
+void FRemoteSessionInputRecorder::Close()
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive == nullptr)
+	{
+		return;
+	}
+
+	// closing writes whatever is still buffered
+	Archive->Close();
+	delete Archive;
+	Archive = nullptr;
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Recorded %d input events over %.02f seconds to %s"), NumEvents, FPlatformTime::Seconds() - StartTime, *Filename);
+}
+
+FRemoteSessionInputPlayer::FRemoteSessionInputPlayer(TSharedRef<FRecordingMessageHandler> InHandler)
+	: Handler(InHandler)
+	, NextEvent(0)
+	, bPlayByFrame(false)
+	, StartTime(0)
+	, StartFrame(0)
+{
+}
+
+bool FRemoteSessionInputPlayer::Load(const FString& InFilename)
+{
+	Filename = InFilename;
+	Events.Reset();
+	NextEvent = 0;
+
+	TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileReader(*Filename));
+
+	if (Archive.IsValid() == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Failed to open input recording %s"), *Filename);
+		return false;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*Archive << Magic << Version;
+
+	if (Magic != FRemoteSessionInputRecorder::kMagic || Version != FRemoteSessionInputRecorder::kVersion)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("%s is not a version %d input recording"), *Filename, FRemoteSessionInputRecorder::kVersion);
+		return false;
+	}
+
+	while (Archive->AtEnd() == false)
+	{
+		FRemoteSessionInputEvent Event;
+		*Archive << Event;
+
+		// the last event may have been cut off
+		if (Archive->IsError())
+		{
+			break;
+		}
+
+		Events.Add(MoveTemp(Event));
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Loaded %d input events covering %.02f seconds from %s"), Events.Num(), Events.Num() ? Events.Last().Time : 0.0, *Filename);
+
+	return Events.Num() > 0;
+}
+
+void FRemoteSessionInputPlayer::Tick(float DeltaTime)
+{
+	if (IsFinished())
+	{
+		return;
+	}
+
+	if (StartTime == 0)
+	{
+		// the mode is fixed for a run so the results mean one thing
+		bPlayByFrame = GRemoteSessionInputPlayByFrame != 0;
+		StartTime = FPlatformTime::Seconds();
+		StartFrame = GFrameCounter;
+	}
+	else
+	{
+		FrameTimesMS.Add(DeltaTime * 1000.0f);
+	}
+
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	const int32 ElapsedFrames = (int32)(GFrameCounter - StartFrame);
+
+	while (NextEvent < Events.Num())
+	{
+		const FRemoteSessionInputEvent& Event = Events[NextEvent];
+
+		if (bPlayByFrame ? Event.Frame > ElapsedFrames : Event.Time > Elapsed)
+		{
+			break;
+		}
+
+		Handler->PlayMessageImmediately(*Event.Message, Event.Data);
+		NextEvent++;
+	}
+}
+
+bool FRemoteSessionInputPlayer::WriteResults(const FString& OutputFile) const
+{
+	const FRemoteSessionDistribution FrameTimes = FRemoteSessionDistribution::FromValues(FrameTimesMS);
+
+	double TotalMS = 0;
+	for (float FrameTime : FrameTimesMS)
+	{
+		TotalMS += FrameTime;
+	}
+
+	TSharedRef<FJsonObject> Results = MakeShareable(new FJsonObject);
+	Results->SetStringField(TEXT("recording"), Filename);
+	Results->SetBoolField(TEXT("completed"), IsFinished());
+	Results->SetBoolField(TEXT("playByFrame"), bPlayByFrame);
+	Results->SetNumberField(TEXT("events"), NextEvent);
+	Results->SetNumberField(TEXT("frames"), FrameTimesMS.Num());
+	Results->SetNumberField(TEXT("seconds"), TotalMS / 1000.0);
+	Results->SetNumberField(TEXT("fps"), TotalMS > 0 ? FrameTimesMS.Num() / (TotalMS / 1000.0) : 0.0);
+	FrameTimes.AddToJson(Results, TEXT("frameMs"));
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Results, Writer);
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Played %d input events from %s. Frame times (ms): %s"), NextEvent, *Filename, *FrameTimes.ToString());
+
+	if (FFileHelper::SaveStringToFile(Json, *OutputFile) == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Failed to write input playback results to %s"), *OutputFile);
+		return false;
+	}
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Input playback results written to %s"), *OutputFile);
+	return true;
+}
@@ -0,0 +1,115 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MessageHandler/RecordingMessageHandler.h"
+
+class FArchive;
+
+/* An input message and when it happened, relative to the start of its recording */
+struct FRemoteSessionInputEvent
+{
+	double		Time = 0;
+
+	/** Engine frames since the recording started */
+	int32		Frame = 0;
+
+	FString		Message;
+	TArray<uint8>	Data;
+
+	friend FArchive& operator<<(FArchive& Ar, FRemoteSessionInputEvent& Event)
+	{
+		return Ar << Event.Time << Event.Frame << Event.Message << Event.Data;
+	}
+};
+
+/*
+	Writes input messages to a file as they're recorded or received, so a session on a device can be played back
+	on a host later without one. Events are flushed to disk at least once a second, so a recording cut short
+	loses at most its last second.
+
+	Messages can arrive on the receive thread, so everything is done under a lock.
+*/
+class FRemoteSessionInputRecorder : public IRecordingMessageHandlerWriter
+{
+public:
+
+	static const uint32 kMagic = 0x4E495352;	// RSIN
+	static const uint32 kVersion = 1;
+
+	virtual ~FRemoteSessionInputRecorder();
+
+	/** Creates Filename and writes the header. Returns null if the file couldn't be created */
+	static TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> Create(const FString& Filename);
+
+	virtual void RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data) override;
+
+	/** Flushes events that have been waiting longer than the flush interval, so a quiet spell doesn't hold them back */
+	void Tick();
+
+	/** Flushes and closes the file. Nothing is recorded after this */
+	void Close();
+
+	const FString& GetFilename() const { return Filename; }
+
+protected:
+
+	FRemoteSessionInputRecorder(const FString& InFilename, FArchive* InArchive);
+
+	/** Flushes if enough has been written, or it's been long enough, since the last flush. Called under Mutex */
+	void FlushIfDue(double Now);
+
+	FCriticalSection	Mutex;
+	FString				Filename;
+	FArchive*			Archive;
+	double				StartTime;
+	uint64				StartFrame;
+	int32				NumEvents;
+
+	/** Bytes written and when, since the last flush */
+	int64				UnflushedBytes;
+	double				LastFlushTime;
+};
+
+/*
+	Plays a recording made by FRemoteSessionInputRecorder through a message handler on the game thread. Each event
+	is played on the first tick at or after the time it was recorded, or with remote.input.playbyframe on the
+	same engine frame it was recorded on, which repeats exactly when the game runs at a fixed frame rate.
+
+	Frame times are kept while playing so runs of the same recording can be compared.
+*/
+class FRemoteSessionInputPlayer
+{
+public:
+
+	FRemoteSessionInputPlayer(TSharedRef<FRecordingMessageHandler> InHandler);
+
+	/** Reads the events in Filename. Returns false if it isn't a recording */
+	bool Load(const FString& Filename);
+
+	/** Plays events that are due. Call once per engine frame */
+	void Tick(float DeltaTime);
+
+	/** True once every event has been played */
+	bool IsFinished() const { return NextEvent >= Events.Num(); }
+
+	/** Writes the frame times seen while playing as JSON and logs a summary */
+	bool WriteResults(const FString& OutputFile) const;
+
+	const FString& GetFilename() const { return Filename; }
+
+protected:
+
+	TSharedRef<FRecordingMessageHandler>	Handler;
+
+	FString							Filename;
+	TArray<FRemoteSessionInputEvent>	Events;
+	int32							NextEvent;
+
+	bool							bPlayByFrame;
+	double							StartTime;
+	uint64							StartFrame;
+
+	TArray<float>					FrameTimesMS;
+};
@@ -0,0 +1,358 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionBenchmark.h"
+#include "RemoteSession.h"
+#include "RemoteSessionHost.h"
+#include "RemoteSessionClient.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Channels/RemoteSessionFrameSource.h"
+#include "MessageHandler/RecordingMessageHandler.h"
+#include "RemoteSessionDistribution.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+
+/* Scripted touches are made in this space, which is what the input rect is set to */
+static const float kInputExtent = 1000.0f;
+
+/* A touch is lifted and started again after this many moves */
+static const int32 kMovesPerTouch = 120;
+
+FRemoteSessionBenchmarkSettings FRemoteSessionBenchmarkSettings::Parse(const TCHAR* Params)
+{
+	FRemoteSessionBenchmarkSettings Settings;
+
+	FParse::Value(Params, TEXT("Width="), Settings.FrameSize.X);
+	FParse::Value(Params, TEXT("Height="), Settings.FrameSize.Y);
+	FParse::Value(Params, TEXT("Complexity="), Settings.Complexity);
+	FParse::Value(Params, TEXT("Quality="), Settings.Quality);
+	FParse::Value(Params, TEXT("Framerate="), Settings.Framerate);
+	FParse::Value(Params, TEXT("Warmup="), Settings.WarmupSeconds);
+	FParse::Value(Params, TEXT("Seconds="), Settings.MeasureSeconds);
+	FParse::Value(Params, TEXT("InputRate="), Settings.InputRate);
+	FParse::Value(Params, TEXT("Port="), Settings.Port);
+	FParse::Value(Params, TEXT("Output="), Settings.OutputFile);
+
+	Settings.Network = FRemoteSessionNetworkConditions::Get();
+
+	FString NetworkPreset;
+	if (FParse::Value(Params, TEXT("Net="), NetworkPreset))
+	{
+		Settings.Network.Parse(*NetworkPreset);
+	}
+
+	// overrides on top of the preset
+	Settings.Network.Parse(Params);
+
+	if (Settings.OutputFile.IsEmpty())
+	{
+		Settings.OutputFile = FPaths::ProjectSavedDir() / TEXT("RemoteSession") / FString::Printf(TEXT("Benchmark-%s.json"), *FDateTime::Now().ToString());
+	}
+
+	return Settings;
+}
+
+FRemoteSessionBenchmark::FRemoteSessionBenchmark(const FRemoteSessionBenchmarkSettings& InSettings)
+	: Settings(InSettings)
+{
+	NextInputTime = 0;
+	InputStep = 0;
+	InputEventsSent = 0;
+	Phase = EPhase::Connecting;
+	PhaseStartTime = 0;
+	bSucceeded = false;
+	bRecording = false;
+	bNetworkApplied = false;
+}
+
+FRemoteSessionBenchmark::~FRemoteSessionBenchmark()
+{
+	// channels call us from other threads until they're gone
+	Client = nullptr;
+	Host = nullptr;
+
+	RestoreNetwork();
+}
+
+void FRemoteSessionBenchmark::RestoreNetwork()
+{
+	if (bNetworkApplied)
+	{
+		FRemoteSessionNetworkConditions::Set(PreviousNetwork);
+		bNetworkApplied = false;
+	}
+}
+
+bool FRemoteSessionBenchmark::Start()
+{
+	// both connections are made over loopback in this process, so this emulates the link in each direction
+	PreviousNetwork = FRemoteSessionNetworkConditions::Get();
+	FRemoteSessionNetworkConditions::Set(Settings.Network);
+	bNetworkApplied = true;
+
+	Host = MakeShareable(new FRemoteSessionHost(Settings.Quality, Settings.Framerate));
+	Host->SetFrameSource(IRemoteSessionFrameSource::CreateSynthetic(Settings.FrameSize, Settings.Complexity));
+
+	if (Host->StartListening((uint16)Settings.Port) == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Benchmark: failed to listen on port %d"), Settings.Port);
+		Host = nullptr;
+		Phase = EPhase::Finished;
+		RestoreNetwork();
+		return false;
+	}
+
+	const FString Address = FString::Printf(TEXT("127.0.0.1:%d"), Settings.Port);
+	Client = MakeShareable(new FRemoteSessionClient(*Address));
+
+	// no target, the input only goes to the client's channel and from there to the host
+	InputScript = MakeShareable(new FRecordingMessageHandler(nullptr));
+	InputScript->SetInputRect(FVector2D::ZeroVector, FVector2D(kInputExtent, kInputExtent));
+
+	Phase = EPhase::Connecting;
+	PhaseStartTime = FPlatformTime::Seconds();
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Benchmark: %dx%d frames, complexity %.02f, quality %d, %d fps, network %s, measuring for %.0f seconds"),
+		Settings.FrameSize.X, Settings.FrameSize.Y, Settings.Complexity, Settings.Quality, Settings.Framerate, *Settings.Network.ToString(), Settings.MeasureSeconds);
+
+	return true;
+}
+
+void FRemoteSessionBenchmark::BindChannels()
+{
+	TSharedPtr<FRemoteSessionFrameBufferChannel> NewHostChannel = Host->GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+	if (NewHostChannel.IsValid() && NewHostChannel != HostChannel.Pin())
+	{
+		NewHostChannel->AddFrameSentHandler(FOnRemoteSessionFrameTiming::FDelegate::CreateRaw(this, &FRemoteSessionBenchmark::OnFrameSent));
+		HostChannel = NewHostChannel;
+	}
+
+	TSharedPtr<FRemoteSessionFrameBufferChannel> NewClientChannel = Client->GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+	if (NewClientChannel.IsValid() && NewClientChannel != ClientChannel.Pin())
+	{
+		NewClientChannel->AddFrameDisplayedHandler(FOnRemoteSessionFrameTiming::FDelegate::CreateRaw(this, &FRemoteSessionBenchmark::OnFrameDisplayed));
+		ClientChannel = NewClientChannel;
+	}
+
+	TSharedPtr<FRemoteSessionInputChannel> NewInputChannel = Client->GetChannelById<FRemoteSessionInputChannel>(*FRemoteSessionInputChannel::StaticType());
+
+	if (NewInputChannel.IsValid() && NewInputChannel != InputChannel.Pin())
+	{
+		InputScript->SetRecordingHandler(NewInputChannel.Get());
+		InputChannel = NewInputChannel;
+	}
+}
+
+void FRemoteSessionBenchmark::Tick(float DeltaTime)
+{
+	if (Phase == EPhase::Finished)
+	{
+		return;
+	}
+
+	Host->Tick(DeltaTime);
+	Client->Tick(DeltaTime);
+
+	BindChannels();
+
+	const double Now = FPlatformTime::Seconds();
+	const double PhaseTime = Now - PhaseStartTime;
+
+	switch (Phase)
+	{
+	case EPhase::Connecting:
+		if (Host->IsConnected() && Client->IsConnected() && ClientChannel.IsValid())
+		{
+			UE_LOG(LogRemoteSession, Display, TEXT("Benchmark: connected in %.02f secs, warming up"), PhaseTime);
+			Phase = EPhase::Warmup;
+			PhaseStartTime = Now;
+		}
+		else if (PhaseTime > Settings.ConnectTimeoutSeconds)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Benchmark: client failed to connect within %.0f seconds"), Settings.ConnectTimeoutSeconds);
+			Finish(false);
+		}
+		break;
+
+	case EPhase::Warmup:
+		TickInput(Now);
+
+		if (PhaseTime >= Settings.WarmupSeconds)
+		{
+			FScopeLock Lock(&TimingMutex);
+			bRecording = true;
+			InputEventsSent = 0;
+			Phase = EPhase::Measuring;
+			PhaseStartTime = Now;
+		}
+		break;
+
+	case EPhase::Measuring:
+		TickInput(Now);
+
+		if (Client->IsConnected() == false)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Benchmark: client disconnected while measuring"));
+			Finish(false);
+		}
+		else if (PhaseTime >= Settings.MeasureSeconds)
+		{
+			Finish(true);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void FRemoteSessionBenchmark::TickInput(double Now)
+{
+	if (Settings.InputRate <= 0 || InputChannel.IsValid() == false || Now < NextInputTime)
+	{
+		return;
+	}
+
+	NextInputTime = Now + 1.0 / Settings.InputRate;
+
+	// drag around a circle, lifting now and then so starts and ends are sent too
+	const int32 Move = InputStep % (kMovesPerTouch + 1);
+	const float Angle = (InputStep * 2.0f * PI) / kMovesPerTouch;
+	const FVector2D Location(kInputExtent * (0.5f + 0.25f * FMath::Cos(Angle)), kInputExtent * (0.5f + 0.25f * FMath::Sin(Angle)));
+
+	if (Move == 0)
+	{
+#if REMOTE_WITH_FORCE_PARAM
+		InputScript->OnTouchStarted(nullptr, Location, 1.0f, 0, 0);
+#else
+		InputScript->OnTouchStarted(nullptr, Location, 0, 0);
+#endif
+	}
+	else if (Move == kMovesPerTouch)
+	{
+		InputScript->OnTouchEnded(Location, 0, 0);
+	}
+	else
+	{
+#if REMOTE_WITH_FORCE_PARAM
+		InputScript->OnTouchMoved(Location, 1.0f, 0, 0);
+#else
+		InputScript->OnTouchMoved(Location, 0, 0);
+#endif
+	}
+
+	InputStep++;
+	InputEventsSent++;
+}
+
+void FRemoteSessionBenchmark::OnFrameSent(const FRemoteSessionFrameTiming& Timing)
+{
+	FScopeLock Lock(&TimingMutex);
+
+	if (bRecording)
+	{
+		SentFrames.Add(Timing.ImageIndex, Timing);
+	}
+}
+
+void FRemoteSessionBenchmark::OnFrameDisplayed(const FRemoteSessionFrameTiming& Timing)
+{
+	FScopeLock Lock(&TimingMutex);
+
+	if (bRecording)
+	{
+		DisplayedFrames.Add(Timing);
+	}
+}
+
+void FRemoteSessionBenchmark::Finish(bool bCompleted)
+{
+	const double MeasuredSeconds = FPlatformTime::Seconds() - PhaseStartTime;
+
+	TMap<int32, FRemoteSessionFrameTiming> Sent;
+	TArray<FRemoteSessionFrameTiming> Displayed;
+
+	{
+		FScopeLock Lock(&TimingMutex);
+		bRecording = false;
+		Sent = MoveTemp(SentFrames);
+		Displayed = MoveTemp(DisplayedFrames);
+	}
+
+	TArray<float> EncodeMS, DecodeMS, UploadMS, LatencyMS, Bytes;
+	int64 TotalBytes = 0;
+
+	for (const auto& KV : Sent)
+	{
+		EncodeMS.Add(KV.Value.EncodeMS);
+		Bytes.Add(KV.Value.EncodedBytes);
+		TotalBytes += KV.Value.EncodedBytes;
+	}
+
+	for (const FRemoteSessionFrameTiming& Timing : Displayed)
+	{
+		DecodeMS.Add(Timing.DecodeMS);
+		UploadMS.Add(Timing.UploadMS);
+
+		// host and client share a clock, so this is the whole pipeline
+		if (const FRemoteSessionFrameTiming* SentTiming = Sent.Find(Timing.ImageIndex))
+		{
+			LatencyMS.Add((Timing.DisplayTime - SentTiming->CaptureTime) * 1000.0);
+		}
+	}
+
+	TSharedRef<FJsonObject> Results = MakeShareable(new FJsonObject);
+	Results->SetBoolField(TEXT("completed"), bCompleted);
+	Results->SetNumberField(TEXT("width"), Settings.FrameSize.X);
+	Results->SetNumberField(TEXT("height"), Settings.FrameSize.Y);
+	Results->SetNumberField(TEXT("complexity"), Settings.Complexity);
+	Results->SetNumberField(TEXT("quality"), Settings.Quality);
+	Results->SetNumberField(TEXT("targetFps"), Settings.Framerate);
+	Results->SetNumberField(TEXT("seconds"), MeasuredSeconds);
+	Results->SetNumberField(TEXT("framesSent"), Sent.Num());
+	Results->SetNumberField(TEXT("framesDisplayed"), Displayed.Num());
+	Results->SetNumberField(TEXT("sentFps"), MeasuredSeconds > 0 ? Sent.Num() / MeasuredSeconds : 0.0);
+	Results->SetNumberField(TEXT("displayedFps"), MeasuredSeconds > 0 ? Displayed.Num() / MeasuredSeconds : 0.0);
+	Results->SetNumberField(TEXT("sentKbps"), MeasuredSeconds > 0 ? (TotalBytes * 8 / 1000.0) / MeasuredSeconds : 0.0);
+	Results->SetNumberField(TEXT("inputEventsSent"), InputEventsSent);
+	Settings.Network.AddToJson(Results, TEXT("network"));
+
+	FRemoteSessionDistribution TouchToPhoton;
+	if (Client.IsValid() && Client->GetTouchToPhotonLatency(TouchToPhoton))
+	{
+		TouchToPhoton.AddToJson(Results, TEXT("touchToPhotonMs"));
+	}
+	FRemoteSessionDistribution::FromValues(Bytes).AddToJson(Results, TEXT("bytesPerFrame"));
+	FRemoteSessionDistribution::FromValues(EncodeMS).AddToJson(Results, TEXT("encodeMs"));
+	FRemoteSessionDistribution::FromValues(DecodeMS).AddToJson(Results, TEXT("decodeMs"));
+	FRemoteSessionDistribution::FromValues(UploadMS).AddToJson(Results, TEXT("uploadMs"));
+	FRemoteSessionDistribution::FromValues(LatencyMS).AddToJson(Results, TEXT("latencyMs"));
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Results, Writer);
+
+	if (FFileHelper::SaveStringToFile(Json, *Settings.OutputFile))
+	{
+		UE_LOG(LogRemoteSession, Display, TEXT("Benchmark: %.01f fps displayed, %.01f ms median latency. Results written to %s"),
+			MeasuredSeconds > 0 ? Displayed.Num() / MeasuredSeconds : 0.0, Results->GetObjectField(TEXT("latencyMs"))->GetNumberField(TEXT("p50")), *Settings.OutputFile);
+	}
+	else
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Benchmark: failed to write results to %s"), *Settings.OutputFile);
+	}
+
+	bSucceeded = bCompleted;
+	Phase = EPhase::Finished;
+
+	InputScript->SetRecordingHandler(nullptr);
+	Client = nullptr;
+	Host = nullptr;
+
+	RestoreNetwork();
+}
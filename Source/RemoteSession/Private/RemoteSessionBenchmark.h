@@ -0,0 +1,127 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "Transport/RemoteSessionNetworkEmulator.h"
+
+class FRemoteSessionHost;
+class FRemoteSessionClient;
+class FRecordingMessageHandler;
+class FRemoteSessionInputChannel;
+
+/* What the benchmark runs. Parsed from Key=Value pairs, e.g. "Width=1920 Height=1080 Complexity=0.8 Seconds=20" */
+struct FRemoteSessionBenchmarkSettings
+{
+	/** Size and complexity (0-1) of the synthetic frames the host sends */
+	FIntPoint	FrameSize = FIntPoint(1280, 720);
+	float		Complexity = 0.5f;
+
+	int32		Quality = 85;
+	int32		Framerate = 60;
+
+	/** Time allowed to connect, time before measuring starts, and time measured */
+	float		ConnectTimeoutSeconds = 10.0f;
+	float		WarmupSeconds = 2.0f;
+	float		MeasureSeconds = 10.0f;
+
+	/** Scripted touch events per second sent from the client. 0 for none */
+	int32		InputRate = 60;
+
+	/** Port the host listens on, away from the default so a running host doesn't get in the way */
+	int32		Port = 2051;
+
+	/** Network conditions emulated for the run, from Net=<preset> and Latency/Jitter/Bandwidth/Loss/Reorder. Defaults to the current remote.net.* cvars */
+	FRemoteSessionNetworkConditions	Network;
+
+	/** Where results go. Defaults to Saved/RemoteSession/Benchmark-<time>.json */
+	FString		OutputFile;
+
+	static FRemoteSessionBenchmarkSettings Parse(const TCHAR* Params);
+};
+
+/*
+	Runs a host and a client in this process over loopback and measures frames going from one to the other. The host
+	streams synthetic frames so this works headless (-nullrhi), and the client sends scripted touch input.
+
+	Results (fps, bytes per frame, encode/decode/upload times and capture to display latency percentiles) are written
+	as JSON so runs can be compared. Network conditions can be emulated on both ends to see how the stream holds up.
+*/
+class FRemoteSessionBenchmark
+{
+public:
+
+	FRemoteSessionBenchmark(const FRemoteSessionBenchmarkSettings& InSettings);
+
+	~FRemoteSessionBenchmark();
+
+	/** Starts the host and client. Returns false if the host couldn't listen */
+	bool Start();
+
+	/** Ticks the host and client, and writes the results once measuring is over */
+	void Tick(float DeltaTime);
+
+	/** True once results have been written, or the run failed */
+	bool IsFinished() const { return Phase == EPhase::Finished; }
+
+	/** True if the run completed and results were written */
+	bool Succeeded() const { return bSucceeded; }
+
+protected:
+
+	enum class EPhase
+	{
+		Connecting,
+		Warmup,
+		Measuring,
+		Finished
+	};
+
+	/** Binds to the framebuffer channels once they exist, and again if they're recreated */
+	void BindChannels();
+
+	/** Sends the next touch events in our script */
+	void TickInput(double Now);
+
+	/** Called on encoding threads */
+	void OnFrameSent(const FRemoteSessionFrameTiming& Timing);
+
+	/** Called on the render thread */
+	void OnFrameDisplayed(const FRemoteSessionFrameTiming& Timing);
+
+	/** Works out the results, writes them to OutputFile and shuts everything down */
+	void Finish(bool bCompleted);
+
+	/** Puts back the network conditions that were set before we started */
+	void RestoreNetwork();
+
+	FRemoteSessionBenchmarkSettings		Settings;
+
+	TSharedPtr<FRemoteSessionHost>		Host;
+	TSharedPtr<FRemoteSessionClient>	Client;
+
+	TWeakPtr<FRemoteSessionFrameBufferChannel>	HostChannel;
+	TWeakPtr<FRemoteSessionFrameBufferChannel>	ClientChannel;
+
+	/** Records our scripted input and hands it to the client's input channel */
+	TSharedPtr<FRecordingMessageHandler>	InputScript;
+	TWeakPtr<FRemoteSessionInputChannel>	InputChannel;
+	double								NextInputTime;
+	int32								InputStep;
+	int32								InputEventsSent;
+
+	/** Conditions are global, so the ones we replaced are restored when we finish */
+	FRemoteSessionNetworkConditions		PreviousNetwork;
+	bool								bNetworkApplied;
+
+	EPhase								Phase;
+	double								PhaseStartTime;
+	bool								bSucceeded;
+
+	/** Filled in on other threads while measuring */
+	FCriticalSection					TimingMutex;
+	TMap<int32, FRemoteSessionFrameTiming>	SentFrames;
+	TArray<FRemoteSessionFrameTiming>	DisplayedFrames;
+	bool								bRecording;
+};
@@ -8,25 +8,50 @@
 #include "IImageWrapper.h"
 #include "IImageWrapperModule.h"
 #include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
 #include "RemoteSession.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Transport/RemoteSessionTransportSettings.h"
+#include "Transport/RemoteSessionSharedMemoryConnection.h"
+#include "Transport/RemoteSessionReplayConnection.h"
+#include "RemoteSessionHandshake.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "RemoteSessionStats.h"
+#include "Channels/RemoteSessionLatencyProbe.h"
 
 
-DECLARE_CYCLE_STAT(TEXT("RSClientTick"), STAT_RDClientTick, STATGROUP_Game);
+DECLARE_CYCLE_STAT(TEXT("Client Tick"), STAT_RDClientTick, STATGROUP_RemoteSession);
 
 FRemoteSessionClient::FRemoteSessionClient(const TCHAR* InHostAddress)
 {
 	HostAddress = InHostAddress;
 	ConnectionAttemptTimer = FLT_MAX;		// attempt a connection asap
 	TimeConnectionAttemptStarted = 0;
+	ReconnectDelay = 0;
     ConnectionTimeout = 5;
 
 	IsConnecting = false;
 
+	// channels to ask the host for when we connect, others can be opened later with OpenChannel
+	GConfig->GetArray(TEXT("RemoteSession"), TEXT("ClientChannels"), ChannelTypes, GEngineIni);
+
+	if (ChannelTypes.Num() == 0)
+	{
+		ChannelTypes.Add(FRemoteSessionInputChannel::StaticType());
+		ChannelTypes.Add(FRemoteSessionFrameBufferChannel::StaticType());
+	}
+
 	if (HostAddress.Contains(TEXT(":")) == false)
 	{
 		HostAddress += FString::Printf(TEXT(":%d"), (int32)IRemoteSessionModule::kDefaultPort);
 	}
 
+	LatencyProbe = MakeShareable(new FRemoteSessionLatencyProbe());
+
 	UE_LOG(LogRemoteSession, Display, TEXT("Will attempt to connect to %s.."), *HostAddress);
 }
 
@@ -37,9 +62,15 @@ FRemoteSessionClient::~FRemoteSessionClient()
 
 bool FRemoteSessionClient::IsConnected() const
 {
-	// this is to work-around the UE BSD socket implt always saying
-	// things are connected for the first 5 secs...
-	return FRemoteSessionRole::IsConnected() && Connection->GetPacketsReceived() > 0;
+	// a BSD socket says it's connected before the host has accepted us, so wait until we've heard from
+	// the host. It pings as soon as it accepts so this takes one trip, and the heartbeat drops the
+	// connection if it goes quiet after that
+	return FRemoteSessionRole::IsConnected() && Receiver.IsValid() && Receiver->GetLastReceiveTime() > 0;
+}
+
+bool FRemoteSessionClient::IsReplayFinished() const
+{
+	return ReplayConnection.IsValid() && ReplayConnection->IsConnected() == false;
 }
 
 void FRemoteSessionClient::Tick(float DeltaTime)
@@ -52,7 +83,7 @@ void FRemoteSessionClient::Tick(float DeltaTime)
 		{
 			const double TimeSinceLastAttempt = FPlatformTime::Seconds() - TimeConnectionAttemptStarted;
 
-			if (TimeSinceLastAttempt >= 5.0)
+			if (TimeSinceLastAttempt >= ReconnectDelay)
 			{
 				StartConnection();
 			}
@@ -63,18 +94,68 @@ void FRemoteSessionClient::Tick(float DeltaTime)
 			CheckConnection();
 		}
 	}
+	else
+	{
+		// if this connection drops, try again straight away
+		IsConnecting = false;
+		ReconnectDelay = 0;
+
+		LatencyProbe->Tick(GetChannelById<FRemoteSessionInputChannel>(*FRemoteSessionInputChannel::StaticType()),
+			GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType()));
+	}
 
 	FRemoteSessionRole::Tick(DeltaTime);
 }
 
+bool FRemoteSessionClient::GetTouchToPhotonLatency(FRemoteSessionDistribution& OutLatency) const
+{
+	OutLatency = LatencyProbe->GetDistribution();
+	return OutLatency.Count > 0;
+}
+
 void  FRemoteSessionClient::StartConnection()
 {
 	check(IsConnecting == false);
 
-	Close();
+	// a replay that's ended leaves its last frame up rather than starting over
+	if (ReplayConnection.IsValid())
+	{
+		return;
+	}
+
+	// keep our channels so they can be resumed if the host remembers us
+	CloseConnection();
 
-	if (IBackChannelTransport* Transport = IBackChannelTransport::Get())
+	TransportSettings = FRemoteSessionTransportSettings::LoadFromConfig();
+
+	if (HostAddress.StartsWith(FRemoteSessionReplayConnection::AddressPrefix))
 	{
+		ReplayConnection = MakeShareable(new FRemoteSessionReplayConnection());
+
+		if (ReplayConnection->Connect(*HostAddress))
+		{
+			Connection = ReplayConnection;
+			IsConnecting = true;
+		}
+	}
+	else if (HostAddress.StartsWith(FRemoteSessionSharedMemoryConnection::AddressPrefix))
+	{
+		// same-machine host, frames go through mapped memory instead of the loopback socket
+		SharedMemoryConnection = MakeShareable(new FRemoteSessionSharedMemoryConnection(TransportSettings.SharedMemoryRingSizeMB));
+
+		if (SharedMemoryConnection->Connect(*HostAddress))
+		{
+			Connection = SharedMemoryConnection;
+			IsConnecting = true;
+		}
+		else
+		{
+			SharedMemoryConnection = nullptr;
+		}
+	}
+	else if (IBackChannelTransport* Transport = IBackChannelTransport::Get())
+	{
+		// Always connect with TCP, frames are switched to UDP after connecting if requested
 		Connection = Transport->CreateConnection(IBackChannelTransport::TCP);
 
 		if (Connection.IsValid())
@@ -88,35 +169,91 @@ void  FRemoteSessionClient::StartConnection()
 	}
 
 	TimeConnectionAttemptStarted = FPlatformTime::Seconds();
+
+	if (IsConnecting == false)
+	{
+		BackOff();
+	}
+}
+
+void FRemoteSessionClient::BackOff()
+{
+	// retry quickly in case this was a blip, then less often if the host stays away
+	const double InitialDelay = TransportSettings.ReconnectInitialDelayMS / 1000.0;
+	const double MaxDelay = FMath::Max(InitialDelay, TransportSettings.ReconnectMaxDelayMS / 1000.0);
+
+	ReconnectDelay = FMath::Clamp(ReconnectDelay * 2.0, InitialDelay, MaxDelay);
 }
 
 void FRemoteSessionClient::CheckConnection()
 {
 	check(IsConnected() == false && IsConnecting == true);
-	check(Connection->GetSocket());
+	check(Connection->GetSocket() || SharedMemoryConnection.IsValid() || ReplayConnection.IsValid());
+
+	bool Success = true;
+
+	// once we've set up the connection we're waiting to hear from the host, which it does as soon as it accepts us
+	if (Sender.IsValid())
+	{
+		Success = OSCConnection.IsValid() && IsTransportConnected();
+	}
+	else
+	{
+		// success indicates that our check was successful, if our connection was successful then
+		// the delegate code is called
+		Success = Connection->WaitForConnection(0, [this](auto InConnection) {
+			AdoptTransport(CreateTransport(Connection.ToSharedRef(), SharedMemoryConnection, TransportSettings, false, Capture));
 
-	// success indicates that our check was successful, if our connection was successful then
-	// the delegate code is called
-	bool Success = Connection->WaitForConnection(0, [this](auto InConnection) {
-		int32 WantedSize = 4 * 1024 * 1024;
-		int32 ActualSize(0);
+			BindChannelRequests();
 
-		Connection->GetSocket()->SetReceiveBufferSize(WantedSize, ActualSize);
+			TArray<FString> RequestedChannels;
 
-		OSCConnection = MakeShareable(new FBackChannelOSCConnection(Connection.ToSharedRef()));
+			if (Channels.Num())
+			{
+				// reconnecting, our channels (and their textures) carry on with the new connection
+				ResumeChannels();
 
-		Channels.Add(MakeShareable(new FRemoteSessionInputChannel(ERemoteSessionChannelMode::Send, OSCConnection)));
-		Channels.Add(MakeShareable(new FRemoteSessionFrameBufferChannel(ERemoteSessionChannelMode::Receive, OSCConnection)));
+				for (const TSharedPtr<IRemoteSessionChannel>& Channel : Channels)
+				{
+					RequestedChannels.Add(Channel->GetType());
+				}
+			}
+			else
+			{
+				for (const FString& Type : ChannelTypes)
+				{
+					if (CreateChannel(*Type).IsValid())
+					{
+						RequestedChannels.Add(Type);
+					}
+				}
+			}
 
-		UE_LOG(LogRemoteSession, Log, TEXT("Connected to host at %s (ReceiveSize=%dkb)"), *HostAddress, ActualSize / 1024);
+			// tell the host about us before anything else so the first frame suits this device
+			OSCConnection->GetDispatchMap().GetAddressHandler(FRemoteSessionHelloAck::Address).AddRaw(this, &FRemoteSessionClient::OnHostHelloAck);
 
-		IsConnecting = false;
+			FBackChannelOSCMessage HelloMsg(FRemoteSessionHello::Address);
+			FRemoteSessionHello Hello = FRemoteSessionHello::ForThisDevice(RequestedChannels);
 
-		OSCConnection->StartReceiveThread();
-		//SetReceiveInBackground(true);
+			if (Compressor.IsValid())
+			{
+				Hello.Compression = Compressor->GetDescription();
+				Hello.CompressedChannels = TransportSettings.CompressedChannels;
+			}
 
-		return true;
-	});
+			Hello.ResumeToken = SessionToken;
+
+			Hello.Write(HelloMsg);
+			Sender->SendPacket(HelloMsg);
+
+			UE_LOG(LogRemoteSession, Log, TEXT("Connected to host at %s"), *HostAddress);
+
+			// a replay has nothing to wait on, so it's read as we tick
+			SetReceiveInBackground(ReplayConnection.IsValid() == false);
+
+			return true;
+		});
+	}
 
 	const double TimeSpentConnecting = FPlatformTime::Seconds() - TimeConnectionAttemptStarted;
 
@@ -134,8 +271,66 @@ void FRemoteSessionClient::CheckConnection()
 				UE_LOG(LogRemoteSession, Log, TEXT("Failed to check for connection. Aborting."));
 			}
 
-			Close();
+			CloseConnection();
 			TimeConnectionAttemptStarted = FPlatformTime::Seconds();
+			BackOff();
 		}
 	}
 }
+
+void FRemoteSessionClient::OnHostHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
+	FRemoteSessionHelloAck Ack;
+	Ack.Read(Message);
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Host protocol %d will send %dx%d frames using %s%s"),
+		Ack.ProtocolVersion, Ack.FrameWidth, Ack.FrameHeight, *Ack.Codec, Ack.bResumed ? TEXT(" (resumed)") : TEXT(""));
+
+	// only read on the game thread when we next connect, by which point this thread has stopped
+	SessionToken = Ack.SessionToken;
+
+	// the host will compress its messages once it's seen our hello, we can start once we've seen its reply
+	EnableCompressionForPeer(Ack.Compression, Ack.CompressedChannels);
+
+	// arrives before any frames, which are decoded with whatever we set here. We're on the receive thread so
+	// use the pointer we kept rather than looking through our channels
+	TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = HandshakeFramebufferChannel.Pin();
+
+	if (FramebufferChannel.IsValid())
+	{
+		if (Ack.Codec.Len())
+		{
+			FramebufferChannel->SetCodec(Ack.Codec);
+		}
+
+		// the host only listens for this once its channel exists, which it does now
+		if (TransportSettings.bUseUDPForFrames && SharedMemoryConnection.IsValid() == false && ReplayConnection.IsValid() == false && Ack.Channels.Contains(FRemoteSessionFrameBufferChannel::StaticType())
+			&& Connection.IsValid() && Connection->GetSocket())
+		{
+			// frames will only be accepted from the machine we're connected to
+			TSharedRef<FInternetAddr> HostInternetAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+			Connection->GetSocket()->GetPeerAddress(*HostInternetAddress);
+
+			FramebufferChannel->RequestUDPFrames(HostInternetAddress);
+		}
+	}
+}
+
+bool FRemoteSessionClient::ConfigureChannel(const TSharedPtr<IRemoteSessionChannel>& InChannel)
+{
+	const FString Type = InChannel->GetType();
+
+	if (Type == FRemoteSessionInputChannel::StaticType())
+	{
+		StaticCastSharedPtr<FRemoteSessionInputChannel>(InChannel)->SetSender(Sender);
+	}
+	else if (Type == FRemoteSessionFrameBufferChannel::StaticType())
+	{
+		TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = StaticCastSharedPtr<FRemoteSessionFrameBufferChannel>(InChannel);
+		FramebufferChannel->SetReceiver(Receiver);
+		FramebufferChannel->SetSender(Sender);
+		HandshakeFramebufferChannel = FramebufferChannel;
+	}
+
+	return true;
+}
@@ -4,6 +4,12 @@
 
 #include "RemoteSessionRole.h"
 
+class FBackChannelOSCMessage;
+class FBackChannelOSCDispatch;
+class FRemoteSessionFrameBufferChannel;
+class FRemoteSessionReplayConnection;
+class FRemoteSessionLatencyProbe;
+struct FRemoteSessionDistribution;
 
 class FRemoteSessionClient : public FRemoteSessionRole
 {
@@ -16,16 +22,46 @@ public:
 
 	virtual bool IsConnected() const override;
 
+	/** True once a client connected to a replay: address has played the whole capture, or couldn't open it */
+	bool IsReplayFinished() const;
+
+	/** Returns the touch to photon latency measured by recent probes (see remote.probe.interval). False if none have come back */
+	bool GetTouchToPhotonLatency(FRemoteSessionDistribution& OutLatency) const;
+
 protected:
 
 	void StartConnection();
 	void CheckConnection();
 
+	/** Increases the delay before our next connection attempt */
+	void BackOff();
+
+	/** Bound to the host's reply to our hello */
+	void OnHostHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch);
+
+	virtual bool ConfigureChannel(const TSharedPtr<IRemoteSessionChannel>& InChannel) override;
+
 	FString				HostAddress;
+
+	/** Channel types we ask for when connecting */
+	TArray<FString>		ChannelTypes;
+
+	/** Framebuffer channel to configure when the host replies to our hello */
+	TWeakPtr<FRemoteSessionFrameBufferChannel>	HandshakeFramebufferChannel;
+
+	/** Set when HostAddress is a capture to replay. Captures are only played once */
+	TSharedPtr<FRemoteSessionReplayConnection>	ReplayConnection;
+
+	/** Sends probes and times them while remote.probe.interval is set */
+	TSharedPtr<FRemoteSessionLatencyProbe, ESPMode::ThreadSafe>	LatencyProbe;
 	
 	bool				IsConnecting;
     float               ConnectionTimeout;
 
 	double				ConnectionAttemptTimer;
 	double				TimeConnectionAttemptStarted;
+
+	/** Seconds to wait before the next attempt. Zero after a connection drops so we retry immediately */
+	double				ReconnectDelay;
+
 };
@@ -0,0 +1,59 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionDistribution.h"
+#include "Dom/JsonObject.h"
+
+FRemoteSessionDistribution FRemoteSessionDistribution::FromValues(TArray<float> Values)
+{
+	FRemoteSessionDistribution Distribution;
+
+	if (Values.Num() == 0)
+	{
+		return Distribution;
+	}
+
+	Values.Sort();
+
+	double Total = 0;
+	for (float Value : Values)
+	{
+		Total += Value;
+	}
+
+	auto Percentile = [&Values](float P)
+	{
+		return Values[FMath::Clamp(FMath::CeilToInt(P * Values.Num()) - 1, 0, Values.Num() - 1)];
+	};
+
+	Distribution.Count = Values.Num();
+	Distribution.Mean = Total / Values.Num();
+	Distribution.Min = Values[0];
+	Distribution.P50 = Percentile(0.5f);
+	Distribution.P90 = Percentile(0.9f);
+	Distribution.P95 = Percentile(0.95f);
+	Distribution.P99 = Percentile(0.99f);
+	Distribution.Max = Values.Last();
+
+	return Distribution;
+}
+
+void FRemoteSessionDistribution::AddToJson(const TSharedRef<FJsonObject>& Object, const TCHAR* Name) const
+{
+	TSharedRef<FJsonObject> Distribution = MakeShareable(new FJsonObject);
+
+	Distribution->SetNumberField(TEXT("count"), Count);
+	Distribution->SetNumberField(TEXT("mean"), Mean);
+	Distribution->SetNumberField(TEXT("min"), Min);
+	Distribution->SetNumberField(TEXT("p50"), P50);
+	Distribution->SetNumberField(TEXT("p90"), P90);
+	Distribution->SetNumberField(TEXT("p95"), P95);
+	Distribution->SetNumberField(TEXT("p99"), P99);
+	Distribution->SetNumberField(TEXT("max"), Max);
+
+	Object->SetObjectField(Name, Distribution);
+}
+
+FString FRemoteSessionDistribution::ToString() const
+{
+	return FString::Printf(TEXT("mean %.02f, p50 %.02f, p90 %.02f, p99 %.02f, max %.02f (n=%d)"), Mean, P50, P90, P99, Max, Count);
+}
@@ -0,0 +1,28 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FJsonObject;
+
+/* Mean and percentiles of a set of samples, for reports */
+struct FRemoteSessionDistribution
+{
+	int32	Count = 0;
+	double	Mean = 0;
+	float	Min = 0;
+	float	P50 = 0;
+	float	P90 = 0;
+	float	P95 = 0;
+	float	P99 = 0;
+	float	Max = 0;
+
+	static FRemoteSessionDistribution FromValues(TArray<float> Values);
+
+	/** Adds us to Object as Name */
+	void AddToJson(const TSharedRef<FJsonObject>& Object, const TCHAR* Name) const;
+
+	/** e.g. "mean 16.70, p50 16.60, p90 17.10, p99 33.40, max 50.10 (n=1200)" */
+	FString ToString() const;
+};
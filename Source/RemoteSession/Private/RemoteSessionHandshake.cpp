@@ -0,0 +1,159 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionHandshake.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Framework/Application/SlateApplication.h"
+
+const TCHAR* FRemoteSessionHello::Address = TEXT("/Hello");
+const TCHAR* FRemoteSessionHelloAck::Address = TEXT("/HelloAck");
+
+namespace RemoteSessionHandshake
+{
+	static FString JoinList(const TArray<FString>& Items)
+	{
+		return FString::Join(Items, TEXT(","));
+	}
+
+	static TArray<FString> SplitList(const FString& InString)
+	{
+		TArray<FString> Items;
+		InString.ParseIntoArray(Items, TEXT(","), true);
+		return Items;
+	}
+}
+
+FRemoteSessionHello::FRemoteSessionHello()
+	: ProtocolVersion(1)
+	, DisplayWidth(0)
+	, DisplayHeight(0)
+	, NumCores(0)
+{
+}
+
+FRemoteSessionHello FRemoteSessionHello::ForThisDevice(const TArray<FString>& InChannels)
+{
+	FRemoteSessionHello Hello;
+	Hello.ProtocolVersion = kRemoteSessionProtocolVersion;
+	Hello.Codecs = FRemoteSessionFrameBufferChannel::GetSupportedCodecs();
+	Hello.NumCores = FPlatformMisc::NumberOfCores();
+	Hello.Channels = InChannels;
+
+	if (FSlateApplication::IsInitialized())
+	{
+		FDisplayMetrics Metrics;
+		FSlateApplication::Get().GetCachedDisplayMetrics(Metrics);
+		Hello.DisplayWidth = Metrics.PrimaryDisplayWidth;
+		Hello.DisplayHeight = Metrics.PrimaryDisplayHeight;
+	}
+
+	return Hello;
+}
+
+FRemoteSessionHello FRemoteSessionHello::ForLegacyClient()
+{
+	FRemoteSessionHello Hello;
+	Hello.Codecs.Add(TEXT("jpg"));
+	Hello.Channels.Add(FRemoteSessionInputChannel::StaticType());
+	Hello.Channels.Add(FRemoteSessionFrameBufferChannel::StaticType());
+	return Hello;
+}
+
+void FRemoteSessionHello::Write(FBackChannelOSCMessage& Message) const
+{
+	Message.Write(ProtocolVersion);
+	Message.Write(RemoteSessionHandshake::JoinList(Codecs));
+	Message.Write(DisplayWidth);
+	Message.Write(DisplayHeight);
+	Message.Write(NumCores);
+	Message.Write(RemoteSessionHandshake::JoinList(Channels));
+	Message.Write(Compression);
+	Message.Write(RemoteSessionHandshake::JoinList(CompressedChannels));
+	Message.Write(ResumeToken);
+}
+
+void FRemoteSessionHello::Read(FBackChannelOSCMessage& Message)
+{
+	FString CodecList, ChannelList;
+
+	Message << ProtocolVersion;
+	Message << CodecList;
+	Message << DisplayWidth;
+	Message << DisplayHeight;
+	Message << NumCores;
+	Message << ChannelList;
+
+	Codecs = RemoteSessionHandshake::SplitList(CodecList);
+	Channels = RemoteSessionHandshake::SplitList(ChannelList);
+
+	if (ProtocolVersion >= 3)
+	{
+		FString CompressedList;
+		Message << Compression;
+		Message << CompressedList;
+		CompressedChannels = RemoteSessionHandshake::SplitList(CompressedList);
+	}
+
+	if (ProtocolVersion >= 4)
+	{
+		Message << ResumeToken;
+	}
+}
+
+FString FRemoteSessionHello::ToString() const
+{
+	return FString::Printf(TEXT("Protocol=%d Display=%dx%d Cores=%d Codecs=%s Channels=%s Compression=%s"),
+		ProtocolVersion, DisplayWidth, DisplayHeight, NumCores, 
+		*RemoteSessionHandshake::JoinList(Codecs), *RemoteSessionHandshake::JoinList(Channels), *Compression);
+}
+
+FRemoteSessionHelloAck::FRemoteSessionHelloAck()
+	: ProtocolVersion(kRemoteSessionProtocolVersion)
+	, FrameWidth(0)
+	, FrameHeight(0)
+	, bResumed(false)
+{
+}
+
+void FRemoteSessionHelloAck::Write(FBackChannelOSCMessage& Message) const
+{
+	Message.Write(ProtocolVersion);
+	Message.Write(Codec);
+	Message.Write(FrameWidth);
+	Message.Write(FrameHeight);
+	Message.Write(RemoteSessionHandshake::JoinList(Channels));
+	Message.Write(Compression);
+	Message.Write(RemoteSessionHandshake::JoinList(CompressedChannels));
+	Message.Write(SessionToken);
+	Message.Write(bResumed ? 1 : 0);
+}
+
+void FRemoteSessionHelloAck::Read(FBackChannelOSCMessage& Message)
+{
+	FString ChannelList;
+
+	Message << ProtocolVersion;
+	Message << Codec;
+	Message << FrameWidth;
+	Message << FrameHeight;
+	Message << ChannelList;
+
+	Channels = RemoteSessionHandshake::SplitList(ChannelList);
+
+	if (ProtocolVersion >= 3)
+	{
+		FString CompressedList;
+		Message << Compression;
+		Message << CompressedList;
+		CompressedChannels = RemoteSessionHandshake::SplitList(CompressedList);
+	}
+
+	if (ProtocolVersion >= 4)
+	{
+		int32 Resumed = 0;
+		Message << SessionToken;
+		Message << Resumed;
+		bResumed = Resumed != 0;
+	}
+}
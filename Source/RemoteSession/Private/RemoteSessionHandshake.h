@@ -0,0 +1,94 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBackChannelOSCMessage;
+
+/* Protocol version we speak. Bump when messages change in a way older peers can't handle */
+static const int32 kRemoteSessionProtocolVersion = 4;
+
+/* Oldest client protocol the host will talk to. Clients that don't say hello at all are version 1 */
+static const int32 kRemoteSessionMinProtocolVersion = 1;
+
+/*
+	Sent by the client as soon as it connects so the host can set up channels and encoding to suit it
+	before the first frame is sent.
+*/
+struct FRemoteSessionHello
+{
+	FRemoteSessionHello();
+
+	/** Address the hello is sent to */
+	static const TCHAR* Address;
+
+	int32				ProtocolVersion;
+
+	/** Image codecs the client can decode, in order of preference */
+	TArray<FString>		Codecs;
+
+	/** Size of the client's display */
+	int32				DisplayWidth;
+	int32				DisplayHeight;
+
+	int32				NumCores;
+
+	/** Channel types the client wants */
+	TArray<FString>		Channels;
+
+	/** Compression the client can decode (e.g. zlib:<dictionary id>), empty if none. Version 3+ */
+	FString				Compression;
+
+	/** Channels the client will accept compressed messages on. Version 3+ */
+	TArray<FString>		CompressedChannels;
+
+	/** Token from the last session with this host, if we're reconnecting. Version 4+ */
+	FString				ResumeToken;
+
+	/** Describes the current device */
+	static FRemoteSessionHello ForThisDevice(const TArray<FString>& InChannels);
+
+	/** What clients from before the handshake, which don't send a hello, always got */
+	static FRemoteSessionHello ForLegacyClient();
+
+	void Write(FBackChannelOSCMessage& Message) const;
+	void Read(FBackChannelOSCMessage& Message);
+
+	FString ToString() const;
+};
+
+/*
+	The host's reply to FRemoteSessionHello with what it picked
+*/
+struct FRemoteSessionHelloAck
+{
+	FRemoteSessionHelloAck();
+
+	static const TCHAR* Address;
+
+	int32				ProtocolVersion;
+
+	/** Codec frames will be encoded with */
+	FString				Codec;
+
+	/** Size frames will be captured at */
+	int32				FrameWidth;
+	int32				FrameHeight;
+
+	/** Channels the host created */
+	TArray<FString>		Channels;
+
+	/** Same as FRemoteSessionHello, from the host's side. Version 3+ */
+	FString				Compression;
+	TArray<FString>		CompressedChannels;
+
+	/** Identifies this session, give it back in the next hello to resume. Version 4+ */
+	FString				SessionToken;
+
+	/** True if the client's previous session was resumed. Version 4+ */
+	bool				bResumed;
+
+	void Write(FBackChannelOSCMessage& Message) const;
+	void Read(FBackChannelOSCMessage& Message);
+};
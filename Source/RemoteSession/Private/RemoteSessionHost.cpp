@@ -2,12 +2,23 @@
 
 #include "RemoteSessionHost.h"
 #include "BackChannel/Transport/IBackChannelTransport.h"
-#include "FrameGrabber.h"
+#include "Channels/RemoteSessionFrameSource.h"
 #include "Widgets/SViewport.h"
 #include "Utils/BackChannelThreadedConnection.h"
 #include "Channels/RemoteSessionInputChannel.h"
 #include "Channels/RemoteSessionFrameBufferChannel.h"
 #include "Engine/GameEngine.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "RemoteSessionListener.h"
+#include "MessageHandler/RemoteSessionInputRecording.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "RemoteSessionStats.h"
 
 #if WITH_EDITOR
 	#include "Editor.h"
@@ -15,22 +26,33 @@
 #endif
 
 
+DECLARE_CYCLE_STAT(TEXT("Adopt Client"), STAT_RSAdoptClient, STATGROUP_RemoteSession);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Connection Setup (ms)"), STAT_RSConnectionSetup, STATGROUP_RemoteSession);
+
+/* Size of synthetic frames before they're scaled to the client's display */
+static const FIntPoint kSyntheticFrameSize(1920, 1080);
+
 FRemoteSessionHost::FRemoteSessionHost(int32 InQuality, int32 InFramerate)
 {
 	Quality = InQuality;
 	Framerate = InFramerate;
+	bSyntheticFramesWhenHeadless = false;
+
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bSyntheticFramesWhenHeadless"), bSyntheticFramesWhenHeadless, GEngineIni);
 }
 
 FRemoteSessionHost::~FRemoteSessionHost()
 {
-	// close this manually to force the thread to stop before things start to be 
-	// destroyed
+	// stop accepting clients before things start to be destroyed
 	if (Listener.IsValid())
 	{
-		Listener->Close();
+		Listener->Stop();
 	}
 
 	Close();
+
+	// after Close() since a shared memory session shares the listener's mapping
+	Listener = nullptr;
 }
 
 void FRemoteSessionHost::SetScreenSharing(const bool bEnabled)
@@ -45,6 +67,25 @@ void FRemoteSessionHost::SetConsumeInput(const bool bConsume)
 	}*/
 }
 
+void FRemoteSessionHost::SetFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource)
+{
+	FrameSource = InSource;
+
+	TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+	// a connected client switches over with its next frame
+	if (FramebufferChannel.IsValid())
+	{
+		TWeakPtr<SWindow> InputWindow;
+		TSharedPtr<FSceneViewport> SceneViewport;
+
+		FindPlaybackViewport(InputWindow, SceneViewport);
+
+		FramebufferChannel->SetFrameSource(nullptr);
+		ConfigureCapture(FramebufferChannel, SceneViewport);
+	}
+}
+
 bool FRemoteSessionHost::StartListening(const uint16 InPort)
 {
 	if (Listener.IsValid())
@@ -52,29 +93,50 @@ bool FRemoteSessionHost::StartListening(const uint16 InPort)
 		return false;
 	}
 
-	if (IBackChannelTransport* Transport = IBackChannelTransport::Get())
-	{
-		Listener = Transport->CreateConnection(IBackChannelTransport::TCP);
+	TransportSettings = FRemoteSessionTransportSettings::LoadFromConfig();
 
-		if (Listener->Listen(InPort) == false)
-		{
-			Listener = nullptr;
-		}
+	Listener = MakeUnique<FRemoteSessionListener>(TransportSettings);
+	Listener->SetCapture(Capture);
+
+	if (Listener->Listen(InPort) == false)
+	{
+		Listener = nullptr;
 	}
 
 	return Listener.IsValid();
 }
 
+void FRemoteSessionHost::SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	FRemoteSessionRole::SetCapture(InCapture);
+
+	if (Listener.IsValid())
+	{
+		Listener->SetCapture(InCapture);
+	}
+}
 
-bool FRemoteSessionHost::ProcessIncomingConnection(TSharedRef<IBackChannelConnection> NewConnection)
+void FRemoteSessionHost::AdoptClient(const FRemoteSessionAcceptedClient& Client)
 {
-	Close();
+	SCOPE_CYCLE_COUNTER(STAT_RSAdoptClient);
 
-	OSCConnection = MakeShareable(new FBackChannelOSCConnection(NewConnection));
+	// channels are kept until we know whether the client is resuming
+	CloseConnection();
+	AdoptTransport(Client.Transport);
+	BindChannelRequests();
 
-	TWeakPtr<SWindow> InputWindow;
-	TSharedPtr<FSceneViewport> SceneViewport;
+	CreateChannels(Client.Hello);
+
+	SetReceiveInBackground(true);
+
+	const double SetupTime = (FPlatformTime::Seconds() - Client.AcceptTime) * 1000.0;
+	SET_FLOAT_STAT(STAT_RSConnectionSetup, SetupTime);
 
+	UE_LOG(LogRemoteSession, Log, TEXT("Connection %s was set up in %.02fms"), *Connection->GetDescription(), SetupTime);
+}
+
+void FRemoteSessionHost::FindPlaybackViewport(TWeakPtr<SWindow>& OutInputWindow, TSharedPtr<FSceneViewport>& OutSceneViewport) const
+{
 #if WITH_EDITOR
 	if (GIsEditor)
 	{
@@ -87,10 +149,10 @@ bool FRemoteSessionHost::ProcessIncomingConnection(TSharedRef<IBackChannelConnec
 				{
 					if (SlatePlayInEditorSession->SlatePlayInEditorWindowViewport.IsValid())
 					{
-						SceneViewport = SlatePlayInEditorSession->SlatePlayInEditorWindowViewport;
+						OutSceneViewport = SlatePlayInEditorSession->SlatePlayInEditorWindowViewport;
 					}
 
-					InputWindow = SlatePlayInEditorSession->SlatePlayInEditorWindow;
+					OutInputWindow = SlatePlayInEditorSession->SlatePlayInEditorWindow;
 				}
 			}
 		}
@@ -100,37 +162,264 @@ bool FRemoteSessionHost::ProcessIncomingConnection(TSharedRef<IBackChannelConnec
 #endif
 	{
 		UGameEngine* GameEngine = Cast<UGameEngine>(GEngine);
-		SceneViewport = GameEngine->SceneViewport;
-		InputWindow = GameEngine->GameViewportWindow;
+		OutSceneViewport = GameEngine->SceneViewport;
+		OutInputWindow = GameEngine->GameViewportWindow;
+	}
+}
+
+bool FRemoteSessionHost::ConfigureChannel(const TSharedPtr<IRemoteSessionChannel>& InChannel)
+{
+	TWeakPtr<SWindow> InputWindow;
+	TSharedPtr<FSceneViewport> SceneViewport;
+
+	FindPlaybackViewport(InputWindow, SceneViewport);
+
+	const FString Type = InChannel->GetType();
+
+	if (Type == FRemoteSessionInputChannel::StaticType())
+	{
+		TSharedPtr<FRemoteSessionInputChannel> InputChannel = StaticCastSharedPtr<FRemoteSessionInputChannel>(InChannel);
+		InputChannel->SetPlaybackWindow(InputWindow, SceneViewport);
+		InputChannel->SetSender(Sender);
 	}
+	else if (Type == FRemoteSessionFrameBufferChannel::StaticType())
+	{
+		TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = StaticCastSharedPtr<FRemoteSessionFrameBufferChannel>(InChannel);
 
-	TSharedPtr<FRemoteSessionInputChannel> InputChannel = MakeShareable(new FRemoteSessionInputChannel(ERemoteSessionChannelMode::Receive, OSCConnection));
-	InputChannel->SetPlaybackWindow(InputWindow, SceneViewport);
-	Channels.Add(InputChannel);
+		// a resumed channel keeps capturing as it was, only the connection has changed
+		if (FramebufferChannel->IsCapturing() == false && ConfigureCapture(FramebufferChannel, SceneViewport) == false)
+		{
+			return false;
+		}
+
+		FramebufferChannel->SetSender(Sender);
+		FramebufferChannel->SetFrameHistorySize(TransportSettings.FrameHistorySize);
+
+		if (TransportSettings.bAllowUDPFrames && Connection->GetSocket())
+		{
+			TSharedRef<FInternetAddr> ClientAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+			Connection->GetSocket()->GetPeerAddress(*ClientAddress);
+			FramebufferChannel->AllowUDPFrames(ClientAddress, TransportSettings.UDPFragmentSize, TransportSettings.UDPFECGroupSize);
+		}
+	}
+
+	return true;
+}
+
+bool FRemoteSessionHost::ConfigureCapture(const TSharedPtr<FRemoteSessionFrameBufferChannel>& FramebufferChannel, TSharedPtr<FSceneViewport> SceneViewport)
+{
+	// first codec the client prefers that we also support
+	const TArray<FString> OurCodecs = FRemoteSessionFrameBufferChannel::GetSupportedCodecs();
+	const FString* Codec = ClientHello.Codecs.FindByPredicate([&OurCodecs](const FString& Item) {
+		return OurCodecs.Contains(Item);
+	});
+
+	if (Codec)
+	{
+		FramebufferChannel->SetCodec(*Codec);
+	}
 
-	if (SceneViewport.IsValid())
+	if (FrameSource.IsValid())
+	{
+		// whoever provided the source picked its size
+		FramebufferChannel->SetFrameSource(FrameSource);
+	}
+	else if (SceneViewport.IsValid())
+	{
+		FramebufferChannel->SetCaptureViewport(SceneViewport.ToSharedRef(), GetCaptureSizeForClient(SceneViewport->GetSize()));
+	}
+	else if (bSyntheticFramesWhenHeadless)
 	{
-		TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = MakeShareable(new FRemoteSessionFrameBufferChannel(ERemoteSessionChannelMode::Send, OSCConnection));
-		FramebufferChannel->SetCaptureViewport(SceneViewport.ToSharedRef());
-		FramebufferChannel->SetCaptureQuality(Quality, Framerate);
-		Channels.Add(FramebufferChannel);
+		FramebufferChannel->SetFrameSource(IRemoteSessionFrameSource::CreateSynthetic(GetCaptureSizeForClient(kSyntheticFrameSize)));
+	}
+	else
+	{
+		return false;
 	}
 
-	OSCConnection->StartReceiveThread();
+	FramebufferChannel->SetCaptureQuality(Quality, Framerate);
 
 	return true;
 }
 
+FIntPoint FRemoteSessionHost::GetCaptureSizeForClient(FIntPoint SourceSize) const
+{
+	// no point capturing more pixels than the device can show. Compare long and short edges so the
+	// device's orientation doesn't matter
+	FIntPoint CaptureSize = SourceSize;
+
+	if (ClientHello.DisplayWidth > 0 && ClientHello.DisplayHeight > 0 && SourceSize.X > 0 && SourceSize.Y > 0)
+	{
+		const float LongScale = (float)FMath::Max(ClientHello.DisplayWidth, ClientHello.DisplayHeight) / SourceSize.GetMax();
+		const float ShortScale = (float)FMath::Min(ClientHello.DisplayWidth, ClientHello.DisplayHeight) / SourceSize.GetMin();
+		const float Scale = FMath::Min(1.0f, FMath::Min(LongScale, ShortScale));
+
+		// keep dimensions even, some encoders insist on it
+		CaptureSize.X = FMath::Max(2, FMath::RoundToInt(SourceSize.X * Scale) & ~1);
+		CaptureSize.Y = FMath::Max(2, FMath::RoundToInt(SourceSize.Y * Scale) & ~1);
+	}
+
+	return CaptureSize;
+}
+
+void FRemoteSessionHost::CreateChannels(const FRemoteSessionHello& Hello)
+{
+	ClientHello = Hello;
+
+	FRemoteSessionHelloAck Ack;
+
+	EnableCompressionForPeer(Hello.Compression, Hello.CompressedChannels);
+
+	if (Compressor.IsValid())
+	{
+		Ack.Compression = Compressor->GetDescription();
+		Ack.CompressedChannels = TransportSettings.CompressedChannels;
+	}
+
+	// a client that drops and comes back quickly picks up its old channels, capture and all
+	const bool bResume = Hello.ResumeToken.Len() > 0 && Hello.ResumeToken == SessionToken && Channels.Num() > 0
+		&& FPlatformTime::Seconds() - LastDisconnectTime <= TransportSettings.ResumeWindowSeconds;
+
+	// the last client's frames are still the best picture we have until the new capture produces one
+	TArray<FRemoteSessionFrameBufferChannel::FEncodedFrame> RecentFrames;
+
+	if (bResume)
+	{
+		ResumeChannels();
+	}
+	else
+	{
+		TSharedPtr<FRemoteSessionFrameBufferChannel> OldFramebufferChannel = GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+		if (OldFramebufferChannel.IsValid())
+		{
+			RecentFrames = OldFramebufferChannel->GetRecentFrames();
+		}
+
+		ResetChannels();
+		SessionToken = FGuid::NewGuid().ToString();
+	}
+
+	Ack.SessionToken = SessionToken;
+	Ack.bResumed = bResume;
+
+	// only what was asked for, registered types the client doesn't want cost nothing
+	for (const FString& Type : Hello.Channels)
+	{
+		if (ChannelsById.Contains(*Type) || CreateChannel(*Type).IsValid())
+		{
+			Ack.Channels.Add(Type);
+		}
+	}
+
+	TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+	if (FramebufferChannel.IsValid())
+	{
+		Ack.Codec = FramebufferChannel->GetCodec();
+		Ack.FrameWidth = FramebufferChannel->GetCaptureSize().X;
+		Ack.FrameHeight = FramebufferChannel->GetCaptureSize().Y;
+
+		FramebufferChannel->SeedRecentFrames(RecentFrames);
+	}
+
+	// clients from before the handshake wouldn't understand the reply
+	if (Hello.ProtocolVersion >= 2)
+	{
+		FBackChannelOSCMessage Msg(FRemoteSessionHelloAck::Address);
+		Ack.Write(Msg);
+		Sender->SendPacket(Msg);
+	}
+
+	// after the ack so the client knows the codec. Its first picture is then a round trip away instead of a capture and encode
+	if (FramebufferChannel.IsValid())
+	{
+		FramebufferChannel->SendLatestFrame(TransportSettings.LateJoinMaxFrameAgeSeconds);
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("%s %d channels for client (%s). Codec=%s Frames=%dx%d"),
+		bResume ? TEXT("Resumed") : TEXT("Created"), Channels.Num(), *Hello.ToString(), *Ack.Codec, Ack.FrameWidth, Ack.FrameHeight);
+}
 
 void FRemoteSessionHost::Tick(float DeltaTime)
 {
-	// non-threaded listener
-	if (IsConnected() == false)
+	if (Listener.IsValid())
+	{
+		// clients are accepted and set up on the listener's thread, we only create their channels
+		Listener->SetAccepting(IsConnected() == false);
+
+		TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> Client = Listener->TakeClient();
+
+		if (Client.IsValid())
+		{
+			if (IsConnected() == false)
+			{
+				AdoptClient(*Client);
+			}
+			else
+			{
+				UE_LOG(LogRemoteSession, Log, TEXT("Already have a client, closing %s"), *Client->Transport.Connection->GetDescription());
+				Client->Transport.Connection->Close();
+			}
+		}
+	}
+
+	if (IsConnected())
 	{
-		Listener->WaitForConnection(0, [this](TSharedRef<IBackChannelConnection> InConnection) {
-			return ProcessIncomingConnection(InConnection);
-		});
+		// probes are marked on the game thread like other input, so the frames after one has been
+		// handled carry its marker
+		TSharedPtr<FRemoteSessionInputChannel> InputChannel = GetChannelById<FRemoteSessionInputChannel>(*FRemoteSessionInputChannel::StaticType());
+		TSharedPtr<FRemoteSessionFrameBufferChannel> FramebufferChannel = GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+		if (FramebufferChannel.IsValid())
+		{
+			FramebufferChannel->SetProbeMarker(InputChannel.IsValid() ? InputChannel->GetLatencyProbe() : -1);
+		}
+	}
+
+	if (InputPlayer.IsValid())
+	{
+		InputPlayer->Tick(DeltaTime);
+
+		if (InputPlayer->IsFinished())
+		{
+			StopInputPlayback();
+		}
 	}
 	
 	FRemoteSessionRole::Tick(DeltaTime);
 }
+
+bool FRemoteSessionHost::StartInputPlayback(const FString& Filename, const FString& ResultsFile)
+{
+	StopInputPlayback();
+
+	TWeakPtr<SWindow> InputWindow;
+	TSharedPtr<FSceneViewport> SceneViewport;
+
+	FindPlaybackViewport(InputWindow, SceneViewport);
+
+	// played the same way as input from a client
+	TSharedRef<FRecordingMessageHandler> Handler = MakeShareable(new FRecordingMessageHandler(FSlateApplication::Get().GetPlatformApplication()->GetMessageHandler()));
+	Handler->SetPlaybackWindow(InputWindow, SceneViewport);
+
+	InputPlayer = MakeUnique<FRemoteSessionInputPlayer>(Handler);
+
+	if (InputPlayer->Load(Filename) == false)
+	{
+		InputPlayer = nullptr;
+		return false;
+	}
+
+	InputPlaybackResultsFile = ResultsFile;
+	return true;
+}
+
+void FRemoteSessionHost::StopInputPlayback()
+{
+	if (InputPlayer.IsValid())
+	{
+		InputPlayer->WriteResults(InputPlaybackResultsFile);
+		InputPlayer = nullptr;
+	}
+}
@@ -3,12 +3,19 @@
 #pragma once
 
 #include "RemoteSessionRole.h"
+#include "RemoteSessionHandshake.h"
 
 class IBackChannelConnection;
 class FRecordingMessageHandler;
-class FFrameGrabber;
+class IRemoteSessionFrameSource;
 class IImageWrapper;
 class FRemoteSessionInputChannel;
+class FRemoteSessionFrameBufferChannel;
+class FSceneViewport;
+class SWindow;
+class FRemoteSessionListener;
+class FRemoteSessionInputPlayer;
+struct FRemoteSessionAcceptedClient;
 
 class FRemoteSessionHost : public FRemoteSessionRole, public TSharedFromThis<FRemoteSessionHost>
 {
@@ -23,14 +30,62 @@ public:
 
 	void SetConsumeInput(const bool bConsume);
 
+	/** Streams frames from InSource instead of the game's viewport. Null goes back to the viewport */
+	void SetFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource);
+
 	virtual void Tick(float DeltaTime) override;
 
+	/**
+	 * Plays input recorded with StartInputRecording on our viewport as if a client were sending it. When every event
+	 * has been played the frame times seen are written to ResultsFile as JSON
+	 */
+	bool StartInputPlayback(const FString& Filename, const FString& ResultsFile);
+
+	void StopInputPlayback();
+
+	bool IsPlayingInput() const { return InputPlayer.IsValid(); }
+
 protected:
 
-	bool	ProcessIncomingConnection(TSharedRef<IBackChannelConnection> NewConnection);
+	/** Takes over a connection the listener has accepted and creates the client's channels */
+	void	AdoptClient(const FRemoteSessionAcceptedClient& Client);
+
+	/** Creates the channels the client asked for, set up for its device, and tells it what we picked */
+	void	CreateChannels(const FRemoteSessionHello& Hello);
+
+	/** Finds the viewport and window to capture from and play input back on */
+	void	FindPlaybackViewport(TWeakPtr<SWindow>& OutInputWindow, TSharedPtr<FSceneViewport>& OutSceneViewport) const;
+
+	virtual bool IsHost() const override { return true; }
+
+	/** Also hands the capture to the listener so new clients are recorded from their hello */
+	virtual void SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture) override;
 
-	TSharedPtr<IBackChannelConnection> Listener;
+	virtual bool ConfigureChannel(const TSharedPtr<IRemoteSessionChannel>& InChannel) override;
+
+	/** Picks a codec and capture size that suit the client and starts capturing. Returns false if there's nothing to capture */
+	bool	ConfigureCapture(const TSharedPtr<FRemoteSessionFrameBufferChannel>& FramebufferChannel, TSharedPtr<FSceneViewport> SceneViewport);
+
+	/** Scales SourceSize down to fit the client's display */
+	FIntPoint GetCaptureSizeForClient(FIntPoint SourceSize) const;
+
+	/** Accepts clients on a background thread */
+	TUniquePtr<FRemoteSessionListener> Listener;
+
+	/** Recorded input being played, and where its results go */
+	TUniquePtr<FRemoteSessionInputPlayer> InputPlayer;
+	FString		InputPlaybackResultsFile;
 
 	int32		Quality;
 	int32		Framerate;
+
+	/** Set by game code to stream something other than the viewport */
+	TSharedPtr<IRemoteSessionFrameSource> FrameSource;
+
+	/** Stream a test pattern when there's no viewport, e.g. with -nullrhi */
+	bool		bSyntheticFramesWhenHeadless;
+
+
+	/** What the connected client told us about itself */
+	FRemoteSessionHello					ClientHello;
 };
\ No newline at end of file
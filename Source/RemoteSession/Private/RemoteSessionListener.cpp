@@ -0,0 +1,244 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionListener.h"
+#include "RemoteSession.h"
+#include "BackChannel/Transport/IBackChannelTransport.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Transport/RemoteSessionHeartbeat.h"
+#include "Transport/RemoteSessionSharedMemoryConnection.h"
+#include "HAL/RunnableThread.h"
+#include "Sockets.h"
+
+/* How long we block waiting for a TCP client before checking for shared memory clients and whether to exit */
+static const double kAcceptWaitSeconds = 0.02;
+
+/* How long to wait for a client to say hello before assuming it predates the handshake */
+static const double kHelloTimeoutSeconds = 2.0;
+
+/* How often we check for the hello (or an exit request) while waiting for it */
+static const float kHelloWaitTimeMS = 10.0f;
+
+FRemoteSessionListener::FRemoteSessionListener(const FRemoteSessionTransportSettings& InSettings)
+	: Settings(InSettings)
+{
+}
+
+FRemoteSessionListener::~FRemoteSessionListener()
+{
+	Stop();
+
+	if (SharedMemoryListener.IsValid())
+	{
+		SharedMemoryListener->Close();
+		SharedMemoryListener = nullptr;
+	}
+}
+
+bool FRemoteSessionListener::Listen(uint16 Port)
+{
+	check(Thread == nullptr);
+
+	if (IBackChannelTransport* Transport = IBackChannelTransport::Get())
+	{
+		// Control and input always use TCP. Clients can ask for frames to be sent over UDP once connected
+		Listener = Transport->CreateConnection(IBackChannelTransport::TCP);
+
+		if (Listener->Listen(Port) == false)
+		{
+			Listener = nullptr;
+		}
+	}
+
+	if (Listener.IsValid() == false)
+	{
+		return false;
+	}
+
+	if (Settings.bAllowSharedMemory)
+	{
+		SharedMemoryListener = MakeShareable(new FRemoteSessionSharedMemoryConnection(Settings.SharedMemoryRingSizeMB));
+
+		if (SharedMemoryListener->Listen(Port) == false)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Failed to create shared memory listener on port %d"), Port);
+			SharedMemoryListener = nullptr;
+		}
+	}
+
+	bExitRequested = false;
+	bAccepting = true;
+
+	Thread = FRunnableThread::Create(this, TEXT("RemoteSessionListener"), 128 * 1024, TPri_BelowNormal);
+
+	return true;
+}
+
+void FRemoteSessionListener::Stop()
+{
+	if (Thread)
+	{
+		bExitRequested = true;
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (Listener.IsValid())
+	{
+		Listener->Close();
+		Listener = nullptr;
+	}
+
+	FScopeLock Lock(&ClientMutex);
+	ReadyClient = nullptr;
+}
+
+void FRemoteSessionListener::SetAccepting(bool bAccept)
+{
+	bAccepting = bAccept;
+}
+
+TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> FRemoteSessionListener::TakeClient()
+{
+	FScopeLock Lock(&ClientMutex);
+	return MoveTemp(ReadyClient);
+}
+
+uint32 FRemoteSessionListener::Run()
+{
+	while (bExitRequested == false)
+	{
+		bool bHaveClient = false;
+
+		{
+			FScopeLock Lock(&ClientMutex);
+			bHaveClient = ReadyClient.IsValid();
+		}
+
+		// one client at a time, and only once the last one has been picked up
+		if (bAccepting == false || bHaveClient)
+		{
+			FPlatformProcess::Sleep(kAcceptWaitSeconds);
+			continue;
+		}
+
+		Listener->WaitForConnection(kAcceptWaitSeconds, [this](TSharedRef<IBackChannelConnection> InConnection) {
+			Accept(InConnection, nullptr);
+			return true;
+		});
+
+		if (SharedMemoryListener.IsValid())
+		{
+			SharedMemoryListener->WaitForConnection(0, [this](TSharedRef<IBackChannelConnection> InConnection) {
+				Accept(InConnection, StaticCastSharedRef<FRemoteSessionSharedMemoryConnection>(InConnection));
+				return true;
+			});
+		}
+
+		// the callbacks have let go of the connection, so the transport holds the only references
+		if (AcceptedClient.IsValid())
+		{
+			FScopeLock Lock(&ClientMutex);
+			ReadyClient = MoveTemp(AcceptedClient);
+		}
+	}
+
+	return 0;
+}
+
+void FRemoteSessionListener::SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	FScopeLock Lock(&ClientMutex);
+	Capture = InCapture;
+}
+
+void FRemoteSessionListener::Accept(TSharedRef<IBackChannelConnection> InConnection, TSharedPtr<FRemoteSessionSharedMemoryConnection> InSharedMemoryConnection)
+{
+	TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> Client = MakeShareable(new FRemoteSessionAcceptedClient);
+	Client->AcceptTime = FPlatformTime::Seconds();
+
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> LocalCapture;
+
+	{
+		FScopeLock Lock(&ClientMutex);
+		LocalCapture = Capture;
+	}
+
+	Client->Transport = FRemoteSessionRole::CreateTransport(InConnection, InSharedMemoryConnection, Settings, true, LocalCapture);
+
+	if (WaitForHello(*Client))
+	{
+		AcceptedClient = MoveTemp(Client);
+	}
+	else
+	{
+		InConnection->Close();
+	}
+}
+
+bool FRemoteSessionListener::WaitForHello(FRemoteSessionAcceptedClient& Client)
+{
+	FRemoteSessionTransport& Transport = Client.Transport;
+
+	// the handler stays bound to the connection after we're done with it, so it only holds a weak reference
+	TSharedRef<TOptional<FRemoteSessionHello>, ESPMode::ThreadSafe> ReceivedHello = MakeShareable(new TOptional<FRemoteSessionHello>());
+	TWeakPtr<TOptional<FRemoteSessionHello>, ESPMode::ThreadSafe> WeakHello = ReceivedHello;
+
+	Transport.OSCConnection->GetDispatchMap().GetAddressHandler(FRemoteSessionHello::Address).AddLambda([WeakHello](FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch) {
+		TSharedPtr<TOptional<FRemoteSessionHello>, ESPMode::ThreadSafe> Hello = WeakHello.Pin();
+
+		if (Hello.IsValid())
+		{
+			FRemoteSessionHello Value;
+			Value.Read(Message);
+			*Hello = Value;
+		}
+	});
+
+	const FTimespan WaitTime = FTimespan::FromMilliseconds(kHelloWaitTimeMS);
+	FSocket* Socket = Transport.Connection->GetSocket();
+
+	while (ReceivedHello->IsSet() == false)
+	{
+		if (bExitRequested)
+		{
+			return false;
+		}
+
+		if (FPlatformTime::Seconds() - Client.AcceptTime >= kHelloTimeoutSeconds)
+		{
+			break;
+		}
+
+		const bool bReadable = Socket ? Socket->Wait(ESocketWaitConditions::WaitForRead, WaitTime) : Transport.SharedMemoryConnection->WaitForData(WaitTime);
+
+		// readable with nothing to read means the other end closed the socket
+		if (bReadable && Transport.Receiver->ReceivePackets() == 0)
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("%s disconnected before saying hello"), *Transport.Connection->GetDescription());
+			return false;
+		}
+
+		// lets the client know we've accepted it
+		Transport.Heartbeat->Tick(FPlatformTime::Seconds(), Transport.Receiver->GetLastReceiveTime());
+	}
+
+	if (ReceivedHello->IsSet() == false)
+	{
+		Client.Hello = FRemoteSessionHello::ForLegacyClient();
+		return true;
+	}
+
+	Client.Hello = ReceivedHello->GetValue();
+
+	if (Client.Hello.ProtocolVersion < kRemoteSessionMinProtocolVersion)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Client protocol %d is older than the minimum of %d, disconnecting"),
+			Client.Hello.ProtocolVersion, kRemoteSessionMinProtocolVersion);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,86 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RemoteSessionRole.h"
+#include "RemoteSessionHandshake.h"
+
+class FRunnableThread;
+
+/* A client that has connected and said hello, ready for the host to create channels for */
+struct FRemoteSessionAcceptedClient
+{
+	FRemoteSessionTransport		Transport;
+
+	/** The client's hello, or what old clients that don't send one always got */
+	FRemoteSessionHello			Hello;
+
+	/** When the connection was accepted */
+	double						AcceptTime = 0;
+};
+
+/*
+	Accepts clients on a background thread, over TCP and (if enabled) shared memory. Each new connection has its
+	transport built and its hello read here so the host's game thread only has to create channels and bind them
+	to the viewport.
+*/
+class FRemoteSessionListener : public FRunnable
+{
+public:
+
+	FRemoteSessionListener(const FRemoteSessionTransportSettings& InSettings);
+
+	virtual ~FRemoteSessionListener();
+
+	/** Starts listening on Port and starts our thread. Returns false if we couldn't listen */
+	bool Listen(uint16 Port);
+
+	/** Stops our thread and the TCP listener. The shared memory listener is kept until we're destroyed since any session it handed out shares its mapping */
+	void Stop();
+
+	/** Whether new clients should be accepted. The host only talks to one at a time */
+	void SetAccepting(bool bAccept);
+
+	/** Records clients we accept from here on, from their first packet. Null stops recording new clients */
+	void SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture);
+
+	/** Returns the next client that's ready, if there is one. Our thread holds no references to it by then */
+	TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> TakeClient();
+
+protected:
+
+	virtual uint32 Run() override;
+
+	/** Sets up a connection and waits for its hello, closing it if that doesn't work out */
+	void Accept(TSharedRef<IBackChannelConnection> InConnection, TSharedPtr<FRemoteSessionSharedMemoryConnection> InSharedMemoryConnection);
+
+	/** Reads from the client until it says hello or it's clear it won't */
+	bool WaitForHello(FRemoteSessionAcceptedClient& Client);
+
+	FRemoteSessionTransportSettings			Settings;
+
+	TSharedPtr<IBackChannelConnection>		Listener;
+
+	/** Accepts clients on the same machine, if enabled */
+	TSharedPtr<FRemoteSessionSharedMemoryConnection> SharedMemoryListener;
+
+	FRunnableThread*						Thread = nullptr;
+	FThreadSafeBool							bExitRequested;
+	FThreadSafeBool							bAccepting;
+
+	/**
+		A client that said hello, only touched on our thread. It's moved to ReadyClient once the connection
+		callbacks have returned, since a connection's reference count isn't thread safe and nothing on our
+		thread may hold one when another thread takes the client
+	*/
+	TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> AcceptedClient;
+
+	FCriticalSection						ClientMutex;
+	TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> ReadyClient;
+
+	/** Read on our thread when a client connects, guarded by ClientMutex */
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> Capture;
+};
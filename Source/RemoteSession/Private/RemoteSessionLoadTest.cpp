@@ -0,0 +1,919 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionLoadTest.h"
+#include "RemoteSession.h"
+#include "RemoteSessionHost.h"
+#include "RemoteSessionRelay.h"
+#include "RemoteSessionHandshake.h"
+#include "RemoteSessionDistribution.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Channels/RemoteSessionFrameSource.h"
+#include "BackChannel/Transport/IBackChannelTransport.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "HAL/RunnableThread.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+
+/* How long a client waits between attempts to connect */
+static const double kLoadClientRetrySeconds = 1.0;
+
+/* How long the other end has to answer a client's hello */
+static const double kLoadClientConnectTimeoutSeconds = 5.0;
+
+/* How long a client sleeps when there was nothing to do */
+static const float kLoadClientIdleSleepSeconds = 0.001f;
+
+/* Touches are made in this space, and lifted and started again after this many moves */
+static const float kLoadInputExtent = 1000.0f;
+static const int32 kLoadMovesPerTouch = 120;
+
+/* How long the clients' process has to start and connect its first clients, and to finish once we're done */
+static const double kClientProcessStartSeconds = 120.0;
+static const double kClientProcessExitSeconds = 60.0;
+
+FRemoteSessionLoadTestSettings FRemoteSessionLoadTestSettings::Parse(const TCHAR* Params)
+{
+	FRemoteSessionLoadTestSettings Settings;
+
+	FString ClientSteps;
+	if (FParse::Value(Params, TEXT("Clients="), ClientSteps, false))
+	{
+		TArray<FString> Steps;
+		ClientSteps.ParseIntoArray(Steps, TEXT(","));
+
+		for (const FString& Step : Steps)
+		{
+			const int32 NumClients = FCString::Atoi(*Step);
+
+			// steps only ever add clients
+			if (NumClients > 0 && (Settings.ClientSteps.Num() == 0 || NumClients > Settings.ClientSteps.Last()))
+			{
+				Settings.ClientSteps.Add(NumClients);
+			}
+		}
+	}
+
+	if (Settings.ClientSteps.Num() == 0)
+	{
+		Settings.ClientSteps = { 1, 2, 4, 8 };
+	}
+
+	int32 Decode = Settings.bDecode ? 1 : 0;
+	FParse::Value(Params, TEXT("Decode="), Decode);
+	Settings.bDecode = Decode != 0;
+
+	FParse::Value(Params, TEXT("InputRate="), Settings.InputRate);
+	FParse::Value(Params, TEXT("Width="), Settings.FrameSize.X);
+	FParse::Value(Params, TEXT("Height="), Settings.FrameSize.Y);
+	FParse::Value(Params, TEXT("Complexity="), Settings.Complexity);
+	FParse::Value(Params, TEXT("Quality="), Settings.Quality);
+	FParse::Value(Params, TEXT("Framerate="), Settings.Framerate);
+	FParse::Value(Params, TEXT("Warmup="), Settings.WarmupSeconds);
+	FParse::Value(Params, TEXT("Seconds="), Settings.MeasureSeconds);
+	FParse::Value(Params, TEXT("HostPort="), Settings.HostPort);
+	FParse::Value(Params, TEXT("RelayPort="), Settings.RelayPort);
+	FParse::Value(Params, TEXT("Address="), Settings.Address);
+	FParse::Value(Params, TEXT("Output="), Settings.OutputFile);
+
+	int32 ReportFrames = Settings.bReportFrames ? 1 : 0;
+	FParse::Value(Params, TEXT("ReportFrames="), ReportFrames);
+	Settings.bReportFrames = ReportFrames != 0;
+
+	if (Settings.OutputFile.IsEmpty())
+	{
+		Settings.OutputFile = FString::Printf(TEXT("LoadTest-%s.json"), *FDateTime::Now().ToString());
+	}
+
+	if (FPaths::GetPath(Settings.OutputFile).IsEmpty())
+	{
+		Settings.OutputFile = FPaths::ProjectSavedDir() / TEXT("RemoteSession") / Settings.OutputFile;
+	}
+
+	return Settings;
+}
+
+FRemoteSessionLoadClient::FRemoteSessionLoadClient(int32 InId, const FString& InAddress, bool bInDecode, int32 InInputRate, bool bInRecordFrames)
+	: Id(InId)
+	, Address(InAddress)
+	, bDecode(bInDecode)
+	, InputRate(InInputRate)
+	, bRecordFrames(bInRecordFrames)
+	, AttemptTime(0)
+	, NextInputTime(0)
+	, InputStep(0)
+	, Thread(nullptr)
+{
+	Settings = FRemoteSessionTransportSettings::LoadFromConfig();
+	Settings.bAllowSharedMemory = false;
+
+	// no target, touches only become messages to send
+	InputScript = MakeShareable(new FRecordingMessageHandler(nullptr));
+	InputScript->SetInputRect(FVector2D::ZeroVector, FVector2D(kLoadInputExtent, kLoadInputExtent));
+	InputScript->SetRecordingHandler(this);
+}
+
+FRemoteSessionLoadClient::~FRemoteSessionLoadClient()
+{
+	if (Thread)
+	{
+		bExitRequested = true;
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	InputScript->SetRecordingHandler(nullptr);
+}
+
+void FRemoteSessionLoadClient::Start()
+{
+	Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("RemoteSessionLoadClient%d"), Id), 128 * 1024, TPri_Normal);
+}
+
+FRemoteSessionLoadClient::FResults FRemoteSessionLoadClient::TakeResults()
+{
+	FScopeLock Lock(&ResultsMutex);
+
+	FResults Taken = MoveTemp(Results);
+	Results = FResults();
+
+	return Taken;
+}
+
+uint32 FRemoteSessionLoadClient::Run()
+{
+	while (bExitRequested == false)
+	{
+		const double Now = FPlatformTime::Seconds();
+
+		if (Connection.IsValid() == false)
+		{
+			if (Now - AttemptTime >= kLoadClientRetrySeconds)
+			{
+				StartConnection(Now);
+			}
+
+			FPlatformProcess::Sleep(kLoadClientIdleSleepSeconds);
+			continue;
+		}
+
+		if (Transport.Receiver.IsValid() == false)
+		{
+			// still connecting
+			Connection->WaitForConnection(0, [this](TSharedRef<IBackChannelConnection> InConnection) {
+				OnConnected();
+				return true;
+			});
+
+			if (Transport.Receiver.IsValid() == false && Now - AttemptTime >= kLoadClientConnectTimeoutSeconds)
+			{
+				CloseConnection(Now);
+			}
+
+			FPlatformProcess::Sleep(kLoadClientIdleSleepSeconds);
+			continue;
+		}
+
+		bool bReceived = false;
+
+		if (FRemoteSessionRelay::ReceiveFrom(Transport, Now, bReceived) == false)
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("Load client %d lost connection to %s"), Id, *Address);
+			CloseConnection(Now);
+			continue;
+		}
+
+		if (bHelloAcked == false && Now - AttemptTime >= kLoadClientConnectTimeoutSeconds)
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("%s didn't answer load client %d's hello"), *Address, Id);
+			CloseConnection(Now);
+			continue;
+		}
+
+		TickInput(Now);
+
+		const double BusySeconds = FPlatformTime::Seconds() - Now;
+
+		{
+			FScopeLock Lock(&ResultsMutex);
+			Results.BusySeconds += BusySeconds;
+		}
+
+		if (bReceived == false)
+		{
+			FPlatformProcess::Sleep(kLoadClientIdleSleepSeconds);
+		}
+	}
+
+	CloseConnection(FPlatformTime::Seconds());
+	return 0;
+}
+
+void FRemoteSessionLoadClient::StartConnection(double Now)
+{
+	AttemptTime = Now;
+
+	if (IBackChannelTransport* BackChannel = IBackChannelTransport::Get())
+	{
+		Connection = BackChannel->CreateConnection(IBackChannelTransport::TCP);
+
+		if (Connection.IsValid() && Connection->Connect(*Address) == false)
+		{
+			Connection = nullptr;
+		}
+	}
+}
+
+void FRemoteSessionLoadClient::OnConnected()
+{
+	Transport = FRemoteSessionRole::CreateTransport(Connection.ToSharedRef(), nullptr, Settings, false);
+
+	Transport.Receiver->BindHandler(TEXT("/Screen"), FRemoteSessionMessageHandler::CreateRaw(this, &FRemoteSessionLoadClient::OnFrame));
+	Transport.OSCConnection->GetDispatchMap().GetAddressHandler(FRemoteSessionHelloAck::Address).AddRaw(this, &FRemoteSessionLoadClient::OnHelloAck);
+
+	// no display size, so every client gets the same full size frames
+	FRemoteSessionHello Hello;
+	Hello.ProtocolVersion = kRemoteSessionProtocolVersion;
+	Hello.Codecs = FRemoteSessionFrameBufferChannel::GetSupportedCodecs();
+	Hello.NumCores = FPlatformMisc::NumberOfCores();
+	Hello.Channels.Add(FRemoteSessionInputChannel::StaticType());
+	Hello.Channels.Add(FRemoteSessionFrameBufferChannel::StaticType());
+
+	if (Transport.Compressor.IsValid())
+	{
+		Hello.Compression = Transport.Compressor->GetDescription();
+		Hello.CompressedChannels = Settings.CompressedChannels;
+	}
+
+	FBackChannelOSCMessage Msg(FRemoteSessionHello::Address);
+	Hello.Write(Msg);
+	Transport.Sender->SendPacket(Msg);
+}
+
+void FRemoteSessionLoadClient::CloseConnection(double Now)
+{
+	if (Connection.IsValid())
+	{
+		Connection->Close();
+	}
+
+	Transport = FRemoteSessionTransport();
+	Connection = nullptr;
+	AttemptTime = Now;
+	bHelloAcked = false;
+	bReady = false;
+}
+
+void FRemoteSessionLoadClient::OnHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
+	FRemoteSessionHelloAck Ack;
+	Ack.Read(Message);
+
+	if (Transport.Compressor.IsValid() && Ack.Compression == Transport.Compressor->GetDescription())
+	{
+		TArray<FString> Channels;
+
+		for (const FString& Channel : Settings.CompressedChannels)
+		{
+			if (Ack.CompressedChannels.Contains(Channel))
+			{
+				Channels.Add(Channel);
+			}
+		}
+
+		Transport.Sender->EnableCompression(Transport.Compressor, Channels);
+	}
+
+	Codec = Ack.Codec;
+	bHelloAcked = true;
+}
+
+void FRemoteSessionLoadClient::OnFrame(FRemoteSessionReceivedMessage& Message)
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 ImageIndex = 0;
+	FRemoteSessionBlobView Data;
+
+	if (!Message.Read(Width) || !Message.Read(Height) || !Message.Read(Data) || !Message.Read(ImageIndex))
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Load client %d received a malformed frame"), Id);
+		return;
+	}
+
+	float DecodeMS = 0;
+
+	if (bDecode)
+	{
+		const double DecodeStartTime = FPlatformTime::Seconds();
+
+		if (FRemoteSessionFrameBufferChannel::DecodeImage(Codec, Data.GetData(), Data.Num(), DecodedPixels) == false)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Load client %d couldn't decode frame %d"), Id, ImageIndex);
+			return;
+		}
+
+		DecodeMS = (FPlatformTime::Seconds() - DecodeStartTime) * 1000.0;
+	}
+
+	FScopeLock Lock(&ResultsMutex);
+
+	Results.FramesReceived++;
+	Results.BytesReceived += Message.GetSize();
+
+	if (bDecode)
+	{
+		Results.DecodeMS.Add(DecodeMS);
+	}
+
+	if (bRecordFrames)
+	{
+		Results.FrameIndices.Add(ImageIndex);
+		Results.FrameTimes.Add(FPlatformTime::Seconds());
+	}
+
+	bReady = true;
+}
+
+void FRemoteSessionLoadClient::TickInput(double Now)
+{
+	if (InputRate <= 0 || bHelloAcked == false || Now < NextInputTime)
+	{
+		return;
+	}
+
+	NextInputTime = Now + 1.0 / InputRate;
+
+	// drag around a circle, each client starting somewhere different
+	const int32 Step = InputStep + Id * (kLoadMovesPerTouch / 4);
+	const int32 Move = InputStep % (kLoadMovesPerTouch + 1);
+	const float Angle = (Step * 2.0f * PI) / kLoadMovesPerTouch;
+	const FVector2D Location(kLoadInputExtent * (0.5f + 0.25f * FMath::Cos(Angle)), kLoadInputExtent * (0.5f + 0.25f * FMath::Sin(Angle)));
+
+	if (Move == 0)
+	{
+#if REMOTE_WITH_FORCE_PARAM
+		InputScript->OnTouchStarted(nullptr, Location, 1.0f, 0, 0);
+#else
+		InputScript->OnTouchStarted(nullptr, Location, 0, 0);
+#endif
+	}
+	else if (Move == kLoadMovesPerTouch)
+	{
+		InputScript->OnTouchEnded(Location, 0, 0);
+	}
+	else
+	{
+#if REMOTE_WITH_FORCE_PARAM
+		InputScript->OnTouchMoved(Location, 1.0f, 0, 0);
+#else
+		InputScript->OnTouchMoved(Location, 0, 0);
+#endif
+	}
+
+	InputStep++;
+
+	FScopeLock Lock(&ResultsMutex);
+	Results.InputEventsSent++;
+}
+
+void FRemoteSessionLoadClient::RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data)
+{
+	if (Transport.Sender.IsValid())
+	{
+		FString Path = FString::Printf(TEXT("/MessageHandler/%s"), MsgName);
+		FBackChannelOSCMessage Msg(*Path);
+		Msg.Write(Data);
+
+		Transport.Sender->SendPacket(Msg, FRemoteSessionInputChannel::StaticType());
+	}
+}
+
+FRemoteSessionLoadTest::FRemoteSessionLoadTest(const FRemoteSessionLoadTestSettings& InSettings)
+	: Settings(InSettings)
+	, StepIndex(0)
+	, Phase(EPhase::Connecting)
+	, PhaseStartTime(0)
+	, ProcessCPUTotal(0)
+	, ProcessCPUSamples(0)
+	, PreviousProcessCores(0)
+	, PreviousClients(0)
+{
+}
+
+FRemoteSessionLoadTest::~FRemoteSessionLoadTest()
+{
+	if (ClientProcess.IsValid())
+	{
+		FPlatformProcess::TerminateProc(ClientProcess);
+		FPlatformProcess::CloseProc(ClientProcess);
+	}
+
+	Clients.Empty();
+	Relay = nullptr;
+	Host = nullptr;
+}
+
+bool FRemoteSessionLoadTest::Start()
+{
+	if (Settings.Address.IsEmpty())
+	{
+		Host = MakeShareable(new FRemoteSessionHost(Settings.Quality, Settings.Framerate));
+		Host->SetFrameSource(IRemoteSessionFrameSource::CreateSynthetic(Settings.FrameSize, Settings.Complexity));
+
+		if (Host->StartListening((uint16)Settings.HostPort) == false)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Load test: failed to listen on port %d"), Settings.HostPort);
+			Host = nullptr;
+			Phase = EPhase::Finished;
+			return false;
+		}
+
+		Relay = MakeUnique<FRemoteSessionRelay>(FString::Printf(TEXT("127.0.0.1:%d"), Settings.HostPort), (uint16)Settings.RelayPort);
+
+		if (Relay->Start() == false || StartClientProcess() == false)
+		{
+			Relay = nullptr;
+			Host = nullptr;
+			Phase = EPhase::Finished;
+			return false;
+		}
+	}
+
+	TArray<FString> Steps;
+
+	for (int32 NumClients : Settings.ClientSteps)
+	{
+		Steps.Add(FString::FromInt(NumClients));
+	}
+
+	const FString Address = Host.IsValid() ? FString::Printf(TEXT("a relay on port %d from another process"), Settings.RelayPort) : Settings.Address;
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Load test: %s clients against %s, %s, %d touches per second each, measuring each step for %.0f seconds"),
+		*FString::Join(Steps, TEXT(",")), *Address, Settings.bDecode ? TEXT("decoding") : TEXT("not decoding"), Settings.InputRate, Settings.MeasureSeconds);
+
+	StartStep();
+	return true;
+}
+
+bool FRemoteSessionLoadTest::StartClientProcess()
+{
+	TArray<FString> Steps;
+
+	for (int32 NumClients : Settings.ClientSteps)
+	{
+		Steps.Add(FString::FromInt(NumClients));
+	}
+
+	// a bare file name so the path, which may have spaces, doesn't have to be quoted inside the quoted parameters
+	const FString ResultsName = FPaths::GetBaseFilename(Settings.OutputFile) + TEXT("-Clients.json");
+	ClientResultsFile = FPaths::ProjectSavedDir() / TEXT("RemoteSession") / ResultsName;
+
+	const FString Params = FString::Printf(TEXT("Clients=%s Decode=%d InputRate=%d Warmup=%f Seconds=%f Address=127.0.0.1:%d ReportFrames=1 Output=%s"),
+		*FString::Join(Steps, TEXT(",")), Settings.bDecode ? 1 : 0, Settings.InputRate, Settings.WarmupSeconds, Settings.MeasureSeconds, Settings.RelayPort, *ResultsName);
+
+	FString Args;
+
+#if !IS_MONOLITHIC
+	if (FPaths::IsProjectFilePathSet())
+	{
+		Args += FString::Printf(TEXT("\"%s\" "), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()));
+	}
+#endif
+
+	if (GIsEditor)
+	{
+		Args += TEXT("-game ");
+	}
+
+	Args += FString::Printf(TEXT("-nullrhi -nosound -unattended -RemoteSessionLoadTest=\"%s\""), *Params);
+
+	ClientProcess = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Args, false, true, true, nullptr, 0, nullptr, nullptr);
+
+	if (ClientProcess.IsValid() == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Load test: failed to start %s %s"), FPlatformProcess::ExecutablePath(), *Args);
+		return false;
+	}
+
+	return true;
+}
+
+void FRemoteSessionLoadTest::StartStep()
+{
+	const int32 NumClients = Settings.ClientSteps[StepIndex];
+
+	// when we host, the clients' process adds its own as each of its steps starts
+	while (Host.IsValid() == false && Clients.Num() < NumClients)
+	{
+		TSharedPtr<FRemoteSessionLoadClient> Client = MakeShareable(new FRemoteSessionLoadClient(Clients.Num(), Settings.Address, Settings.bDecode, Settings.InputRate, Settings.bReportFrames));
+
+		Client->Start();
+		Clients.Add(Client);
+	}
+
+	Phase = EPhase::Connecting;
+	PhaseStartTime = FPlatformTime::Seconds();
+}
+
+void FRemoteSessionLoadTest::Tick(float DeltaTime)
+{
+	if (Phase == EPhase::Finished)
+	{
+		return;
+	}
+
+	if (Host.IsValid())
+	{
+		Host->Tick(DeltaTime);
+
+		TSharedPtr<FRemoteSessionFrameBufferChannel> NewHostChannel = Host->GetChannelById<FRemoteSessionFrameBufferChannel>(*FRemoteSessionFrameBufferChannel::StaticType());
+
+		if (NewHostChannel.IsValid() && NewHostChannel != HostChannel.Pin())
+		{
+			NewHostChannel->AddFrameSentHandler(FOnRemoteSessionFrameTiming::FDelegate::CreateRaw(this, &FRemoteSessionLoadTest::OnFrameSent));
+			HostChannel = NewHostChannel;
+		}
+
+		if (Phase != EPhase::Collecting && FPlatformProcess::IsProcRunning(ClientProcess) == false)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Load test: the clients' process exited early"));
+			Finish(false);
+			return;
+		}
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	const double PhaseTime = Now - PhaseStartTime;
+
+	switch (Phase)
+	{
+	case EPhase::Connecting:
+		{
+			const int32 NumClients = Settings.ClientSteps[StepIndex];
+			bool bAllReady = false;
+
+			if (Host.IsValid())
+			{
+				bAllReady = Relay->GetNumViewers() >= NumClients;
+			}
+			else
+			{
+				bAllReady = Clients.FindByPredicate([](const TSharedPtr<FRemoteSessionLoadClient>& Client) { return Client->IsReady() == false; }) == nullptr;
+			}
+
+			// the clients' process has to start up before the first step can connect
+			const double Timeout = Settings.ConnectTimeoutSeconds + (Host.IsValid() && StepIndex == 0 ? kClientProcessStartSeconds : 0);
+
+			if (bAllReady)
+			{
+				UE_LOG(LogRemoteSession, Display, TEXT("Load test: %d clients connected in %.02f secs, warming up"), NumClients, PhaseTime);
+				Phase = EPhase::Warmup;
+				PhaseStartTime = Now;
+			}
+			else if (PhaseTime > Timeout)
+			{
+				UE_LOG(LogRemoteSession, Error, TEXT("Load test: not every client was sent a frame within %.0f seconds of connecting"), Timeout);
+				Finish(false);
+			}
+		}
+		break;
+
+	case EPhase::Warmup:
+		if (PhaseTime >= Settings.WarmupSeconds)
+		{
+			for (const TSharedPtr<FRemoteSessionLoadClient>& Client : Clients)
+			{
+				Client->TakeResults();
+			}
+
+			// the first call only starts the measurement
+			FPlatformTime::GetCPUTime();
+			ProcessCPUTotal = 0;
+			ProcessCPUSamples = 0;
+			FramesSent.Reset();
+
+			Phase = EPhase::Measuring;
+			PhaseStartTime = Now;
+		}
+		break;
+
+	case EPhase::Measuring:
+		ProcessCPUTotal += FPlatformTime::GetCPUTime().CPUTimePctRelative;
+		ProcessCPUSamples++;
+
+		if (PhaseTime >= Settings.MeasureSeconds)
+		{
+			EndStep(PhaseTime);
+
+			if (++StepIndex < Settings.ClientSteps.Num())
+			{
+				StartStep();
+			}
+			else if (Host.IsValid())
+			{
+				Phase = EPhase::Collecting;
+				PhaseStartTime = Now;
+			}
+			else
+			{
+				Finish(true);
+			}
+		}
+		break;
+
+	case EPhase::Collecting:
+		if (FPlatformProcess::IsProcRunning(ClientProcess) == false)
+		{
+			Finish(MergeClientResults());
+		}
+		else if (PhaseTime > kClientProcessExitSeconds)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Load test: the clients' process didn't finish within %.0f seconds of us"), kClientProcessExitSeconds);
+			Finish(false);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void FRemoteSessionLoadTest::EndStep(double MeasuredSeconds)
+{
+	TSharedRef<FJsonObject> Step = MakeShareable(new FJsonObject);
+
+	const int32 NumClients = Settings.ClientSteps[StepIndex];
+	const float ProcessCores = ProcessCPUSamples > 0 ? ProcessCPUTotal / ProcessCPUSamples / 100.0 : 0.0;
+
+	Step->SetNumberField(TEXT("clients"), NumClients);
+	Step->SetNumberField(TEXT("seconds"), MeasuredSeconds);
+
+	if (Host.IsValid())
+	{
+		AddHostResults(Step, NumClients, ProcessCores, MeasuredSeconds);
+	}
+	else
+	{
+		AddClientResults(Step, ProcessCores, MeasuredSeconds);
+	}
+
+	StepResults.Add(Step);
+}
+
+void FRemoteSessionLoadTest::AddHostResults(const TSharedRef<FJsonObject>& Step, int32 NumClients, float ProcessCores, double MeasuredSeconds)
+{
+	// the clients are in their own process, so everything this one used went on the host and relay
+	const int32 AddedClients = NumClients - PreviousClients;
+
+	Step->SetNumberField(TEXT("viewers"), Relay->GetNumViewers());
+	Step->SetNumberField(TEXT("hostFps"), FramesSent.GetValue() / MeasuredSeconds);
+	Step->SetNumberField(TEXT("hostCpuCores"), ProcessCores);
+	Step->SetNumberField(TEXT("hostCpuCoresPerClient"), ProcessCores / NumClients);
+
+	FString AddedSummary;
+
+	if (PreviousClients > 0 && AddedClients > 0)
+	{
+		const float CoresPerAddedClient = (ProcessCores - PreviousProcessCores) / AddedClients;
+		Step->SetNumberField(TEXT("hostCpuCoresPerAddedClient"), CoresPerAddedClient);
+		AddedSummary = FString::Printf(TEXT(", %.03f per added client"), CoresPerAddedClient);
+	}
+
+	PreviousProcessCores = ProcessCores;
+	PreviousClients = NumClients;
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Load test: %d clients, host and relay %.02f cores (%.03f per client%s), %.01f fps"),
+		NumClients, ProcessCores, ProcessCores / NumClients, *AddedSummary, FramesSent.GetValue() / MeasuredSeconds);
+}
+
+void FRemoteSessionLoadTest::AddClientResults(const TSharedRef<FJsonObject>& Step, float ProcessCores, double MeasuredSeconds)
+{
+	TArray<TSharedPtr<FJsonValue>> ClientResults;
+	TArray<float> ClientFps;
+
+	for (const TSharedPtr<FRemoteSessionLoadClient>& Client : Clients)
+	{
+		const FRemoteSessionLoadClient::FResults Results = Client->TakeResults();
+		const float Fps = Results.FramesReceived / MeasuredSeconds;
+
+		ClientFps.Add(Fps);
+
+		TSharedRef<FJsonObject> ClientResult = MakeShareable(new FJsonObject);
+		ClientResult->SetNumberField(TEXT("id"), Client->GetId());
+		ClientResult->SetNumberField(TEXT("fps"), Fps);
+		ClientResult->SetNumberField(TEXT("receivedKbps"), (Results.BytesReceived * 8 / 1000.0) / MeasuredSeconds);
+		ClientResult->SetNumberField(TEXT("inputEventsSent"), Results.InputEventsSent);
+		ClientResult->SetNumberField(TEXT("busyCores"), Results.BusySeconds / MeasuredSeconds);
+		FRemoteSessionDistribution::FromValues(Results.DecodeMS).AddToJson(ClientResult, TEXT("decodeMs"));
+
+		if (Settings.bReportFrames)
+		{
+			TArray<TSharedPtr<FJsonValue>> FrameIndices;
+			TArray<TSharedPtr<FJsonValue>> FrameTimes;
+
+			for (int32 Index = 0; Index < Results.FrameIndices.Num(); ++Index)
+			{
+				FrameIndices.Add(MakeShareable(new FJsonValueNumber(Results.FrameIndices[Index])));
+				FrameTimes.Add(MakeShareable(new FJsonValueNumber(Results.FrameTimes[Index])));
+			}
+
+			ClientResult->SetArrayField(TEXT("frameIndices"), FrameIndices);
+			ClientResult->SetArrayField(TEXT("frameTimes"), FrameTimes);
+		}
+
+		ClientResults.Add(MakeShareable(new FJsonValueObject(ClientResult)));
+	}
+
+	// Jain's index: 1 when every client gets the same fps, 1/N when one gets everything
+	double FpsTotal = 0;
+	double FpsSquaredTotal = 0;
+
+	for (float Fps : ClientFps)
+	{
+		FpsTotal += Fps;
+		FpsSquaredTotal += Fps * Fps;
+	}
+
+	const double FpsFairness = FpsSquaredTotal > 0 ? (FpsTotal * FpsTotal) / (ClientFps.Num() * FpsSquaredTotal) : 0.0;
+	const FRemoteSessionDistribution Fps = FRemoteSessionDistribution::FromValues(ClientFps);
+
+	Step->SetNumberField(TEXT("fpsFairness"), FpsFairness);
+	Fps.AddToJson(Step, TEXT("clientFps"));
+
+	// these clients are all this process runs
+	Step->SetNumberField(TEXT("clientCpuCores"), ProcessCores);
+	Step->SetArrayField(TEXT("perClient"), ClientResults);
+
+	UE_LOG(LogRemoteSession, Display, TEXT("Load test: %d clients using %.02f cores, client fps %.01f-%.01f (fairness %.03f)"),
+		Clients.Num(), ProcessCores, Fps.Min, Fps.Max, FpsFairness);
+}
+
+bool FRemoteSessionLoadTest::MergeClientResults()
+{
+	FString Json;
+	TSharedPtr<FJsonObject> ClientRun;
+
+	if (FFileHelper::LoadFileToString(Json, *ClientResultsFile) == false || FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), ClientRun) == false || ClientRun.IsValid() == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Load test: failed to read the clients' results from %s"), *ClientResultsFile);
+		return false;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* ClientSteps = nullptr;
+
+	if (ClientRun->TryGetArrayField(TEXT("steps"), ClientSteps) == false)
+	{
+		ClientSteps = nullptr;
+	}
+
+	const int32 NumSteps = ClientSteps ? FMath::Min(ClientSteps->Num(), StepResults.Num()) : 0;
+
+	// FPlatformTime::Seconds reads a clock every process on the machine shares, so the clients' arrival
+	// times can be set against our capture times
+	FScopeLock Lock(&CaptureTimesMutex);
+
+	for (int32 StepIndexToMerge = 0; StepIndexToMerge < NumSteps; ++StepIndexToMerge)
+	{
+		const TSharedPtr<FJsonObject> ClientStep = (*ClientSteps)[StepIndexToMerge]->AsObject();
+		const TSharedPtr<FJsonObject>& Step = StepResults[StepIndexToMerge];
+
+		if (ClientStep.IsValid() == false)
+		{
+			continue;
+		}
+
+		TArray<float> ClientLatencyP50;
+		const TArray<TSharedPtr<FJsonValue>>* PerClient = nullptr;
+
+		if (ClientStep->TryGetArrayField(TEXT("perClient"), PerClient))
+		{
+			for (const TSharedPtr<FJsonValue>& Value : *PerClient)
+			{
+				const TSharedPtr<FJsonObject> ClientResult = Value->AsObject();
+				const TArray<TSharedPtr<FJsonValue>>* FrameIndices = nullptr;
+				const TArray<TSharedPtr<FJsonValue>>* FrameTimes = nullptr;
+
+				if (ClientResult.IsValid() == false || ClientResult->TryGetArrayField(TEXT("frameIndices"), FrameIndices) == false || ClientResult->TryGetArrayField(TEXT("frameTimes"), FrameTimes) == false)
+				{
+					continue;
+				}
+
+				TArray<float> LatencyMS;
+
+				for (int32 Index = 0; Index < FrameIndices->Num() && Index < FrameTimes->Num(); ++Index)
+				{
+					const double* CaptureTime = CaptureTimes.Find((int32)(*FrameIndices)[Index]->AsNumber());
+
+					if (CaptureTime)
+					{
+						LatencyMS.Add(((*FrameTimes)[Index]->AsNumber() - *CaptureTime) * 1000.0);
+					}
+				}
+
+				const FRemoteSessionDistribution Latency = FRemoteSessionDistribution::FromValues(LatencyMS);
+				Latency.AddToJson(ClientResult.ToSharedRef(), TEXT("latencyMs"));
+
+				if (Latency.Count > 0)
+				{
+					ClientLatencyP50.Add(Latency.P50);
+				}
+
+				// the raw times have served their purpose
+				ClientResult->RemoveField(TEXT("frameIndices"));
+				ClientResult->RemoveField(TEXT("frameTimes"));
+			}
+		}
+
+		for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : ClientStep->Values)
+		{
+			if (Step->HasField(Field.Key) == false)
+			{
+				Step->SetField(Field.Key, Field.Value);
+			}
+		}
+
+		if (ClientLatencyP50.Num())
+		{
+			const FRemoteSessionDistribution LatencyP50 = FRemoteSessionDistribution::FromValues(ClientLatencyP50);
+			LatencyP50.AddToJson(Step.ToSharedRef(), TEXT("clientLatencyP50Ms"));
+			Step->SetNumberField(TEXT("latencyP50SpreadMs"), LatencyP50.Max - LatencyP50.Min);
+		}
+	}
+
+	bool bClientsCompleted = false;
+	ClientRun->TryGetBoolField(TEXT("completed"), bClientsCompleted);
+
+	return bClientsCompleted && NumSteps == StepResults.Num();
+}
+
+void FRemoteSessionLoadTest::Finish(bool bCompleted)
+{
+	TSharedRef<FJsonObject> Results = MakeShareable(new FJsonObject);
+	Results->SetBoolField(TEXT("completed"), bCompleted);
+	Results->SetStringField(TEXT("address"), Settings.Address);
+	Results->SetBoolField(TEXT("decode"), Settings.bDecode);
+	Results->SetNumberField(TEXT("inputRate"), Settings.InputRate);
+	Results->SetNumberField(TEXT("numCores"), FPlatformMisc::NumberOfCores());
+
+	if (Host.IsValid())
+	{
+		Results->SetNumberField(TEXT("width"), Settings.FrameSize.X);
+		Results->SetNumberField(TEXT("height"), Settings.FrameSize.Y);
+		Results->SetNumberField(TEXT("complexity"), Settings.Complexity);
+		Results->SetNumberField(TEXT("quality"), Settings.Quality);
+		Results->SetNumberField(TEXT("targetFps"), Settings.Framerate);
+	}
+
+	TArray<TSharedPtr<FJsonValue>> Steps;
+
+	for (const TSharedPtr<FJsonObject>& Step : StepResults)
+	{
+		Steps.Add(MakeShareable(new FJsonValueObject(Step)));
+	}
+
+	Results->SetArrayField(TEXT("steps"), Steps);
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Results, Writer);
+
+	if (FFileHelper::SaveStringToFile(Json, *Settings.OutputFile))
+	{
+		UE_LOG(LogRemoteSession, Display, TEXT("Load test: results for %d steps written to %s"), StepResults.Num(), *Settings.OutputFile);
+	}
+	else
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Load test: failed to write results to %s"), *Settings.OutputFile);
+	}
+
+	Phase = EPhase::Finished;
+
+	if (ClientProcess.IsValid())
+	{
+		// only still running if the run failed
+		FPlatformProcess::TerminateProc(ClientProcess);
+		FPlatformProcess::CloseProc(ClientProcess);
+	}
+
+	Clients.Empty();
+	Relay = nullptr;
+	Host = nullptr;
+}
+
+void FRemoteSessionLoadTest::OnFrameSent(const FRemoteSessionFrameTiming& Timing)
+{
+	FScopeLock Lock(&CaptureTimesMutex);
+
+	CaptureTimes.Add(Timing.ImageIndex, Timing.CaptureTime);
+	FramesSent.Increment();
+}
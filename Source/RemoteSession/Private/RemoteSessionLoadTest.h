@@ -0,0 +1,239 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/PlatformProcess.h"
+#include "RemoteSessionRole.h"
+#include "MessageHandler/RecordingMessageHandler.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+
+class FRunnableThread;
+class FRemoteSessionHost;
+class FRemoteSessionRelay;
+class FJsonObject;
+class FRemoteSessionReceivedMessage;
+
+/* What the load test runs. Parsed from Key=Value pairs, e.g. "Clients=1,2,4,8,16 Seconds=10 Decode=0" */
+struct FRemoteSessionLoadTestSettings
+{
+	/** Clients connected in each step. Clients are added between steps, never removed */
+	TArray<int32>	ClientSteps;
+
+	/** Whether clients decode frames as a device would, or only receive them */
+	bool		bDecode = true;
+
+	/** Touch events per second sent by each client. 0 for none */
+	int32		InputRate = 30;
+
+	/** Size and complexity (0-1) of the synthetic frames the host sends */
+	FIntPoint	FrameSize = FIntPoint(1280, 720);
+	float		Complexity = 0.5f;
+
+	int32		Quality = 85;
+	int32		Framerate = 30;
+
+	/** Time allowed for each step's clients to connect, time before measuring starts, and time measured */
+	float		ConnectTimeoutSeconds = 10.0f;
+	float		WarmupSeconds = 2.0f;
+	float		MeasureSeconds = 10.0f;
+
+	/** Ports for the host and relay we start, away from the defaults so a running host doesn't get in the way */
+	int32		HostPort = 2052;
+	int32		RelayPort = 2053;
+
+	/** Connect clients here instead of to a host and relay of our own. Host CPU and latency can't be measured then */
+	FString		Address;
+
+	/** Set for the process started to run the clients. Each client's frame arrival times go in its results so
+	    the process with the host can work out latency */
+	bool		bReportFrames = false;
+
+	/** Where results go. Defaults to Saved/RemoteSession/LoadTest-<time>.json, and a bare file name goes there too */
+	FString		OutputFile;
+
+	static FRemoteSessionLoadTestSettings Parse(const TCHAR* Params);
+};
+
+/*
+	A client with no window, textures or message handler. It says hello, answers pings, reads frames (and
+	decodes them if asked) and sends touches at a fixed rate, all on its own thread, so many can run at once.
+*/
+class FRemoteSessionLoadClient : public FRunnable, public IRecordingMessageHandlerWriter
+{
+public:
+
+	/** What a client measured since it was last reset */
+	struct FResults
+	{
+		int32			FramesReceived = 0;
+		int64			BytesReceived = 0;
+		int32			InputEventsSent = 0;
+
+		/** Time our thread spent receiving, decoding and sending rather than waiting */
+		double			BusySeconds = 0;
+
+		TArray<float>	DecodeMS;
+
+		/** Index of each frame and when we had it (decoded if we decode), if we're recording them */
+		TArray<int32>	FrameIndices;
+		TArray<double>	FrameTimes;
+	};
+
+	FRemoteSessionLoadClient(int32 InId, const FString& InAddress, bool bInDecode, int32 InInputRate, bool bInRecordFrames);
+
+	virtual ~FRemoteSessionLoadClient();
+
+	/** Starts our thread, which connects and keeps reconnecting */
+	void Start();
+
+	int32 GetId() const { return Id; }
+
+	/** True once the host or relay has answered our hello and sent a frame */
+	bool IsReady() const { return bReady; }
+
+	/** Returns what's been measured and starts again */
+	FResults TakeResults();
+
+	/* Begin IRecordingMessageHandlerWriter */
+	virtual void RecordMessage(const TCHAR* MsgName, const TArray<uint8>& Data) override;
+	/* End IRecordingMessageHandlerWriter */
+
+protected:
+
+	virtual uint32 Run() override;
+
+	void StartConnection(double Now);
+	void OnConnected();
+	void CloseConnection(double Now);
+
+	void OnHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch);
+	void OnFrame(FRemoteSessionReceivedMessage& Message);
+
+	/** Sends the next touch if it's due */
+	void TickInput(double Now);
+
+	int32							Id;
+	FString							Address;
+	bool							bDecode;
+	int32							InputRate;
+	bool							bRecordFrames;
+
+	FRemoteSessionTransportSettings	Settings;
+	TSharedPtr<IBackChannelConnection>	Connection;
+	FRemoteSessionTransport			Transport;
+	double							AttemptTime;
+
+	/** Codec from the hello ack, only read on our thread */
+	FString							Codec;
+	TArray<uint8>					DecodedPixels;
+
+	/** Turns touches into messages, which come back to RecordMessage */
+	TSharedPtr<FRecordingMessageHandler>	InputScript;
+	double							NextInputTime;
+	int32							InputStep;
+
+	mutable FCriticalSection		ResultsMutex;
+	FResults						Results;
+
+	FRunnableThread*				Thread;
+	FThreadSafeBool					bExitRequested;
+	FThreadSafeBool					bHelloAcked;
+	FThreadSafeBool					bReady;
+};
+
+/*
+	Finds where a host saturates as viewers are added. Starts a host streaming synthetic frames and a relay in
+	this process, and a second process that connects more and more headless clients to the relay, one step at a
+	time. Keeping the clients out of this process means what it uses is the host and relay alone. For each step
+	that's measured along with the CPU each client costs, each client's fps and latency, and how evenly frames
+	were shared out. The clients' process writes its results, which are merged into ours and written as JSON.
+
+	Given an Address this only runs the clients, which is also what the second process does.
+*/
+class FRemoteSessionLoadTest
+{
+public:
+
+	FRemoteSessionLoadTest(const FRemoteSessionLoadTestSettings& InSettings);
+
+	~FRemoteSessionLoadTest();
+
+	/** Starts the host and relay (unless connecting elsewhere) and the first clients. Returns false if they can't listen */
+	bool Start();
+
+	/** Ticks the host, moves through the steps and writes the results once they're done */
+	void Tick(float DeltaTime);
+
+	/** True once results have been written, or the run failed */
+	bool IsFinished() const { return Phase == EPhase::Finished; }
+
+protected:
+
+	enum class EPhase
+	{
+		Connecting,
+		Warmup,
+		Measuring,
+		Collecting,
+		Finished
+	};
+
+	/** Starts the process that runs the clients against our relay */
+	bool StartClientProcess();
+
+	/** Adds clients until there are as many as the current step wants, unless they're in another process */
+	void StartStep();
+
+	/** Works out a step's results from what the host or the clients measured */
+	void EndStep(double MeasuredSeconds);
+	void AddHostResults(const TSharedRef<FJsonObject>& Step, int32 NumClients, float ProcessCores, double MeasuredSeconds);
+	void AddClientResults(const TSharedRef<FJsonObject>& Step, float ProcessCores, double MeasuredSeconds);
+
+	/** Adds what the clients' process measured to our steps, and their latency from our capture times */
+	bool MergeClientResults();
+
+	/** Writes the results and shuts everything down */
+	void Finish(bool bCompleted);
+
+	/** Called on encoding threads */
+	void OnFrameSent(const FRemoteSessionFrameTiming& Timing);
+
+	FRemoteSessionLoadTestSettings		Settings;
+
+	TSharedPtr<FRemoteSessionHost>		Host;
+	TUniquePtr<FRemoteSessionRelay>		Relay;
+	TWeakPtr<FRemoteSessionFrameBufferChannel>	HostChannel;
+
+	/** The process running the clients when we host, and where it writes its results */
+	FProcHandle							ClientProcess;
+	FString								ClientResultsFile;
+
+	/** Our clients when we don't host */
+	TArray<TSharedPtr<FRemoteSessionLoadClient>>	Clients;
+
+	int32								StepIndex;
+	EPhase								Phase;
+	double								PhaseStartTime;
+
+	/** Process CPU use sampled each tick while measuring, as a percentage of one core */
+	double								ProcessCPUTotal;
+	int32								ProcessCPUSamples;
+
+	/** Host frames sent while measuring, counted on encoding threads */
+	FThreadSafeCounter					FramesSent;
+
+	/** This process's CPU in cores for the previous step, for the cost of the clients each step adds */
+	float								PreviousProcessCores;
+	int32								PreviousClients;
+
+	/** Capture time of each frame by index, filled in on encoding threads. Kept for the whole run since which
+	    frames the clients measured is only known once their results are in */
+	FCriticalSection					CaptureTimesMutex;
+	TMap<int32, double>					CaptureTimes;
+
+	TArray<TSharedPtr<FJsonObject>>		StepResults;
+};
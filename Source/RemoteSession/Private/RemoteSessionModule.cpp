@@ -5,7 +5,16 @@
 #include "BackChannel/Transport/IBackChannelTransport.h"
 #include "RemoteSessionHost.h"
 #include "RemoteSessionClient.h"
+#include "RemoteSessionRelay.h"
+#include "RemoteSessionBenchmark.h"
+#include "RemoteSessionLoadTest.h"
+#include "RemoteSessionReplayDriver.h"
+#include "Transport/RemoteSessionReplayConnection.h"
+#include "Transport/RemoteSessionNetworkEmulator.h"
 #include "CoreGlobals.h"
+#include "Channels/RemoteSessionChannelRegistry.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "Misc/Paths.h"
 
 #if WITH_EDITOR
 	#include "Editor.h"
@@ -20,6 +29,38 @@ protected:
 
 	TSharedPtr<FRemoteSessionHost>		Host;
 	TSharedPtr<FRemoteSessionClient>		Client;
+	TUniquePtr<FRemoteSessionRelay>		Relay;
+
+	TUniquePtr<FRemoteSessionBenchmark>	Benchmark;
+
+	TUniquePtr<FRemoteSessionLoadTest>	LoadTest;
+
+	/** Feeds a capture to a host */
+	TUniquePtr<FRemoteSessionReplayDriver>	ReplayDriver;
+
+	/** Set when started with -RemoteSessionCapture, every host and client we create records to this directory */
+	TOptional<FString>					CommandLineCaptureDirectory;
+
+	/** Set when started with -RemoteSessionReplay=<capture>, which plays it on a client then exits */
+	bool								bExitAfterReplay = false;
+
+	/** Set when started with -RemoteSessionRecordInput, every host and client we create records its input to this directory */
+	TOptional<FString>					CommandLineInputDirectory;
+
+	/** Set when started with -RemoteSessionPlayInput=<recording>, which plays once the engine is ticking then exits */
+	TOptional<FString>					CommandLineInputPlayback;
+	bool								bExitAfterInputPlayback = false;
+
+	/** Set when started with -RemoteSessionBenchmark, which runs once the engine is ticking then exits */
+	TOptional<FString>					CommandLineBenchmark;
+	bool								bExitAfterBenchmark = false;
+
+	/** Set when started with -RemoteSessionLoadTest, which runs once the engine is ticking then exits */
+	TOptional<FString>					CommandLineLoadTest;
+	bool								bExitAfterLoadTest = false;
+
+	/** Where the host's frames come from if not the viewport */
+	TSharedPtr<IRemoteSessionFrameSource>	HostFrameSource;
 
 	int32								DefaultPort;
 	int32								Quality;
@@ -51,6 +92,87 @@ public:
 		GConfig->GetInt(TEXT("RemoteSession"), TEXT("Quality"), Quality, GEngineIni);
 		GConfig->GetInt(TEXT("RemoteSession"), TEXT("Framerate"), Framerate, GEngineIni);
 
+		// before anything connects so every connection is emulated
+		FString NetworkConditions;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionNet="), NetworkConditions, false))
+		{
+			FRemoteSessionNetworkConditions Conditions = FRemoteSessionNetworkConditions::Get();
+
+			if (Conditions.Parse(*NetworkConditions))
+			{
+				FRemoteSessionNetworkConditions::Set(Conditions);
+				UE_LOG(LogRemoteSession, Log, TEXT("Emulating network conditions: %s"), *Conditions.ToString());
+			}
+		}
+
+		FString CaptureDirectory;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionCapture="), CaptureDirectory))
+		{
+			CommandLineCaptureDirectory = CaptureDirectory;
+		}
+		else if (FParse::Param(FCommandLine::Get(), TEXT("RemoteSessionCapture")))
+		{
+			CommandLineCaptureDirectory = GetDefaultCaptureDirectory();
+		}
+
+		FString InputDirectory;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionRecordInput="), InputDirectory))
+		{
+			CommandLineInputDirectory = InputDirectory;
+		}
+		else if (FParse::Param(FCommandLine::Get(), TEXT("RemoteSessionRecordInput")))
+		{
+			CommandLineInputDirectory = GetDefaultCaptureDirectory();
+		}
+
+		FString InputRecording;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionPlayInput="), InputRecording))
+		{
+			CommandLineInputPlayback = InputRecording;
+		}
+
+		FString ReplayFilename;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionReplay="), ReplayFilename))
+		{
+			FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionReplaySpeed="), GRemoteSessionReplaySpeed);
+			StartReplay(ReplayFilename);
+			bExitAfterReplay = true;
+			return;
+		}
+
+		FString BenchmarkParams;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionBenchmark="), BenchmarkParams, false))
+		{
+			CommandLineBenchmark = BenchmarkParams;
+			return;
+		}
+		else if (FParse::Param(FCommandLine::Get(), TEXT("RemoteSessionBenchmark")))
+		{
+			CommandLineBenchmark = FString();
+			return;
+		}
+
+		FString LoadTestParams;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionLoadTest="), LoadTestParams, false))
+		{
+			CommandLineLoadTest = LoadTestParams;
+			return;
+		}
+		else if (FParse::Param(FCommandLine::Get(), TEXT("RemoteSessionLoadTest")))
+		{
+			CommandLineLoadTest = FString();
+			return;
+		}
+
+		// a process started as a relay has nothing of its own to host
+		FString RelayHostAddress;
+		if (FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionRelay="), RelayHostAddress))
+		{
+			int32 RelayPort = DefaultPort + 1;
+			FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionRelayPort="), RelayPort);
+			InitRelay(*RelayHostAddress, RelayPort);
+			return;
+		}
 
 		if (PLATFORM_DESKTOP 
 			&& IsRunningDedicatedServer() == false 
@@ -96,6 +218,15 @@ public:
 
 		Client = MakeShareable(new FRemoteSessionClient(RemoteAddress));
 
+		if (CommandLineCaptureDirectory.IsSet())
+		{
+			Client->StartCapture(GetCaptureFilename(CommandLineCaptureDirectory.GetValue(), TEXT("Client")));
+		}
+
+		if (CommandLineInputDirectory.IsSet())
+		{
+			Client->StartInputRecording(GetInputFilename(CommandLineInputDirectory.GetValue(), TEXT("Client")));
+		}
 	}
 
 	virtual bool IsClientConnected() const override
@@ -132,6 +263,18 @@ public:
 #endif
 
 		TSharedPtr<FRemoteSessionHost> NewHost = MakeShareable(new FRemoteSessionHost(Quality, Framerate));
+		NewHost->SetFrameSource(HostFrameSource);
+
+		// before listening so the first client is recorded from its hello
+		if (CommandLineCaptureDirectory.IsSet())
+		{
+			NewHost->StartCapture(GetCaptureFilename(CommandLineCaptureDirectory.GetValue(), TEXT("Host")));
+		}
+
+		if (CommandLineInputDirectory.IsSet())
+		{
+			NewHost->StartInputRecording(GetInputFilename(CommandLineInputDirectory.GetValue(), TEXT("Host")));
+		}
 
 		int16 SelectedPort = Port ? Port : (int16)DefaultPort;
 
@@ -166,6 +309,177 @@ public:
 		return Host;
 	}
 
+	virtual void SetHostFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource) override
+	{
+		HostFrameSource = InSource;
+
+		if (Host.IsValid())
+		{
+			Host->SetFrameSource(InSource);
+		}
+	}
+
+	void InitRelay(const TCHAR* HostAddress, int32 Port)
+	{
+		Relay = MakeUnique<FRemoteSessionRelay>(HostAddress, (uint16)Port);
+
+		if (Relay->Start() == false)
+		{
+			Relay = nullptr;
+		}
+	}
+
+	void StopRelay()
+	{
+		Relay = nullptr;
+	}
+
+	static FString GetDefaultCaptureDirectory()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("RemoteSession");
+	}
+
+	static FString GetCaptureFilename(const FString& Directory, const TCHAR* Name)
+	{
+		return Directory / FString::Printf(TEXT("Capture-%s-%s.rscap"), Name, *FDateTime::Now().ToString());
+	}
+
+	static FString GetInputFilename(const FString& Directory, const TCHAR* Name)
+	{
+		return Directory / FString::Printf(TEXT("Input-%s-%s.rsinput"), Name, *FDateTime::Now().ToString());
+	}
+
+	/** Starts recording the input of the host and client to Directory, or stops them if Directory is empty */
+	void SetInputRecording(const FString& Directory)
+	{
+		if (Directory.IsEmpty())
+		{
+			if (Host.IsValid())
+			{
+				Host->StopInputRecording();
+			}
+
+			if (Client.IsValid())
+			{
+				Client->StopInputRecording();
+			}
+
+			return;
+		}
+
+		if (Host.IsValid())
+		{
+			Host->StartInputRecording(GetInputFilename(Directory, TEXT("Host")));
+		}
+
+		if (Client.IsValid())
+		{
+			Client->StartInputRecording(GetInputFilename(Directory, TEXT("Client")));
+		}
+	}
+
+	/** Plays a recording on the host, starting one if needed. Results go to Saved/RemoteSession unless ResultsFile is given */
+	bool StartInputPlayback(const FString& Filename, FString ResultsFile)
+	{
+		if (Host.IsValid() == false)
+		{
+			InitHost();
+		}
+
+		if (Host.IsValid() == false)
+		{
+			return false;
+		}
+
+		if (ResultsFile.IsEmpty())
+		{
+			ResultsFile = GetDefaultCaptureDirectory() / FString::Printf(TEXT("InputPlayback-%s.json"), *FDateTime::Now().ToString());
+		}
+
+		return Host->StartInputPlayback(Filename, ResultsFile);
+	}
+
+	/** Starts recording the host and client to Directory, or stops them if Directory is empty */
+	void SetCapture(const FString& Directory)
+	{
+		if (Directory.IsEmpty())
+		{
+			if (Host.IsValid())
+			{
+				Host->StopCapture();
+			}
+
+			if (Client.IsValid())
+			{
+				Client->StopCapture();
+			}
+
+			return;
+		}
+
+		if (Host.IsValid())
+		{
+			Host->StartCapture(GetCaptureFilename(Directory, TEXT("Host")));
+		}
+
+		if (Client.IsValid())
+		{
+			Client->StartCapture(GetCaptureFilename(Directory, TEXT("Client")));
+		}
+	}
+
+	/** Plays back what the host sent in Filename on a new client */
+	void StartReplay(const FString& Filename)
+	{
+		InitClient(*(FString(FRemoteSessionReplayConnection::AddressPrefix) + Filename));
+	}
+
+	/** Sends what the client sent in Filename to a host at HostAddress */
+	void StartHostReplay(const FString& Filename, const FString& HostAddress, float Speed)
+	{
+		ReplayDriver = MakeUnique<FRemoteSessionReplayDriver>(Filename, HostAddress, Speed);
+
+		if (ReplayDriver->Start() == false)
+		{
+			ReplayDriver = nullptr;
+		}
+	}
+
+	void StopHostReplay()
+	{
+		ReplayDriver = nullptr;
+	}
+
+	void StartBenchmark(const FString& Params)
+	{
+		Benchmark = MakeUnique<FRemoteSessionBenchmark>(FRemoteSessionBenchmarkSettings::Parse(*Params));
+
+		if (Benchmark->Start() == false)
+		{
+			Benchmark = nullptr;
+		}
+	}
+
+	void StartLoadTest(const FString& Params)
+	{
+		LoadTest = MakeUnique<FRemoteSessionLoadTest>(FRemoteSessionLoadTestSettings::Parse(*Params));
+
+		if (LoadTest->Start() == false)
+		{
+			LoadTest = nullptr;
+		}
+	}
+
+	virtual void AddChannelFactory(const FString& InChannelType, FOnRemoteSessionChannelCreate InFactory) override
+	{
+		FRemoteSessionChannelRegistry::Get().AddFactory(*InChannelType, InFactory);
+	}
+
+	virtual void RemoveChannelFactory(const FString& InChannelType) override
+	{
+		FRemoteSessionChannelRegistry::Get().RemoveFactory(*InChannelType);
+	}
+
 	void OnPIEStarted(bool bSimulating)
 	{
 		if (bAutoHostWithPIE)
@@ -201,6 +515,84 @@ public:
 		{
 			Host->Tick(DeltaTime);
 		}
+
+		if (CommandLineBenchmark.IsSet())
+		{
+			bExitAfterBenchmark = true;
+			StartBenchmark(CommandLineBenchmark.GetValue());
+			CommandLineBenchmark.Reset();
+		}
+
+		if (Benchmark.IsValid())
+		{
+			Benchmark->Tick(DeltaTime);
+
+			if (Benchmark->IsFinished())
+			{
+				Benchmark = nullptr;
+			}
+		}
+
+		if (CommandLineLoadTest.IsSet())
+		{
+			bExitAfterLoadTest = true;
+			StartLoadTest(CommandLineLoadTest.GetValue());
+			CommandLineLoadTest.Reset();
+		}
+
+		if (LoadTest.IsValid())
+		{
+			LoadTest->Tick(DeltaTime);
+
+			if (LoadTest->IsFinished())
+			{
+				LoadTest = nullptr;
+			}
+		}
+
+		if (CommandLineInputPlayback.IsSet())
+		{
+			FString ResultsFile;
+			FParse::Value(FCommandLine::Get(), TEXT("RemoteSessionPlayInputResults="), ResultsFile);
+
+			bExitAfterInputPlayback = StartInputPlayback(CommandLineInputPlayback.GetValue(), ResultsFile);
+			CommandLineInputPlayback.Reset();
+
+			if (bExitAfterInputPlayback == false)
+			{
+				FPlatformMisc::RequestExit(false);
+			}
+		}
+
+		if (bExitAfterInputPlayback && (Host.IsValid() == false || Host->IsPlayingInput() == false))
+		{
+			bExitAfterInputPlayback = false;
+			FPlatformMisc::RequestExit(false);
+		}
+
+		if (ReplayDriver.IsValid() && ReplayDriver->IsFinished())
+		{
+			ReplayDriver = nullptr;
+		}
+
+		if (bExitAfterReplay && (Client.IsValid() == false || Client->IsReplayFinished()))
+		{
+			bExitAfterReplay = false;
+			FPlatformMisc::RequestExit(false);
+		}
+
+		// results (or the lack of them) say whether the run worked
+		if (bExitAfterBenchmark && Benchmark.IsValid() == false)
+		{
+			bExitAfterBenchmark = false;
+			FPlatformMisc::RequestExit(false);
+		}
+
+		if (bExitAfterLoadTest && LoadTest.IsValid() == false)
+		{
+			bExitAfterLoadTest = false;
+			FPlatformMisc::RequestExit(false);
+		}
 	}	
 };
 	
@@ -229,10 +621,259 @@ FAutoConsoleCommand GRemoteDisconnectCommand(
 		{
 			Viewer->StopClient();
 			Viewer->StopHost();
+			Viewer->StopRelay();
+			Viewer->StopHostReplay();
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteRelayCommand(
+	TEXT("remote.relay"),
+	TEXT("Relays a host's frames to any number of viewers. Usage: remote.relay <host address> [port to listen on]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0)
+		{
+			UE_LOG(LogRemoteSession, Display, TEXT("Usage: remote.relay <host address> [port to listen on]"));
+			return;
+		}
+
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			const int32 Port = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : IRemoteSessionModule::kDefaultPort + 1;
+			Viewer->InitRelay(*Args[0], Port);
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteBenchmarkCommand(
+	TEXT("remote.benchmark"),
+	TEXT("Streams synthetic frames from a host to a client in this process and writes timings as JSON. Usage: remote.benchmark [Width=1280] [Height=720] [Complexity=0.5] [Quality=85] [Framerate=60] [Warmup=2] [Seconds=10] [InputRate=60] [Port=2051] [Net=<preset>] [Latency=ms] [Jitter=ms] [Bandwidth=kbps] [Loss=%] [Reorder=%] [Output=<file>]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			Viewer->StartBenchmark(FString::Join(Args, TEXT(" ")));
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteLoadTestCommand(
+	TEXT("remote.loadtest"),
+	TEXT("Connects more and more headless clients from another process to a host and relay in this one, and writes CPU, fps and latency per step as JSON. Usage: remote.loadtest [Clients=1,2,4,8] [Decode=1] [InputRate=30] [Width=1280] [Height=720] [Complexity=0.5] [Quality=85] [Framerate=30] [Warmup=2] [Seconds=10] [HostPort=2052] [RelayPort=2053] [Address=<host:port>] [Output=<file>]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			Viewer->StartLoadTest(FString::Join(Args, TEXT(" ")));
+		}
+	})
+);
+
+/* Logs the stats for one end of a session, if it's connected */
+static void LogRoleStats(const TCHAR* Name, const TSharedPtr<IRemoteSessionRole>& Role)
+{
+	FRemoteSessionStats Stats;
+
+	if (Role.IsValid() == false || Role->GetStats(Stats) == false)
+	{
+		return;
+	}
+
+	UE_LOG(LogRemoteSession, Display, TEXT("%s: sent %lld bytes in %d messages, received %lld bytes in %d messages, dropped %d messages"),
+		Name, Stats.Total.BytesSent, Stats.Total.MessagesSent, Stats.Total.BytesReceived, Stats.Total.MessagesReceived, Stats.Total.MessagesDropped);
+
+	for (const auto& KV : Stats.Channels)
+	{
+		UE_LOG(LogRemoteSession, Display, TEXT("  %s: sent %lld bytes in %d messages, received %lld bytes in %d messages, dropped %d messages"),
+			*KV.Key, KV.Value.BytesSent, KV.Value.MessagesSent, KV.Value.BytesReceived, KV.Value.MessagesReceived, KV.Value.MessagesDropped);
+	}
+
+	UE_LOG(LogRemoteSession, Display, TEXT("  Send queue: %d bytes in %d packets"), Stats.SendQueueBytes, Stats.SendQueuePackets);
+
+	UE_LOG(LogRemoteSession, Display, TEXT("  Frames: %d captured, %d encoded, %d received, %d decoded, %d uploaded, %d dropped, %d waiting to decode"),
+		Stats.Frames.FramesCaptured, Stats.Frames.FramesEncoded, Stats.Frames.FramesReceived, Stats.Frames.FramesDecoded,
+		Stats.Frames.FramesUploaded, Stats.Frames.FramesDropped, Stats.Frames.DecodeQueueDepth);
+
+	UE_LOG(LogRemoteSession, Display, TEXT("  Receive buffers: %d in use, %d free, %lld bytes"),
+		Stats.ReceiveBuffersInUse, Stats.ReceiveBuffersFree, Stats.ReceiveBufferBytes);
+}
+
+FAutoConsoleCommand GRemoteStatsCommand(
+	TEXT("remote.stats"),
+	TEXT("Logs traffic, queue, frame and buffer counters for the current host and client"),
+	FConsoleCommandDelegate::CreateStatic(
+		[]()
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			LogRoleStats(TEXT("Host"), Viewer->GetHost());
+			LogRoleStats(TEXT("Client"), Viewer->GetClient());
 		}
 	})
 );
 
+/* Writes the frame timeline for one end of a session to Directory, if it has a framebuffer channel */
+static void DumpRoleTimeline(const TCHAR* Name, const TSharedPtr<IRemoteSessionRole>& Role, const FString& Directory)
+{
+	TSharedPtr<FRemoteSessionFrameBufferChannel> Channel = Role.IsValid() ? Role->GetChannel<FRemoteSessionFrameBufferChannel>(FRemoteSessionFrameBufferChannel::StaticType()) : nullptr;
+
+	if (Channel.IsValid() == false)
+	{
+		return;
+	}
+
+	const FString Filename = Directory / FString::Printf(TEXT("Timeline-%s-%s.csv"), Name, *FDateTime::Now().ToString());
+
+	if (Channel->DumpTimeline(Filename))
+	{
+		UE_LOG(LogRemoteSession, Display, TEXT("Wrote %d frames from the %s to %s"), Channel->GetTimeline().Num(), Name, *Filename);
+	}
+	else
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("No timeline written for the %s"), Name);
+	}
+}
+
+FAutoConsoleCommand GRemoteDumpTimelineCommand(
+	TEXT("remote.dumptimeline"),
+	TEXT("Writes the timings of each stage of recent frames on the host and client to CSV. Usage: remote.dumptimeline [directory]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			const FString Directory = Args.Num() ? Args[0] : FPaths::ProjectSavedDir() / TEXT("RemoteSession");
+			DumpRoleTimeline(TEXT("Host"), Viewer->GetHost(), Directory);
+			DumpRoleTimeline(TEXT("Client"), Viewer->GetClient(), Directory);
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteCaptureCommand(
+	TEXT("remote.capture"),
+	TEXT("Records every packet the host and client send and receive, until stopped. Usage: remote.capture [directory] | stop"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			if (Args.Num() && Args[0] == TEXT("stop"))
+			{
+				Viewer->SetCapture(FString());
+			}
+			else
+			{
+				Viewer->SetCapture(Args.Num() ? Args[0] : FRemoteSessionModule::GetDefaultCaptureDirectory());
+			}
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteReplayCommand(
+	TEXT("remote.replay"),
+	TEXT("Plays what the host sent in a capture on a new client. Usage: remote.replay <capture> [speed, 0 for as fast as possible]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0)
+		{
+			UE_LOG(LogRemoteSession, Display, TEXT("Usage: remote.replay <capture> [speed]"));
+			return;
+		}
+
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			if (Args.Num() > 1)
+			{
+				GRemoteSessionReplaySpeed = FCString::Atof(*Args[1]);
+			}
+
+			Viewer->StartReplay(Args[0]);
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteReplayHostCommand(
+	TEXT("remote.replayhost"),
+	TEXT("Sends what the client sent in a capture to a host. Usage: remote.replayhost <capture> [host address=127.0.0.1] [speed, 0 for as fast as possible]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0)
+		{
+			UE_LOG(LogRemoteSession, Display, TEXT("Usage: remote.replayhost <capture> [host address] [speed]"));
+			return;
+		}
+
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			const FString HostAddress = Args.Num() > 1 ? Args[1] : FString(TEXT("127.0.0.1"));
+			const float Speed = Args.Num() > 2 ? FCString::Atof(*Args[2]) : GRemoteSessionReplaySpeed;
+			Viewer->StartHostReplay(Args[0], HostAddress, Speed);
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteInputRecordCommand(
+	TEXT("remote.input.record"),
+	TEXT("Records input sent by the client or received by the host, with timings, until stopped. Usage: remote.input.record [directory] | stop"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			if (Args.Num() && Args[0] == TEXT("stop"))
+			{
+				Viewer->SetInputRecording(FString());
+			}
+			else
+			{
+				Viewer->SetInputRecording(Args.Num() ? Args[0] : FRemoteSessionModule::GetDefaultCaptureDirectory());
+			}
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteInputPlayCommand(
+	TEXT("remote.input.play"),
+	TEXT("Plays recorded input on the host and writes the frame times seen to JSON. Usage: remote.input.play <recording> [results file]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0)
+		{
+			UE_LOG(LogRemoteSession, Display, TEXT("Usage: remote.input.play <recording> [results file]"));
+			return;
+		}
+
+		if (FRemoteSessionModule* Viewer = FModuleManager::LoadModulePtr<FRemoteSessionModule>("RemoteSession"))
+		{
+			Viewer->StartInputPlayback(Args[0], Args.Num() > 1 ? Args[1] : FString());
+		}
+	})
+);
+
+FAutoConsoleCommand GRemoteNetCommand(
+	TEXT("remote.net"),
+	TEXT("Emulates network conditions on connections made from now on. Usage: remote.net [off|lan|wifi|hotelwifi|lte|3g] [Latency=ms] [Jitter=ms] [Bandwidth=kbps] [Loss=%] [Reorder=%]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(
+		[](const TArray<FString>& Args)
+	{
+		FRemoteSessionNetworkConditions Conditions = FRemoteSessionNetworkConditions::Get();
+
+		if (Args.Num() && Conditions.Parse(*FString::Join(Args, TEXT(" "))))
+		{
+			FRemoteSessionNetworkConditions::Set(Conditions);
+		}
+
+		UE_LOG(LogRemoteSession, Display, TEXT("Network conditions: %s"), *Conditions.ToString());
+	})
+);
+
 FAutoConsoleCommand GRemoteAutoPIECommand(
 	TEXT("remote.autopie"),
 	TEXT("enables remote with pie"),
@@ -0,0 +1,380 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionRelay.h"
+#include "RemoteSession.h"
+#include "RemoteSessionListener.h"
+#include "BackChannel/Transport/IBackChannelTransport.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionHeartbeat.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "HAL/RunnableThread.h"
+#include "Sockets.h"
+
+/* How long to wait between attempts to connect to the host */
+static const double kHostRetrySeconds = 1.0;
+
+/* How long the host has to answer our hello before we try again */
+static const double kHostConnectTimeoutSeconds = 5.0;
+
+/* How long to sleep when there was nothing to do */
+static const float kIdleSleepSeconds = 0.001f;
+
+FRemoteSessionRelay::FRemoteSessionRelay(const FString& InHostAddress, uint16 InListenPort)
+	: HostAddress(InHostAddress)
+	, ListenPort(InListenPort)
+	, HostAttemptTime(0)
+	, NextViewerId(0)
+	, Thread(nullptr)
+{
+	if (HostAddress.Contains(TEXT(":")) == false)
+	{
+		HostAddress += FString::Printf(TEXT(":%d"), (int32)IRemoteSessionModule::kDefaultPort);
+	}
+
+	Settings = FRemoteSessionTransportSettings::LoadFromConfig();
+
+	// viewers are on other devices, and shared memory could clash with a host on this machine
+	Settings.bAllowSharedMemory = false;
+}
+
+FRemoteSessionRelay::~FRemoteSessionRelay()
+{
+	if (Thread)
+	{
+		bExitRequested = true;
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	Listener = nullptr;
+}
+
+bool FRemoteSessionRelay::Start()
+{
+	Listener = MakeUnique<FRemoteSessionListener>(Settings);
+
+	if (Listener->Listen(ListenPort) == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Relay failed to listen on port %d"), ListenPort);
+		Listener = nullptr;
+		return false;
+	}
+
+	// nothing to show viewers until we're connected to the host
+	Listener->SetAccepting(false);
+
+	Thread = FRunnableThread::Create(this, TEXT("RemoteSessionRelay"), 128 * 1024, TPri_AboveNormal);
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Relaying %s to viewers on port %d"), *HostAddress, ListenPort);
+	return true;
+}
+
+uint32 FRemoteSessionRelay::Run()
+{
+	while (bExitRequested == false)
+	{
+		const double Now = FPlatformTime::Seconds();
+
+		bool bDidWork = TickHost(Now);
+
+		Listener->SetAccepting(HostAck.IsSet());
+
+		TSharedPtr<FRemoteSessionAcceptedClient, ESPMode::ThreadSafe> Client = Listener->TakeClient();
+
+		if (Client.IsValid())
+		{
+			AddViewer(*Client);
+			bDidWork = true;
+		}
+
+		bDidWork |= TickViewers(Now);
+
+		if (bDidWork == false)
+		{
+			FPlatformProcess::Sleep(kIdleSleepSeconds);
+		}
+	}
+
+	for (const TSharedPtr<FViewer>& Viewer : Viewers)
+	{
+		Viewer->Transport.Connection->Close();
+	}
+
+	Viewers.Empty();
+	NumViewers.Reset();
+
+	CloseHostConnection(FPlatformTime::Seconds());
+	return 0;
+}
+
+bool FRemoteSessionRelay::ReceiveFrom(FRemoteSessionTransport& Transport, double Now, bool& bOutReceived)
+{
+	FSocket* Socket = Transport.Connection->GetSocket();
+
+	if (Socket && Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::Zero()))
+	{
+		// readable with nothing to read means the other end closed the socket
+		if (Transport.Receiver->ReceivePackets() == 0)
+		{
+			Transport.Receiver->MarkDisconnected();
+		}
+		else
+		{
+			bOutReceived = true;
+		}
+	}
+
+	if (Transport.Receiver->IsConnected())
+	{
+		Transport.Heartbeat->Tick(Now, Transport.Receiver->GetLastReceiveTime());
+	}
+
+	return Transport.Receiver->IsConnected() && Transport.Heartbeat->IsLinkDead() == false;
+}
+
+bool FRemoteSessionRelay::TickHost(double Now)
+{
+	if (HostConnection.IsValid() == false)
+	{
+		if (Now - HostAttemptTime >= kHostRetrySeconds)
+		{
+			StartHostConnection(Now);
+		}
+		return false;
+	}
+
+	if (Host.Receiver.IsValid() == false)
+	{
+		// still connecting
+		HostConnection->WaitForConnection(0, [this](TSharedRef<IBackChannelConnection> InConnection) {
+			OnHostConnected();
+			return true;
+		});
+
+		if (Host.Receiver.IsValid() == false && Now - HostAttemptTime >= kHostConnectTimeoutSeconds)
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("Relay timed out connecting to %s"), *HostAddress);
+			CloseHostConnection(Now);
+		}
+
+		return false;
+	}
+
+	bool bReceived = false;
+
+	if (ReceiveFrom(Host, Now, bReceived) == false)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Relay lost connection to %s"), *HostAddress);
+		CloseHostConnection(Now);
+	}
+	else if (HostAck.IsSet() == false && Now - HostAttemptTime >= kHostConnectTimeoutSeconds)
+	{
+		UE_LOG(LogRemoteSession, Log, TEXT("%s didn't answer our hello"), *HostAddress);
+		CloseHostConnection(Now);
+	}
+
+	return bReceived;
+}
+
+void FRemoteSessionRelay::StartHostConnection(double Now)
+{
+	HostAttemptTime = Now;
+
+	if (IBackChannelTransport* Transport = IBackChannelTransport::Get())
+	{
+		HostConnection = Transport->CreateConnection(IBackChannelTransport::TCP);
+
+		if (HostConnection.IsValid() && HostConnection->Connect(*HostAddress) == false)
+		{
+			HostConnection = nullptr;
+		}
+	}
+}
+
+void FRemoteSessionRelay::OnHostConnected()
+{
+	Host = FRemoteSessionRole::CreateTransport(HostConnection.ToSharedRef(), nullptr, Settings, false);
+
+	// frames are passed on as they are, so take them straight from the receive buffer
+	Host.Receiver->BindHandler(TEXT("/Screen"), FRemoteSessionMessageHandler::CreateRaw(this, &FRemoteSessionRelay::OnHostFrame));
+	Host.OSCConnection->GetDispatchMap().GetAddressHandler(FRemoteSessionHelloAck::Address).AddRaw(this, &FRemoteSessionRelay::OnHostHelloAck);
+
+	// no display size, so the host sends full size frames and each viewer scales them to fit
+	FRemoteSessionHello Hello;
+	Hello.ProtocolVersion = kRemoteSessionProtocolVersion;
+	Hello.Codecs = FRemoteSessionFrameBufferChannel::GetSupportedCodecs();
+	Hello.NumCores = FPlatformMisc::NumberOfCores();
+	Hello.Channels.Add(FRemoteSessionInputChannel::StaticType());
+	Hello.Channels.Add(FRemoteSessionFrameBufferChannel::StaticType());
+	Hello.ResumeToken = HostSessionToken;
+
+	if (Host.Compressor.IsValid())
+	{
+		Hello.Compression = Host.Compressor->GetDescription();
+		Hello.CompressedChannels = Settings.CompressedChannels;
+	}
+
+	FBackChannelOSCMessage Msg(FRemoteSessionHello::Address);
+	Hello.Write(Msg);
+	Host.Sender->SendPacket(Msg);
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Relay connected to %s"), *HostAddress);
+}
+
+void FRemoteSessionRelay::CloseHostConnection(double Now)
+{
+	if (HostConnection.IsValid())
+	{
+		HostConnection->Close();
+	}
+
+	Host = FRemoteSessionTransport();
+	HostConnection = nullptr;
+	HostAck.Reset();
+	HostAttemptTime = Now;
+
+	// viewers stay connected and keep the last frame until we're back
+}
+
+void FRemoteSessionRelay::OnHostHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
+	FRemoteSessionHelloAck Ack;
+	Ack.Read(Message);
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Host %s will send %dx%d frames using %s"), *HostAddress, Ack.FrameWidth, Ack.FrameHeight, *Ack.Codec);
+
+	if (Host.Compressor.IsValid() && Ack.Compression == Host.Compressor->GetDescription())
+	{
+		TArray<FString> Channels;
+
+		for (const FString& Channel : Settings.CompressedChannels)
+		{
+			if (Ack.CompressedChannels.Contains(Channel))
+			{
+				Channels.Add(Channel);
+			}
+		}
+
+		Host.Sender->EnableCompression(Host.Compressor, Channels);
+	}
+
+	HostSessionToken = Ack.SessionToken;
+	HostAck = Ack;
+}
+
+void FRemoteSessionRelay::OnHostFrame(FRemoteSessionReceivedMessage& Message)
+{
+	FRemoteSessionPooledBufferPtr Frame = Message.GetBuffer();
+
+	// the receive buffer is shared with every viewer's send queue, so it's only copied if it holds more than this packet
+	if (Frame->Num() != Message.GetSize())
+	{
+		Frame = MakeShareable(new TArray<uint8>(Frame->GetData(), Message.GetSize()));
+	}
+
+	LastFrame = Frame;
+
+	for (const TSharedPtr<FViewer>& Viewer : Viewers)
+	{
+		if (Viewer->bWantsFrames)
+		{
+			Viewer->Transport.Sender->SendEncoded(Frame, FRemoteSessionFrameBufferChannel::StaticType());
+		}
+	}
+}
+
+void FRemoteSessionRelay::AddViewer(const FRemoteSessionAcceptedClient& Client)
+{
+	TSharedPtr<FViewer> Viewer = MakeShareable(new FViewer);
+	Viewer->Id = NextViewerId++;
+	Viewer->Transport = Client.Transport;
+	Viewer->bWantsFrames = Client.Hello.Channels.Contains(FRemoteSessionFrameBufferChannel::StaticType());
+
+	const int32 ViewerId = Viewer->Id;
+
+	Viewer->Transport.OSCConnection->GetDispatchMap().GetAddressHandler(TEXT("/MessageHandler/")).AddLambda([this, ViewerId](FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch) {
+		OnViewerInput(Message, ViewerId);
+	});
+
+	// same as the host would say, apart from the session which viewers can't resume
+	FRemoteSessionHelloAck Ack;
+	Ack.Codec = HostAck->Codec;
+	Ack.FrameWidth = HostAck->FrameWidth;
+	Ack.FrameHeight = HostAck->FrameHeight;
+
+	for (const FString& Type : Client.Hello.Channels)
+	{
+		if (Type == FRemoteSessionInputChannel::StaticType() || Type == FRemoteSessionFrameBufferChannel::StaticType())
+		{
+			Ack.Channels.Add(Type);
+		}
+	}
+
+	if (Viewer->Transport.Compressor.IsValid())
+	{
+		Ack.Compression = Viewer->Transport.Compressor->GetDescription();
+		Ack.CompressedChannels = Settings.CompressedChannels;
+	}
+
+	if (Client.Hello.ProtocolVersion >= 2)
+	{
+		FBackChannelOSCMessage Msg(FRemoteSessionHelloAck::Address);
+		Ack.Write(Msg);
+		Viewer->Transport.Sender->SendPacket(Msg);
+	}
+
+	if (Viewer->bWantsFrames && LastFrame.IsValid())
+	{
+		Viewer->Transport.Sender->SendEncoded(LastFrame, FRemoteSessionFrameBufferChannel::StaticType());
+	}
+
+	Viewers.Add(Viewer);
+	NumViewers.Increment();
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Viewer %d connected from %s%s. %d viewers"),
+		ViewerId, *Viewer->Transport.Connection->GetDescription(), Viewers.Num() == 1 ? TEXT(" and is the controller") : TEXT(""), Viewers.Num());
+}
+
+bool FRemoteSessionRelay::TickViewers(double Now)
+{
+	bool bReceived = false;
+
+	for (int32 Index = 0; Index < Viewers.Num(); )
+	{
+		TSharedPtr<FViewer> Viewer = Viewers[Index];
+
+		if (ReceiveFrom(Viewer->Transport, Now, bReceived))
+		{
+			Index++;
+			continue;
+		}
+
+		Viewer->Transport.Connection->Close();
+		Viewers.RemoveAt(Index);
+		NumViewers.Decrement();
+
+		UE_LOG(LogRemoteSession, Log, TEXT("Viewer %d disconnected. %d viewers"), Viewer->Id, Viewers.Num());
+
+		if (Index == 0 && Viewers.Num())
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("Viewer %d is now the controller"), Viewers[0]->Id);
+		}
+	}
+
+	return bReceived;
+}
+
+void FRemoteSessionRelay::OnViewerInput(FBackChannelOSCMessage& Message, int32 ViewerId)
+{
+	const bool bIsController = Viewers.Num() && Viewers[0]->Id == ViewerId;
+
+	if (bIsController && HostAck.IsSet())
+	{
+		Host.Sender->SendPacket(Message, FRemoteSessionInputChannel::StaticType());
+	}
+}
@@ -0,0 +1,98 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "RemoteSessionRole.h"
+#include "RemoteSessionHandshake.h"
+#include "Transport/RemoteSessionReceiver.h"
+
+class FRunnableThread;
+class FRemoteSessionListener;
+struct FRemoteSessionAcceptedClient;
+
+/*
+	Connects to a host as a client and serves its frames to any number of viewers. A playtest can then be
+	watched from many devices for the cost of one on the game machine.
+
+	Frames are passed on as the packets they arrived in, without being decoded or re-encoded. Input is only
+	passed on from one viewer, the controller. That's whichever viewer has been connected longest.
+
+	Everything runs on the relay's own thread.
+*/
+class REMOTESESSION_API FRemoteSessionRelay : public FRunnable
+{
+public:
+
+	FRemoteSessionRelay(const FString& InHostAddress, uint16 InListenPort);
+
+	virtual ~FRemoteSessionRelay();
+
+	/** Starts listening for viewers and connecting to the host. Returns false if we can't listen */
+	bool Start();
+
+	/** Number of viewers currently connected */
+	int32 GetNumViewers() const { return NumViewers.GetValue(); }
+
+	/** Reads whatever has arrived on Transport and ticks its heartbeat, returns false if the connection has gone */
+	static bool ReceiveFrom(FRemoteSessionTransport& Transport, double Now, bool& bOutReceived);
+
+protected:
+
+	struct FViewer
+	{
+		int32					Id;
+		FRemoteSessionTransport	Transport;
+		bool					bWantsFrames;
+	};
+
+	virtual uint32 Run() override;
+
+	/** Connects, or keeps trying to connect, to the host. Returns true if anything was received */
+	bool TickHost(double Now);
+
+	/** Reads from viewers and drops any that have gone. Returns true if anything was received */
+	bool TickViewers(double Now);
+
+	void StartHostConnection(double Now);
+	void OnHostConnected();
+	void CloseHostConnection(double Now);
+
+	void AddViewer(const FRemoteSessionAcceptedClient& Client);
+
+	/** Bound to frames from the host */
+	void OnHostFrame(FRemoteSessionReceivedMessage& Message);
+
+	void OnHostHelloAck(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch);
+
+	void OnViewerInput(FBackChannelOSCMessage& Message, int32 ViewerId);
+
+	FString							HostAddress;
+	uint16							ListenPort;
+	FRemoteSessionTransportSettings	Settings;
+
+	TUniquePtr<FRemoteSessionListener>	Listener;
+
+	/** Our connection to the host, and what it told us when we said hello */
+	TSharedPtr<IBackChannelConnection>	HostConnection;
+	FRemoteSessionTransport			Host;
+	TOptional<FRemoteSessionHelloAck>	HostAck;
+	double							HostAttemptTime;
+
+	/** Lets us resume with the host if the connection to it drops */
+	FString							HostSessionToken;
+
+	/** Most recent frame, sent to viewers as soon as they connect */
+	FRemoteSessionPooledBufferPtr	LastFrame;
+
+	/** Viewers in the order they connected, the first is the controller */
+	TArray<TSharedPtr<FViewer>>		Viewers;
+	int32							NextViewerId;
+	FThreadSafeCounter				NumViewers;
+
+	FRunnableThread*				Thread;
+	FThreadSafeBool					bExitRequested;
+};
@@ -0,0 +1,190 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionReplayDriver.h"
+#include "RemoteSession.h"
+#include "BackChannel/Transport/IBackChannelTransport.h"
+#include "HAL/RunnableThread.h"
+
+/* How long we wait for the host to accept us */
+static const double kConnectTimeoutSeconds = 5.0;
+
+/* Longest we sleep between checking for packets that are due, what the host sent, and whether to exit */
+static const double kMaxSleepSeconds = 0.005;
+
+/* How long to keep reading from the host after the last packet so it has time to act on it */
+static const double kLingerSeconds = 1.0;
+
+FRemoteSessionReplayDriver::FRemoteSessionReplayDriver(const FString& InFilename, const FString& InHostAddress, float InSpeed)
+	: Filename(InFilename)
+	, HostAddress(InHostAddress)
+	, Speed(FMath::Max(InSpeed, 0.0f))
+	, BytesDrained(0)
+	, Thread(nullptr)
+{
+	if (HostAddress.Contains(TEXT(":")) == false)
+	{
+		HostAddress += FString::Printf(TEXT(":%d"), (int32)IRemoteSessionModule::kDefaultPort);
+	}
+
+	DrainBuffer.SetNumUninitialized(64 * 1024);
+}
+
+FRemoteSessionReplayDriver::~FRemoteSessionReplayDriver()
+{
+	if (Thread)
+	{
+		bExitRequested = true;
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+bool FRemoteSessionReplayDriver::Start()
+{
+	if (Reader.Open(Filename) == false)
+	{
+		return false;
+	}
+
+	Thread = FRunnableThread::Create(this, TEXT("RemoteSessionReplay"), 128 * 1024, TPri_AboveNormal);
+	return true;
+}
+
+bool FRemoteSessionReplayDriver::ConnectToHost()
+{
+	IBackChannelTransport* Transport = IBackChannelTransport::Get();
+
+	if (Transport == nullptr)
+	{
+		return false;
+	}
+
+	Connection = Transport->CreateConnection(IBackChannelTransport::TCP);
+
+	if (Connection.IsValid() == false || Connection->Connect(*HostAddress) == false)
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	bool bConnected = false;
+
+	while (bConnected == false && bExitRequested == false && FPlatformTime::Seconds() - StartTime < kConnectTimeoutSeconds)
+	{
+		Connection->WaitForConnection(kMaxSleepSeconds, [&bConnected](TSharedRef<IBackChannelConnection> InConnection) {
+			bConnected = true;
+			return true;
+		});
+	}
+
+	return bConnected;
+}
+
+bool FRemoteSessionReplayDriver::SendPacket(const uint8* Data, int32 Size)
+{
+	// framed the same way as FRemoteSessionSender, a size then the data
+	if (Connection->SendData(&Size, sizeof(Size)) != sizeof(Size))
+	{
+		return false;
+	}
+
+	while (Size > 0)
+	{
+		const int32 Sent = Connection->SendData(Data, Size);
+
+		if (Sent <= 0)
+		{
+			return false;
+		}
+
+		Data += Sent;
+		Size -= Sent;
+	}
+
+	return true;
+}
+
+void FRemoteSessionReplayDriver::DrainHost()
+{
+	int32 BytesRead = 0;
+
+	while ((BytesRead = Connection->ReceiveData(DrainBuffer.GetData(), DrainBuffer.Num())) > 0)
+	{
+		BytesDrained += BytesRead;
+	}
+}
+
+uint32 FRemoteSessionReplayDriver::Run()
+{
+	if (ConnectToHost() == false)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Replay failed to connect to %s"), *HostAddress);
+		bFinished = true;
+		return 0;
+	}
+
+	// we're the client, so play whatever went to the host
+	const ERemoteSessionCaptureDirection Direction = Reader.GetClientToHostDirection();
+
+	const double StartTime = FPlatformTime::Seconds();
+	double FirstRecordTime = -1;
+
+	int32 PacketsSent = 0;
+	int64 BytesSent = 0;
+
+	for (int32 Index = 0; Index < Reader.GetNumRecords() && bExitRequested == false; ++Index)
+	{
+		const uint8* Data = nullptr;
+		const FRemoteSessionCaptureRecord& Record = Reader.GetRecord(Index, Data);
+
+		if (Record.Direction != Direction)
+		{
+			continue;
+		}
+
+		if (FirstRecordTime < 0)
+		{
+			FirstRecordTime = Record.Time;
+		}
+
+		if (Speed > 0)
+		{
+			const double DueTime = StartTime + (Record.Time - FirstRecordTime) / Speed;
+
+			while (bExitRequested == false && FPlatformTime::Seconds() < DueTime)
+			{
+				DrainHost();
+				FPlatformProcess::Sleep(FMath::Min(kMaxSleepSeconds, DueTime - FPlatformTime::Seconds()));
+			}
+		}
+
+		DrainHost();
+
+		if (SendPacket(Data, Record.Size) == false || Connection->IsConnected() == false)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Host closed the connection %.02f seconds into %s"), Record.Time, *Filename);
+			break;
+		}
+
+		PacketsSent++;
+		BytesSent += Record.Size;
+	}
+
+	const double EndTime = FPlatformTime::Seconds();
+
+	while (bExitRequested == false && FPlatformTime::Seconds() - EndTime < kLingerSeconds)
+	{
+		DrainHost();
+		FPlatformProcess::Sleep(kMaxSleepSeconds);
+	}
+
+	Connection->Close();
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Replayed %d packets (%.02f MB) from %s to %s in %.02f seconds, host sent %.02f MB"),
+		PacketsSent, BytesSent / (1024.0 * 1024.0), *Filename, *HostAddress, EndTime - StartTime, BytesDrained / (1024.0 * 1024.0));
+
+	bFinished = true;
+	return 0;
+}
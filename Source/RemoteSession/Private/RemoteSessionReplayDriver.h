@@ -0,0 +1,64 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Transport/RemoteSessionCapture.h"
+
+class FRunnableThread;
+class IBackChannelConnection;
+
+/*
+	Connects to a host and sends it what a client sent in a capture (the hello, input and so on) with the
+	same timing, or as fast as possible, so the host's side of a session can be reproduced without a device.
+	Whatever the host sends back is read and thrown away.
+
+	Clients are replayed with a replay: address instead, see FRemoteSessionReplayConnection.
+
+	Everything runs on the driver's own thread.
+*/
+class FRemoteSessionReplayDriver : public FRunnable
+{
+public:
+
+	/** Speed is as for remote.replayspeed, 1 is as recorded and 0 as fast as possible */
+	FRemoteSessionReplayDriver(const FString& InFilename, const FString& InHostAddress, float InSpeed);
+
+	virtual ~FRemoteSessionReplayDriver();
+
+	/** Opens the capture and starts our thread. Returns false if the capture can't be read */
+	bool Start();
+
+	/** True once everything has been sent, or the host went away */
+	bool IsFinished() const { return bFinished; }
+
+protected:
+
+	virtual uint32 Run() override;
+
+	/** Connects to the host, returns false if it doesn't accept us in time */
+	bool ConnectToHost();
+
+	/** Sends one packet framed with its size, returns false on error */
+	bool SendPacket(const uint8* Data, int32 Size);
+
+	/** Reads and discards whatever the host has sent */
+	void DrainHost();
+
+	FString							Filename;
+	FString							HostAddress;
+	float							Speed;
+
+	FRemoteSessionCaptureReader		Reader;
+
+	TSharedPtr<IBackChannelConnection>	Connection;
+
+	TArray<uint8>					DrainBuffer;
+	int64							BytesDrained;
+
+	FRunnableThread*				Thread;
+	FThreadSafeBool					bExitRequested;
+	FThreadSafeBool					bFinished;
+};
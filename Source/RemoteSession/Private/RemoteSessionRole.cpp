@@ -4,33 +4,138 @@
 #include "RemoteSessionRole.h"
 #include "RemoteSession.h"
 #include "Channels/RemoteSessionChannel.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Transport/RemoteSessionSharedMemoryConnection.h"
+#include "Channels/RemoteSessionChannelRegistry.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "Transport/RemoteSessionHeartbeat.h"
+#include "Transport/RemoteSessionTrafficCounter.h"
+#include "Transport/RemoteSessionCapture.h"
+#include "Transport/RemoteSessionNetworkEmulator.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "Channels/RemoteSessionInputChannel.h"
+#include "MessageHandler/RemoteSessionInputRecording.h"
+#include "RemoteSessionStats.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+#include "HAL/RunnableThread.h"
+#include "Sockets.h"
 
 DEFINE_LOG_CATEGORY(LogRemoteSession);
 
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Round Trip (ms)"), STAT_RSRoundTrip, STATGROUP_RemoteSession);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Jitter (ms)"), STAT_RSJitter, STATGROUP_RemoteSession);
+
+/* Address the other end sends channel types it wants us to create to */
+static const TCHAR* kOpenChannelAddress = TEXT("/OpenChannel");
+
+/* How long the receive thread blocks on the socket before checking whether it should exit */
+static const float kReceiveThreadWaitTimeMS = 100.0f;
+
 FRemoteSessionRole::~FRemoteSessionRole()
 {
 	Close();
+	StopCapture();
+	StopInputRecording();
+
+	if (ConnectionChangedEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(ConnectionChangedEvent);
+		ConnectionChangedEvent = nullptr;
+	}
 }
 
 void FRemoteSessionRole::Close()
+{
+	CloseConnection();
+	ResetChannels();
+}
+
+void FRemoteSessionRole::CloseConnection()
 {
 	// order is specific since OSC uses the connection, and
 	// dispatches to channels
 	StopBackgroundThread();
+	Heartbeat = nullptr;
+	Receiver = nullptr;
 	OSCConnection = nullptr;
+	Sender = nullptr;
+	Compressor = nullptr;
+	Traffic = nullptr;
 	Connection = nullptr;
+	SharedMemoryConnection = nullptr;
+
+	FScopeLock Lock(&ChannelRequestMutex);
+	PendingChannelRequests.Empty();
+}
+
+void FRemoteSessionRole::ResetChannels()
+{
 	Channels.Empty();
+	ChannelsById.Empty();
+}
+
+void FRemoteSessionRole::ResumeChannels()
+{
+	TArray<TSharedPtr<IRemoteSessionChannel>> PreviousChannels = MoveTemp(Channels);
+	ResetChannels();
+
+	for (const TSharedPtr<IRemoteSessionChannel>& Channel : PreviousChannels)
+	{
+		const FName Type(*Channel->GetType());
+
+		if (Channel->SetConnection(OSCConnection) && ConfigureChannel(Channel))
+		{
+			Channels.Add(Channel);
+			ChannelsById.Add(Type, Channel);
+		}
+		else
+		{
+			CreateChannel(Type);
+		}
+	}
 }
 
 void FRemoteSessionRole::Tick(float DeltaTime)
 {
 	if (OSCConnection.IsValid())
 	{
-		if (OSCConnection->IsConnected())
+		if (IsTransportConnected())
 		{
 			if (ThreadRunning == false && OSCConnection->IsThreaded() == false)
 			{
-				OSCConnection->ReceivePackets();
+				if (Receiver.IsValid())
+				{
+					Receiver->ReceivePackets();
+				}
+				else
+				{
+					OSCConnection->ReceivePackets();
+				}
+
+				TickHeartbeat();
+			}
+
+			if (Heartbeat.IsValid())
+			{
+				const FRemoteSessionLinkStats LinkStats = Heartbeat->GetStats();
+				SET_FLOAT_STAT(STAT_RSRoundTrip, LinkStats.RoundTripMS);
+				SET_FLOAT_STAT(STAT_RSJitter, LinkStats.JitterMS);
+			}
+
+			TArray<FName> ChannelRequests;
+
+			{
+				FScopeLock Lock(&ChannelRequestMutex);
+				ChannelRequests = MoveTemp(PendingChannelRequests);
+			}
+
+			for (const FName& ChannelType : ChannelRequests)
+			{
+				if (ChannelsById.Contains(ChannelType) == false)
+				{
+					CreateChannel(ChannelType);
+				}
 			}
 
 			for (auto& Channel : Channels)
@@ -41,18 +146,28 @@ void FRemoteSessionRole::Tick(float DeltaTime)
 		else
 		{
 			UE_LOG(LogRemoteSession, Warning, TEXT("Connection %s has disconnected."), *OSCConnection->GetDescription());
-			OSCConnection = nullptr;
+
+			LastDisconnectTime = FPlatformTime::Seconds();
+
+			// release the whole transport so a listener sees the session go (a shared memory region is only
+			// reset for the next client once nothing holds it), but keep the channels for a resume
+			CloseConnection();
 		}
 	}
+
+	if (InputRecorder.IsValid())
+	{
+		InputRecorder->Tick();
+	}
 }
 
 void FRemoteSessionRole::SetReceiveInBackground(bool bValue)
 {
-	if (bValue && !ThreadRunning)
+	if (bValue && BackgroundThread == nullptr)
 	{
 		StartBackgroundThread();
 	}
-	else if (!bValue && ThreadRunning)
+	else if (!bValue && BackgroundThread != nullptr)
 	{
 		StopBackgroundThread();
 	}
@@ -60,37 +175,80 @@ void FRemoteSessionRole::SetReceiveInBackground(bool bValue)
 
 void FRemoteSessionRole::StartBackgroundThread()
 {
-	check(ThreadRunning == false);
+	check(BackgroundThread == nullptr);
 	ThreadExitRequested = false;
 	ThreadRunning = true;
 
-	FRunnableThread* Thread = FRunnableThread::Create(this, TEXT("RemoteSessionClientThread"), 
+	if (ConnectionChangedEvent == nullptr)
+	{
+		ConnectionChangedEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+
+	BackgroundThread = FRunnableThread::Create(this, TEXT("RemoteSessionClientThread"), 
 		1024 * 1024, 
 		TPri_AboveNormal);
 }
 
+void FRemoteSessionRole::SignalConnectionChanged()
+{
+	if (ConnectionChangedEvent)
+	{
+		ConnectionChangedEvent->Trigger();
+	}
+}
+
 bool FRemoteSessionRole::IsConnected() const
 {
-	return OSCConnection.IsValid() && OSCConnection->IsConnected();
+	return OSCConnection.IsValid() && IsTransportConnected();
 }
 
-uint32 FRemoteSessionRole::Run()
+bool FRemoteSessionRole::IsTransportConnected() const
 {
-	/* Not used and likely to be removed! */
-	double LastTick = FPlatformTime::Seconds();
+	return OSCConnection->IsConnected() && (Receiver.IsValid() == false || Receiver->IsConnected());
+}
 
+uint32 FRemoteSessionRole::Run()
+{
 	while (ThreadExitRequested == false)
 	{
-		const double DeltaTime = FPlatformTime::Seconds() - LastTick;
+		FSocket* Socket = Connection.IsValid() ? Connection->GetSocket() : nullptr;
 
-		if (OSCConnection.IsValid() == false || OSCConnection->IsConnected() == false)
+		if (OSCConnection.IsValid() == false || IsTransportConnected() == false || (Socket == nullptr && SharedMemoryConnection.IsValid() == false))
 		{
-			FPlatformProcess::SleepNoStats(0);
+			// nothing to do until we're told something changed
+			ConnectionChangedEvent->Wait();
 			continue;
 		}
 
-		OSCConnection->ReceivePackets(1);
-		LastTick = FPlatformTime::Seconds();
+		// block until there's data (or the socket closes) rather than polling, but wake in time to send our next ping
+		FTimespan WaitTime = FTimespan::FromMilliseconds(kReceiveThreadWaitTimeMS);
+
+		if (Heartbeat.IsValid())
+		{
+			// clamp before converting, a disabled heartbeat never pings and FTimespan can't hold DBL_MAX
+			const double TimeUntilPing = Heartbeat->GetTimeUntilNextPing(FPlatformTime::Seconds());
+			WaitTime = FTimespan::FromSeconds(FMath::Min(TimeUntilPing, WaitTime.GetTotalSeconds()));
+		}
+
+		const bool bReadable = Socket ? Socket->Wait(ESocketWaitConditions::WaitForRead, WaitTime) : SharedMemoryConnection->WaitForData(WaitTime);
+
+		if (bReadable)
+		{
+			if (Receiver.IsValid())
+			{
+				// readable with nothing to read means the other end closed the socket
+				if (Receiver->ReceivePackets() == 0)
+				{
+					Receiver->MarkDisconnected();
+				}
+			}
+			else
+			{
+				OSCConnection->ReceivePackets();
+			}
+		}
+
+		TickHeartbeat();
 	}
 
 	ThreadRunning = false;
@@ -99,31 +257,351 @@ uint32 FRemoteSessionRole::Run()
 
 void FRemoteSessionRole::StopBackgroundThread()
 {
-	if (ThreadRunning == false)
+	if (BackgroundThread == nullptr)
 	{
 		return;
 	}
 
 	ThreadExitRequested = true;
+	SignalConnectionChanged();
+
+	// blocks until Run() has returned
+	BackgroundThread->WaitForCompletion();
+
+	delete BackgroundThread;
+	BackgroundThread = nullptr;
+}
 
-	while (ThreadRunning)
+TSharedPtr<IRemoteSessionChannel> FRemoteSessionRole::GetChannel(const FString& InType)
+{
+	// don't add names for types that were never registered
+	const FName Type(*InType, FNAME_Find);
+	return Type.IsNone() ? nullptr : GetChannelById(Type);
+}
+
+TSharedPtr<IRemoteSessionChannel> FRemoteSessionRole::GetChannelById(const FName& InType)
+{
+	return ChannelsById.FindRef(InType);
+}
+
+TSharedPtr<IRemoteSessionChannel> FRemoteSessionRole::CreateChannel(const FName& InType)
+{
+	if (OSCConnection.IsValid() == false)
+	{
+		return nullptr;
+	}
+
+	FRemoteSessionChannelCreationContext Context;
+	Context.bIsHost = IsHost();
+	Context.Connection = OSCConnection;
+
+	TSharedPtr<IRemoteSessionChannel> Channel = FRemoteSessionChannelRegistry::Get().CreateChannel(InType, Context);
+
+	if (Channel.IsValid() == false || ConfigureChannel(Channel) == false)
 	{
-		FPlatformProcess::SleepNoStats(0);
+		return nullptr;
 	}
+
+	if (InputRecorder.IsValid() && Channel->GetType() == FRemoteSessionInputChannel::StaticType())
+	{
+		StaticCastSharedPtr<FRemoteSessionInputChannel>(Channel)->SetRecorder(InputRecorder);
+	}
+
+	Channels.Add(Channel);
+	ChannelsById.Add(InType, Channel);
+
+	return Channel;
 }
 
-TSharedPtr<IRemoteSessionChannel> FRemoteSessionRole::GetChannel(const FString& InType)
+TSharedPtr<IRemoteSessionChannel> FRemoteSessionRole::OpenChannel(const FString& InType)
 {
-	TSharedPtr<IRemoteSessionChannel> Channel;
+	const FName Type(*InType);
 
-	TSharedPtr<IRemoteSessionChannel>* FoundChannel = Channels.FindByPredicate([InType](auto Item) {
-		return Item->GetType() == InType;
-	});
+	TSharedPtr<IRemoteSessionChannel> Channel = GetChannelById(Type);
 
-	if (FoundChannel)
+	if (Channel.IsValid() == false && IsConnected())
 	{
-		Channel = *FoundChannel;
+		Channel = CreateChannel(Type);
+
+		if (Channel.IsValid())
+		{
+			FBackChannelOSCMessage Msg(kOpenChannelAddress);
+			Msg.Write(InType);
+
+			// the connection has its own lock, so writing to it directly could split the sender's packets
+			if (Sender.IsValid())
+			{
+				Sender->SendPacket(Msg);
+			}
+		}
 	}
 
 	return Channel;
 }
+
+FRemoteSessionTransport FRemoteSessionRole::CreateTransport(TSharedRef<IBackChannelConnection> InConnection, TSharedPtr<FRemoteSessionSharedMemoryConnection> InSharedMemoryConnection,
+	const FRemoteSessionTransportSettings& InSettings, bool bScheduleSends, TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	FRemoteSessionTransport Transport;
+
+	InSettings.ApplyToSocket(InConnection->GetSocket());
+
+	// everything above the socket goes through the emulator when network conditions are set
+	TSharedRef<IBackChannelConnection> Connection = FRemoteSessionEmulatedConnection::WrapIfEnabled(InConnection);
+
+	Transport.Connection = Connection;
+	Transport.SharedMemoryConnection = InSharedMemoryConnection;
+	Transport.OSCConnection = MakeShareable(new FBackChannelOSCConnection(Connection));
+	Transport.Sender = MakeShareable(new FRemoteSessionSender(Connection));
+	Transport.Receiver = MakeShareable(new FRemoteSessionReceiver(Connection, Transport.OSCConnection.ToSharedRef()));
+
+	// set before the send thread starts, which reads it
+	Transport.Traffic = MakeShareable(new FRemoteSessionTrafficCounter());
+	Transport.Traffic->MapAddress(TEXT("/Screen"), FRemoteSessionFrameBufferChannel::StaticType());
+	Transport.Traffic->MapAddress(TEXT("/MessageHandler/"), FRemoteSessionInputChannel::StaticType());
+	Transport.Sender->SetTrafficCounter(Transport.Traffic);
+	Transport.Receiver->SetTrafficCounter(Transport.Traffic);
+
+	if (InCapture.IsValid())
+	{
+		Transport.Sender->SetCapture(InCapture);
+		Transport.Receiver->SetCapture(InCapture);
+	}
+
+	if (bScheduleSends)
+	{
+		Transport.Sender->EnableScheduling(InSettings);
+	}
+
+	if (InSettings.bEnableCompression)
+	{
+		Transport.Compressor = MakeShareable(new FRemoteSessionMessageCompressor(InSettings.CompressionThreshold, InSettings.CompressionDictionary));
+		Transport.Receiver->SetDecompressor(Transport.Compressor);
+	}
+
+	Transport.Heartbeat = MakeShareable(new FRemoteSessionHeartbeat(Transport.Sender.ToSharedRef(), InSettings.HeartbeatIntervalMS, InSettings.HeartbeatTimeoutMS));
+	Transport.Heartbeat->Bind(*Transport.Receiver);
+
+	return Transport;
+}
+
+void FRemoteSessionRole::AdoptTransport(const FRemoteSessionTransport& InTransport)
+{
+	check(BackgroundThread == nullptr);
+
+	Connection = InTransport.Connection;
+	SharedMemoryConnection = InTransport.SharedMemoryConnection;
+	OSCConnection = InTransport.OSCConnection;
+	Sender = InTransport.Sender;
+	Receiver = InTransport.Receiver;
+	Compressor = InTransport.Compressor;
+	Heartbeat = InTransport.Heartbeat;
+	Traffic = InTransport.Traffic;
+
+	// a capture may have started or stopped since the transport was built
+	Sender->SetCapture(Capture);
+	Receiver->SetCapture(Capture);
+}
+
+bool FRemoteSessionRole::StartCapture(const FString& Filename)
+{
+	StopCapture();
+
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> NewCapture = FRemoteSessionCaptureWriter::Create(Filename, IsHost());
+
+	if (NewCapture.IsValid() == false)
+	{
+		return false;
+	}
+
+	SetCapture(NewCapture);
+	return true;
+}
+
+void FRemoteSessionRole::StopCapture()
+{
+	if (Capture.IsValid() == false)
+	{
+		return;
+	}
+
+	// close explicitly, the receive and send threads may hold on to it for a moment
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> OldCapture = Capture;
+	SetCapture(nullptr);
+	OldCapture->Close();
+}
+
+bool FRemoteSessionRole::StartInputRecording(const FString& Filename)
+{
+	StopInputRecording();
+
+	InputRecorder = FRemoteSessionInputRecorder::Create(Filename);
+
+	TSharedPtr<FRemoteSessionInputChannel> InputChannel = GetChannel<FRemoteSessionInputChannel>(FRemoteSessionInputChannel::StaticType());
+
+	if (InputChannel.IsValid())
+	{
+		InputChannel->SetRecorder(InputRecorder);
+	}
+
+	return InputRecorder.IsValid();
+}
+
+void FRemoteSessionRole::StopInputRecording()
+{
+	if (InputRecorder.IsValid() == false)
+	{
+		return;
+	}
+
+	TSharedPtr<FRemoteSessionInputChannel> InputChannel = GetChannel<FRemoteSessionInputChannel>(FRemoteSessionInputChannel::StaticType());
+
+	if (InputChannel.IsValid())
+	{
+		InputChannel->SetRecorder(nullptr);
+	}
+
+	InputRecorder->Close();
+	InputRecorder = nullptr;
+}
+
+void FRemoteSessionRole::SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	Capture = InCapture;
+
+	if (Sender.IsValid())
+	{
+		Sender->SetCapture(Capture);
+	}
+
+	if (Receiver.IsValid())
+	{
+		Receiver->SetCapture(Capture);
+	}
+}
+
+void FRemoteSessionRole::TickHeartbeat()
+{
+	if (Heartbeat.IsValid() == false || Receiver.IsValid() == false || Receiver->IsConnected() == false)
+	{
+		return;
+	}
+
+	Heartbeat->Tick(FPlatformTime::Seconds(), Receiver->GetLastReceiveTime());
+
+	if (Heartbeat->IsLinkDead())
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Nothing received for %dms, assuming the connection is lost"), TransportSettings.HeartbeatTimeoutMS);
+		Receiver->MarkDisconnected();
+	}
+}
+
+bool FRemoteSessionRole::GetLinkStats(FRemoteSessionLinkStats& OutStats) const
+{
+	if (IsConnected() == false || Heartbeat.IsValid() == false)
+	{
+		return false;
+	}
+
+	OutStats = Heartbeat->GetStats();
+	return true;
+}
+
+bool FRemoteSessionRole::GetStats(FRemoteSessionStats& OutStats) const
+{
+	if (IsConnected() == false)
+	{
+		return false;
+	}
+
+	OutStats = FRemoteSessionStats();
+
+	if (Traffic.IsValid())
+	{
+		Traffic->GetStats(OutStats);
+	}
+
+	if (Sender.IsValid())
+	{
+		OutStats.SendQueueBytes = Sender->GetQueuedBytes();
+		OutStats.SendQueuePackets = Sender->GetQueuedPackets();
+	}
+
+	if (Receiver.IsValid())
+	{
+		const FRemoteSessionBufferPool& Pool = Receiver->GetBufferPool();
+		OutStats.ReceiveBuffersInUse = Pool.GetNumInUse();
+		OutStats.ReceiveBuffersFree = Pool.GetNumFree();
+		OutStats.ReceiveBufferBytes = Pool.GetAllocatedBytes();
+	}
+
+	static const FName FramebufferType(*FRemoteSessionFrameBufferChannel::StaticType());
+	TSharedPtr<IRemoteSessionChannel> FramebufferChannel = ChannelsById.FindRef(FramebufferType);
+
+	if (FramebufferChannel.IsValid())
+	{
+		StaticCastSharedPtr<FRemoteSessionFrameBufferChannel>(FramebufferChannel)->GetFrameStats(OutStats.Frames);
+	}
+
+	return true;
+}
+
+void FRemoteSessionRole::EnableCompressionForPeer(const FString& PeerCompression, const TArray<FString>& PeerChannels)
+{
+	if (Compressor.IsValid() == false || Sender.IsValid() == false)
+	{
+		return;
+	}
+
+	if (PeerCompression != Compressor->GetDescription())
+	{
+		if (PeerCompression.Len())
+		{
+			UE_LOG(LogRemoteSession, Log, TEXT("Not compressing messages, peer uses %s and we use %s"), 
+				*PeerCompression, *Compressor->GetDescription());
+		}
+		return;
+	}
+
+	TArray<FString> Channels;
+
+	for (const FString& Channel : TransportSettings.CompressedChannels)
+	{
+		if (PeerChannels.Contains(Channel))
+		{
+			Channels.Add(Channel);
+		}
+	}
+
+	if (Channels.Num())
+	{
+		Sender->EnableCompression(Compressor, Channels);
+		UE_LOG(LogRemoteSession, Log, TEXT("Compressing messages on %s"), *FString::Join(Channels, TEXT(",")));
+	}
+}
+
+void FRemoteSessionRole::BindChannelRequests()
+{
+	OSCConnection->GetDispatchMap().GetAddressHandler(kOpenChannelAddress).AddRaw(this, &FRemoteSessionRole::OnChannelRequest);
+}
+
+void FRemoteSessionRole::OnChannelRequest(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch)
+{
+	FString Type;
+	Message << Type;
+
+	// the peer decides this string, so only look up names that already exist. A registered type
+	// always has one, and anything else would grow the global name table from the receive thread
+	const FName TypeName(*Type, FNAME_Find);
+
+	// ignore anything we couldn't create anyway
+	if (TypeName.IsNone() == false && FRemoteSessionChannelRegistry::Get().IsRegistered(TypeName))
+	{
+		FScopeLock Lock(&ChannelRequestMutex);
+		PendingChannelRequests.AddUnique(TypeName);
+	}
+	else
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Ignoring request for unknown channel %s"), *Type);
+	}
+}
@@ -5,8 +5,35 @@
 #include "RemoteSession/RemoteSessionRole.h"
 #include "BackChannel/Protocol/OSC/BackChannelOSCConnection.h"
 #include "Tickable.h"
-
-
+#include "Transport/RemoteSessionTransportSettings.h"
+
+class FRemoteSessionSender;
+class FRemoteSessionReceiver;
+class FRemoteSessionSharedMemoryConnection;
+class FRemoteSessionMessageCompressor;
+class FRemoteSessionHeartbeat;
+class FRemoteSessionTrafficCounter;
+class FRemoteSessionCaptureWriter;
+class FRemoteSessionInputRecorder;
+class FBackChannelOSCMessage;
+class FBackChannelOSCDispatch;
+
+/*
+	A connection and everything needed to talk over it. Can be built on any thread, then handed to a role.
+	The connections come from IBackChannelTransport and aren't thread safe shared pointers, so a transport has
+	to be handed over whole, with nothing left holding them on the thread that built it
+*/
+struct FRemoteSessionTransport
+{
+	TSharedPtr<IBackChannelConnection>	Connection;
+	TSharedPtr<FRemoteSessionSharedMemoryConnection> SharedMemoryConnection;
+	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> OSCConnection;
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> Sender;
+	TSharedPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> Receiver;
+	TSharedPtr<FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> Compressor;
+	TSharedPtr<FRemoteSessionHeartbeat, ESPMode::ThreadSafe> Heartbeat;
+	TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe> Traffic;
+};
 
 class FRemoteSessionRole : public IRemoteSessionRole, FRunnable
 {
@@ -16,30 +43,144 @@ public:
 
 	virtual void Close();
 
+	/** Closes the connection but keeps our channels so they can be resumed on a new one */
+	void			CloseConnection();
+
 	virtual bool IsConnected() const;
 
 	virtual void Tick( float DeltaTime );
 
 	virtual TSharedPtr<IRemoteSessionChannel> GetChannel(const FString& Type) override;
 
+	virtual TSharedPtr<IRemoteSessionChannel> GetChannelById(const FName& Type) override;
+
+	// the typed versions would otherwise be hidden by the overrides above
+	using IRemoteSessionRole::GetChannel;
+	using IRemoteSessionRole::GetChannelById;
+
+	virtual TSharedPtr<IRemoteSessionChannel> OpenChannel(const FString& Type) override;
+
+	virtual bool GetLinkStats(FRemoteSessionLinkStats& OutStats) const override;
+
+	virtual bool GetStats(FRemoteSessionStats& OutStats) const override;
+
 	void			SetReceiveInBackground(bool bValue);
 
+	/** Records everything sent and received on this connection and any that follow to Filename, until StopCapture */
+	bool			StartCapture(const FString& Filename);
+
+	void			StopCapture();
+
+	bool			IsCapturing() const { return Capture.IsValid(); }
+
+	/** Writes the input our input channel sends or receives to Filename, with timings, until StopInputRecording */
+	bool			StartInputRecording(const FString& Filename);
+
+	void			StopInputRecording();
+
 protected:
 
+	/** Applies a capture (or null to stop) to the current connection and any new ones */
+	virtual void	SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture);
+
 	void			StartBackgroundThread();
 	void			StopBackgroundThread();
 
+	/** Returns true if neither the OSC connection nor our receiver have seen the connection fail */
+	bool			IsTransportConnected() const;
+
+	/** Wakes the background thread if it is waiting for a connection */
+	void			SignalConnectionChanged();
+
 	uint32			Run();
 
+	/** True for the host end of a session */
+	virtual bool	IsHost() const { return false; }
+
+	/** Creates a channel of InType from the registry, configures it and adds it to our list */
+	TSharedPtr<IRemoteSessionChannel> CreateChannel(const FName& InType);
+
+	/** Called on new channels before they're added. Return false to discard the channel */
+	virtual bool	ConfigureChannel(const TSharedPtr<IRemoteSessionChannel>& InChannel) { return true; }
+
+	/**
+	 * Creates the OSC connection, sender, receiver, compressor (if enabled) and heartbeat for InConnection. Touches
+	 * nothing on the role so it's safe to call from any thread. If InCapture is set everything from the first
+	 * packet on is recorded to it
+	 */
+	static FRemoteSessionTransport CreateTransport(TSharedRef<IBackChannelConnection> InConnection, TSharedPtr<FRemoteSessionSharedMemoryConnection> InSharedMemoryConnection, 
+		const FRemoteSessionTransportSettings& InSettings, bool bScheduleSends, TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture = nullptr);
+
+	/** Starts using InTransport. The receive thread must not be running */
+	void			AdoptTransport(const FRemoteSessionTransport& InTransport);
+
+	/** Sends pings and drops the connection if the peer has gone quiet. Called wherever we receive */
+	void			TickHeartbeat();
+
+	/** Starts compressing the channels both we and the peer listed, if the peer uses our dictionary */
+	void			EnableCompressionForPeer(const FString& PeerCompression, const TArray<FString>& PeerChannels);
+
+	/** Moves our channels to OSCConnection, recreating any that can't be moved */
+	void			ResumeChannels();
+
+	/** Removes all channels */
+	void			ResetChannels();
+
+	/** Lets the other end open channels on us. Call once OSCConnection is created */
+	void			BindChannelRequests();
+
+	/** Bound to /OpenChannel, called on the receive thread */
+	void			OnChannelRequest(FBackChannelOSCMessage& Message, FBackChannelOSCDispatch& Dispatch);
+
 protected:
 	
 	TSharedPtr<IBackChannelConnection>	Connection;
 
+	/** Set when Connection is a same-machine shared memory connection, which has no socket to wait on */
+	TSharedPtr<FRemoteSessionSharedMemoryConnection> SharedMemoryConnection;
+
 	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> OSCConnection;
 
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> Sender;
+
+	TSharedPtr<FRemoteSessionReceiver, ESPMode::ThreadSafe> Receiver;
+
+	TSharedPtr<FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> Compressor;
+
+	TSharedPtr<FRemoteSessionHeartbeat, ESPMode::ThreadSafe> Heartbeat;
+
+	/** Bytes and messages sent and received on the current connection, by channel */
+	TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe> Traffic;
+
+	/** Where input is being recorded, if anywhere. Given to input channels as they're created */
+	TSharedPtr<FRemoteSessionInputRecorder, ESPMode::ThreadSafe> InputRecorder;
+
+	/** Where sent and received packets are being recorded, if anywhere. Outlives connections */
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> Capture;
+
+	FRemoteSessionTransportSettings		TransportSettings;
+
+	/** Identifies the session so a client that reconnects can pick up where it left off */
+	FString					SessionToken;
+
+	/** When we last noticed the connection drop */
+	double					LastDisconnectTime = 0;
+
 	TArray<TSharedPtr<IRemoteSessionChannel>> Channels;
+
+	/** Channels by type, for lookup */
+	TMap<FName, TSharedPtr<IRemoteSessionChannel>> ChannelsById;
+
+	/** Channel types the other end has asked us to open, waiting for the game thread */
+	FCriticalSection		ChannelRequestMutex;
+	TArray<FName>			PendingChannelRequests;
 	
 	FThreadSafeBool			ThreadExitRequested;
 	FThreadSafeBool			ThreadRunning;
 
+	FRunnableThread*		BackgroundThread = nullptr;
+
+	/** Triggered when the connection changes or the thread should exit */
+	FEvent*					ConnectionChangedEvent = nullptr;
+
 };
\ No newline at end of file
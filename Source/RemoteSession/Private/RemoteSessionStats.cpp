@@ -0,0 +1,23 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionStats.h"
+
+DEFINE_STAT(STAT_RSBytesSent);
+DEFINE_STAT(STAT_RSBytesReceived);
+DEFINE_STAT(STAT_RSMessagesSent);
+DEFINE_STAT(STAT_RSMessagesReceived);
+DEFINE_STAT(STAT_RSMessagesDropped);
+
+DEFINE_STAT(STAT_RSSendQueueBytes);
+DEFINE_STAT(STAT_RSSendQueuePackets);
+
+DEFINE_STAT(STAT_RSFramesCaptured);
+DEFINE_STAT(STAT_RSFramesEncoded);
+DEFINE_STAT(STAT_RSFramesReceived);
+DEFINE_STAT(STAT_RSFramesDecoded);
+DEFINE_STAT(STAT_RSFramesUploaded);
+DEFINE_STAT(STAT_RSFramesDropped);
+DEFINE_STAT(STAT_RSDecodeQueue);
+
+DEFINE_STAT(STAT_RSReceiveBuffersInUse);
+DEFINE_STAT(STAT_RSReceiveBufferMemory);
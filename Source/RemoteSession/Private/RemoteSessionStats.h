@@ -0,0 +1,33 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+/* Everything RemoteSession measures, shown with "stat remotesession" */
+DECLARE_STATS_GROUP(TEXT("RemoteSession"), STATGROUP_RemoteSession, STATCAT_Advanced);
+
+/* Traffic on all connections. Counters reset each frame so these read as per-frame throughput */
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes Sent"), STAT_RSBytesSent, STATGROUP_RemoteSession, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes Received"), STAT_RSBytesReceived, STATGROUP_RemoteSession, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Messages Sent"), STAT_RSMessagesSent, STATGROUP_RemoteSession, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Messages Received"), STAT_RSMessagesReceived, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Messages Dropped"), STAT_RSMessagesDropped, STATGROUP_RemoteSession, );
+
+/* Bytes and packets waiting on the send thread */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Send Queue Bytes"), STAT_RSSendQueueBytes, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Send Queue Packets"), STAT_RSSendQueuePackets, STATGROUP_RemoteSession, );
+
+/* Totals for the framebuffer channel */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Captured"), STAT_RSFramesCaptured, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Encoded"), STAT_RSFramesEncoded, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Received"), STAT_RSFramesReceived, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Decoded"), STAT_RSFramesDecoded, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Uploaded"), STAT_RSFramesUploaded, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frames Dropped"), STAT_RSFramesDropped, STATGROUP_RemoteSession, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Decode Queue"), STAT_RSDecodeQueue, STATGROUP_RemoteSession, );
+
+/* Receive buffers handed out by pools, and the memory every pool holds */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Receive Buffers In Use"), STAT_RSReceiveBuffersInUse, STATGROUP_RemoteSession, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Receive Buffer Memory"), STAT_RSReceiveBufferMemory, STATGROUP_RemoteSession, );
@@ -0,0 +1,33 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionTrace.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 TraceFrameStages = 0;
+static FAutoConsoleVariableRef CVarTraceFrameStages(
+	TEXT("remote.trace"), TraceFrameStages,
+	TEXT("Emits a named event for each stage of every frame (capture, encode, send, decode, upload), tagged with the frame index"),
+	ECVF_Default);
+
+FRemoteSessionTraceScope::FRemoteSessionTraceScope(const TCHAR* InStage, int32 InImageIndex)
+{
+	bEmitted = IsEnabled();
+
+	if (bEmitted)
+	{
+		FPlatformMisc::BeginNamedEvent(FColor::Cyan, *FString::Printf(TEXT("RS %s %d"), InStage, InImageIndex));
+	}
+}
+
+FRemoteSessionTraceScope::~FRemoteSessionTraceScope()
+{
+	if (bEmitted)
+	{
+		FPlatformMisc::EndNamedEvent();
+	}
+}
+
+bool FRemoteSessionTraceScope::IsEnabled()
+{
+	return TraceFrameStages != 0;
+}
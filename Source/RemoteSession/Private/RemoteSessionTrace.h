@@ -0,0 +1,28 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+	Emits a named event for one stage of a frame, e.g. "RS Encode 1234", while remote.trace is set. The events show up in
+	platform profilers (PIX, Razor, etc) and stat captures with named events enabled, so a hitch can be traced to a stage
+	of a particular frame.
+*/
+class FRemoteSessionTraceScope
+{
+public:
+
+	FRemoteSessionTraceScope(const TCHAR* InStage, int32 InImageIndex);
+
+	~FRemoteSessionTraceScope();
+
+	/** True while remote.trace is set */
+	static bool IsEnabled();
+
+protected:
+
+	bool	bEmitted;
+};
+
+#define SCOPE_REMOTESESSION_TRACE(Stage, ImageIndex) FRemoteSessionTraceScope ANONYMOUS_VARIABLE(RemoteSessionTrace)(TEXT(Stage), ImageIndex)
@@ -0,0 +1,293 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionCapture.h"
+#include "RemoteSession.h"
+#include "Transport/RemoteSessionSender.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/Archive.h"
+
+static_assert(sizeof(FRemoteSessionCaptureHeader) == 32, "Capture header layout is part of the file format");
+static_assert(sizeof(FRemoteSessionCaptureRecord) == 16, "Capture record layout is part of the file format");
+
+/* Records and their data are 8-byte aligned so they can be read in place from a mapping */
+static const int32 kCaptureAlignment = 8;
+
+TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> FRemoteSessionCaptureWriter::Create(const FString& Filename, bool bRecordedByHost)
+{
+	FArchive* Archive = IFileManager::Get().CreateFileWriter(*Filename);
+
+	if (Archive == nullptr)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Failed to create capture file %s"), *Filename);
+		return nullptr;
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Capturing session to %s"), *Filename);
+
+	return MakeShareable(new FRemoteSessionCaptureWriter(Filename, Archive, bRecordedByHost));
+}
+
+FRemoteSessionCaptureWriter::FRemoteSessionCaptureWriter(const FString& InFilename, FArchive* InArchive, bool bRecordedByHost)
+	: Filename(InFilename)
+	, Archive(InArchive)
+{
+	Header.Flags = bRecordedByHost ? FRemoteSessionCaptureHeader::kFlagRecordedByHost : 0;
+	Header.StartTime = FDateTime::UtcNow().ToUnixTimestamp();
+
+	Archive->Serialize(&Header, sizeof(Header));
+
+	StartTime = FPlatformTime::Seconds();
+}
+
+FRemoteSessionCaptureWriter::~FRemoteSessionCaptureWriter()
+{
+	Close();
+}
+
+void FRemoteSessionCaptureWriter::BeginRecord(ERemoteSessionCaptureDirection Direction, int32 Size)
+{
+	FRemoteSessionCaptureRecord Record;
+	Record.Time = FPlatformTime::Seconds() - StartTime;
+	Record.Size = Size;
+	Record.Direction = Direction;
+
+	RecordOffsets.Add(Archive->Tell());
+	Archive->Serialize(&Record, sizeof(Record));
+}
+
+void FRemoteSessionCaptureWriter::EndRecord(int32 Size)
+{
+	uint8 Padding[kCaptureAlignment] = { 0 };
+	Archive->Serialize(Padding, Align(Size, kCaptureAlignment) - Size);
+}
+
+void FRemoteSessionCaptureWriter::Record(ERemoteSessionCaptureDirection Direction, const uint8* Data, int32 Size)
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive == nullptr)
+	{
+		return;
+	}
+
+	BeginRecord(Direction, Size);
+	Archive->Serialize(const_cast<uint8*>(Data), Size);
+	EndRecord(Size);
+}
+
+void FRemoteSessionCaptureWriter::Record(ERemoteSessionCaptureDirection Direction, const FRemoteSessionOutgoingPacket& Packet)
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive == nullptr)
+	{
+		return;
+	}
+
+	const int32 Size = Packet.GetSize();
+
+	BeginRecord(Direction, Size);
+
+	Archive->Serialize(const_cast<uint8*>(Packet.Header.GetData()), Packet.Header.Num());
+
+	if (Packet.Payload.IsValid())
+	{
+		Archive->Serialize(Packet.Payload->GetData(), Packet.Payload->Num());
+	}
+
+	Archive->Serialize(const_cast<uint8*>(Packet.Trailer.GetData()), Packet.Trailer.Num());
+
+	EndRecord(Size);
+}
+
+void FRemoteSessionCaptureWriter::Close()
+{
+	FScopeLock Lock(&Mutex);
+
+	if (Archive == nullptr)
+	{
+		return;
+	}
+
+	// index goes on the end, then patch the header to point at it
+	Header.NumRecords = RecordOffsets.Num();
+	Header.IndexOffset = Archive->Tell();
+
+	Archive->Serialize(RecordOffsets.GetData(), RecordOffsets.Num() * sizeof(int64));
+
+	Archive->Seek(0);
+	Archive->Serialize(&Header, sizeof(Header));
+
+	Archive->Close();
+	delete Archive;
+	Archive = nullptr;
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Captured %d packets over %.02f seconds to %s"), RecordOffsets.Num(), FPlatformTime::Seconds() - StartTime, *Filename);
+}
+
+FRemoteSessionCaptureReader::FRemoteSessionCaptureReader()
+	: Data(nullptr)
+	, DataSize(0)
+{
+}
+
+FRemoteSessionCaptureReader::~FRemoteSessionCaptureReader()
+{
+	// region has to go before the file it maps
+	MappedRegion = nullptr;
+	MappedHandle = nullptr;
+}
+
+bool FRemoteSessionCaptureReader::Open(const FString& InFilename)
+{
+	Filename = InFilename;
+
+	MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+
+	if (MappedHandle.IsValid())
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion());
+	}
+
+	if (MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedHandle = nullptr;
+
+		if (FFileHelper::LoadFileToArray(LoadedData, *Filename) == false)
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Failed to open capture file %s"), *Filename);
+			return false;
+		}
+
+		Data = LoadedData.GetData();
+		DataSize = LoadedData.Num();
+	}
+
+	if (DataSize < (int64)sizeof(Header))
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("%s is too small to be a capture"), *Filename);
+		return false;
+	}
+
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	if (Header.Magic != FRemoteSessionCaptureHeader::kMagic || Header.Version != FRemoteSessionCaptureHeader::kVersion)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("%s is not a version %d capture"), *Filename, FRemoteSessionCaptureHeader::kVersion);
+		return false;
+	}
+
+	const int64 IndexSize = (int64)Header.NumRecords * sizeof(int64);
+
+	if (Header.IndexOffset > 0 && Header.IndexOffset + IndexSize <= DataSize)
+	{
+		RecordOffsets.SetNumUninitialized(Header.NumRecords);
+		FMemory::Memcpy(RecordOffsets.GetData(), Data + Header.IndexOffset, IndexSize);
+
+		// records are read straight from the file, so every one has to be inside it
+		for (int64 Offset : RecordOffsets)
+		{
+			if (IsRecordInBounds(Offset) == false)
+			{
+				UE_LOG(LogRemoteSession, Warning, TEXT("%s has a corrupt index, rebuilding it"), *Filename);
+				RebuildIndex();
+				break;
+			}
+		}
+	}
+	else
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("%s was not closed, rebuilding its index"), *Filename);
+		RebuildIndex();
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Opened %s (%s), %d packets over %.02f seconds"), *Filename,
+		WasRecordedByHost() ? TEXT("host") : TEXT("client"), RecordOffsets.Num(), GetDuration());
+
+	return true;
+}
+
+void FRemoteSessionCaptureReader::RebuildIndex()
+{
+	RecordOffsets.Reset();
+
+	int64 Offset = sizeof(Header);
+
+	while (Offset + (int64)sizeof(FRemoteSessionCaptureRecord) <= DataSize)
+	{
+		// the last record may have been cut off
+		if (IsRecordInBounds(Offset) == false)
+		{
+			break;
+		}
+
+		const FRemoteSessionCaptureRecord* Record = (const FRemoteSessionCaptureRecord*)(Data + Offset);
+		const int64 NextOffset = FMath::Min<int64>(Offset + sizeof(FRemoteSessionCaptureRecord) + Align(Record->Size, kCaptureAlignment), DataSize);
+
+		RecordOffsets.Add(Offset);
+		Offset = NextOffset;
+	}
+}
+
+bool FRemoteSessionCaptureReader::IsRecordInBounds(int64 Offset) const
+{
+	if (Offset < (int64)sizeof(FRemoteSessionCaptureHeader) || Offset + (int64)sizeof(FRemoteSessionCaptureRecord) > DataSize)
+	{
+		return false;
+	}
+
+	const FRemoteSessionCaptureRecord* Record = (const FRemoteSessionCaptureRecord*)(Data + Offset);
+
+	// the padding after the last record may not have been written
+	return Record->Size >= 0 && Offset + (int64)sizeof(FRemoteSessionCaptureRecord) + Record->Size <= DataSize;
+}
+
+const FRemoteSessionCaptureRecord& FRemoteSessionCaptureReader::GetRecord(int32 Index, const uint8*& OutData) const
+{
+	// Open only keeps records that are in bounds
+	checkf(IsRecordInBounds(RecordOffsets[Index]), TEXT("Capture record %d is outside %s"), Index, *Filename);
+
+	const uint8* RecordStart = Data + RecordOffsets[Index];
+	OutData = RecordStart + sizeof(FRemoteSessionCaptureRecord);
+	return *(const FRemoteSessionCaptureRecord*)RecordStart;
+}
+
+int32 FRemoteSessionCaptureReader::FindRecord(double Time) const
+{
+	const uint8* Unused = nullptr;
+
+	// records are appended as they happen so times only go up
+	int32 First = 0;
+	int32 Count = RecordOffsets.Num();
+
+	while (Count > 0)
+	{
+		const int32 Step = Count / 2;
+		const int32 Middle = First + Step;
+
+		if (GetRecord(Middle, Unused).Time < Time)
+		{
+			First = Middle + 1;
+			Count -= Step + 1;
+		}
+		else
+		{
+			Count = Step;
+		}
+	}
+
+	return First;
+}
+
+double FRemoteSessionCaptureReader::GetDuration() const
+{
+	const uint8* Unused = nullptr;
+	return RecordOffsets.Num() > 0 ? GetRecord(RecordOffsets.Num() - 1, Unused).Time : 0;
+}
@@ -0,0 +1,156 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FArchive;
+class IMappedFileHandle;
+class IMappedFileRegion;
+struct FRemoteSessionOutgoingPacket;
+
+/* Which way a captured packet went, from the point of view of the end that recorded it */
+enum class ERemoteSessionCaptureDirection : uint8
+{
+	Sent,
+	Received,
+};
+
+/*
+	Capture files hold every packet one end of a session sent and received, exactly as they were on the wire (after
+	compression, without the size prefix). The layout is
+
+		FRemoteSessionCaptureHeader
+		FRemoteSessionCaptureRecord + data, padded to 8 bytes		(repeated, appended as packets go by)
+		int64 record offsets										(written when the capture is closed)
+
+	so a file can be mapped and read in place. If the process dies before the index is written the reader rebuilds
+	it by walking the records.
+*/
+struct FRemoteSessionCaptureHeader
+{
+	static const uint32 kMagic = 0x50435352;	// RSCP
+	static const uint32 kVersion = 1;
+
+	/** Set in Flags if the host made the capture */
+	static const uint32 kFlagRecordedByHost = 1;
+
+	uint32	Magic = kMagic;
+	uint32	Version = kVersion;
+	uint32	Flags = 0;
+	uint32	NumRecords = 0;
+
+	/** Where the index starts, or 0 if the capture wasn't closed */
+	int64	IndexOffset = 0;
+
+	/** When capturing started, as a unix timestamp */
+	int64	StartTime = 0;
+};
+
+struct FRemoteSessionCaptureRecord
+{
+	/** Seconds since capturing started */
+	double	Time = 0;
+	int32	Size = 0;
+	ERemoteSessionCaptureDirection	Direction = ERemoteSessionCaptureDirection::Sent;
+	uint8	Padding[3] = { 0, 0, 0 };
+};
+
+/* Appends packets to a capture file. Safe to call from the send and receive threads at once */
+class FRemoteSessionCaptureWriter
+{
+public:
+
+	~FRemoteSessionCaptureWriter();
+
+	/** Creates Filename and writes the header. Returns null if the file couldn't be created */
+	static TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> Create(const FString& Filename, bool bRecordedByHost);
+
+	void Record(ERemoteSessionCaptureDirection Direction, const uint8* Data, int32 Size);
+
+	/** Records a packet that's in pieces, as one record */
+	void Record(ERemoteSessionCaptureDirection Direction, const FRemoteSessionOutgoingPacket& Packet);
+
+	/** Writes the index and closes the file. Nothing is recorded after this */
+	void Close();
+
+	const FString& GetFilename() const { return Filename; }
+
+protected:
+
+	FRemoteSessionCaptureWriter(const FString& InFilename, FArchive* InArchive, bool bRecordedByHost);
+
+	/** Writes the record header for Size bytes of data. Mutex must be held */
+	void BeginRecord(ERemoteSessionCaptureDirection Direction, int32 Size);
+
+	/** Pads the data written since BeginRecord. Mutex must be held */
+	void EndRecord(int32 Size);
+
+	FCriticalSection				Mutex;
+	FString							Filename;
+	FArchive*						Archive;
+	FRemoteSessionCaptureHeader		Header;
+	TArray<int64>					RecordOffsets;
+	double							StartTime;
+};
+
+/* Reads a capture file, mapped into memory if the platform allows */
+class FRemoteSessionCaptureReader
+{
+public:
+
+	FRemoteSessionCaptureReader();
+
+	~FRemoteSessionCaptureReader();
+
+	/** Opens Filename and reads (or rebuilds) its index. Returns false if it isn't a capture */
+	bool Open(const FString& Filename);
+
+	int32 GetNumRecords() const { return RecordOffsets.Num(); }
+
+	/** The header of record Index. Data is valid for as long as we are */
+	const FRemoteSessionCaptureRecord& GetRecord(int32 Index, const uint8*& OutData) const;
+
+	/** Index of the first record at or after Time, or GetNumRecords() if there isn't one */
+	int32 FindRecord(double Time) const;
+
+	/** Time of the last record */
+	double GetDuration() const;
+
+	bool WasRecordedByHost() const { return (Header.Flags & FRemoteSessionCaptureHeader::kFlagRecordedByHost) != 0; }
+
+	/** Which records hold what a host sent to its client, whichever end made the capture */
+	ERemoteSessionCaptureDirection GetHostToClientDirection() const
+	{
+		return WasRecordedByHost() ? ERemoteSessionCaptureDirection::Sent : ERemoteSessionCaptureDirection::Received;
+	}
+
+	ERemoteSessionCaptureDirection GetClientToHostDirection() const
+	{
+		return WasRecordedByHost() ? ERemoteSessionCaptureDirection::Received : ERemoteSessionCaptureDirection::Sent;
+	}
+
+	const FString& GetFilename() const { return Filename; }
+
+protected:
+
+	/** Walks the records to find where each one starts, for captures that were never closed */
+	void RebuildIndex();
+
+	/** True if the record at Offset and its data are inside the file */
+	bool IsRecordInBounds(int64 Offset) const;
+
+	FString								Filename;
+
+	TUniquePtr<IMappedFileHandle>		MappedHandle;
+	TUniquePtr<IMappedFileRegion>		MappedRegion;
+
+	/** Used instead of a mapping on platforms that can't map files */
+	TArray<uint8>						LoadedData;
+
+	const uint8*						Data;
+	int64								DataSize;
+
+	FRemoteSessionCaptureHeader			Header;
+	TArray<int64>						RecordOffsets;
+};
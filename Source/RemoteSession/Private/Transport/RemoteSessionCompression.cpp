@@ -0,0 +1,179 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionCompression.h"
+#include "RemoteSession.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/Crc.h"
+#include "BackChannel/Protocol/OSC/BackChannelOSCMessage.h"
+#include "zlib.h"
+
+const TCHAR* FRemoteSessionMessageCompressor::Address = TEXT("/Z");
+
+/* Raw deflate (no zlib header or checksum) since our packets are tiny and already framed */
+static const int32 kDeflateWindowBits = -15;
+
+FRemoteSessionMessageCompressor::FRemoteSessionMessageCompressor(int32 InThreshold, const FString& DictionaryFile)
+	: DictionaryId(0)
+	, Threshold(FMath::Max(InThreshold, 1))
+{
+	if (DictionaryFile.Len())
+	{
+		const FString Path = FPaths::IsRelative(DictionaryFile) ? FPaths::Combine(FPaths::ProjectDir(), DictionaryFile) : DictionaryFile;
+
+		if (FFileHelper::LoadFileToArray(Dictionary, *Path) == false)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Failed to load compression dictionary %s, using the default"), *Path);
+		}
+	}
+
+	if (Dictionary.Num() == 0)
+	{
+		Dictionary = BuildDefaultDictionary();
+	}
+
+	DictionaryId = FCrc::MemCrc32(Dictionary.GetData(), Dictionary.Num());
+}
+
+TArray<uint8> FRemoteSessionMessageCompressor::BuildDefaultDictionary()
+{
+	// deflate favors matches near the end of the dictionary, so the most frequent messages are last
+	static const TCHAR* MessageNames[] = {
+		TEXT("OnKeyChar"), TEXT("OnKeyDown"), TEXT("OnKeyUp"),
+		TEXT("OnMouseDoubleClick"), TEXT("OnMouseWheel"), TEXT("OnMouseDown"), TEXT("OnMouseUp"),
+		TEXT("OnControllerButtonPressed"), TEXT("OnControllerButtonReleased"),
+		TEXT("OnBeginGesture"), TEXT("OnEndGesture"), TEXT("OnTouchGesture"),
+		TEXT("OnTouchStarted"), TEXT("OnTouchEnded"),
+		TEXT("OnRawMouseMove"), TEXT("OnMouseMove"),
+		TEXT("OnControllerAnalog"), TEXT("OnMotionDetected"), TEXT("OnTouchMoved"),
+	};
+
+	// analog messages carry the axis name as a string
+	static const TCHAR* AxisNames[] = {
+		TEXT("Gamepad_LeftTriggerAxis"), TEXT("Gamepad_RightTriggerAxis"),
+		TEXT("Gamepad_RightX"), TEXT("Gamepad_RightY"), TEXT("Gamepad_LeftX"), TEXT("Gamepad_LeftY"),
+	};
+
+	TArray<uint8> Result;
+
+	auto AppendPadded = [&Result](const FString& Value)
+	{
+		FTCHARToUTF8 Converted(*Value);
+		Result.Append((const uint8*)Converted.Get(), Converted.Length());
+		Result.AddZeroed(Align(Converted.Length() + 1, 4) - Converted.Length());
+	};
+
+	for (const TCHAR* Axis : AxisNames)
+	{
+		AppendPadded(Axis);
+	}
+
+	for (const TCHAR* Name : MessageNames)
+	{
+		// address and type tags exactly as FRemoteSessionInputChannel writes them
+		AppendPadded(FString::Printf(TEXT("/MessageHandler/%s"), Name));
+		AppendPadded(TEXT(",b"));
+	}
+
+	return Result;
+}
+
+FString FRemoteSessionMessageCompressor::GetDescription() const
+{
+	return FString::Printf(TEXT("zlib:%u"), DictionaryId);
+}
+
+bool FRemoteSessionMessageCompressor::Compress(const TArray<uint8>& Packet, TArray<uint8>& OutPacket) const
+{
+	if (Packet.Num() < Threshold)
+	{
+		return false;
+	}
+
+	z_stream Stream;
+	FMemory::Memzero(Stream);
+
+	if (deflateInit2(&Stream, Z_BEST_SPEED, Z_DEFLATED, kDeflateWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	deflateSetDictionary(&Stream, Dictionary.GetData(), Dictionary.Num());
+
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(deflateBound(&Stream, Packet.Num()));
+
+	Stream.next_in = (Bytef*)Packet.GetData();
+	Stream.avail_in = Packet.Num();
+	Stream.next_out = Compressed.GetData();
+	Stream.avail_out = Compressed.Num();
+
+	const int32 Result = deflate(&Stream, Z_FINISH);
+	const int32 CompressedSize = Stream.total_out;
+	deflateEnd(&Stream);
+
+	if (Result != Z_STREAM_END)
+	{
+		return false;
+	}
+
+	Compressed.SetNum(CompressedSize, false);
+
+	FBackChannelOSCMessage Msg(Address);
+	Msg.Write(Packet.Num());
+	Msg.Write(Compressed);
+
+	OutPacket = Msg.WriteToBuffer();
+
+	// the wrapper costs a few bytes so tiny gains aren't gains
+	return OutPacket.Num() < Packet.Num();
+}
+
+bool FRemoteSessionMessageCompressor::Decompress(FRemoteSessionReceivedMessage& Message, FRemoteSessionBufferPool& Pool, FRemoteSessionPooledBufferPtr& OutBuffer, int32& OutSize) const
+{
+	int32 UncompressedSize = 0;
+	FRemoteSessionBlobView CompressedData;
+
+	if (!Message.Read(UncompressedSize) || !Message.Read(CompressedData) || UncompressedSize <= 0)
+	{
+		return false;
+	}
+
+	// the size comes from the peer, so don't allocate more than we'd accept uncompressed
+	if (UncompressedSize > FRemoteSessionReceiver::kMaxPacketSize)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Compressed packet claims to be %d bytes, dropping it"), UncompressedSize);
+		return false;
+	}
+
+	z_stream Stream;
+	FMemory::Memzero(Stream);
+
+	if (inflateInit2(&Stream, kDeflateWindowBits) != Z_OK)
+	{
+		return false;
+	}
+
+	// raw streams take the dictionary up front rather than asking for it
+	inflateSetDictionary(&Stream, Dictionary.GetData(), Dictionary.Num());
+
+	OutBuffer = Pool.Acquire(UncompressedSize);
+
+	Stream.next_in = (Bytef*)CompressedData.GetData();
+	Stream.avail_in = CompressedData.Num();
+	Stream.next_out = OutBuffer->GetData();
+	Stream.avail_out = UncompressedSize;
+
+	const int32 Result = inflate(&Stream, Z_FINISH);
+	OutSize = Stream.total_out;
+	inflateEnd(&Stream);
+
+	if (Result != Z_STREAM_END || OutSize != UncompressedSize)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Failed to decompress packet (%d), dictionaries may not match"), Result);
+		OutBuffer = nullptr;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,45 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Transport/RemoteSessionReceiver.h"
+
+/*
+	Compresses small, repetitive OSC packets (input, control, telemetry) with deflate and a preset dictionary.
+
+	A compressed packet is sent as an OSC message to Address with the original size and the deflated packet as
+	a blob, so it passes through the same framing and dispatch as anything else. Both ends must use the same
+	dictionary, which is why its id is exchanged in the handshake before compression is turned on.
+*/
+class FRemoteSessionMessageCompressor
+{
+public:
+
+	/** Address compressed packets are sent to */
+	static const TCHAR* Address;
+
+	/** Uses the built-in dictionary, or the contents of DictionaryFile if it's set and can be loaded */
+	FRemoteSessionMessageCompressor(int32 InThreshold, const FString& DictionaryFile = FString());
+
+	/** Identifies the dictionary, peers must agree on this before sending compressed packets */
+	uint32 GetDictionaryId() const { return DictionaryId; }
+
+	/** Returns "zlib:<dictionary id>", what we advertise in the handshake */
+	FString GetDescription() const;
+
+	/** Writes a compressed version of Packet to OutPacket. Returns false if Packet is too small or didn't get smaller */
+	bool Compress(const TArray<uint8>& Packet, TArray<uint8>& OutPacket) const;
+
+	/** Inflates a message sent to Address into a pooled buffer */
+	bool Decompress(FRemoteSessionReceivedMessage& Message, FRemoteSessionBufferPool& Pool, FRemoteSessionPooledBufferPtr& OutBuffer, int32& OutSize) const;
+
+protected:
+
+	/** A dictionary of the OSC addresses and type tags our input messages start with */
+	static TArray<uint8> BuildDefaultDictionary();
+
+	TArray<uint8>		Dictionary;
+	uint32				DictionaryId;
+	int32				Threshold;
+};
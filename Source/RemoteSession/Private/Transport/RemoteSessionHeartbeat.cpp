@@ -0,0 +1,149 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionHeartbeat.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+#include "Protocol/OSC/BackChannelOSCMessage.h"
+
+const TCHAR* FRemoteSessionHeartbeat::PingAddress = TEXT("/Ping");
+const TCHAR* FRemoteSessionHeartbeat::PongAddress = TEXT("/Pong");
+const TCHAR* FRemoteSessionHeartbeat::ChannelName = TEXT("rs.heartbeat");
+
+/* Weights for the smoothed RTT and jitter, from RFC 6298 and RFC 3550 */
+static const float kRoundTripGain = 1.0f / 8.0f;
+static const float kJitterGain = 1.0f / 16.0f;
+
+FRemoteSessionHeartbeat::FRemoteSessionHeartbeat(TSharedRef<FRemoteSessionSender, ESPMode::ThreadSafe> InSender, int32 InIntervalMS, int32 InTimeoutMS)
+	: Sender(InSender)
+	, IntervalSeconds(InIntervalMS / 1000.0)
+	, TimeoutSeconds(InTimeoutMS / 1000.0)
+	, StartTime(FPlatformTime::Seconds())
+	, LastPingTime(0)
+	, NextSequence(0)
+	, LastReceiveTime(0)
+	, LastTickTime(0)
+	, bPeerResponds(false)
+{
+}
+
+void FRemoteSessionHeartbeat::Bind(FRemoteSessionReceiver& Receiver)
+{
+	Receiver.BindHandler(PingAddress, FRemoteSessionMessageHandler::CreateRaw(this, &FRemoteSessionHeartbeat::OnPing));
+	Receiver.BindHandler(PongAddress, FRemoteSessionMessageHandler::CreateRaw(this, &FRemoteSessionHeartbeat::OnPong));
+}
+
+uint32 FRemoteSessionHeartbeat::GetTimestamp(double Now) const
+{
+	return (uint32)(uint64)((Now - StartTime) * 1000000.0);
+}
+
+void FRemoteSessionHeartbeat::Tick(double Now, double InLastReceiveTime)
+{
+	{
+		FScopeLock Lock(&StatsMutex);
+		LastReceiveTime = InLastReceiveTime;
+		LastTickTime = Now;
+	}
+
+	if (IntervalSeconds <= 0 || Now - LastPingTime < IntervalSeconds)
+	{
+		return;
+	}
+
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> LocalSender = Sender.Pin();
+
+	if (LocalSender.IsValid())
+	{
+		FBackChannelOSCMessage Msg(PingAddress);
+		Msg.Write(NextSequence++);
+		Msg.Write((int32)GetTimestamp(Now));
+		LocalSender->SendPacket(Msg, ChannelName);
+
+		FScopeLock Lock(&StatsMutex);
+		Stats.PingsSent++;
+	}
+
+	LastPingTime = Now;
+}
+
+double FRemoteSessionHeartbeat::GetTimeUntilNextPing(double Now) const
+{
+	if (IntervalSeconds <= 0)
+	{
+		return DBL_MAX;
+	}
+
+	return FMath::Max(0.0, LastPingTime + IntervalSeconds - Now);
+}
+
+bool FRemoteSessionHeartbeat::IsLinkDead() const
+{
+	FScopeLock Lock(&StatsMutex);
+
+	// peers that don't answer pings (older versions, or heartbeats turned off) are left to the socket
+	return bPeerResponds && TimeoutSeconds > 0 && LastTickTime - LastReceiveTime > TimeoutSeconds;
+}
+
+FRemoteSessionLinkStats FRemoteSessionHeartbeat::GetStats() const
+{
+	FScopeLock Lock(&StatsMutex);
+
+	FRemoteSessionLinkStats Result = Stats;
+	Result.TimeSinceLastReceiveMS = LastReceiveTime > 0 ? (float)((FPlatformTime::Seconds() - LastReceiveTime) * 1000.0) : 0.0f;
+	return Result;
+}
+
+void FRemoteSessionHeartbeat::OnPing(FRemoteSessionReceivedMessage& Message)
+{
+	int32 Sequence = 0;
+	int32 Timestamp = 0;
+
+	if (Message.Read(Sequence) == false || Message.Read(Timestamp) == false)
+	{
+		return;
+	}
+
+	TSharedPtr<FRemoteSessionSender, ESPMode::ThreadSafe> LocalSender = Sender.Pin();
+
+	if (LocalSender.IsValid())
+	{
+		// echo back as-is, the timestamp only means something to whoever sent it
+		FBackChannelOSCMessage Msg(PongAddress);
+		Msg.Write(Sequence);
+		Msg.Write(Timestamp);
+		LocalSender->SendPacket(Msg, ChannelName);
+	}
+}
+
+void FRemoteSessionHeartbeat::OnPong(FRemoteSessionReceivedMessage& Message)
+{
+	int32 Sequence = 0;
+	int32 Timestamp = 0;
+
+	if (Message.Read(Sequence) == false || Message.Read(Timestamp) == false)
+	{
+		return;
+	}
+
+	// unsigned subtraction handles the timestamp wrapping
+	const uint32 ElapsedMicroseconds = GetTimestamp(FPlatformTime::Seconds()) - (uint32)Timestamp;
+	const float Sample = ElapsedMicroseconds / 1000.0f;
+
+	FScopeLock Lock(&StatsMutex);
+
+	if (Stats.PongsReceived == 0)
+	{
+		Stats.RoundTripMS = Sample;
+		Stats.JitterMS = 0;
+	}
+	else
+	{
+		Stats.JitterMS += (FMath::Abs(Sample - Stats.LastRoundTripMS) - Stats.JitterMS) * kJitterGain;
+		Stats.RoundTripMS += (Sample - Stats.RoundTripMS) * kRoundTripGain;
+	}
+
+	Stats.LastRoundTripMS = Sample;
+	Stats.PongsReceived++;
+	Stats.bHasSamples = true;
+	bPeerResponds = true;
+}
@@ -0,0 +1,67 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RemoteSession/RemoteSessionRole.h"
+
+class FRemoteSessionSender;
+class FRemoteSessionReceiver;
+class FRemoteSessionReceivedMessage;
+
+/*
+	Pings the other end at a fixed interval and answers its pings, all from the receive thread so a busy game
+	thread on either end doesn't show up as latency.
+
+	Each pong gives a round trip sample which is smoothed into RTT and jitter estimates the same way RFC 6298
+	and RFC 3550 do. Once the peer has answered at least once, going longer than the timeout without receiving
+	anything means the link is dead.
+*/
+class FRemoteSessionHeartbeat
+{
+public:
+
+	static const TCHAR* PingAddress;
+	static const TCHAR* PongAddress;
+
+	/** Messages are sent on behalf of this channel so the scheduler can prioritize them */
+	static const TCHAR* ChannelName;
+
+	FRemoteSessionHeartbeat(TSharedRef<FRemoteSessionSender, ESPMode::ThreadSafe> InSender, int32 InIntervalMS, int32 InTimeoutMS);
+
+	/** Registers for pings and pongs on Receiver */
+	void Bind(FRemoteSessionReceiver& Receiver);
+
+	/** Sends a ping if one is due. LastReceiveTime is when anything last arrived from the peer */
+	void Tick(double Now, double LastReceiveTime);
+
+	/** True if the peer answers pings and hasn't been heard from within the timeout */
+	bool IsLinkDead() const;
+
+	/** Seconds until the next ping is due, used to decide how long the receive thread can sleep */
+	double GetTimeUntilNextPing(double Now) const;
+
+	FRemoteSessionLinkStats GetStats() const;
+
+protected:
+
+	void OnPing(FRemoteSessionReceivedMessage& Message);
+	void OnPong(FRemoteSessionReceivedMessage& Message);
+
+	/** Microseconds since we were created, wraps after ~71 minutes which is fine for differences */
+	uint32 GetTimestamp(double Now) const;
+
+	TWeakPtr<FRemoteSessionSender, ESPMode::ThreadSafe> Sender;
+
+	double		IntervalSeconds;
+	double		TimeoutSeconds;
+	double		StartTime;
+	double		LastPingTime;
+	int32		NextSequence;
+
+	mutable FCriticalSection	StatsMutex;
+	FRemoteSessionLinkStats		Stats;
+	double						LastReceiveTime;
+	double						LastTickTime;
+	bool						bPeerResponds;
+};
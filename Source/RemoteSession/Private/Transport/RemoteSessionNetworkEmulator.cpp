@@ -0,0 +1,446 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionNetworkEmulator.h"
+#include "RemoteSession.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Dom/JsonObject.h"
+
+static int32 GRemoteSessionNetLatencyMS = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionNetLatency(
+	TEXT("remote.net.latency"), GRemoteSessionNetLatencyMS,
+	TEXT("Milliseconds of latency added to everything sent"),
+	ECVF_Default);
+
+static int32 GRemoteSessionNetJitterMS = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionNetJitter(
+	TEXT("remote.net.jitter"), GRemoteSessionNetJitterMS,
+	TEXT("Milliseconds the added latency varies by either way"),
+	ECVF_Default);
+
+static int32 GRemoteSessionNetBandwidthKbps = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionNetBandwidth(
+	TEXT("remote.net.bandwidth"), GRemoteSessionNetBandwidthKbps,
+	TEXT("Emulated link speed in kbps, 0 for no cap"),
+	ECVF_Default);
+
+static float GRemoteSessionNetLossPercent = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionNetLoss(
+	TEXT("remote.net.loss"), GRemoteSessionNetLossPercent,
+	TEXT("Percentage of packets lost. Over TCP these are delayed by a retransmit instead"),
+	ECVF_Default);
+
+static float GRemoteSessionNetReorderPercent = 0;
+static FAutoConsoleVariableRef CVarRemoteSessionNetReorder(
+	TEXT("remote.net.reorder"), GRemoteSessionNetReorderPercent,
+	TEXT("Percentage of UDP frame datagrams that arrive after ones sent later"),
+	ECVF_Default);
+
+/* How much a stream can have waiting before Push blocks. Roughly a socket send buffer */
+static const int32 kMaxQueuedStreamBytes = 256 * 1024;
+
+/* How much datagrams can have waiting before more are dropped. Roughly a router's queue */
+static const int32 kMaxQueuedDatagramBytes = 1024 * 1024;
+
+/* Shortest time TCP waits before resending a lost packet */
+static const double kMinRetransmitSeconds = 0.2;
+
+struct FRemoteSessionNetworkPreset
+{
+	const TCHAR*	Name;
+	int32			LatencyMS;
+	int32			JitterMS;
+	int32			BandwidthKbps;
+	float			LossPercent;
+	float			ReorderPercent;
+};
+
+static const FRemoteSessionNetworkPreset GRemoteSessionNetworkPresets[] =
+{
+	{ TEXT("off"),			0,		0,		0,		0.0f,	0.0f },
+	{ TEXT("lan"),			1,		0,		0,		0.0f,	0.0f },
+	{ TEXT("wifi"),			5,		5,		50000,	0.1f,	0.0f },
+	{ TEXT("hotelwifi"),	60,		40,		3000,	2.0f,	1.0f },
+	{ TEXT("lte"),			35,		15,		12000,	0.5f,	0.2f },
+	{ TEXT("3g"),			120,	60,		1500,	1.5f,	0.5f },
+};
+
+bool FRemoteSessionNetworkConditions::Parse(const TCHAR* Params)
+{
+	FString Token;
+	const TCHAR* Remaining = Params;
+
+	// a bare word is a preset, anything with an = is an override
+	while (FParse::Token(Remaining, Token, false))
+	{
+		if (Token.Contains(TEXT("=")))
+		{
+			continue;
+		}
+
+		const FRemoteSessionNetworkPreset* Preset = nullptr;
+
+		for (const FRemoteSessionNetworkPreset& Candidate : GRemoteSessionNetworkPresets)
+		{
+			if (Token.Equals(Candidate.Name, ESearchCase::IgnoreCase))
+			{
+				Preset = &Candidate;
+				break;
+			}
+		}
+
+		if (Preset == nullptr)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Unknown network preset %s. Presets are %s"), *Token, *FString::Join(GetPresetNames(), TEXT(", ")));
+			return false;
+		}
+
+		LatencyMS = Preset->LatencyMS;
+		JitterMS = Preset->JitterMS;
+		BandwidthKbps = Preset->BandwidthKbps;
+		LossPercent = Preset->LossPercent;
+		ReorderPercent = Preset->ReorderPercent;
+	}
+
+	FParse::Value(Params, TEXT("Latency="), LatencyMS);
+	FParse::Value(Params, TEXT("Jitter="), JitterMS);
+	FParse::Value(Params, TEXT("Bandwidth="), BandwidthKbps);
+	FParse::Value(Params, TEXT("Loss="), LossPercent);
+	FParse::Value(Params, TEXT("Reorder="), ReorderPercent);
+
+	LatencyMS = FMath::Max(LatencyMS, 0);
+	JitterMS = FMath::Max(JitterMS, 0);
+	BandwidthKbps = FMath::Max(BandwidthKbps, 0);
+	LossPercent = FMath::Clamp(LossPercent, 0.0f, 100.0f);
+	ReorderPercent = FMath::Clamp(ReorderPercent, 0.0f, 100.0f);
+
+	return true;
+}
+
+FString FRemoteSessionNetworkConditions::ToString() const
+{
+	if (IsEnabled() == false)
+	{
+		return TEXT("off");
+	}
+
+	return FString::Printf(TEXT("Latency=%d Jitter=%d Bandwidth=%d Loss=%.02f Reorder=%.02f"), LatencyMS, JitterMS, BandwidthKbps, LossPercent, ReorderPercent);
+}
+
+void FRemoteSessionNetworkConditions::AddToJson(const TSharedRef<FJsonObject>& Object, const TCHAR* Name) const
+{
+	TSharedRef<FJsonObject> Conditions = MakeShareable(new FJsonObject);
+
+	Conditions->SetNumberField(TEXT("latencyMs"), LatencyMS);
+	Conditions->SetNumberField(TEXT("jitterMs"), JitterMS);
+	Conditions->SetNumberField(TEXT("bandwidthKbps"), BandwidthKbps);
+	Conditions->SetNumberField(TEXT("lossPercent"), LossPercent);
+	Conditions->SetNumberField(TEXT("reorderPercent"), ReorderPercent);
+
+	Object->SetObjectField(Name, Conditions);
+}
+
+FRemoteSessionNetworkConditions FRemoteSessionNetworkConditions::Get()
+{
+	FRemoteSessionNetworkConditions Conditions;
+	Conditions.LatencyMS = FMath::Max(GRemoteSessionNetLatencyMS, 0);
+	Conditions.JitterMS = FMath::Max(GRemoteSessionNetJitterMS, 0);
+	Conditions.BandwidthKbps = FMath::Max(GRemoteSessionNetBandwidthKbps, 0);
+	Conditions.LossPercent = FMath::Clamp(GRemoteSessionNetLossPercent, 0.0f, 100.0f);
+	Conditions.ReorderPercent = FMath::Clamp(GRemoteSessionNetReorderPercent, 0.0f, 100.0f);
+	return Conditions;
+}
+
+void FRemoteSessionNetworkConditions::Set(const FRemoteSessionNetworkConditions& InConditions)
+{
+	GRemoteSessionNetLatencyMS = InConditions.LatencyMS;
+	GRemoteSessionNetJitterMS = InConditions.JitterMS;
+	GRemoteSessionNetBandwidthKbps = InConditions.BandwidthKbps;
+	GRemoteSessionNetLossPercent = InConditions.LossPercent;
+	GRemoteSessionNetReorderPercent = InConditions.ReorderPercent;
+}
+
+TArray<FString> FRemoteSessionNetworkConditions::GetPresetNames()
+{
+	TArray<FString> Names;
+
+	for (const FRemoteSessionNetworkPreset& Preset : GRemoteSessionNetworkPresets)
+	{
+		Names.Add(Preset.Name);
+	}
+
+	return Names;
+}
+
+FRemoteSessionDelayLine::FRemoteSessionDelayLine(FOutput InOutput, bool bInInOrder, const TCHAR* ThreadName)
+	: Output(InOutput)
+	, bInOrder(bInInOrder)
+	, QueuedBytes(0)
+	, LinkFreeTime(0)
+	, LastReleaseTime(0)
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, ThreadName, 128 * 1024, TPri_AboveNormal);
+}
+
+FRemoteSessionDelayLine::~FRemoteSessionDelayLine()
+{
+	Stop();
+
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+void FRemoteSessionDelayLine::Stop()
+{
+	bStopRequested = true;
+	WakeEvent->Trigger();
+}
+
+double FRemoteSessionDelayLine::GetReleaseTime(const FRemoteSessionNetworkConditions& Conditions, int32 Size, double Now, bool& bOutLost)
+{
+	bOutLost = Conditions.LossPercent > 0 && FMath::FRand() * 100.0f < Conditions.LossPercent;
+
+	// the link sends one packet at a time, so with a cap each one waits for those before it to go out
+	double SentTime = Now;
+
+	if (Conditions.BandwidthKbps > 0)
+	{
+		SentTime = FMath::Max(Now, LinkFreeTime) + (Size * 8.0) / (Conditions.BandwidthKbps * 1000.0);
+		LinkFreeTime = SentTime;
+	}
+
+	const double Jitter = (FMath::FRand() * 2.0 - 1.0) * Conditions.JitterMS;
+	double ReleaseTime = SentTime + FMath::Max(Conditions.LatencyMS + Jitter, 0.0) / 1000.0;
+
+	if (bInOrder)
+	{
+		// TCP resends a lost packet once it times out, and nothing after it can be read until it arrives
+		if (bOutLost)
+		{
+			const double RoundTrip = 2.0 * (Conditions.LatencyMS + Conditions.JitterMS) / 1000.0;
+			ReleaseTime += FMath::Max(kMinRetransmitSeconds, 2.0 * RoundTrip);
+			bOutLost = false;
+		}
+
+		ReleaseTime = FMath::Max(ReleaseTime, LastReleaseTime);
+	}
+	else if (Conditions.ReorderPercent > 0 && FMath::FRand() * 100.0f < Conditions.ReorderPercent)
+	{
+		// hold it back long enough for the next few to get ahead of it
+		ReleaseTime += (5 + Conditions.JitterMS + Conditions.LatencyMS / 2) / 1000.0;
+	}
+
+	LastReleaseTime = FMath::Max(LastReleaseTime, ReleaseTime);
+
+	return ReleaseTime;
+}
+
+void FRemoteSessionDelayLine::Push(const uint8* Data, int32 Size)
+{
+	if (bFailed || Size <= 0)
+	{
+		return;
+	}
+
+	const FRemoteSessionNetworkConditions Conditions = FRemoteSessionNetworkConditions::Get();
+
+	FScopeLock Lock(&Mutex);
+
+	if (bInOrder)
+	{
+		// like a full socket buffer, make the sender wait for some of what's queued to go out
+		while (QueuedBytes > 0 && QueuedBytes + Size > kMaxQueuedStreamBytes && !bStopRequested && !bFailed)
+		{
+			Mutex.Unlock();
+			FPlatformProcess::Sleep(0.001f);
+			Mutex.Lock();
+		}
+	}
+	else if (QueuedBytes + Size > kMaxQueuedDatagramBytes)
+	{
+		return;
+	}
+
+	bool bLost = false;
+	const double ReleaseTime = GetReleaseTime(Conditions, Size, FPlatformTime::Seconds(), bLost);
+
+	if (bLost)
+	{
+		return;
+	}
+
+	int32 InsertAt = Queue.Num();
+	while (InsertAt > 0 && Queue[InsertAt - 1].ReleaseTime > ReleaseTime)
+	{
+		InsertAt--;
+	}
+
+	Queue.InsertDefaulted(InsertAt);
+
+	FPacket& Packet = Queue[InsertAt];
+	Packet.ReleaseTime = ReleaseTime;
+	Packet.Data.Append(Data, Size);
+
+	QueuedBytes += Size;
+
+	if (InsertAt == 0)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+uint32 FRemoteSessionDelayLine::Run()
+{
+	TArray<FPacket> Due;
+
+	while (!bStopRequested)
+	{
+		double WaitSeconds = 0.1;
+
+		{
+			FScopeLock Lock(&Mutex);
+
+			const double Now = FPlatformTime::Seconds();
+
+			int32 NumDue = 0;
+			while (NumDue < Queue.Num() && Queue[NumDue].ReleaseTime <= Now)
+			{
+				QueuedBytes -= Queue[NumDue].Data.Num();
+				Due.Add(MoveTemp(Queue[NumDue]));
+				NumDue++;
+			}
+
+			Queue.RemoveAt(0, NumDue, false);
+
+			if (Queue.Num())
+			{
+				WaitSeconds = Queue[0].ReleaseTime - Now;
+			}
+		}
+
+		for (const FPacket& Packet : Due)
+		{
+			if (bFailed == false && Output(Packet.Data.GetData(), Packet.Data.Num()) == false)
+			{
+				bFailed = true;
+			}
+		}
+
+		Due.Reset();
+
+		if (WaitSeconds > 0)
+		{
+			WakeEvent->Wait(FMath::Max(1, FMath::CeilToInt(WaitSeconds * 1000.0)));
+		}
+	}
+
+	return 0;
+}
+
+TSharedRef<IBackChannelConnection> FRemoteSessionEmulatedConnection::WrapIfEnabled(TSharedRef<IBackChannelConnection> InConnection)
+{
+	const FRemoteSessionNetworkConditions Conditions = FRemoteSessionNetworkConditions::Get();
+
+	if (Conditions.IsEnabled() == false)
+	{
+		return InConnection;
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Emulating network conditions on %s: %s"), *InConnection->GetDescription(), *Conditions.ToString());
+
+	return MakeShareable(new FRemoteSessionEmulatedConnection(InConnection));
+}
+
+FRemoteSessionEmulatedConnection::FRemoteSessionEmulatedConnection(TSharedRef<IBackChannelConnection> InInner)
+	: Inner(InInner)
+{
+	TSharedRef<IBackChannelConnection> Destination = Inner;
+
+	DelayLine = MakeUnique<FRemoteSessionDelayLine>([Destination](const uint8* Data, int32 Size)
+	{
+		while (Size > 0)
+		{
+			const int32 Sent = Destination->SendData(Data, Size);
+
+			if (Sent <= 0)
+			{
+				UE_LOG(LogRemoteSession, Warning, TEXT("Emulated connection failed to send %d bytes"), Size);
+				return false;
+			}
+
+			Data += Sent;
+			Size -= Sent;
+		}
+
+		return true;
+	}, true, TEXT("RemoteSessionNetEmulator"));
+}
+
+FRemoteSessionEmulatedConnection::~FRemoteSessionEmulatedConnection()
+{
+	DelayLine.Reset();
+}
+
+void FRemoteSessionEmulatedConnection::Close()
+{
+	// anything still in flight is lost with the connection
+	DelayLine->Stop();
+	Inner->Close();
+}
+
+int32 FRemoteSessionEmulatedConnection::SendData(const void* InData, const int32 InSize)
+{
+	if (DelayLine->HasFailed())
+	{
+		return -1;
+	}
+
+	FScopeLock Lock(&SendMutex);
+
+	Partial.Append((const uint8*)InData, InSize);
+
+	// pass on each whole [size][data] packet so it's delayed, and lost, as one
+	int32 Consumed = 0;
+
+	while (Partial.Num() - Consumed >= (int32)sizeof(int32))
+	{
+		int32 PacketSize = 0;
+		FMemory::Memcpy(&PacketSize, Partial.GetData() + Consumed, sizeof(PacketSize));
+
+		if (PacketSize < 0)
+		{
+			// not something we framed, send it all through as is
+			DelayLine->Push(Partial.GetData() + Consumed, Partial.Num() - Consumed);
+			Consumed = Partial.Num();
+			break;
+		}
+
+		const int32 FramedSize = sizeof(int32) + PacketSize;
+
+		if (Partial.Num() - Consumed < FramedSize)
+		{
+			break;
+		}
+
+		DelayLine->Push(Partial.GetData() + Consumed, FramedSize);
+		Consumed += FramedSize;
+	}
+
+	Partial.RemoveAt(0, Consumed, false);
+
+	return InSize;
+}
+
+FString FRemoteSessionEmulatedConnection::GetDescription() const
+{
+	return FString::Printf(TEXT("%s (emulated %s)"), *Inner->GetDescription(), *FRemoteSessionNetworkConditions::Get().ToString());
+}
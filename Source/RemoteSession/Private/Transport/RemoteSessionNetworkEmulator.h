@@ -0,0 +1,154 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "BackChannel/Transport/IBackChannelConnection.h"
+
+class FEvent;
+class FRunnableThread;
+class FJsonObject;
+
+/*
+	Network conditions to emulate on what we send. Set with the remote.net.* cvars, the remote.net command or
+	-RemoteSessionNet on the command line, either as a preset (e.g. hotelwifi) or as Key=Value pairs.
+*/
+struct FRemoteSessionNetworkConditions
+{
+	/** Added to every packet, in each direction that has conditions set */
+	int32	LatencyMS = 0;
+
+	/** Latency varies by up to this much either way */
+	int32	JitterMS = 0;
+
+	/** Cap on the rate packets leave at, 0 for no cap */
+	int32	BandwidthKbps = 0;
+
+	/** Percentage of packets lost. Over TCP a lost packet is resent after a timeout, holding up everything behind it */
+	float	LossPercent = 0;
+
+	/** Percentage of packets held back so later ones overtake them. Only UDP frames can arrive out of order */
+	float	ReorderPercent = 0;
+
+	bool IsEnabled() const
+	{
+		return LatencyMS > 0 || JitterMS > 0 || BandwidthKbps > 0 || LossPercent > 0 || ReorderPercent > 0;
+	}
+
+	/** Applies a preset name and/or Key=Value pairs (Latency, Jitter, Bandwidth, Loss, Reorder) on top of us. Returns false for an unknown preset */
+	bool Parse(const TCHAR* Params);
+
+	FString ToString() const;
+
+	void AddToJson(const TSharedRef<FJsonObject>& Object, const TCHAR* Name) const;
+
+	/** The conditions currently set by the cvars */
+	static FRemoteSessionNetworkConditions Get();
+
+	/** Sets the cvars. Connections that are already emulated pick the new values up with their next packet */
+	static void Set(const FRemoteSessionNetworkConditions& InConditions);
+
+	/** Names of the presets Parse accepts */
+	static TArray<FString> GetPresetNames();
+};
+
+/*
+	Holds packets back to emulate a network path, then hands them to Output on its own thread once they're due.
+
+	For streams (bInOrder) packets always leave in the order they went in, so jitter and loss hold up the packets
+	behind them as TCP would. Push blocks while too much is waiting, as a full socket buffer would. Otherwise
+	packets are datagrams that can be lost outright, overtake each other, or be dropped when the queue is full.
+*/
+class FRemoteSessionDelayLine : public FRunnable
+{
+public:
+
+	/** Sends a packet on, returns false if it couldn't */
+	typedef TFunction<bool(const uint8* /*Data*/, int32 /*Size*/)> FOutput;
+
+	FRemoteSessionDelayLine(FOutput InOutput, bool bInInOrder, const TCHAR* ThreadName);
+
+	virtual ~FRemoteSessionDelayLine();
+
+	void Push(const uint8* Data, int32 Size);
+
+	/** True if Output has failed, after which nothing more is sent */
+	bool HasFailed() const { return bFailed; }
+
+	/* Begin FRunnable */
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	/* End FRunnable */
+
+protected:
+
+	struct FPacket
+	{
+		double			ReleaseTime;
+		TArray<uint8>	Data;
+	};
+
+	/** Works out when a packet of Size bytes sent now should come out the other end. Mutex must be held */
+	double GetReleaseTime(const FRemoteSessionNetworkConditions& Conditions, int32 Size, double Now, bool& bOutLost);
+
+	FOutput					Output;
+	bool					bInOrder;
+
+	FCriticalSection		Mutex;
+
+	/** Ordered by release time */
+	TArray<FPacket>			Queue;
+	int32					QueuedBytes;
+
+	/** When the emulated link finishes sending what it has, for the bandwidth cap */
+	double					LinkFreeTime;
+
+	/** Release time of the newest packet, which streams can't overtake */
+	double					LastReleaseTime;
+
+	FEvent*					WakeEvent;
+	FRunnableThread*		Thread;
+	FThreadSafeBool			bStopRequested;
+	FThreadSafeBool			bFailed;
+};
+
+/*
+	Sits between FBackChannelOSCConnection (and our sender) and a real connection, and passes what's sent through a
+	delay line. Data is split back into the size-prefixed packets it was written as so each is delayed as a whole.
+	Receiving goes straight to the real connection, so set conditions on both ends to affect both directions.
+*/
+class FRemoteSessionEmulatedConnection : public IBackChannelConnection, public TSharedFromThis<FRemoteSessionEmulatedConnection>
+{
+public:
+
+	/** Returns InConnection wrapped if any conditions are set, otherwise InConnection itself */
+	static TSharedRef<IBackChannelConnection> WrapIfEnabled(TSharedRef<IBackChannelConnection> InConnection);
+
+	FRemoteSessionEmulatedConnection(TSharedRef<IBackChannelConnection> InInner);
+
+	virtual ~FRemoteSessionEmulatedConnection();
+
+	/* Begin IBackChannelConnection */
+	virtual bool Connect(const TCHAR* InEndPoint) override { return Inner->Connect(InEndPoint); }
+	virtual bool Listen(const int16 Port) override { return Inner->Listen(Port); }
+	virtual void Close() override;
+	virtual bool WaitForConnection(double InTimeout, TFunction<bool(TSharedRef<IBackChannelConnection>)> InDelegate) override { return Inner->WaitForConnection(InTimeout, InDelegate); }
+	virtual int32 SendData(const void* InData, const int32 InSize) override;
+	virtual int32 ReceiveData(void* OutBuffer, const int32 BufferSize) override { return Inner->ReceiveData(OutBuffer, BufferSize); }
+	virtual FSocket* GetSocket() override { return Inner->GetSocket(); }
+	virtual bool IsConnected() const override { return Inner->IsConnected() && DelayLine->HasFailed() == false; }
+	virtual uint32 GetPacketsReceived() const override { return Inner->GetPacketsReceived(); }
+	virtual FString GetDescription() const override;
+	/* End IBackChannelConnection */
+
+protected:
+
+	TSharedRef<IBackChannelConnection>	Inner;
+	TUniquePtr<FRemoteSessionDelayLine>	DelayLine;
+
+	/** Bytes written that don't make up a whole packet yet */
+	FCriticalSection					SendMutex;
+	TArray<uint8>						Partial;
+};
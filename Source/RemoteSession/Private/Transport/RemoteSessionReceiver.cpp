@@ -0,0 +1,365 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionReceiver.h"
+#include "RemoteSession.h"
+#include "BackChannel/Protocol/OSC/BackChannelOSCConnection.h"
+#include "BackChannel/Protocol/OSC/BackChannelOSCMessage.h"
+#include "BackChannel/Protocol/OSC/BackChannelOSCPacket.h"
+#include "BackChannel/Transport/IBackChannelConnection.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "Transport/RemoteSessionTrafficCounter.h"
+#include "Transport/RemoteSessionCapture.h"
+#include "RemoteSessionStats.h"
+
+FRemoteSessionBufferPool::FRemoteSessionBufferPool(int32 InMaxFreeBuffers)
+	: MaxFreeBuffers(InMaxFreeBuffers)
+{
+}
+
+FRemoteSessionBufferPool::~FRemoteSessionBufferPool()
+{
+	for (TArray<uint8>* Buffer : FreeBuffers)
+	{
+		DeleteBuffer(Buffer);
+	}
+	FreeBuffers.Empty();
+}
+
+void FRemoteSessionBufferPool::DeleteBuffer(TArray<uint8>* Buffer)
+{
+	const int64 BufferBytes = Buffer->GetAllocatedSize();
+	AllocatedBytes.Subtract(BufferBytes);
+	DEC_MEMORY_STAT_BY(STAT_RSReceiveBufferMemory, BufferBytes);
+
+	delete Buffer;
+}
+
+FRemoteSessionPooledBufferPtr FRemoteSessionBufferPool::Acquire(int32 Size)
+{
+	TArray<uint8>* Buffer = nullptr;
+
+	{
+		FScopeLock Lock(&PoolMutex);
+
+		// prefer a buffer that's already big enough, otherwise grow whatever is free
+		int32 Index = FreeBuffers.IndexOfByPredicate([Size](const TArray<uint8>* Item) {
+			return Item->Max() >= Size;
+		});
+
+		if (Index == INDEX_NONE && FreeBuffers.Num())
+		{
+			Index = FreeBuffers.Num() - 1;
+		}
+
+		if (Index != INDEX_NONE)
+		{
+			Buffer = FreeBuffers[Index];
+			FreeBuffers.RemoveAtSwap(Index);
+		}
+	}
+
+	if (Buffer == nullptr)
+	{
+		Buffer = new TArray<uint8>();
+	}
+
+	// the only place buffers grow, so track the difference for our memory stats
+	const int64 PreviousBytes = Buffer->GetAllocatedSize();
+	Buffer->SetNumUninitialized(Size, false);
+	const int64 GrownBytes = Buffer->GetAllocatedSize() - PreviousBytes;
+
+	AllocatedBytes.Add(GrownBytes);
+	INC_MEMORY_STAT_BY(STAT_RSReceiveBufferMemory, GrownBytes);
+
+	NumInUse.Increment();
+	INC_DWORD_STAT(STAT_RSReceiveBuffersInUse);
+
+	TWeakPtr<FRemoteSessionBufferPool, ESPMode::ThreadSafe> WeakPool = AsShared();
+
+	return MakeShareable(Buffer, [WeakPool](TArray<uint8>* InBuffer) {
+		TSharedPtr<FRemoteSessionBufferPool, ESPMode::ThreadSafe> Pool = WeakPool.Pin();
+		if (Pool.IsValid())
+		{
+			Pool->Release(InBuffer);
+		}
+		else
+		{
+			// the pool has gone, but its memory stats are global
+			DEC_DWORD_STAT(STAT_RSReceiveBuffersInUse);
+			DEC_MEMORY_STAT_BY(STAT_RSReceiveBufferMemory, InBuffer->GetAllocatedSize());
+			delete InBuffer;
+		}
+	});
+}
+
+void FRemoteSessionBufferPool::Release(TArray<uint8>* Buffer)
+{
+	NumInUse.Decrement();
+	DEC_DWORD_STAT(STAT_RSReceiveBuffersInUse);
+
+	FScopeLock Lock(&PoolMutex);
+
+	if (FreeBuffers.Num() < MaxFreeBuffers)
+	{
+		FreeBuffers.Add(Buffer);
+	}
+	else
+	{
+		DeleteBuffer(Buffer);
+	}
+}
+
+int32 FRemoteSessionBufferPool::GetNumFree() const
+{
+	FScopeLock Lock(&PoolMutex);
+	return FreeBuffers.Num();
+}
+
+FRemoteSessionReceivedMessage::FRemoteSessionReceivedMessage(FRemoteSessionPooledBufferPtr InBuffer, int32 InSize)
+	: Buffer(InBuffer)
+	, Size(InSize)
+	, ReadOffset(0)
+	, TagIndex(1)
+	, bIsValid(false)
+{
+	bIsValid = ReadString(Address) && ReadString(TagString) && TagString.StartsWith(TEXT(","));
+}
+
+bool FRemoteSessionReceivedMessage::ReadBytes(void* OutData, int32 InSize)
+{
+	if (ReadOffset + InSize > Size)
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(OutData, Buffer->GetData() + ReadOffset, InSize);
+	ReadOffset = Align(ReadOffset + InSize, 4);
+	return true;
+}
+
+bool FRemoteSessionReceivedMessage::ReadString(FString& OutValue)
+{
+	const uint8* Start = Buffer->GetData() + ReadOffset;
+	const int32 Remaining = Size - ReadOffset;
+
+	int32 Length = 0;
+	while (Length < Remaining && Start[Length] != 0)
+	{
+		Length++;
+	}
+
+	if (Length >= Remaining)
+	{
+		return false;
+	}
+
+	OutValue = FString(UTF8_TO_TCHAR((const ANSICHAR*)Start));
+	ReadOffset = Align(ReadOffset + Length + 1, 4);
+	return true;
+}
+
+bool FRemoteSessionReceivedMessage::ReadTag(TCHAR Expected)
+{
+	if (bIsValid == false || TagIndex >= TagString.Len() || TagString[TagIndex] != Expected)
+	{
+		return false;
+	}
+
+	TagIndex++;
+	return true;
+}
+
+bool FRemoteSessionReceivedMessage::Read(int32& OutValue)
+{
+	return ReadTag(TEXT('i')) && ReadBytes(&OutValue, sizeof(OutValue));
+}
+
+bool FRemoteSessionReceivedMessage::Read(float& OutValue)
+{
+	return ReadTag(TEXT('f')) && ReadBytes(&OutValue, sizeof(OutValue));
+}
+
+bool FRemoteSessionReceivedMessage::Read(FString& OutValue)
+{
+	return ReadTag(TEXT('s')) && ReadString(OutValue);
+}
+
+bool FRemoteSessionReceivedMessage::Read(FRemoteSessionBlobView& OutValue)
+{
+	int32 BlobSize = 0;
+
+	if (ReadTag(TEXT('b')) == false || ReadBytes(&BlobSize, sizeof(BlobSize)) == false)
+	{
+		return false;
+	}
+
+	if (BlobSize < 0 || ReadOffset + BlobSize > Size)
+	{
+		return false;
+	}
+
+	OutValue = FRemoteSessionBlobView(Buffer, ReadOffset, BlobSize);
+	ReadOffset = Align(ReadOffset + BlobSize, 4);
+	return true;
+}
+
+FRemoteSessionReceiver::FRemoteSessionReceiver(TSharedRef<IBackChannelConnection> InConnection, TSharedRef<FBackChannelOSCConnection, ESPMode::ThreadSafe> InOSCConnection)
+	: Connection(InConnection)
+	, OSCConnection(InOSCConnection)
+	, BufferPool(MakeShareable(new FRemoteSessionBufferPool()))
+	, ExpectedPacketSize(0)
+	, SizeBytesRead(0)
+	, PacketBytesRead(0)
+	, bHasError(false)
+	, LastReceiveTime(0)
+{
+}
+
+void FRemoteSessionReceiver::BindHandler(const TCHAR* Address, const FRemoteSessionMessageHandler& Handler)
+{
+	FScopeLock Lock(&HandlerMutex);
+	Handlers.Add(Address, Handler);
+}
+
+void FRemoteSessionReceiver::UnbindHandler(const TCHAR* Address)
+{
+	FScopeLock Lock(&HandlerMutex);
+	Handlers.Remove(Address);
+}
+
+void FRemoteSessionReceiver::SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	FScopeLock Lock(&CaptureMutex);
+	Capture = InCapture;
+}
+
+int32 FRemoteSessionReceiver::ReceivePackets()
+{
+	int32 TotalBytesRead = 0;
+
+	while (bHasError == false)
+	{
+		if (ExpectedPacketSize == 0)
+		{
+			// Packets are framed the same way FBackChannelOSCConnection sends them, a size then the data
+			const int32 BytesRead = Connection->ReceiveData(SizeBuffer + SizeBytesRead, sizeof(SizeBuffer) - SizeBytesRead);
+
+			if (BytesRead <= 0)
+			{
+				break;
+			}
+
+			TotalBytesRead += BytesRead;
+			SizeBytesRead += BytesRead;
+
+			if (SizeBytesRead == sizeof(SizeBuffer))
+			{
+				FMemory::Memcpy(&ExpectedPacketSize, SizeBuffer, sizeof(ExpectedPacketSize));
+				SizeBytesRead = 0;
+
+				if (ExpectedPacketSize <= 0 || ExpectedPacketSize > FRemoteSessionReceiver::kMaxPacketSize)
+				{
+					UE_LOG(LogRemoteSession, Error, TEXT("Received invalid packet size %d. Closing connection."), ExpectedPacketSize);
+					bHasError = true;
+					break;
+				}
+
+				PacketBuffer = BufferPool->Acquire(ExpectedPacketSize);
+				PacketBytesRead = 0;
+			}
+		}
+		else
+		{
+			const int32 BytesRead = Connection->ReceiveData(PacketBuffer->GetData() + PacketBytesRead, ExpectedPacketSize - PacketBytesRead);
+
+			if (BytesRead <= 0)
+			{
+				break;
+			}
+
+			TotalBytesRead += BytesRead;
+			PacketBytesRead += BytesRead;
+
+			if (PacketBytesRead == ExpectedPacketSize)
+			{
+				FRemoteSessionPooledBufferPtr CompletedBuffer = PacketBuffer;
+				const int32 CompletedSize = ExpectedPacketSize;
+
+				PacketBuffer = nullptr;
+				ExpectedPacketSize = 0;
+
+				TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> LocalCapture;
+
+				{
+					FScopeLock Lock(&CaptureMutex);
+					LocalCapture = Capture;
+				}
+
+				if (LocalCapture.IsValid())
+				{
+					LocalCapture->Record(ERemoteSessionCaptureDirection::Received, CompletedBuffer->GetData(), CompletedSize);
+				}
+
+				DispatchPacket(CompletedBuffer, CompletedSize, CompletedSize);
+			}
+		}
+	}
+
+	if (TotalBytesRead > 0)
+	{
+		LastReceiveTime = FPlatformTime::Seconds();
+	}
+
+	return TotalBytesRead;
+}
+
+void FRemoteSessionReceiver::DispatchPacket(FRemoteSessionPooledBufferPtr Buffer, int32 Size, int32 WireSize)
+{
+	FRemoteSessionReceivedMessage Message(Buffer, Size);
+
+	if (Message.IsValid() && Decompressor.IsValid() && Message.GetAddress() == FRemoteSessionMessageCompressor::Address)
+	{
+		FRemoteSessionPooledBufferPtr Inflated;
+		int32 InflatedSize = 0;
+
+		// counted against the channel of the message inside
+		if (Decompressor->Decompress(Message, BufferPool.Get(), Inflated, InflatedSize))
+		{
+			DispatchPacket(Inflated, InflatedSize, WireSize);
+		}
+		return;
+	}
+
+	if (Traffic.IsValid())
+	{
+		Traffic->RecordReceived(Message.IsValid() ? Message.GetAddress() : FString(), WireSize);
+	}
+
+	if (Message.IsValid())
+	{
+		FRemoteSessionMessageHandler Handler;
+
+		{
+			FScopeLock Lock(&HandlerMutex);
+			if (FRemoteSessionMessageHandler* Found = Handlers.Find(Message.GetAddress()))
+			{
+				Handler = *Found;
+			}
+		}
+
+		if (Handler.IsBound())
+		{
+			Handler.Execute(Message);
+			return;
+		}
+	}
+
+	// not something we handle in place, let the OSC connection's dispatch map deal with it
+	TSharedPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe> LocalOSCConnection = OSCConnection.Pin();
+	TSharedPtr<FBackChannelOSCPacket> Packet = FBackChannelOSCPacket::CreateFromBuffer(Buffer->GetData(), Size);
+
+	if (LocalOSCConnection.IsValid() && Packet.IsValid() && Packet->GetType() == OSCPacketType::Message)
+	{
+		LocalOSCConnection->GetDispatchMap().DispatchMessage(*StaticCastSharedPtr<FBackChannelOSCMessage>(Packet));
+	}
+}
@@ -0,0 +1,212 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+class IBackChannelConnection;
+class FBackChannelOSCConnection;
+class FRemoteSessionMessageCompressor;
+class FRemoteSessionTrafficCounter;
+class FRemoteSessionCaptureWriter;
+
+/* A buffer that returns itself to its pool when the last reference is released */
+typedef TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> FRemoteSessionPooledBufferPtr;
+
+/*
+	A small pool of receive buffers. Buffers are handed out as shared pointers and go back into the pool once
+	every reference (e.g. a frame waiting to be decoded) has been released.
+*/
+class FRemoteSessionBufferPool : public TSharedFromThis<FRemoteSessionBufferPool, ESPMode::ThreadSafe>
+{
+public:
+
+	FRemoteSessionBufferPool(int32 InMaxFreeBuffers = 4);
+
+	~FRemoteSessionBufferPool();
+
+	/** Returns a buffer with at least Size bytes */
+	FRemoteSessionPooledBufferPtr Acquire(int32 Size);
+
+	/** Number of buffers currently handed out */
+	int32 GetNumInUse() const { return NumInUse.GetValue(); }
+
+	/** Number of buffers waiting to be reused */
+	int32 GetNumFree() const;
+
+	/** Memory held by buffers that are in use or waiting to be reused */
+	int64 GetAllocatedBytes() const { return AllocatedBytes.GetValue(); }
+
+protected:
+
+	void Release(TArray<uint8>* Buffer);
+
+	/** Deletes a buffer, taking it out of our memory stats */
+	void DeleteBuffer(TArray<uint8>* Buffer);
+
+	mutable FCriticalSection	PoolMutex;
+	TArray<TArray<uint8>*>		FreeBuffers;
+	int32						MaxFreeBuffers;
+	FThreadSafeCounter			NumInUse;
+	FThreadSafeCounter64		AllocatedBytes;
+};
+
+/* A view of part of a pooled buffer. Holds a reference so the data remains valid while the view exists */
+class FRemoteSessionBlobView
+{
+public:
+
+	FRemoteSessionBlobView()
+		: Offset(0)
+		, Size(0)
+	{
+	}
+
+	FRemoteSessionBlobView(FRemoteSessionPooledBufferPtr InBuffer, int32 InOffset, int32 InSize)
+		: Buffer(InBuffer)
+		, Offset(InOffset)
+		, Size(InSize)
+	{
+	}
+
+	const uint8* GetData() const { return Buffer.IsValid() ? Buffer->GetData() + Offset : nullptr; }
+
+	int32 Num() const { return Size; }
+
+	bool IsValid() const { return Buffer.IsValid(); }
+
+	/** Releases our reference to the underlying buffer */
+	void Reset()
+	{
+		Buffer = nullptr;
+		Offset = 0;
+		Size = 0;
+	}
+
+protected:
+
+	FRemoteSessionPooledBufferPtr	Buffer;
+	int32							Offset;
+	int32							Size;
+};
+
+/* Reads arguments from an OSC message in a pooled buffer. Blobs are returned as views rather than copies */
+class FRemoteSessionReceivedMessage
+{
+public:
+
+	FRemoteSessionReceivedMessage(FRemoteSessionPooledBufferPtr InBuffer, int32 InSize);
+
+	/** Returns true if the buffer contained a valid OSC message */
+	bool IsValid() const { return bIsValid; }
+
+	const FString& GetAddress() const { return Address; }
+
+	/** The buffer holding the whole message, e.g. to pass it on without re-encoding it */
+	const FRemoteSessionPooledBufferPtr& GetBuffer() const { return Buffer; }
+
+	/** Size of the whole message */
+	int32 GetSize() const { return Size; }
+
+	bool Read(int32& OutValue);
+	bool Read(float& OutValue);
+	bool Read(FString& OutValue);
+	bool Read(FRemoteSessionBlobView& OutValue);
+
+protected:
+
+	/** Returns the next type tag if it matches Expected */
+	bool ReadTag(TCHAR Expected);
+
+	bool ReadString(FString& OutValue);
+
+	bool ReadBytes(void* OutData, int32 InSize);
+
+	FRemoteSessionPooledBufferPtr	Buffer;
+	int32							Size;
+	int32							ReadOffset;
+	FString							Address;
+	FString							TagString;
+	int32							TagIndex;
+	bool							bIsValid;
+};
+
+DECLARE_DELEGATE_OneParam(FRemoteSessionMessageHandler, FRemoteSessionReceivedMessage&);
+
+/*
+	Reads packets from a connection into pooled buffers. Addresses with a registered handler are given the message
+	in place, everything else is passed on to the OSC connection's dispatch map as before.
+*/
+class FRemoteSessionReceiver
+{
+public:
+
+	/** Anything bigger than this is assumed to be a corrupt stream */
+	static const int32 kMaxPacketSize = 64 * 1024 * 1024;
+
+	FRemoteSessionReceiver(TSharedRef<IBackChannelConnection> InConnection, TSharedRef<FBackChannelOSCConnection, ESPMode::ThreadSafe> InOSCConnection);
+
+	/** Reads and dispatches all available packets. Returns the number of bytes that were read */
+	int32 ReceivePackets();
+
+	/** Called when the socket was readable but had nothing to read, which means the peer closed it */
+	void MarkDisconnected() { bHasError = true; }
+
+	/** Registers a handler that will receive messages for Address without them being copied. Safe to call while receiving */
+	void BindHandler(const TCHAR* Address, const FRemoteSessionMessageHandler& Handler);
+
+	/** Removes the handler for Address. A message already being dispatched to it may still arrive */
+	void UnbindHandler(const TCHAR* Address);
+
+	/** When data last arrived, or 0 if nothing has */
+	double GetLastReceiveTime() const { return LastReceiveTime; }
+
+	/** Returns true if no errors have been seen on the connection */
+	bool IsConnected() const { return bHasError == false; }
+
+	FRemoteSessionBufferPool& GetBufferPool() { return BufferPool.Get(); }
+
+	/** Lets us expand compressed packets from a peer using the same dictionary */
+	void SetDecompressor(TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> InDecompressor) { Decompressor = InDecompressor; }
+
+	/** Counts everything we receive by channel. Must be set before receiving starts */
+	void SetTrafficCounter(TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe> InTraffic) { Traffic = InTraffic; }
+
+	/** Records every packet we receive, as it arrived, until set to null */
+	void SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture);
+
+protected:
+
+	/** WireSize is how much arrived, which is less than Size for a packet that was compressed */
+	void DispatchPacket(FRemoteSessionPooledBufferPtr Buffer, int32 Size, int32 WireSize);
+
+	TSharedRef<IBackChannelConnection>							Connection;
+	TWeakPtr<FBackChannelOSCConnection, ESPMode::ThreadSafe>	OSCConnection;
+	TSharedRef<FRemoteSessionBufferPool, ESPMode::ThreadSafe>	BufferPool;
+
+	TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe>	Decompressor;
+
+	TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe>	Traffic;
+
+	/** Capturing can be started and stopped while the receive thread is running */
+	FCriticalSection						CaptureMutex;
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe>	Capture;
+
+	FCriticalSection						HandlerMutex;
+	TMap<FString, FRemoteSessionMessageHandler>	Handlers;
+
+	/** Size of the packet being read, or 0 if we're reading the size */
+	int32							ExpectedPacketSize;
+	int32							SizeBytesRead;
+	uint8							SizeBuffer[4];
+
+	/** Buffer being read into and how much has arrived */
+	FRemoteSessionPooledBufferPtr	PacketBuffer;
+	int32							PacketBytesRead;
+
+	bool							bHasError;
+
+	double							LastReceiveTime;
+};
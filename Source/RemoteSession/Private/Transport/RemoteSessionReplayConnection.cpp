@@ -0,0 +1,180 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionReplayConnection.h"
+#include "RemoteSession.h"
+#include "HAL/IConsoleManager.h"
+
+const TCHAR* FRemoteSessionReplayConnection::AddressPrefix = TEXT("replay:");
+
+/* Frames are the only packets sent to this address */
+static const char kFrameAddress[] = "/Screen";
+
+/* Each packet is preceded by its size */
+static const int32 kSizeBytes = sizeof(int32);
+
+float GRemoteSessionReplaySpeed = 1.0f;
+static FAutoConsoleVariableRef CVarRemoteSessionReplaySpeed(
+	TEXT("remote.replayspeed"),
+	GRemoteSessionReplaySpeed,
+	TEXT("Speed captures are replayed at. 1 plays them as recorded, 2 twice as fast, 0 as fast as possible"),
+	ECVF_Default);
+
+FRemoteSessionReplayConnection::FRemoteSessionReplayConnection()
+	: Direction(ERemoteSessionCaptureDirection::Received)
+	, Speed(1.0f)
+	, NextRecord(0)
+	, FirstRecordTime(0)
+	, StartTime(0)
+	, LastFrameReleased(0)
+	, PacketData(nullptr)
+	, PacketSize(0)
+	, PacketBytesRead(0)
+	, PacketsReceived(0)
+	, BytesReceived(0)
+	, bClosed(true)
+	, bFinished(false)
+{
+}
+
+bool FRemoteSessionReplayConnection::Connect(const TCHAR* InEndPoint)
+{
+	FString Filename = InEndPoint;
+	Filename.RemoveFromStart(AddressPrefix);
+
+	if (Reader.Open(Filename) == false)
+	{
+		return false;
+	}
+
+	// we're the client, so play whatever came from the host
+	Direction = Reader.GetHostToClientDirection();
+	Speed = FMath::Max(GRemoteSessionReplaySpeed, 0.0f);
+
+	for (int32 Index = 0; Index < Reader.GetNumRecords(); ++Index)
+	{
+		const uint8* Data = nullptr;
+		const FRemoteSessionCaptureRecord& Record = Reader.GetRecord(Index, Data);
+
+		if (Record.Direction == Direction)
+		{
+			NextRecord = Index;
+			FirstRecordTime = Record.Time;
+			break;
+		}
+	}
+
+	bClosed = false;
+	return true;
+}
+
+bool FRemoteSessionReplayConnection::WaitForConnection(double InTimeout, TFunction<bool(TSharedRef<IBackChannelConnection>)> InDelegate)
+{
+	if (bClosed)
+	{
+		return false;
+	}
+
+	// the "host" is always there
+	StartTime = FPlatformTime::Seconds();
+	return InDelegate(AsShared());
+}
+
+FString FRemoteSessionReplayConnection::GetDescription() const
+{
+	return FString::Printf(TEXT("%s%s"), AddressPrefix, *Reader.GetFilename());
+}
+
+bool FRemoteSessionReplayConnection::IsFramePacket(const uint8* Data, int32 Size)
+{
+	return Size >= (int32)sizeof(kFrameAddress) && FMemory::Memcmp(Data, kFrameAddress, sizeof(kFrameAddress)) == 0;
+}
+
+bool FRemoteSessionReplayConnection::AdvanceToNextRecord()
+{
+	while (NextRecord < Reader.GetNumRecords())
+	{
+		const uint8* Data = nullptr;
+		const FRemoteSessionCaptureRecord& Record = Reader.GetRecord(NextRecord, Data);
+
+		if (Record.Direction != Direction)
+		{
+			NextRecord++;
+			continue;
+		}
+
+		if (Speed > 0)
+		{
+			if ((FPlatformTime::Seconds() - StartTime) * Speed < Record.Time - FirstRecordTime)
+			{
+				return false;
+			}
+		}
+		else if (IsFramePacket(Data, Record.Size))
+		{
+			if (LastFrameReleased == GFrameCounter)
+			{
+				return false;
+			}
+
+			LastFrameReleased = GFrameCounter;
+		}
+
+		PacketData = Data;
+		PacketSize = Record.Size;
+		PacketBytesRead = 0;
+
+		PacketsReceived++;
+		BytesReceived += Record.Size;
+		NextRecord++;
+		return true;
+	}
+
+	if (bFinished == false)
+	{
+		bFinished = true;
+
+		UE_LOG(LogRemoteSession, Log, TEXT("Replayed %u packets (%.02f MB) covering %.02f seconds of %s in %.02f seconds"),
+			PacketsReceived, BytesReceived / (1024.0 * 1024.0), Reader.GetDuration() - FirstRecordTime, *Reader.GetFilename(), FPlatformTime::Seconds() - StartTime);
+	}
+
+	return false;
+}
+
+int32 FRemoteSessionReplayConnection::ReceiveData(void* OutBuffer, const int32 BufferSize)
+{
+	if (IsConnected() == false)
+	{
+		return 0;
+	}
+
+	// framed the way the receiver expects, a size then the data
+	const int32 FramedSize = kSizeBytes + PacketSize;
+
+	if (PacketData == nullptr || PacketBytesRead >= FramedSize)
+	{
+		if (AdvanceToNextRecord() == false)
+		{
+			return 0;
+		}
+	}
+
+	uint8* Out = (uint8*)OutBuffer;
+	int32 BytesRead = 0;
+
+	while (BytesRead < BufferSize && PacketBytesRead < kSizeBytes)
+	{
+		Out[BytesRead++] = ((const uint8*)&PacketSize)[PacketBytesRead++];
+	}
+
+	const int32 DataOffset = PacketBytesRead - kSizeBytes;
+	const int32 DataBytes = FMath::Min(BufferSize - BytesRead, PacketSize - DataOffset);
+
+	if (DataBytes > 0)
+	{
+		FMemory::Memcpy(Out + BytesRead, PacketData + DataOffset, DataBytes);
+		BytesRead += DataBytes;
+		PacketBytesRead += DataBytes;
+	}
+
+	return BytesRead;
+}
@@ -0,0 +1,73 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BackChannel/Transport/IBackChannelConnection.h"
+#include "Transport/RemoteSessionCapture.h"
+
+/* Speed captures are replayed at. 1 is as recorded, 0 is as fast as possible */
+extern float GRemoteSessionReplaySpeed;
+
+/*
+	Plays back what a host sent in a capture as if it were arriving from a live host, so a client can be
+	given the exact same stream over and over. Anything written to the connection is dropped.
+
+	At full speed a frame is released once per engine frame (and everything between frames as it comes) so
+	that each one is received, decoded and shown rather than all but the last being skipped.
+
+	There's no socket, so the connection must be read from the game thread.
+*/
+class FRemoteSessionReplayConnection : public IBackChannelConnection, public TSharedFromThis<FRemoteSessionReplayConnection>
+{
+public:
+
+	/** Prefix for addresses passed to Connect, e.g. replay:Saved/RemoteSession/Capture.rscap */
+	static const TCHAR* AddressPrefix;
+
+	FRemoteSessionReplayConnection();
+
+	/* Begin IBackChannelConnection */
+	virtual bool Connect(const TCHAR* InEndPoint) override;
+	virtual bool Listen(const int16 Port) override { return false; }
+	virtual void Close() override { bClosed = true; }
+	virtual bool WaitForConnection(double InTimeout, TFunction<bool(TSharedRef<IBackChannelConnection>)> InDelegate) override;
+	virtual int32 SendData(const void* InData, const int32 InSize) override { return InSize; }
+	virtual int32 ReceiveData(void* OutBuffer, const int32 BufferSize) override;
+	virtual FSocket* GetSocket() override { return nullptr; }
+	virtual bool IsConnected() const override { return bClosed == false && bFinished == false; }
+	virtual uint32 GetPacketsReceived() const override { return PacketsReceived; }
+	virtual FString GetDescription() const override;
+	/* End IBackChannelConnection */
+
+	/** True once every packet has been read */
+	bool IsFinished() const { return bFinished; }
+
+protected:
+
+	/** Moves on to the next packet from the host if it's time for it. Returns false if there isn't one yet */
+	bool AdvanceToNextRecord();
+
+	/** True if Data is a frame, which are released one per engine frame at full speed */
+	static bool IsFramePacket(const uint8* Data, int32 Size);
+
+	FRemoteSessionCaptureReader		Reader;
+	ERemoteSessionCaptureDirection	Direction;
+	float							Speed;
+
+	int32							NextRecord;
+	double							FirstRecordTime;
+	double							StartTime;
+	uint64							LastFrameReleased;
+
+	/** The packet being read, which is a size and then Data */
+	const uint8*					PacketData;
+	int32							PacketSize;
+	int32							PacketBytesRead;
+
+	uint32							PacketsReceived;
+	int64							BytesReceived;
+
+	bool							bClosed;
+	bool							bFinished;
+};
@@ -0,0 +1,249 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionSendScheduler.h"
+#include "RemoteSession.h"
+#include "HAL/RunnableThread.h"
+#include "Transport/RemoteSessionTrafficCounter.h"
+#include "RemoteSessionStats.h"
+
+/* Bytes added to a channel's deficit each round, per unit of weight */
+static const int32 kSchedulerQuantum = 16 * 1024;
+
+FRemoteSessionSendScheduler::FRemoteSessionSendScheduler(FRemoteSessionSender& InSender, const FRemoteSessionTransportSettings& InSettings)
+	: Sender(InSender)
+	, Settings(InSettings)
+	, NextQueueIndex(0)
+	, QueuedBytes(0)
+	, QueuedPackets(0)
+	, Tokens(0)
+	, LastRefillTime(FPlatformTime::Seconds())
+{
+	Tokens = Settings.SendBurstKB * 1024.0;
+
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("RemoteSessionSendThread"), 128 * 1024, TPri_AboveNormal);
+}
+
+FRemoteSessionSendScheduler::~FRemoteSessionSendScheduler()
+{
+	Stop();
+
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	// whatever was left is never sent, take it back out of the totals
+	{
+		FScopeLock Lock(&QueueMutex);
+		UpdateQueueStats(-QueuedBytes, -QueuedPackets);
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	WorkEvent = nullptr;
+}
+
+void FRemoteSessionSendScheduler::Stop()
+{
+	bStopRequested = true;
+	WorkEvent->Trigger();
+}
+
+void FRemoteSessionSendScheduler::Enqueue(FRemoteSessionOutgoingPacket&& Packet, const FString& Channel)
+{
+	{
+		FScopeLock Lock(&QueueMutex);
+
+		FChannelQueue* Queue = Queues.Find(Channel);
+
+		if (Queue == nullptr)
+		{
+			Queue = &Queues.Add(Channel);
+
+			if (const int32* Weight = Settings.ChannelWeights.Find(Channel))
+			{
+				Queue->Weight = FMath::Max(1, *Weight);
+			}
+
+			if (const int32* MaxQueued = Settings.ChannelMaxQueued.Find(Channel))
+			{
+				Queue->MaxQueued = *MaxQueued;
+			}
+
+			RoundRobinOrder.Add(Channel);
+		}
+
+		if (Queue->MaxQueued > 0 && Queue->Packets.Num() >= Queue->MaxQueued)
+		{
+			UE_LOG(LogRemoteSession, Verbose, TEXT("Send queue for %s is full, dropping oldest packet"), *Channel);
+			UpdateQueueStats(-Queue->Packets[0].GetSize(), -1);
+			Queue->Packets.RemoveAt(0);
+
+			if (const TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe>& Traffic = Sender.GetTrafficCounter())
+			{
+				Traffic->RecordDropped(Channel);
+			}
+		}
+
+		UpdateQueueStats(Packet.GetSize(), 1);
+		Queue->Packets.Add(MoveTemp(Packet));
+	}
+
+	WorkEvent->Trigger();
+}
+
+int32 FRemoteSessionSendScheduler::GetQueuedBytes() const
+{
+	FScopeLock Lock(&QueueMutex);
+	return QueuedBytes;
+}
+
+int32 FRemoteSessionSendScheduler::GetQueuedPackets() const
+{
+	FScopeLock Lock(&QueueMutex);
+	return QueuedPackets;
+}
+
+void FRemoteSessionSendScheduler::UpdateQueueStats(int32 BytesDelta, int32 PacketsDelta)
+{
+	QueuedBytes += BytesDelta;
+	QueuedPackets += PacketsDelta;
+
+	// accumulators shared by every connection, so adjust rather than set
+	INC_DWORD_STAT_BY(STAT_RSSendQueueBytes, BytesDelta);
+	INC_DWORD_STAT_BY(STAT_RSSendQueuePackets, PacketsDelta);
+}
+
+bool FRemoteSessionSendScheduler::DequeueNextPacket(FRemoteSessionOutgoingPacket& OutPacket, FString& OutChannel)
+{
+	FScopeLock Lock(&QueueMutex);
+
+	if (QueuedBytes == 0 || RoundRobinOrder.Num() == 0)
+	{
+		return false;
+	}
+
+	// Each pass over the queues adds Weight * Quantum to a channel's deficit, and it can send once its deficit
+	// covers the packet at the front. Bounded, and a packet that's still too big after that is granted the rest below.
+	for (int32 Pass = 0; Pass < RoundRobinOrder.Num() * 64; Pass++)
+	{
+		const int32 Index = NextQueueIndex % RoundRobinOrder.Num();
+		FChannelQueue& Queue = Queues[RoundRobinOrder[Index]];
+
+		if (Queue.Packets.Num() == 0)
+		{
+			// idle channels don't bank credit
+			Queue.Deficit = 0;
+			NextQueueIndex = Index + 1;
+			continue;
+		}
+
+		const int32 PacketSize = Queue.Packets[0].GetSize();
+
+		if (Queue.Deficit < PacketSize)
+		{
+			Queue.Deficit += Queue.Weight * kSchedulerQuantum;
+		}
+
+		if (Queue.Deficit >= PacketSize)
+		{
+			// stay on this channel while it has credit
+			NextQueueIndex = Index;
+			PopPacket(Index, OutPacket, OutChannel);
+			return true;
+		}
+
+		NextQueueIndex = Index + 1;
+	}
+
+	// every waiting channel is still short, which only happens when their packets are much bigger than a quantum
+	// (e.g. a 4K frame). Returning false would leave the thread waiting for some other packet to wake it, so the
+	// next channel in turn is given what it's missing and its packet goes now.
+	for (int32 Offset = 0; Offset < RoundRobinOrder.Num(); Offset++)
+	{
+		const int32 Index = (NextQueueIndex + Offset) % RoundRobinOrder.Num();
+		FChannelQueue& Queue = Queues[RoundRobinOrder[Index]];
+
+		if (Queue.Packets.Num())
+		{
+			Queue.Deficit = FMath::Max(Queue.Deficit, Queue.Packets[0].GetSize());
+			NextQueueIndex = Index + 1;
+			PopPacket(Index, OutPacket, OutChannel);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FRemoteSessionSendScheduler::PopPacket(int32 Index, FRemoteSessionOutgoingPacket& OutPacket, FString& OutChannel)
+{
+	FChannelQueue& Queue = Queues[RoundRobinOrder[Index]];
+	const int32 PacketSize = Queue.Packets[0].GetSize();
+
+	Queue.Deficit -= PacketSize;
+	UpdateQueueStats(-PacketSize, -1);
+	OutPacket = MoveTemp(Queue.Packets[0]);
+	OutChannel = RoundRobinOrder[Index];
+	Queue.Packets.RemoveAt(0);
+}
+
+bool FRemoteSessionSendScheduler::WaitForTokens(int32 Size)
+{
+	if (Settings.MaxSendBandwidthKbps <= 0)
+	{
+		return true;
+	}
+
+	const double BytesPerSecond = Settings.MaxSendBandwidthKbps * 1000.0 / 8.0;
+	const double BucketSize = FMath::Max(Settings.SendBurstKB * 1024.0, 1.0);
+
+	// packets larger than the bucket are allowed once it's full, and leave it in debt
+	const double Required = FMath::Min((double)Size, BucketSize);
+
+	while (bStopRequested == false)
+	{
+		const double TimeNow = FPlatformTime::Seconds();
+		Tokens = FMath::Min(BucketSize, Tokens + (TimeNow - LastRefillTime) * BytesPerSecond);
+		LastRefillTime = TimeNow;
+
+		if (Tokens >= Required)
+		{
+			Tokens -= Size;
+			return true;
+		}
+
+		// woken early by Stop() or new packets, either way we just recalculate
+		const uint32 WaitMS = FMath::Max(1, FMath::CeilToInt((Required - Tokens) / BytesPerSecond * 1000.0));
+		WorkEvent->Wait(FMath::Min(WaitMS, 100u));
+	}
+
+	return false;
+}
+
+uint32 FRemoteSessionSendScheduler::Run()
+{
+	while (bStopRequested == false)
+	{
+		FRemoteSessionOutgoingPacket Packet;
+		FString Channel;
+
+		if (DequeueNextPacket(Packet, Channel) == false)
+		{
+			WorkEvent->Wait();
+			continue;
+		}
+
+		if (WaitForTokens(Packet.GetSize()) && Sender.SendImmediate(Packet))
+		{
+			if (const TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe>& Traffic = Sender.GetTrafficCounter())
+			{
+				Traffic->RecordSent(Channel, Packet.GetSize());
+			}
+		}
+	}
+
+	return 0;
+}
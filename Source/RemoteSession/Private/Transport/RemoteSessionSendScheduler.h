@@ -0,0 +1,88 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionTransportSettings.h"
+
+class FRunnableThread;
+
+/*
+	Queues outgoing packets per channel and sends them from a background thread.
+
+	Bandwidth is limited with a token bucket that refills at MaxSendBandwidthKbps and can burst up to SendBurstKB.
+	When several channels have data waiting, deficit round-robin gives each one a share proportional to its
+	weight, so a small input message never waits behind a multi-megabyte frame.
+*/
+class FRemoteSessionSendScheduler : public FRunnable
+{
+public:
+
+	FRemoteSessionSendScheduler(FRemoteSessionSender& InSender, const FRemoteSessionTransportSettings& InSettings);
+
+	~FRemoteSessionSendScheduler();
+
+	/** Queues a packet for Channel. If the channel has too many packets waiting the oldest is dropped */
+	void Enqueue(FRemoteSessionOutgoingPacket&& Packet, const FString& Channel);
+
+	/** Total bytes waiting to be sent */
+	int32 GetQueuedBytes() const;
+
+	/** Total packets waiting to be sent */
+	int32 GetQueuedPackets() const;
+
+protected:
+
+	/* Begin FRunnable */
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	/* End FRunnable */
+
+	struct FChannelQueue
+	{
+		FChannelQueue()
+			: Weight(1)
+			, MaxQueued(0)
+			, Deficit(0)
+		{
+		}
+
+		TArray<FRemoteSessionOutgoingPacket>	Packets;
+		int32									Weight;
+		int32									MaxQueued;
+		int32									Deficit;
+	};
+
+	/** Picks the next packet to send using deficit round-robin. Returns false if nothing is queued */
+	bool DequeueNextPacket(FRemoteSessionOutgoingPacket& OutPacket, FString& OutChannel);
+
+	/** Takes the packet at the front of queue Index and charges it to the queue's deficit. QueueMutex must be held */
+	void PopPacket(int32 Index, FRemoteSessionOutgoingPacket& OutPacket, FString& OutChannel);
+
+	/** Publishes the queue depth to "stat remotesession". QueueMutex must be held */
+	void UpdateQueueStats(int32 BytesDelta, int32 PacketsDelta);
+
+	/** Blocks until the bucket has enough tokens to send Size bytes. Returns false if we were stopped */
+	bool WaitForTokens(int32 Size);
+
+	FRemoteSessionSender&				Sender;
+	FRemoteSessionTransportSettings		Settings;
+
+	mutable FCriticalSection			QueueMutex;
+	TMap<FString, FChannelQueue>		Queues;
+	TArray<FString>						RoundRobinOrder;
+	int32								NextQueueIndex;
+	int32								QueuedBytes;
+	int32								QueuedPackets;
+
+	/** Token bucket state, only accessed by the send thread */
+	double								Tokens;
+	double								LastRefillTime;
+
+	FEvent*								WorkEvent;
+	FThreadSafeBool						bStopRequested;
+	FRunnableThread*					Thread;
+};
@@ -0,0 +1,276 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionSender.h"
+#include "RemoteSession.h"
+#include "BackChannel/Protocol/OSC/BackChannelOSCPacket.h"
+#include "BackChannel/Transport/IBackChannelConnection.h"
+#include "Transport/RemoteSessionSendScheduler.h"
+#include "Transport/RemoteSessionTransportSettings.h"
+#include "Transport/RemoteSessionCompression.h"
+#include "Transport/RemoteSessionTrafficCounter.h"
+#include "Transport/RemoteSessionCapture.h"
+#include "RemoteSessionTrace.h"
+#include "Misc/Optional.h"
+
+FRemoteSessionBlobMessage::FRemoteSessionBlobMessage(const TCHAR* InAddress)
+{
+	Address = InAddress;
+	TagString = TEXT(",");
+}
+
+void FRemoteSessionBlobMessage::PadToAlignment(TArray<uint8>& OutBuffer)
+{
+	// OSC requires everything to be 4-byte aligned
+	const int32 Padding = Align(OutBuffer.Num(), 4) - OutBuffer.Num();
+	OutBuffer.AddZeroed(Padding);
+}
+
+void FRemoteSessionBlobMessage::WriteString(TArray<uint8>& OutBuffer, const FString& Value)
+{
+	FTCHARToUTF8 Converted(*Value);
+	OutBuffer.Append((const uint8*)Converted.Get(), Converted.Length());
+	OutBuffer.Add(0);
+	PadToAlignment(OutBuffer);
+}
+
+void FRemoteSessionBlobMessage::WriteArgument(TCHAR Tag, const void* Data, int32 Size)
+{
+	TagString.AppendChar(Tag);
+
+	// anything after the blob goes in the trailer
+	TArray<uint8>& Args = Payload.IsValid() ? TrailerArgs : HeaderArgs;
+	Args.Append((const uint8*)Data, Size);
+	PadToAlignment(Args);
+}
+
+void FRemoteSessionBlobMessage::Write(const int32 Value)
+{
+	WriteArgument(TEXT('i'), &Value, sizeof(Value));
+}
+
+void FRemoteSessionBlobMessage::Write(const float Value)
+{
+	WriteArgument(TEXT('f'), &Value, sizeof(Value));
+}
+
+void FRemoteSessionBlobMessage::Write(const FString& Value)
+{
+	TagString.AppendChar(TEXT('s'));
+	WriteString(Payload.IsValid() ? TrailerArgs : HeaderArgs, Value);
+}
+
+void FRemoteSessionBlobMessage::WriteBlob(FRemoteSessionPayloadPtr InPayload)
+{
+	check(Payload.IsValid() == false);
+	check(InPayload.IsValid());
+
+	TagString.AppendChar(TEXT('b'));
+
+	// blob size goes in the header, the data is sent straight from the payload
+	const int32 BlobSize = InPayload->Num();
+	HeaderArgs.Append((const uint8*)&BlobSize, sizeof(BlobSize));
+
+	Payload = InPayload;
+}
+
+void FRemoteSessionBlobMessage::GetHeaderAndTrailer(TArray<uint8>& OutHeader, TArray<uint8>& OutTrailer) const
+{
+	OutHeader.Reset();
+	WriteString(OutHeader, Address);
+	WriteString(OutHeader, TagString);
+	OutHeader.Append(HeaderArgs);
+
+	OutTrailer.Reset();
+
+	// pad the blob data
+	if (Payload.IsValid())
+	{
+		const int32 BlobPadding = Align(Payload->Num(), 4) - Payload->Num();
+		OutTrailer.AddZeroed(BlobPadding);
+	}
+
+	OutTrailer.Append(TrailerArgs);
+}
+
+int32 FRemoteSessionBlobMessage::GetPacketSize() const
+{
+	TArray<uint8> Header, Trailer;
+	GetHeaderAndTrailer(Header, Trailer);
+
+	return Header.Num() + (Payload.IsValid() ? Payload->Num() : 0) + Trailer.Num();
+}
+
+FRemoteSessionSender::FRemoteSessionSender(TSharedRef<IBackChannelConnection> InConnection)
+	: Connection(InConnection)
+{
+}
+
+FRemoteSessionSender::~FRemoteSessionSender()
+{
+	// stops the send thread before our connection is released
+	Scheduler = nullptr;
+}
+
+void FRemoteSessionSender::EnableScheduling(const FRemoteSessionTransportSettings& InSettings)
+{
+	Scheduler = MakeUnique<FRemoteSessionSendScheduler>(*this, InSettings);
+}
+
+void FRemoteSessionSender::EnableCompression(TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> InCompressor, const TArray<FString>& Channels)
+{
+	FScopeLock Lock(&CompressionMutex);
+	Compressor = InCompressor;
+	CompressedChannels = TSet<FString>(Channels);
+}
+
+bool FRemoteSessionSender::SendPacket(FBackChannelOSCPacket& Packet, const FString& Channel)
+{
+	FRemoteSessionOutgoingPacket Outgoing;
+	Outgoing.Header = Packet.WriteToBuffer();
+
+	TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> LocalCompressor;
+
+	{
+		FScopeLock Lock(&CompressionMutex);
+		if (CompressedChannels.Contains(Channel))
+		{
+			LocalCompressor = Compressor;
+		}
+	}
+
+	TArray<uint8> Compressed;
+
+	if (LocalCompressor.IsValid() && LocalCompressor->Compress(Outgoing.Header, Compressed))
+	{
+		Outgoing.Header = MoveTemp(Compressed);
+	}
+
+	return Send(MoveTemp(Outgoing), Channel);
+}
+
+bool FRemoteSessionSender::SendMessage(const FRemoteSessionBlobMessage& Message, const FString& Channel, int32 FrameIndex, TFunction<void(double)> OnSent)
+{
+	FRemoteSessionOutgoingPacket Outgoing;
+	Message.GetHeaderAndTrailer(Outgoing.Header, Outgoing.Trailer);
+
+	// hold a reference to the payload until the packet has been sent
+	Outgoing.Payload = Message.GetPayload();
+	Outgoing.FrameIndex = FrameIndex;
+	Outgoing.OnSent = MoveTemp(OnSent);
+
+	return Send(MoveTemp(Outgoing), Channel);
+}
+
+bool FRemoteSessionSender::SendEncoded(FRemoteSessionPayloadPtr InPacket, const FString& Channel)
+{
+	FRemoteSessionOutgoingPacket Outgoing;
+	Outgoing.Payload = InPacket;
+
+	return Send(MoveTemp(Outgoing), Channel);
+}
+
+bool FRemoteSessionSender::Send(FRemoteSessionOutgoingPacket&& Packet, const FString& Channel)
+{
+	if (Scheduler.IsValid())
+	{
+		// counted by the scheduler once it's actually sent
+		Scheduler->Enqueue(MoveTemp(Packet), Channel);
+		return true;
+	}
+
+	if (SendImmediate(Packet) == false)
+	{
+		return false;
+	}
+
+	if (Traffic.IsValid())
+	{
+		Traffic->RecordSent(Channel, Packet.GetSize());
+	}
+
+	return true;
+}
+
+void FRemoteSessionSender::SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture)
+{
+	FScopeLock Lock(&SendMutex);
+	Capture = InCapture;
+}
+
+int32 FRemoteSessionSender::GetQueuedBytes() const
+{
+	return Scheduler.IsValid() ? Scheduler->GetQueuedBytes() : 0;
+}
+
+int32 FRemoteSessionSender::GetQueuedPackets() const
+{
+	return Scheduler.IsValid() ? Scheduler->GetQueuedPackets() : 0;
+}
+
+bool FRemoteSessionSender::SendImmediate(const FRemoteSessionOutgoingPacket& Packet)
+{
+	const int32 PacketSize = Packet.GetSize();
+
+	TOptional<FRemoteSessionTraceScope> TraceScope;
+
+	if (Packet.FrameIndex > 0)
+	{
+		TraceScope.Emplace(TEXT("Send"), Packet.FrameIndex);
+	}
+
+	// Packets are framed the same way as FBackChannelOSCConnection::SendPacket, a size then the data. FSocket 
+	// has no vectored send so the pieces are written back to back under one lock instead of being gathered
+	// into a single buffer.
+	FScopeLock Lock(&SendMutex);
+
+	if (SendAll((const uint8*)&PacketSize, sizeof(PacketSize)) == false)
+	{
+		return false;
+	}
+
+	if (SendAll(Packet.Header.GetData(), Packet.Header.Num()) == false)
+	{
+		return false;
+	}
+
+	if (Packet.Payload.IsValid() && SendAll(Packet.Payload->GetData(), Packet.Payload->Num()) == false)
+	{
+		return false;
+	}
+
+	if (SendAll(Packet.Trailer.GetData(), Packet.Trailer.Num()) == false)
+	{
+		return false;
+	}
+
+	if (Capture.IsValid())
+	{
+		Capture->Record(ERemoteSessionCaptureDirection::Sent, Packet);
+	}
+
+	if (Packet.OnSent)
+	{
+		Packet.OnSent(FPlatformTime::Seconds());
+	}
+
+	return true;
+}
+
+bool FRemoteSessionSender::SendAll(const uint8* Data, int32 Size)
+{
+	while (Size > 0)
+	{
+		const int32 Sent = Connection->SendData(Data, Size);
+
+		if (Sent <= 0)
+		{
+			UE_LOG(LogRemoteSession, Warning, TEXT("Failed to send %d bytes"), Size);
+			return false;
+		}
+
+		Data += Sent;
+		Size -= Sent;
+	}
+
+	return true;
+}
@@ -0,0 +1,150 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IBackChannelConnection;
+class FBackChannelOSCPacket;
+class FRemoteSessionMessageCompressor;
+class FRemoteSessionTrafficCounter;
+class FRemoteSessionCaptureWriter;
+
+/* A payload that can be shared between an encoder and any number of in-flight sends without copying */
+typedef TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> FRemoteSessionPayloadPtr;
+
+/*
+	An OSC message whose blob argument is held by reference rather than copied into the message.
+
+	Arguments written before and after the blob are encoded into small header and trailer buffers, the
+	blob itself is sent straight from the payload. The layout on the wire is identical to an
+	FBackChannelOSCMessage with the same arguments so receivers don't need to know the difference.
+*/
+class FRemoteSessionBlobMessage
+{
+public:
+
+	FRemoteSessionBlobMessage(const TCHAR* InAddress);
+
+	void Write(const int32 Value);
+	void Write(const float Value);
+	void Write(const FString& Value);
+
+	/** Writes the blob argument. Only one blob is supported per message */
+	void WriteBlob(FRemoteSessionPayloadPtr InPayload);
+
+	/** Returns the size of the packet on the wire */
+	int32 GetPacketSize() const;
+
+	/** Builds the address, type tags and argument data before and after the blob */
+	void GetHeaderAndTrailer(TArray<uint8>& OutHeader, TArray<uint8>& OutTrailer) const;
+
+	const FRemoteSessionPayloadPtr& GetPayload() const { return Payload; }
+
+	const FString& GetAddress() const { return Address; }
+
+protected:
+
+	void WriteArgument(TCHAR Tag, const void* Data, int32 Size);
+
+	static void WriteString(TArray<uint8>& OutBuffer, const FString& Value);
+
+	static void PadToAlignment(TArray<uint8>& OutBuffer);
+
+	FString					Address;
+	FString					TagString;
+	TArray<uint8>			HeaderArgs;
+	TArray<uint8>			TrailerArgs;
+	FRemoteSessionPayloadPtr	Payload;
+};
+
+/* A packet ready to be sent, split into an inline header, a shared payload and an inline trailer */
+struct FRemoteSessionOutgoingPacket
+{
+	TArray<uint8>				Header;
+	FRemoteSessionPayloadPtr	Payload;
+	TArray<uint8>				Trailer;
+
+	/** Index of the frame in the payload, if any, for tracing */
+	int32						FrameIndex = 0;
+
+	/** Called with the time the packet finished being written to the socket */
+	TFunction<void(double)>		OnSent;
+
+	int32 GetSize() const
+	{
+		return Header.Num() + (Payload.IsValid() ? Payload->Num() : 0) + Trailer.Num();
+	}
+};
+
+/*
+	Sends packets on a connection with a single lock, so large payloads can be written in pieces without
+	being interleaved with other messages and without first being copied into one contiguous buffer.
+
+	If scheduling is enabled packets are queued per channel and sent from a background thread that paces
+	them to a bandwidth cap and shares it between channels by weight.
+*/
+class FRemoteSessionSender
+{
+public:
+
+	FRemoteSessionSender(TSharedRef<IBackChannelConnection> InConnection);
+
+	~FRemoteSessionSender();
+
+	/** Queues packets through a scheduler using the provided settings rather than sending them immediately */
+	void EnableScheduling(const struct FRemoteSessionTransportSettings& InSettings);
+
+	/** Compresses packets sent by SendPacket on behalf of any of Channels, when it makes them smaller */
+	void EnableCompression(TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe> InCompressor, const TArray<FString>& Channels);
+
+	/** Serializes and sends a regular OSC packet on behalf of Channel */
+	bool SendPacket(FBackChannelOSCPacket& Packet, const FString& Channel = FString());
+
+	/**
+	 * Sends the message on behalf of Channel, the payload is referenced until the send completes. If the message holds a frame
+	 * FrameIndex tags the send in traces, and OnSent is called on whichever thread writes it once it's on the socket
+	 */
+	bool SendMessage(const FRemoteSessionBlobMessage& Message, const FString& Channel = FString(), int32 FrameIndex = 0, TFunction<void(double)> OnSent = nullptr);
+
+	/** Sends a packet that's already encoded (e.g. one received from elsewhere) on behalf of Channel, by reference */
+	bool SendEncoded(FRemoteSessionPayloadPtr InPacket, const FString& Channel = FString());
+
+	/** Sends the packet on the connection right away, bypassing any scheduling */
+	bool SendImmediate(const FRemoteSessionOutgoingPacket& Packet);
+
+	/** Counts everything we send (and the scheduler drops) by channel */
+	void SetTrafficCounter(TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe> InTraffic) { Traffic = InTraffic; }
+
+	const TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe>& GetTrafficCounter() const { return Traffic; }
+
+	/** Records every packet we send, as it went on the wire, until set to null */
+	void SetCapture(TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe> InCapture);
+
+	/** Bytes and packets waiting for the scheduler. 0 if scheduling isn't enabled */
+	int32 GetQueuedBytes() const;
+	int32 GetQueuedPackets() const;
+
+protected:
+
+	/** Queues or sends the packet depending on whether scheduling is enabled */
+	bool Send(FRemoteSessionOutgoingPacket&& Packet, const FString& Channel);
+
+	/** Sends all of Size, returns false on error */
+	bool SendAll(const uint8* Data, int32 Size);
+
+	TSharedRef<IBackChannelConnection>	Connection;
+	FCriticalSection					SendMutex;
+
+	TUniquePtr<class FRemoteSessionSendScheduler>	Scheduler;
+
+	/** Compression can be enabled from the receive thread once the peer agrees to it */
+	FCriticalSection					CompressionMutex;
+	TSharedPtr<const FRemoteSessionMessageCompressor, ESPMode::ThreadSafe>	Compressor;
+	TSet<FString>						CompressedChannels;
+
+	TSharedPtr<FRemoteSessionTrafficCounter, ESPMode::ThreadSafe>	Traffic;
+
+	/** Only touched under SendMutex so records are in the order packets went out */
+	TSharedPtr<FRemoteSessionCaptureWriter, ESPMode::ThreadSafe>	Capture;
+};
@@ -0,0 +1,306 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionSharedMemoryConnection.h"
+#include "RemoteSession.h"
+#include "HAL/PlatformMemory.h"
+
+const TCHAR* FRemoteSessionSharedMemoryConnection::AddressPrefix = TEXT("shm:");
+
+static const uint32 kSharedMemoryMagic = 0x5253534D;	// 'RSSM'
+
+/* Ring 0 carries host->client traffic, ring 1 client->host */
+static const int32 kHostToClient = 0;
+static const int32 kClientToHost = 1;
+
+FRemoteSessionSharedMemoryConnection::FRemoteSessionSharedMemoryConnection(int32 InRingSizeMB)
+	: Region(nullptr)
+	, bIsHost(false)
+	, bOwnsRegion(false)
+	, RingSize(FMath::Max(1, InRingSizeMB) * 1024 * 1024)
+	, Port(0)
+	, PacketsReceived(0)
+{
+}
+
+FRemoteSessionSharedMemoryConnection::~FRemoteSessionSharedMemoryConnection()
+{
+	Close();
+}
+
+FRemoteSessionSharedMemoryConnection::FSharedHeader* FRemoteSessionSharedMemoryConnection::GetHeader() const
+{
+	return Region ? (FSharedHeader*)Region->GetAddress() : nullptr;
+}
+
+FRemoteSessionSharedMemoryConnection::FRing* FRemoteSessionSharedMemoryConnection::GetRing(int32 Index) const
+{
+	uint8* Base = (uint8*)Region->GetAddress() + sizeof(FSharedHeader);
+	return (FRing*)(Base + Index * (sizeof(FRing) + RingSize));
+}
+
+uint8* FRemoteSessionSharedMemoryConnection::GetRingData(int32 Index) const
+{
+	return (uint8*)GetRing(Index) + sizeof(FRing);
+}
+
+bool FRemoteSessionSharedMemoryConnection::MapRegion(int32 InPort, bool bCreate)
+{
+	const FString Name = FString::Printf(TEXT("RemoteSession_%d"), InPort);
+	const SIZE_T RegionSize = sizeof(FSharedHeader) + 2 * (sizeof(FRing) + RingSize);
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, bCreate, 
+		FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, RegionSize);
+
+	if (Region == nullptr)
+	{
+		return false;
+	}
+
+	Port = InPort;
+	bOwnsRegion = true;
+
+	if (bCreate)
+	{
+		FSharedHeader* Header = GetHeader();
+		Header->Magic = kSharedMemoryMagic;
+		Header->RingSize = RingSize;
+		ResetRegion();
+	}
+	else if (GetHeader()->Magic != kSharedMemoryMagic || GetHeader()->RingSize != (uint32)RingSize)
+	{
+		UE_LOG(LogRemoteSession, Error, TEXT("Shared memory region %s has an unexpected layout"), *Name);
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void FRemoteSessionSharedMemoryConnection::ResetRegion()
+{
+	for (int32 i = 0; i < 2; i++)
+	{
+		GetRing(i)->WriteCount = 0;
+		GetRing(i)->ReadCount = 0;
+	}
+
+	FPlatformMisc::MemoryBarrier();
+	GetHeader()->State = FSharedHeader::Listening;
+}
+
+bool FRemoteSessionSharedMemoryConnection::Listen(const int16 InPort)
+{
+	bIsHost = true;
+	return MapRegion(InPort, true);
+}
+
+bool FRemoteSessionSharedMemoryConnection::Connect(const TCHAR* InEndPoint)
+{
+	FString EndPoint = InEndPoint;
+	EndPoint.RemoveFromStart(AddressPrefix);
+
+	bIsHost = false;
+
+	if (MapRegion(FCString::Atoi(*EndPoint), false) == false)
+	{
+		return false;
+	}
+
+	// claim the region, only one client at a time
+	if (FPlatformAtomics::InterlockedCompareExchange(&GetHeader()->State, FSharedHeader::Connected, FSharedHeader::Listening) != FSharedHeader::Listening)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Shared memory host on port %d is not accepting connections"), Port);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool FRemoteSessionSharedMemoryConnection::WaitForConnection(double InTimeout, TFunction<bool(TSharedRef<IBackChannelConnection>)> InDelegate)
+{
+	if (Region == nullptr)
+	{
+		return false;
+	}
+
+	if (bIsHost == false)
+	{
+		// Connect() already attached us
+		InDelegate(AsShared());
+		return true;
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + InTimeout;
+
+	do
+	{
+		const int32 State = GetHeader()->State;
+		const bool bSessionOpen = SessionOpen.IsValid() && *SessionOpen;
+
+		if (State == FSharedHeader::Closed && bSessionOpen == false)
+		{
+			// previous client went away, let another one in
+			ResetRegion();
+		}
+		else if (State == FSharedHeader::Connected && bSessionOpen == false)
+		{
+			// the session gets its own object that shares our mapping
+			TSharedRef<FRemoteSessionSharedMemoryConnection> Session = MakeShareable(new FRemoteSessionSharedMemoryConnection(RingSize / (1024 * 1024)));
+			Session->Region = Region;
+			Session->bIsHost = true;
+			Session->bOwnsRegion = false;
+			Session->Port = Port;
+
+			// only one session per region, hold off on accepting until it's closed
+			SessionOpen = MakeShareable(new FThreadSafeBool(true));
+			Session->SessionOpen = SessionOpen;
+			InDelegate(Session);
+			return true;
+		}
+
+		if (FPlatformTime::Seconds() < EndTime)
+		{
+			FPlatformProcess::SleepNoStats(0.001f);
+		}
+
+	} while (FPlatformTime::Seconds() < EndTime);
+
+	return true;
+}
+
+void FRemoteSessionSharedMemoryConnection::Close()
+{
+	if (Region)
+	{
+		// tell the other side this session is over
+		GetHeader()->State = FSharedHeader::Closed;
+
+		// and our listener, which resets the region for the next client
+		if (SessionOpen.IsValid())
+		{
+			*SessionOpen = false;
+		}
+
+		if (bOwnsRegion)
+		{
+			FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		}
+
+		Region = nullptr;
+	}
+}
+
+bool FRemoteSessionSharedMemoryConnection::IsConnected() const
+{
+	return Region != nullptr && GetHeader()->State == FSharedHeader::Connected;
+}
+
+FString FRemoteSessionSharedMemoryConnection::GetDescription() const
+{
+	return FString::Printf(TEXT("%s%d"), AddressPrefix, Port);
+}
+
+int32 FRemoteSessionSharedMemoryConnection::SendData(const void* InData, const int32 InSize)
+{
+	FRing* Ring = GetRing(bIsHost ? kHostToClient : kClientToHost);
+	uint8* RingData = GetRingData(bIsHost ? kHostToClient : kClientToHost);
+
+	// wait for the reader to make room, it's the other process so we can only poll
+	int64 Free = 0;
+
+	while (IsConnected())
+	{
+		FPlatformMisc::MemoryBarrier();
+		Free = RingSize - (Ring->WriteCount - Ring->ReadCount);
+
+		if (Free > 0)
+		{
+			break;
+		}
+
+		FPlatformProcess::SleepNoStats(0.0001f);
+	}
+
+	if (Free <= 0)
+	{
+		return 0;
+	}
+
+	const int32 ToWrite = (int32)FMath::Min<int64>(Free, InSize);
+	const int32 Offset = (int32)(Ring->WriteCount % RingSize);
+	const int32 FirstChunk = FMath::Min(ToWrite, RingSize - Offset);
+
+	FMemory::Memcpy(RingData + Offset, InData, FirstChunk);
+	FMemory::Memcpy(RingData, (const uint8*)InData + FirstChunk, ToWrite - FirstChunk);
+
+	// publish the data before moving the write position
+	FPlatformMisc::MemoryBarrier();
+	Ring->WriteCount += ToWrite;
+
+	return ToWrite;
+}
+
+int32 FRemoteSessionSharedMemoryConnection::ReceiveData(void* OutBuffer, const int32 BufferSize)
+{
+	if (Region == nullptr)
+	{
+		return 0;
+	}
+
+	FRing* Ring = GetRing(bIsHost ? kClientToHost : kHostToClient);
+	const uint8* RingData = GetRingData(bIsHost ? kClientToHost : kHostToClient);
+
+	FPlatformMisc::MemoryBarrier();
+	const int64 Available = Ring->WriteCount - Ring->ReadCount;
+
+	if (Available <= 0)
+	{
+		return 0;
+	}
+
+	const int32 ToRead = (int32)FMath::Min<int64>(Available, BufferSize);
+	const int32 Offset = (int32)(Ring->ReadCount % RingSize);
+	const int32 FirstChunk = FMath::Min(ToRead, RingSize - Offset);
+
+	FMemory::Memcpy(OutBuffer, RingData + Offset, FirstChunk);
+	FMemory::Memcpy((uint8*)OutBuffer + FirstChunk, RingData, ToRead - FirstChunk);
+
+	FPlatformMisc::MemoryBarrier();
+	Ring->ReadCount += ToRead;
+
+	PacketsReceived++;
+
+	return ToRead;
+}
+
+bool FRemoteSessionSharedMemoryConnection::WaitForData(const FTimespan& Timeout)
+{
+	if (Region == nullptr)
+	{
+		return true;
+	}
+
+	const FRing* Ring = GetRing(bIsHost ? kClientToHost : kHostToClient);
+	const double EndTime = FPlatformTime::Seconds() + Timeout.GetTotalSeconds();
+
+	// There's no portable cross-process event so back off from spinning to short sleeps. The first few
+	// checks are cheap and catch data that arrives back to back.
+	int32 Attempts = 0;
+
+	do
+	{
+		FPlatformMisc::MemoryBarrier();
+
+		if (Ring->WriteCount != Ring->ReadCount || IsConnected() == false)
+		{
+			return true;
+		}
+
+		FPlatformProcess::SleepNoStats(Attempts++ < 16 ? 0.0f : 0.001f);
+
+	} while (FPlatformTime::Seconds() < EndTime);
+
+	return false;
+}
@@ -0,0 +1,98 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "BackChannel/Transport/IBackChannelConnection.h"
+
+/*
+	A connection between two processes on the same machine that uses a pair of ring buffers in named shared
+	memory instead of a socket. The host creates the region when it listens and a client attaches to it
+	when it connects, so one host can serve one shared memory client at a time.
+
+	Implements the same interface as the TCP connection so FBackChannelOSCConnection, our sender and receiver
+	work over it unchanged.
+*/
+class FRemoteSessionSharedMemoryConnection : public IBackChannelConnection, public TSharedFromThis<FRemoteSessionSharedMemoryConnection>
+{
+public:
+
+	/** Prefix for addresses passed to Connect, e.g. shm:2049 */
+	static const TCHAR* AddressPrefix;
+
+	FRemoteSessionSharedMemoryConnection(int32 InRingSizeMB);
+
+	virtual ~FRemoteSessionSharedMemoryConnection();
+
+	/* Begin IBackChannelConnection */
+	virtual bool Connect(const TCHAR* InEndPoint) override;
+	virtual bool Listen(const int16 Port) override;
+	virtual void Close() override;
+	virtual bool WaitForConnection(double InTimeout, TFunction<bool(TSharedRef<IBackChannelConnection>)> InDelegate) override;
+	virtual int32 SendData(const void* InData, const int32 InSize) override;
+	virtual int32 ReceiveData(void* OutBuffer, const int32 BufferSize) override;
+	virtual FSocket* GetSocket() override { return nullptr; }
+	virtual bool IsConnected() const override;
+	virtual uint32 GetPacketsReceived() const override { return PacketsReceived; }
+	virtual FString GetDescription() const override;
+	/* End IBackChannelConnection */
+
+	/** Blocks until there's data to read or the other side closes. Returns false on timeout */
+	bool WaitForData(const FTimespan& Timeout);
+
+protected:
+
+	/* Lives at the start of the shared region */
+	struct FSharedHeader
+	{
+		enum EState
+		{
+			Listening = 1,
+			Connected,
+			Closed,
+		};
+
+		uint32			Magic;
+		volatile int32	State;
+		uint32			RingSize;
+		uint32			Padding;
+	};
+
+	/* One direction of traffic. Single producer, single consumer */
+	struct FRing
+	{
+		volatile int64	WriteCount;
+		volatile int64	ReadCount;
+	};
+
+	/** Maps the region for Port, creating and initializing it if bCreate */
+	bool MapRegion(int32 Port, bool bCreate);
+
+	/** Resets both rings and marks the region as waiting for a client */
+	void ResetRegion();
+
+	FRing* GetRing(int32 Index) const;
+	uint8* GetRingData(int32 Index) const;
+
+	FSharedHeader* GetHeader() const;
+
+	FPlatformMemory::FSharedMemoryRegion*	Region;
+
+	/** Is this the creating (host) side */
+	bool			bIsHost;
+
+	/** Host connections created by WaitForConnection share the listener's region but don't own it */
+	bool			bOwnsRegion;
+
+	int32			RingSize;
+	int32			Port;
+	uint32			PacketsReceived;
+
+	/**
+		Shared by the listener and the session it handed out, cleared when the session closes. The session is
+		released on whichever thread owns it, and its shared pointer isn't thread safe, so the listener can't
+		keep a weak pointer to it
+	*/
+	TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe>	SessionOpen;
+};
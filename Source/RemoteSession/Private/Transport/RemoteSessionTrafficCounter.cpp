@@ -0,0 +1,67 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionTrafficCounter.h"
+#include "RemoteSessionStats.h"
+
+void FRemoteSessionTrafficCounter::MapAddress(const FString& AddressPrefix, const FString& Channel)
+{
+	FScopeLock Lock(&Mutex);
+	AddressChannels.Emplace(AddressPrefix, Channel);
+}
+
+FRemoteSessionTrafficStats& FRemoteSessionTrafficCounter::FindOrAddChannel(const FString& Channel)
+{
+	return Channels.FindOrAdd(Channel.Len() ? Channel : FString(FRemoteSessionStats::GetSessionChannel()));
+}
+
+void FRemoteSessionTrafficCounter::RecordSent(const FString& Channel, int32 Bytes)
+{
+	INC_DWORD_STAT_BY(STAT_RSBytesSent, Bytes);
+	INC_DWORD_STAT(STAT_RSMessagesSent);
+
+	FScopeLock Lock(&Mutex);
+	FRemoteSessionTrafficStats& Stats = FindOrAddChannel(Channel);
+	Stats.BytesSent += Bytes;
+	Stats.MessagesSent++;
+}
+
+void FRemoteSessionTrafficCounter::RecordReceived(const FString& Address, int32 Bytes)
+{
+	INC_DWORD_STAT_BY(STAT_RSBytesReceived, Bytes);
+	INC_DWORD_STAT(STAT_RSMessagesReceived);
+
+	FScopeLock Lock(&Mutex);
+
+	const TPair<FString, FString>* Mapping = AddressChannels.FindByPredicate([&Address](const TPair<FString, FString>& Item) {
+		return Address.StartsWith(Item.Key, ESearchCase::CaseSensitive);
+	});
+
+	FRemoteSessionTrafficStats& Stats = FindOrAddChannel(Mapping ? Mapping->Value : FString());
+	Stats.BytesReceived += Bytes;
+	Stats.MessagesReceived++;
+}
+
+void FRemoteSessionTrafficCounter::RecordDropped(const FString& Channel)
+{
+	INC_DWORD_STAT(STAT_RSMessagesDropped);
+
+	FScopeLock Lock(&Mutex);
+	FindOrAddChannel(Channel).MessagesDropped++;
+}
+
+void FRemoteSessionTrafficCounter::GetStats(FRemoteSessionStats& OutStats) const
+{
+	FScopeLock Lock(&Mutex);
+
+	OutStats.Channels = Channels;
+	OutStats.Total = FRemoteSessionTrafficStats();
+
+	for (const auto& KV : Channels)
+	{
+		OutStats.Total.BytesSent += KV.Value.BytesSent;
+		OutStats.Total.BytesReceived += KV.Value.BytesReceived;
+		OutStats.Total.MessagesSent += KV.Value.MessagesSent;
+		OutStats.Total.MessagesReceived += KV.Value.MessagesReceived;
+		OutStats.Total.MessagesDropped += KV.Value.MessagesDropped;
+	}
+}
@@ -0,0 +1,39 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RemoteSession/RemoteSessionRole.h"
+
+/*
+	Counts bytes and messages sent and received on a connection by channel. Senders know which channel they're
+	sending for, received messages are matched to a channel by address prefix.
+
+	Also feeds the totals into "stat remotesession". Safe to use from any thread.
+*/
+class FRemoteSessionTrafficCounter
+{
+public:
+
+	/** Counts messages received at addresses starting with AddressPrefix against Channel */
+	void MapAddress(const FString& AddressPrefix, const FString& Channel);
+
+	void RecordSent(const FString& Channel, int32 Bytes);
+
+	void RecordReceived(const FString& Address, int32 Bytes);
+
+	/** Called when a queued message for Channel is thrown away */
+	void RecordDropped(const FString& Channel);
+
+	/** Fills in the Channels and Total members of OutStats */
+	void GetStats(FRemoteSessionStats& OutStats) const;
+
+protected:
+
+	/** Returns the stats for Channel, or for the session if it's empty. Mutex must be held */
+	FRemoteSessionTrafficStats& FindOrAddChannel(const FString& Channel);
+
+	mutable FCriticalSection						Mutex;
+	TArray<TPair<FString, FString>>					AddressChannels;
+	TMap<FString, FRemoteSessionTrafficStats>		Channels;
+};
@@ -0,0 +1,122 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionTransportSettings.h"
+#include "RemoteSession.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Sockets.h"
+
+FRemoteSessionTransportSettings::FRemoteSessionTransportSettings()
+{
+	MaxSendBandwidthKbps = 0;
+	SendBurstKB = 256;
+	bNoDelay = true;
+	SendBufferSizeKB = 0;
+	ReceiveBufferSizeKB = 4 * 1024;
+	bUseUDPForFrames = false;
+	bAllowUDPFrames = true;
+	// leaves room for IP/UDP headers within a typical 1500 byte MTU
+	UDPFragmentSize = 1200;
+	UDPFECGroupSize = 8;
+	bAllowSharedMemory = true;
+	// a few uncompressed frames worth at typical resolutions
+	SharedMemoryRingSizeMB = 32;
+	bEnableCompression = true;
+	// below this the wrapper costs about as much as deflate saves
+	CompressionThreshold = 32;
+	// frames are already compressed
+	CompressedChannels.Add(TEXT("rs.input"));
+	ResumeWindowSeconds = 10.0f;
+	// only the newest is sent, the rest are there for anything that wants a short history
+	FrameHistorySize = 4;
+	LateJoinMaxFrameAgeSeconds = 10.0f;
+	// short enough that a Wi-Fi blip is over before the user notices, long enough not to spin on a dead host
+	ReconnectInitialDelayMS = 50;
+	ReconnectMaxDelayMS = 5000;
+	HeartbeatIntervalMS = 100;
+	// several missed pings, but still well under the time a user would wait before giving up
+	HeartbeatTimeoutMS = 750;
+
+	// input is tiny and latency sensitive so should never wait behind a frame
+	ChannelWeights.Add(TEXT("rs.input"), 8);
+	ChannelWeights.Add(TEXT("rs.heartbeat"), 8);
+	ChannelWeights.Add(TEXT("rs.framebuffer"), 1);
+
+	// there's no point sending a stale frame when a newer one is waiting
+	ChannelMaxQueued.Add(TEXT("rs.framebuffer"), 2);
+}
+
+FRemoteSessionTransportSettings FRemoteSessionTransportSettings::LoadFromConfig()
+{
+	FRemoteSessionTransportSettings Settings;
+
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("MaxSendBandwidthKbps"), Settings.MaxSendBandwidthKbps, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("SendBurstKB"), Settings.SendBurstKB, GEngineIni);
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bNoDelay"), Settings.bNoDelay, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("SendBufferSizeKB"), Settings.SendBufferSizeKB, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("ReceiveBufferSizeKB"), Settings.ReceiveBufferSizeKB, GEngineIni);
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bUseUDPForFrames"), Settings.bUseUDPForFrames, GEngineIni);
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bAllowUDPFrames"), Settings.bAllowUDPFrames, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("UDPFragmentSize"), Settings.UDPFragmentSize, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("UDPFECGroupSize"), Settings.UDPFECGroupSize, GEngineIni);
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bAllowSharedMemory"), Settings.bAllowSharedMemory, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("SharedMemoryRingSizeMB"), Settings.SharedMemoryRingSizeMB, GEngineIni);
+	GConfig->GetBool(TEXT("RemoteSession"), TEXT("bEnableCompression"), Settings.bEnableCompression, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("CompressionThreshold"), Settings.CompressionThreshold, GEngineIni);
+	GConfig->GetString(TEXT("RemoteSession"), TEXT("CompressionDictionary"), Settings.CompressionDictionary, GEngineIni);
+
+	GConfig->GetFloat(TEXT("RemoteSession"), TEXT("ResumeWindowSeconds"), Settings.ResumeWindowSeconds, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("FrameHistorySize"), Settings.FrameHistorySize, GEngineIni);
+	GConfig->GetFloat(TEXT("RemoteSession"), TEXT("LateJoinMaxFrameAgeSeconds"), Settings.LateJoinMaxFrameAgeSeconds, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("ReconnectInitialDelayMS"), Settings.ReconnectInitialDelayMS, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("ReconnectMaxDelayMS"), Settings.ReconnectMaxDelayMS, GEngineIni);
+
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("HeartbeatIntervalMS"), Settings.HeartbeatIntervalMS, GEngineIni);
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("HeartbeatTimeoutMS"), Settings.HeartbeatTimeoutMS, GEngineIni);
+
+	TArray<FString> CompressedChannels;
+	if (GConfig->GetArray(TEXT("RemoteSession"), TEXT("CompressedChannels"), CompressedChannels, GEngineIni) > 0)
+	{
+		Settings.CompressedChannels = CompressedChannels;
+	}
+
+	// entries are of the form +ChannelWeights=rs.input=8
+	TArray<FString> WeightEntries;
+	GConfig->GetArray(TEXT("RemoteSession"), TEXT("ChannelWeights"), WeightEntries, GEngineIni);
+
+	for (const FString& Entry : WeightEntries)
+	{
+		FString Name, Value;
+		if (Entry.Split(TEXT("="), &Name, &Value))
+		{
+			Settings.ChannelWeights.Add(Name.TrimStartAndEnd(), FMath::Max(1, FCString::Atoi(*Value)));
+		}
+	}
+
+	return Settings;
+}
+
+void FRemoteSessionTransportSettings::ApplyToSocket(FSocket* Socket) const
+{
+	if (Socket == nullptr)
+	{
+		return;
+	}
+
+	Socket->SetNoDelay(bNoDelay);
+
+	int32 ActualSendSize = 0;
+	int32 ActualReceiveSize = 0;
+
+	if (SendBufferSizeKB > 0)
+	{
+		Socket->SetSendBufferSize(SendBufferSizeKB * 1024, ActualSendSize);
+	}
+
+	if (ReceiveBufferSizeKB > 0)
+	{
+		Socket->SetReceiveBufferSize(ReceiveBufferSizeKB * 1024, ActualReceiveSize);
+	}
+
+	UE_LOG(LogRemoteSession, Log, TEXT("Socket options: NoDelay=%d SendSize=%dkb ReceiveSize=%dkb"),
+		bNoDelay ? 1 : 0, ActualSendSize / 1024, ActualReceiveSize / 1024);
+}
@@ -0,0 +1,89 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSocket;
+
+/*
+	Socket and send-pacing options, read from the [RemoteSession] section of the engine ini.
+*/
+struct FRemoteSessionTransportSettings
+{
+	FRemoteSessionTransportSettings();
+
+	/** Max bandwidth the host will send at in kbps. 0 = unlimited */
+	int32					MaxSendBandwidthKbps;
+
+	/** How many KB can be sent in a burst before pacing kicks in */
+	int32					SendBurstKB;
+
+	/** Disable Nagle's algorithm */
+	bool					bNoDelay;
+
+	/** Socket buffer sizes in KB. 0 = leave at the OS default */
+	int32					SendBufferSizeKB;
+	int32					ReceiveBufferSizeKB;
+
+	/** Relative share of bandwidth per channel type when there's contention. Channels not listed have a weight of 1 */
+	TMap<FString, int32>	ChannelWeights;
+
+	/** Max messages queued per channel before the oldest are dropped. 0 = unlimited */
+	TMap<FString, int32>	ChannelMaxQueued;
+
+	/** Client: ask the host to send frames over UDP instead of TCP */
+	bool					bUseUDPForFrames;
+
+	/** Host: whether clients may request UDP frames */
+	bool					bAllowUDPFrames;
+
+	/** Bytes of frame data per UDP datagram */
+	int32					UDPFragmentSize;
+
+	/** Number of UDP fragments protected by each parity fragment */
+	int32					UDPFECGroupSize;
+
+	/** Host: also accept same-machine clients over shared memory (connect with shm:<port>) */
+	bool					bAllowSharedMemory;
+
+	/** Size of each direction's shared memory ring in MB. Host and client must match */
+	int32					SharedMemoryRingSizeMB;
+
+	/** Compress small messages on the channels in CompressedChannels, if the peer agrees */
+	bool					bEnableCompression;
+
+	/** Packets smaller than this are never compressed */
+	int32					CompressionThreshold;
+
+	/** Optional file (relative to the project) with a trained dictionary. Both ends must use the same one */
+	FString					CompressionDictionary;
+
+	/** Channels whose messages we'll compress, and accept compressed */
+	TArray<FString>			CompressedChannels;
+
+	/** Host: how long a dropped client's channels are kept for it to resume */
+	float					ResumeWindowSeconds;
+
+	/** Host: how many sent frames to keep so a client that joins can be shown one straight away */
+	int32					FrameHistorySize;
+
+	/** Host: kept frames older than this aren't sent to a joining client, it waits for a new one instead */
+	float					LateJoinMaxFrameAgeSeconds;
+
+	/** Client: delay before the first reconnect attempt, doubled after each failure up to ReconnectMaxDelayMS */
+	int32					ReconnectInitialDelayMS;
+	int32					ReconnectMaxDelayMS;
+
+	/** How often each end pings the other, 0 to not send pings */
+	int32					HeartbeatIntervalMS;
+
+	/** A peer that answers pings and is silent for this long is considered gone. 0 to leave it to the socket */
+	int32					HeartbeatTimeoutMS;
+
+	/** Reads settings from GEngineIni */
+	static FRemoteSessionTransportSettings LoadFromConfig();
+
+	/** Applies socket options to the provided socket */
+	void ApplyToSocket(FSocket* Socket) const;
+};
@@ -0,0 +1,402 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Transport/RemoteSessionUDPFrameTransport.h"
+#include "Transport/RemoteSessionNetworkEmulator.h"
+#include "RemoteSession.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+static float UDPSimulatedLoss = 0.0f;
+static FAutoConsoleVariableRef CVarUDPSimulatedLoss(
+	TEXT("remote.udp.simulatedloss"), UDPSimulatedLoss,
+	TEXT("Percentage of UDP frame fragments the host drops before sending, for testing recovery on loopback"),
+	ECVF_Default);
+
+/* Max frames we'll reassemble at once. Anything older is abandoned */
+static const int32 kMaxPartialFrames = 4;
+
+/* Largest datagram we'll ever receive */
+static const int32 kMaxDatagramSize = 64 * 1024;
+
+/* Largest frame we'll reassemble, no encoded frame comes close */
+static const uint32 kMaxFrameSize = 64 * 1024 * 1024;
+
+FRemoteSessionUDPFrameSender::FRemoteSessionUDPFrameSender(TSharedRef<FInternetAddr> InDestination, int32 InFragmentSize, int32 InGroupSize)
+	: Socket(nullptr)
+	, Destination(InDestination)
+	, FragmentSize(FMath::Clamp(InFragmentSize, 256, 60 * 1024))
+	, GroupSize(FMath::Clamp(InGroupSize, 1, 255))
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+
+	Socket = SocketSubsystem->CreateSocket(NAME_DGram, TEXT("RemoteSession UDP frame sender"), false);
+
+	if (Socket)
+	{
+		int32 ActualSize = 0;
+		Socket->SetSendBufferSize(4 * 1024 * 1024, ActualSize);
+	}
+
+	DatagramBuffer.SetNumUninitialized(sizeof(FRemoteSessionFrameFragmentHeader) + FragmentSize);
+
+	if (Socket && FRemoteSessionNetworkConditions::Get().IsEnabled())
+	{
+		FSocket* LocalSocket = Socket;
+		TSharedRef<FInternetAddr> LocalDestination = Destination;
+
+		// datagrams can be lost or overtaken, unlike the stream
+		DelayLine = MakeUnique<FRemoteSessionDelayLine>([LocalSocket, LocalDestination](const uint8* Data, int32 Size)
+		{
+			int32 BytesSent = 0;
+			LocalSocket->SendTo(Data, Size, BytesSent, *LocalDestination);
+			return true;
+		}, false, TEXT("RemoteSessionUDPNetEmulator"));
+	}
+}
+
+FRemoteSessionUDPFrameSender::~FRemoteSessionUDPFrameSender()
+{
+	// stop sending before the socket goes
+	DelayLine.Reset();
+
+	if (Socket)
+	{
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
+
+void FRemoteSessionUDPFrameSender::SendFragment(const FRemoteSessionFrameFragmentHeader& Header, const uint8* Data, int32 Size)
+{
+	if (UDPSimulatedLoss > 0.0f && FMath::FRand() * 100.0f < UDPSimulatedLoss)
+	{
+		return;
+	}
+
+	FMemory::Memcpy(DatagramBuffer.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(DatagramBuffer.GetData() + sizeof(Header), Data, Size);
+
+	if (DelayLine.IsValid())
+	{
+		DelayLine->Push(DatagramBuffer.GetData(), sizeof(Header) + Size);
+		return;
+	}
+
+	int32 BytesSent = 0;
+	Socket->SendTo(DatagramBuffer.GetData(), sizeof(Header) + Size, BytesSent, *Destination);
+}
+
+void FRemoteSessionUDPFrameSender::SendFrame(int32 FrameIndex, int32 Width, int32 Height, const FRemoteSessionPayloadPtr& Payload)
+{
+	if (Socket == nullptr || Payload.IsValid() == false)
+	{
+		return;
+	}
+
+	// every fragment is built in the one buffer
+	FScopeLock Lock(&SendMutex);
+
+	const int32 FrameSize = Payload->Num();
+	const int32 NumDataFragments = FMath::DivideAndRoundUp(FrameSize, FragmentSize);
+
+	if (NumDataFragments > MAX_uint16)
+	{
+		UE_LOG(LogRemoteSession, Warning, TEXT("Frame %d is too large to send over UDP (%d bytes)"), FrameIndex, FrameSize);
+		return;
+	}
+
+	FRemoteSessionFrameFragmentHeader Header;
+	Header.Magic = FRemoteSessionFrameFragmentHeader::kMagic;
+	Header.FrameIndex = FrameIndex;
+	Header.FrameSize = FrameSize;
+	Header.Width = Width;
+	Header.Height = Height;
+	Header.NumDataFragments = NumDataFragments;
+	Header.FragmentSize = FragmentSize;
+	Header.GroupSize = GroupSize;
+
+	TArray<uint8> Parity;
+	Parity.SetNumZeroed(FragmentSize);
+
+	for (int32 Index = 0; Index < NumDataFragments; Index++)
+	{
+		const int32 Offset = Index * FragmentSize;
+		const int32 Length = FMath::Min(FragmentSize, FrameSize - Offset);
+		const uint8* Data = Payload->GetData() + Offset;
+
+		Header.FragmentIndex = Index;
+		Header.Flags = 0;
+		SendFragment(Header, Data, Length);
+
+		for (int32 i = 0; i < Length; i++)
+		{
+			Parity[i] ^= Data[i];
+		}
+
+		// close off the group with its parity fragment
+		const bool bEndOfGroup = ((Index + 1) % GroupSize) == 0 || Index == NumDataFragments - 1;
+
+		if (bEndOfGroup)
+		{
+			Header.FragmentIndex = Index / GroupSize;
+			Header.Flags = FRemoteSessionFrameFragmentHeader::kFlagParity;
+			SendFragment(Header, Parity.GetData(), FragmentSize);
+
+			FMemory::Memzero(Parity.GetData(), FragmentSize);
+		}
+	}
+}
+
+FRemoteSessionUDPFrameReceiver::FRemoteSessionUDPFrameReceiver(TSharedRef<FInternetAddr> InHostAddress)
+	: Socket(nullptr)
+	, Port(0)
+	, Thread(nullptr)
+	, HostIP(InHostAddress->ToString(false))
+	, BufferPool(MakeShareable(new FRemoteSessionBufferPool()))
+	, LastDeliveredFrame(0)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+
+	Socket = SocketSubsystem->CreateSocket(NAME_DGram, TEXT("RemoteSession UDP frame receiver"), false);
+
+	if (Socket)
+	{
+		TSharedRef<FInternetAddr> LocalAddr = SocketSubsystem->CreateInternetAddr();
+		LocalAddr->SetAnyAddress();
+		LocalAddr->SetPort(0);
+
+		int32 ActualSize = 0;
+		Socket->SetReceiveBufferSize(4 * 1024 * 1024, ActualSize);
+
+		if (Socket->Bind(*LocalAddr))
+		{
+			Socket->GetAddress(*LocalAddr);
+			Port = LocalAddr->GetPort();
+
+			Thread = FRunnableThread::Create(this, TEXT("RemoteSessionUDPReceiveThread"), 128 * 1024, TPri_AboveNormal);
+		}
+		else
+		{
+			UE_LOG(LogRemoteSession, Error, TEXT("Failed to bind UDP socket for frames"));
+			SocketSubsystem->DestroySocket(Socket);
+			Socket = nullptr;
+		}
+	}
+}
+
+FRemoteSessionUDPFrameReceiver::~FRemoteSessionUDPFrameReceiver()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (Socket)
+	{
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
+
+uint32 FRemoteSessionUDPFrameReceiver::Run()
+{
+	TSharedRef<FInternetAddr> Source = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+
+	TArray<uint8> Datagram;
+	Datagram.SetNumUninitialized(kMaxDatagramSize);
+
+	while (bStopRequested == false)
+	{
+		if (Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(100)) == false)
+		{
+			continue;
+		}
+
+		int32 BytesRead = 0;
+
+		while (Socket->RecvFrom(Datagram.GetData(), Datagram.Num(), BytesRead, *Source) && BytesRead > 0)
+		{
+			// anyone can send to our port
+			if (Source->ToString(false) == HostIP)
+			{
+				HandleDatagram(Datagram.GetData(), BytesRead);
+			}
+		}
+	}
+
+	return 0;
+}
+
+int32 FRemoteSessionUDPFrameReceiver::GetFragmentLength(const FRemoteSessionFrameFragmentHeader& Header, int32 Index)
+{
+	return FMath::Min<int32>(Header.FragmentSize, Header.FrameSize - Index * Header.FragmentSize);
+}
+
+void FRemoteSessionUDPFrameReceiver::HandleDatagram(const uint8* Data, int32 Size)
+{
+	if (Size < sizeof(FRemoteSessionFrameFragmentHeader))
+	{
+		return;
+	}
+
+	FRemoteSessionFrameFragmentHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	const uint8* FragmentData = Data + sizeof(Header);
+	const int32 FragmentLength = Size - sizeof(Header);
+
+	if (Header.Magic != FRemoteSessionFrameFragmentHeader::kMagic || Header.FragmentSize == 0 || Header.GroupSize == 0 || Header.NumDataFragments == 0)
+	{
+		return;
+	}
+
+	// the frame has to fill its fragments, the last one partly
+	const uint32 MaxFrameSize = (uint32)Header.NumDataFragments * Header.FragmentSize;
+
+	if (Header.FrameSize > kMaxFrameSize || Header.FrameSize > MaxFrameSize || Header.FrameSize <= MaxFrameSize - Header.FragmentSize)
+	{
+		return;
+	}
+
+	// late frames are useless, we've already shown something newer
+	if (Header.FrameIndex <= LastDeliveredFrame)
+	{
+		return;
+	}
+
+	FPartialFrame* Frame = PartialFrames.Find(Header.FrameIndex);
+
+	if (Frame == nullptr)
+	{
+		// make room by abandoning the oldest frame
+		if (PartialFrames.Num() >= kMaxPartialFrames)
+		{
+			uint32 OldestFrame = MAX_uint32;
+			for (const auto& KV : PartialFrames)
+			{
+				OldestFrame = FMath::Min(OldestFrame, KV.Key);
+			}
+			PartialFrames.Remove(OldestFrame);
+		}
+
+		Frame = &PartialFrames.Add(Header.FrameIndex);
+		Frame->Header = Header;
+		Frame->Data = BufferPool->Acquire(Header.FrameSize);
+		Frame->ReceivedFragments.Init(false, Header.NumDataFragments);
+		Frame->NumReceived = 0;
+	}
+	else if (Header.FrameSize != Frame->Header.FrameSize || Header.NumDataFragments != Frame->Header.NumDataFragments
+		|| Header.FragmentSize != Frame->Header.FragmentSize || Header.GroupSize != Frame->Header.GroupSize
+		|| Header.Width != Frame->Header.Width || Header.Height != Frame->Header.Height)
+	{
+		// the frame was sized from its first fragment, so anything that disagrees can't be used
+		return;
+	}
+
+	if (Header.Flags & FRemoteSessionFrameFragmentHeader::kFlagParity)
+	{
+		if (FragmentLength == Header.FragmentSize)
+		{
+			Frame->ParityFragments.Add(Header.FragmentIndex, TArray<uint8>(FragmentData, FragmentLength));
+		}
+	}
+	else
+	{
+		const int32 Index = Header.FragmentIndex;
+
+		if (Index >= Header.NumDataFragments || Frame->ReceivedFragments[Index] || FragmentLength != GetFragmentLength(Header, Index))
+		{
+			return;
+		}
+
+		FMemory::Memcpy(Frame->Data->GetData() + Index * Header.FragmentSize, FragmentData, FragmentLength);
+		Frame->ReceivedFragments[Index] = true;
+		Frame->NumReceived++;
+	}
+
+	if (Frame->NumReceived == Header.NumDataFragments || TryRecover(*Frame))
+	{
+		const FRemoteSessionFrameFragmentHeader FrameHeader = Frame->Header;
+		FRemoteSessionBlobView View(Frame->Data, 0, FrameHeader.FrameSize);
+
+		LastDeliveredFrame = FrameHeader.FrameIndex;
+
+		// drop this and anything older that didn't make it
+		for (auto It = PartialFrames.CreateIterator(); It; ++It)
+		{
+			if (It.Key() <= LastDeliveredFrame)
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		FrameReceivedDelegate.ExecuteIfBound(FrameHeader.FrameIndex, FrameHeader.Width, FrameHeader.Height, View);
+	}
+}
+
+bool FRemoteSessionUDPFrameReceiver::TryRecover(FPartialFrame& Frame)
+{
+	const FRemoteSessionFrameFragmentHeader& Header = Frame.Header;
+	const int32 NumGroups = FMath::DivideAndRoundUp<int32>(Header.NumDataFragments, Header.GroupSize);
+
+	for (int32 Group = 0; Group < NumGroups; Group++)
+	{
+		const int32 First = Group * Header.GroupSize;
+		const int32 Last = FMath::Min<int32>(First + Header.GroupSize, Header.NumDataFragments);
+
+		int32 Missing = INDEX_NONE;
+		int32 NumMissing = 0;
+
+		for (int32 Index = First; Index < Last; Index++)
+		{
+			if (Frame.ReceivedFragments[Index] == false)
+			{
+				Missing = Index;
+				NumMissing++;
+			}
+		}
+
+		if (NumMissing == 0)
+		{
+			continue;
+		}
+
+		const TArray<uint8>* Parity = Frame.ParityFragments.Find(Group);
+
+		// XOR parity can only rebuild one fragment per group
+		if (NumMissing > 1 || Parity == nullptr)
+		{
+			return false;
+		}
+
+		TArray<uint8> Rebuilt(*Parity);
+
+		for (int32 Index = First; Index < Last; Index++)
+		{
+			if (Index != Missing)
+			{
+				const uint8* Data = Frame.Data->GetData() + Index * Header.FragmentSize;
+				const int32 Length = GetFragmentLength(Header, Index);
+
+				for (int32 i = 0; i < Length; i++)
+				{
+					Rebuilt[i] ^= Data[i];
+				}
+			}
+		}
+
+		FMemory::Memcpy(Frame.Data->GetData() + Missing * Header.FragmentSize, Rebuilt.GetData(), GetFragmentLength(Header, Missing));
+		Frame.ReceivedFragments[Missing] = true;
+		Frame.NumReceived++;
+
+		UE_LOG(LogRemoteSession, VeryVerbose, TEXT("Recovered fragment %d of frame %d from parity"), Missing, Header.FrameIndex);
+	}
+
+	return Frame.NumReceived == Header.NumDataFragments;
+}
@@ -0,0 +1,133 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Transport/RemoteSessionSender.h"
+#include "Transport/RemoteSessionReceiver.h"
+
+class FSocket;
+class FInternetAddr;
+class FRunnableThread;
+class FRemoteSessionDelayLine;
+
+/*
+	Header at the start of every datagram. Frames are split into fragments of FragmentSize bytes, and every
+	GroupSize data fragments are followed by one parity fragment that is the XOR of the group. A single lost
+	fragment per group can be rebuilt, anything worse and the frame is dropped rather than retransmitted.
+*/
+struct FRemoteSessionFrameFragmentHeader
+{
+	enum
+	{
+		kMagic = 0x52534652,	// 'RSFR'
+		kFlagParity = 1,
+	};
+
+	uint32		Magic;
+	uint32		FrameIndex;
+	uint32		FrameSize;
+	int32		Width;
+	int32		Height;
+	uint16		FragmentIndex;
+	uint16		NumDataFragments;
+	uint16		FragmentSize;
+	uint8		GroupSize;
+	uint8		Flags;
+};
+
+/*
+	Sends encoded frames to a single client as UDP datagrams with XOR parity.
+*/
+class FRemoteSessionUDPFrameSender
+{
+public:
+
+	FRemoteSessionUDPFrameSender(TSharedRef<FInternetAddr> InDestination, int32 InFragmentSize, int32 InGroupSize);
+
+	~FRemoteSessionUDPFrameSender();
+
+	bool IsValid() const { return Socket != nullptr; }
+
+	/** Fragments and sends the frame. The payload is only referenced for the duration of the call */
+	void SendFrame(int32 FrameIndex, int32 Width, int32 Height, const FRemoteSessionPayloadPtr& Payload);
+
+protected:
+
+	void SendFragment(const FRemoteSessionFrameFragmentHeader& Header, const uint8* Data, int32 Size);
+
+	FSocket*					Socket;
+	TSharedRef<FInternetAddr>	Destination;
+	int32						FragmentSize;
+	int32						GroupSize;
+
+	/** Frames are sent from encode tasks and the game thread, and share the datagram buffer */
+	FCriticalSection			SendMutex;
+	TArray<uint8>				DatagramBuffer;
+
+	/** Set if network conditions were being emulated when we were created */
+	TUniquePtr<FRemoteSessionDelayLine>	DelayLine;
+};
+
+DECLARE_DELEGATE_FourParams(FRemoteSessionUDPFrameDelegate, int32 /*FrameIndex*/, int32 /*Width*/, int32 /*Height*/, const FRemoteSessionBlobView& /*Data*/);
+
+/*
+	Receives and reassembles frames sent by FRemoteSessionUDPFrameSender on a background thread. Frames that
+	arrive after a newer frame has been delivered are dropped, as is anything not sent from the host's address.
+*/
+class FRemoteSessionUDPFrameReceiver : public FRunnable
+{
+public:
+
+	FRemoteSessionUDPFrameReceiver(TSharedRef<FInternetAddr> InHostAddress);
+
+	~FRemoteSessionUDPFrameReceiver();
+
+	bool IsValid() const { return Socket != nullptr; }
+
+	/** Returns the local port we're receiving on so the host can be told where to send */
+	int32 GetPort() const { return Port; }
+
+	/** Called on the receive thread when a frame is complete */
+	FRemoteSessionUDPFrameDelegate& OnFrameReceived() { return FrameReceivedDelegate; }
+
+	/* Begin FRunnable */
+	virtual uint32 Run() override;
+	virtual void Stop() override { bStopRequested = true; }
+	/* End FRunnable */
+
+protected:
+
+	struct FPartialFrame
+	{
+		FRemoteSessionFrameFragmentHeader	Header;
+		FRemoteSessionPooledBufferPtr		Data;
+		TBitArray<>							ReceivedFragments;
+		TMap<int32, TArray<uint8>>			ParityFragments;
+		int32								NumReceived;
+	};
+
+	void HandleDatagram(const uint8* Data, int32 Size);
+
+	/** Tries to rebuild missing fragments from parity. Returns true if the frame is now complete */
+	bool TryRecover(FPartialFrame& Frame);
+
+	/** Number of data bytes in fragment Index */
+	static int32 GetFragmentLength(const FRemoteSessionFrameFragmentHeader& Header, int32 Index);
+
+	FSocket*							Socket;
+	int32								Port;
+	FRunnableThread*					Thread;
+
+	/** Without a port, the host sends from wherever its socket was bound */
+	FString								HostIP;
+	FThreadSafeBool						bStopRequested;
+
+	TSharedRef<FRemoteSessionBufferPool, ESPMode::ThreadSafe>	BufferPool;
+	TMap<uint32, FPartialFrame>			PartialFrames;
+	uint32								LastDeliveredFrame;
+
+	FRemoteSessionUDPFrameDelegate		FrameReceivedDelegate;
+};
@@ -47,11 +47,15 @@ public class RemoteSession : ModuleRules
 				"RenderCore",
 				"RHI",
 				"ImageWrapper",
+				"Json",
 				"MovieSceneCapture",
 				"Sockets"
 			}
 		);
 
+		// deflate with preset dictionaries for message compression
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+
 		if (Target.bBuildEditor == true)
 		{
 			//reference the module "MyModule"
@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 #include "RemoteSessionRole.h"
+#include "Channels/RemoteSessionChannel.h"
+#include "Channels/RemoteSessionFrameSource.h"
 
 
 REMOTESESSION_API DECLARE_LOG_CATEGORY_EXTERN(LogRemoteSession, Log, All);
@@ -58,4 +60,16 @@ public:
 	/** Returns a reference to the server role (if any) */
 	virtual TSharedPtr<IRemoteSessionRole>		GetHost() const = 0;
 
+	/** Streams frames from InSource instead of the game's viewport, now and for any host started later. Null goes back to the viewport */
+	virtual void SetHostFrameSource(TSharedPtr<IRemoteSessionFrameSource> InSource) = 0;
+
+public:
+	/** Channels */
+
+	/** Registers a channel type. Channels are only created when a client asks for them, either in its ClientChannels config or through OpenChannel */
+	virtual void AddChannelFactory(const FString& InChannelType, FOnRemoteSessionChannelCreate InFactory) = 0;
+
+	/** Removes a channel type. Existing channels of that type are unaffected */
+	virtual void RemoveChannelFactory(const FString& InChannelType) = 0;
+
 };
@@ -4,6 +4,82 @@
 
 class IRemoteSessionChannel;
 
+/* What we know about the link to the other end, measured with heartbeats */
+struct FRemoteSessionLinkStats
+{
+	/** Smoothed round trip time */
+	float	RoundTripMS = 0;
+
+	/** The most recent round trip */
+	float	LastRoundTripMS = 0;
+
+	/** Smoothed difference between consecutive round trips */
+	float	JitterMS = 0;
+
+	/** Time since anything arrived from the other end */
+	float	TimeSinceLastReceiveMS = 0;
+
+	int32	PingsSent = 0;
+	int32	PongsReceived = 0;
+
+	/** False until the other end has answered a ping, in which case the values above are meaningless */
+	bool	bHasSamples = false;
+};
+
+/* Traffic that went each way on behalf of one channel */
+struct FRemoteSessionTrafficStats
+{
+	int64	BytesSent = 0;
+	int64	BytesReceived = 0;
+
+	int32	MessagesSent = 0;
+	int32	MessagesReceived = 0;
+
+	/** Messages thrown away because the channel's send queue was full */
+	int32	MessagesDropped = 0;
+};
+
+/* Frames that went through the framebuffer channel. Host fills in the first half, client the second */
+struct FRemoteSessionFrameStats
+{
+	int32	FramesCaptured = 0;
+	int32	FramesEncoded = 0;
+
+	int32	FramesReceived = 0;
+	int32	FramesDecoded = 0;
+	int32	FramesUploaded = 0;
+
+	/** Host: captured frames that weren't sent. Client: received frames replaced by a newer one before they were shown */
+	int32	FramesDropped = 0;
+
+	/** Client: frames waiting to be decoded or uploaded */
+	int32	DecodeQueueDepth = 0;
+};
+
+/* Counters for the current connection, e.g. for a network HUD */
+struct FRemoteSessionStats
+{
+	/** Traffic by channel type. Handshakes, heartbeats and anything else not sent by a channel are under GetSessionChannel() */
+	TMap<FString, FRemoteSessionTrafficStats> Channels;
+
+	/** Sum of everything in Channels */
+	FRemoteSessionTrafficStats	Total;
+
+	/** Bytes and packets waiting for the send thread. Always 0 if sends aren't scheduled */
+	int32	SendQueueBytes = 0;
+	int32	SendQueuePackets = 0;
+
+	FRemoteSessionFrameStats	Frames;
+
+	/** Receive buffers being used, e.g. by frames waiting to be decoded, and those kept for reuse */
+	int32	ReceiveBuffersInUse = 0;
+	int32	ReceiveBuffersFree = 0;
+	int64	ReceiveBufferBytes = 0;
+
+	/** Key in Channels for traffic that doesn't belong to a channel */
+	static const TCHAR* GetSessionChannel() { return TEXT("session"); }
+};
+
 class REMOTESESSION_API IRemoteSessionRole
 {
 public:
@@ -11,6 +87,18 @@ public:
 
 	virtual TSharedPtr<IRemoteSessionChannel> GetChannel(const FString& Type) = 0;
 
+	/** Same as GetChannel but with a name that can be created once and kept, avoiding string compares */
+	virtual TSharedPtr<IRemoteSessionChannel> GetChannelById(const FName& Type) = 0;
+
+	/** Creates a channel of a registered type on this end and asks the other end to do the same */
+	virtual TSharedPtr<IRemoteSessionChannel> OpenChannel(const FString& Type) = 0;
+
+	/** Returns RTT and jitter for the current connection. Returns false if there's no connection */
+	virtual bool GetLinkStats(FRemoteSessionLinkStats& OutStats) const = 0;
+
+	/** Returns traffic, queue, frame and buffer counters for the current connection. Returns false if there's no connection */
+	virtual bool GetStats(FRemoteSessionStats& OutStats) const = 0;
+
 	template<class T>
 	TSharedPtr<T> GetChannel(const FString& InType)
 	{
@@ -24,6 +112,12 @@ public:
 		return TSharedPtr<T>();
 	}
 
+	template<class T>
+	TSharedPtr<T> GetChannelById(const FName& InType)
+	{
+		return StaticCastSharedPtr<T>(GetChannelById(InType));
+	}
+
 };
 
 
@@ -23,6 +23,30 @@ struct NoParamMsg
 	}
 };
 
+template <typename P1>
+struct OneParamMsg
+{
+	P1	Param1;
+
+	OneParamMsg(FArchive& Ar)
+	{
+		Param1 = P1();
+		Ar << Param1;
+	}
+
+	OneParamMsg(P1 InParam1)
+	{
+		Param1 = InParam1;
+	}
+
+	TArray<uint8> AsData()
+	{
+		FBufferArchive MemAr;
+		MemAr << Param1;
+		return MemAr;
+	}
+};
+
 template <typename P1, typename P2>
 struct TwoParamMsg
 {
@@ -0,0 +1,447 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionCodecBenchmarkCommandlet.h"
+#include "Channels/RemoteSessionFrameBufferChannel.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMisc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRemoteSessionCodecBenchmark, Log, All);
+
+namespace RemoteSessionCodecBenchmark
+{
+	struct FFrame
+	{
+		FString				Name;
+		int32				Width = 0;
+		int32				Height = 0;
+		TArray<FColor>		Pixels;
+	};
+
+	/* Everything measured for one codec/quality/thread count */
+	struct FResult
+	{
+		FString		Codec;
+		int32		Quality = 0;
+		int32		Threads = 0;
+		int64		RawBytes = 0;
+		int64		EncodedBytes = 0;
+		double		EncodeSeconds = 0;
+		double		DecodeSeconds = 0;
+		double		TotalEncodeMS = 0;
+		double		TotalDecodeMS = 0;
+		double		PSNR = 0;
+		double		SSIM = 0;
+		int32		Failures = 0;
+	};
+
+	/* Splits "a,b,c" into its parts */
+	static TArray<FString> ParseList(const FString& List)
+	{
+		TArray<FString> Items;
+		List.ParseIntoArray(Items, TEXT(","), true);
+		return Items;
+	}
+
+	static bool LoadFrame(IImageWrapperModule& ImageWrapperModule, const FString& Path, FFrame& OutFrame)
+	{
+		TArray<uint8> FileData;
+
+		if (FFileHelper::LoadFileToArray(FileData, *Path) == false)
+		{
+			return false;
+		}
+
+		const EImageFormat Format = ImageWrapperModule.DetectImageFormat(FileData.GetData(), FileData.Num());
+
+		if (Format == EImageFormat::Invalid)
+		{
+			return false;
+		}
+
+		TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(Format);
+		const TArray<uint8>* RawData = nullptr;
+
+		if (ImageWrapper.IsValid() == false
+			|| ImageWrapper->SetCompressed(FileData.GetData(), FileData.Num()) == false
+			|| ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawData) == false)
+		{
+			return false;
+		}
+
+		OutFrame.Name = FPaths::GetCleanFilename(Path);
+		OutFrame.Width = ImageWrapper->GetWidth();
+		OutFrame.Height = ImageWrapper->GetHeight();
+		OutFrame.Pixels.SetNumUninitialized(OutFrame.Width * OutFrame.Height);
+		FMemory::Memcpy(OutFrame.Pixels.GetData(), RawData->GetData(), FMath::Min<int32>(RawData->Num(), OutFrame.Pixels.Num() * sizeof(FColor)));
+
+		// frames are always sent opaque
+		for (FColor& Color : OutFrame.Pixels)
+		{
+			Color.A = 255;
+		}
+
+		return true;
+	}
+
+	/* Runs Work(Index) for every index on NumThreads threads, returning how long it took */
+	static double RunOnThreads(int32 NumThreads, int32 NumItems, TFunction<void(int32)> Work)
+	{
+		FThreadSafeCounter NextItem;
+		TArray<TFuture<void>> Workers;
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 i = 0; i < NumThreads; i++)
+		{
+			Workers.Add(Async<void>(EAsyncExecution::Thread, [&NextItem, NumItems, &Work]()
+			{
+				for (int32 Item = NextItem.Increment() - 1; Item < NumItems; Item = NextItem.Increment() - 1)
+				{
+					Work(Item);
+				}
+			}));
+		}
+
+		for (TFuture<void>& Worker : Workers)
+		{
+			Worker.Wait();
+		}
+
+		return FPlatformTime::Seconds() - StartTime;
+	}
+
+	/* Peak signal to noise ratio over RGB. Decoded is BGRA */
+	static double CalculatePSNR(const FFrame& Frame, const TArray<uint8>& Decoded)
+	{
+		if (Decoded.Num() < Frame.Pixels.Num() * 4)
+		{
+			return 0;
+		}
+
+		double SquaredError = 0;
+
+		for (int32 i = 0; i < Frame.Pixels.Num(); i++)
+		{
+			const FColor& Original = Frame.Pixels[i];
+			const uint8* Pixel = &Decoded[i * 4];
+
+			const int32 DB = (int32)Original.B - Pixel[0];
+			const int32 DG = (int32)Original.G - Pixel[1];
+			const int32 DR = (int32)Original.R - Pixel[2];
+
+			SquaredError += DB * DB + DG * DG + DR * DR;
+		}
+
+		const double MSE = SquaredError / (Frame.Pixels.Num() * 3.0);
+
+		// identical, report a ceiling rather than infinity
+		return MSE > 0 ? 10.0 * FMath::LogX(10.0, (255.0 * 255.0) / MSE) : 99.0;
+	}
+
+	/* Structural similarity of luma, averaged over 8x8 blocks */
+	static double CalculateSSIM(const FFrame& Frame, const TArray<uint8>& Decoded)
+	{
+		const int32 BlockSize = 8;
+
+		if (Decoded.Num() < Frame.Pixels.Num() * 4 || Frame.Width < BlockSize || Frame.Height < BlockSize)
+		{
+			return 0;
+		}
+
+		const double C1 = FMath::Square(0.01 * 255.0);
+		const double C2 = FMath::Square(0.03 * 255.0);
+
+		auto Luma = [](uint8 R, uint8 G, uint8 B)
+		{
+			return 0.299 * R + 0.587 * G + 0.114 * B;
+		};
+
+		double TotalSSIM = 0;
+		int32 NumBlocks = 0;
+
+		for (int32 BlockY = 0; BlockY + BlockSize <= Frame.Height; BlockY += BlockSize)
+		{
+			for (int32 BlockX = 0; BlockX + BlockSize <= Frame.Width; BlockX += BlockSize)
+			{
+				double SumA = 0, SumB = 0, SumAA = 0, SumBB = 0, SumAB = 0;
+
+				for (int32 Y = BlockY; Y < BlockY + BlockSize; Y++)
+				{
+					for (int32 X = BlockX; X < BlockX + BlockSize; X++)
+					{
+						const int32 Index = Y * Frame.Width + X;
+						const FColor& Original = Frame.Pixels[Index];
+						const uint8* Pixel = &Decoded[Index * 4];
+
+						const double A = Luma(Original.R, Original.G, Original.B);
+						const double B = Luma(Pixel[2], Pixel[1], Pixel[0]);
+
+						SumA += A;
+						SumB += B;
+						SumAA += A * A;
+						SumBB += B * B;
+						SumAB += A * B;
+					}
+				}
+
+				const double N = BlockSize * BlockSize;
+				const double MeanA = SumA / N;
+				const double MeanB = SumB / N;
+				const double VarA = SumAA / N - MeanA * MeanA;
+				const double VarB = SumBB / N - MeanB * MeanB;
+				const double Covariance = SumAB / N - MeanA * MeanB;
+
+				TotalSSIM += ((2 * MeanA * MeanB + C1) * (2 * Covariance + C2)) / ((MeanA * MeanA + MeanB * MeanB + C1) * (VarA + VarB + C2));
+				NumBlocks++;
+			}
+		}
+
+		return NumBlocks ? TotalSSIM / NumBlocks : 0;
+	}
+
+	static FResult Measure(const TArray<FFrame>& Frames, const FString& Codec, int32 Quality, int32 Threads, bool bMeasureQuality)
+	{
+		FResult Result;
+		Result.Codec = Codec;
+		Result.Quality = Quality;
+		Result.Threads = Threads;
+
+		TArray<TArray<uint8>> Encoded;
+		TArray<TArray<uint8>> Decoded;
+		TArray<double> EncodeMS;
+		TArray<double> DecodeMS;
+
+		Encoded.SetNum(Frames.Num());
+		Decoded.SetNum(Frames.Num());
+		EncodeMS.SetNumZeroed(Frames.Num());
+		DecodeMS.SetNumZeroed(Frames.Num());
+
+		Result.EncodeSeconds = RunOnThreads(Threads, Frames.Num(), [&](int32 Index)
+		{
+			const FFrame& Frame = Frames[Index];
+			const double StartTime = FPlatformTime::Seconds();
+			FRemoteSessionFrameBufferChannel::EncodeImage(Codec, Quality, Frame.Width, Frame.Height, Frame.Pixels, Encoded[Index]);
+			EncodeMS[Index] = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		});
+
+		Result.DecodeSeconds = RunOnThreads(Threads, Frames.Num(), [&](int32 Index)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			FRemoteSessionFrameBufferChannel::DecodeImage(Codec, Encoded[Index].GetData(), Encoded[Index].Num(), Decoded[Index]);
+			DecodeMS[Index] = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		});
+
+		for (int32 i = 0; i < Frames.Num(); i++)
+		{
+			Result.RawBytes += Frames[i].Width * Frames[i].Height * 3;
+			Result.EncodedBytes += Encoded[i].Num();
+			Result.TotalEncodeMS += EncodeMS[i];
+			Result.TotalDecodeMS += DecodeMS[i];
+
+			if (Decoded[i].Num() == 0)
+			{
+				Result.Failures++;
+			}
+			else if (bMeasureQuality)
+			{
+				Result.PSNR += CalculatePSNR(Frames[i], Decoded[i]) / Frames.Num();
+				Result.SSIM += CalculateSSIM(Frames[i], Decoded[i]) / Frames.Num();
+			}
+		}
+
+		return Result;
+	}
+}
+
+URemoteSessionCodecBenchmarkCommandlet::URemoteSessionCodecBenchmarkCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 URemoteSessionCodecBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace RemoteSessionCodecBenchmark;
+
+	FString FramesDir;
+	if (FParse::Value(*Params, TEXT("Frames="), FramesDir) == false)
+	{
+		UE_LOG(LogRemoteSessionCodecBenchmark, Error, TEXT("Usage: -run=RemoteSessionCodecBenchmark -Frames=<folder> [-Codecs=jpg,png] [-Qualities=50,70,85,95] [-Threads=1,2,4] [-MaxFrames=<count>] [-Output=<file>]"));
+		return 1;
+	}
+
+	TArray<FString> Codecs = FRemoteSessionFrameBufferChannel::GetSupportedCodecs();
+	TArray<int32> Qualities = { 50, 70, 85, 95 };
+	TArray<int32> ThreadCounts = { 1, 2, 4 };
+	int32 MaxFrames = 0;
+	FString OutputFile = FPaths::ProjectSavedDir() / TEXT("RemoteSession") / FString::Printf(TEXT("CodecBenchmark-%s.json"), *FDateTime::Now().ToString());
+
+	FString List;
+	if (FParse::Value(*Params, TEXT("Codecs="), List, false))
+	{
+		Codecs = ParseList(List);
+	}
+
+	if (FParse::Value(*Params, TEXT("Qualities="), List, false))
+	{
+		Qualities.Reset();
+		for (const FString& Item : ParseList(List))
+		{
+			Qualities.Add(FMath::Clamp(FCString::Atoi(*Item), 1, 100));
+		}
+	}
+
+	if (FParse::Value(*Params, TEXT("Threads="), List, false))
+	{
+		ThreadCounts.Reset();
+		for (const FString& Item : ParseList(List))
+		{
+			ThreadCounts.Add(FMath::Max(1, FCString::Atoi(*Item)));
+		}
+	}
+
+	FParse::Value(*Params, TEXT("MaxFrames="), MaxFrames);
+	FParse::Value(*Params, TEXT("Output="), OutputFile);
+
+	// the encoder only looks the module up, it expects it to be loaded already
+	IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(FramesDir / TEXT("*.*")), true, false);
+	Files.Sort();
+
+	TArray<FFrame> Frames;
+	int64 TotalPixels = 0;
+
+	for (const FString& File : Files)
+	{
+		if (MaxFrames > 0 && Frames.Num() >= MaxFrames)
+		{
+			break;
+		}
+
+		FFrame Frame;
+		if (LoadFrame(ImageWrapperModule, FramesDir / File, Frame))
+		{
+			TotalPixels += Frame.Pixels.Num();
+			Frames.Add(MoveTemp(Frame));
+		}
+		else
+		{
+			UE_LOG(LogRemoteSessionCodecBenchmark, Warning, TEXT("Skipping %s, it isn't an image we can read"), *File);
+		}
+	}
+
+	if (Frames.Num() == 0)
+	{
+		UE_LOG(LogRemoteSessionCodecBenchmark, Error, TEXT("No frames found in %s"), *FramesDir);
+		return 1;
+	}
+
+	UE_LOG(LogRemoteSessionCodecBenchmark, Display, TEXT("Loaded %d frames (%.01f megapixels) from %s. %d cores"),
+		Frames.Num(), TotalPixels / 1000000.0, *FramesDir, FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+
+	UE_LOG(LogRemoteSessionCodecBenchmark, Display, TEXT("%-6s %7s %7s %7s %8s %7s %9s %9s %10s %10s"),
+		TEXT("Codec"), TEXT("Quality"), TEXT("Threads"), TEXT("Ratio"), TEXT("PSNR"), TEXT("SSIM"), TEXT("EncodeMS"), TEXT("DecodeMS"), TEXT("EncMPix/s"), TEXT("DecMPix/s"));
+
+	TArray<TSharedPtr<FJsonValue>> JsonResults;
+
+	for (const FString& Codec : Codecs)
+	{
+		if (FRemoteSessionFrameBufferChannel::GetSupportedCodecs().Contains(Codec) == false)
+		{
+			UE_LOG(LogRemoteSessionCodecBenchmark, Warning, TEXT("Codec %s is not supported"), *Codec);
+			continue;
+		}
+
+		// lossless codecs ignore quality, no point repeating them
+		TArray<int32> CodecQualities = Qualities;
+		if (Codec == TEXT("png"))
+		{
+			CodecQualities = { 100 };
+		}
+
+		for (int32 Quality : CodecQualities)
+		{
+			double PSNR = 0;
+			double SSIM = 0;
+
+			for (int32 ThreadIndex = 0; ThreadIndex < ThreadCounts.Num(); ThreadIndex++)
+			{
+				// image quality doesn't depend on the thread count so is only measured once
+				FResult Result = Measure(Frames, Codec, Quality, ThreadCounts[ThreadIndex], ThreadIndex == 0);
+
+				if (ThreadIndex == 0)
+				{
+					PSNR = Result.PSNR;
+					SSIM = Result.SSIM;
+				}
+
+				if (Result.Failures)
+				{
+					UE_LOG(LogRemoteSessionCodecBenchmark, Warning, TEXT("%d frames failed to encode or decode with %s at quality %d"), Result.Failures, *Codec, Quality);
+				}
+
+				const double Ratio = Result.EncodedBytes ? (double)Result.RawBytes / Result.EncodedBytes : 0;
+				const double EncodeMPix = Result.EncodeSeconds > 0 ? TotalPixels / Result.EncodeSeconds / 1000000.0 : 0;
+				const double DecodeMPix = Result.DecodeSeconds > 0 ? TotalPixels / Result.DecodeSeconds / 1000000.0 : 0;
+
+				UE_LOG(LogRemoteSessionCodecBenchmark, Display, TEXT("%-6s %7d %7d %7.02f %8.02f %7.04f %9.02f %9.02f %10.01f %10.01f"),
+					*Codec, Quality, Result.Threads, Ratio, PSNR, SSIM,
+					Result.TotalEncodeMS / Frames.Num(), Result.TotalDecodeMS / Frames.Num(), EncodeMPix, DecodeMPix);
+
+				TSharedRef<FJsonObject> JsonResult = MakeShareable(new FJsonObject);
+				JsonResult->SetStringField(TEXT("codec"), Codec);
+				JsonResult->SetNumberField(TEXT("quality"), Quality);
+				JsonResult->SetNumberField(TEXT("threads"), Result.Threads);
+				JsonResult->SetNumberField(TEXT("frames"), Frames.Num());
+				JsonResult->SetNumberField(TEXT("failures"), Result.Failures);
+				JsonResult->SetNumberField(TEXT("compressionRatio"), Ratio);
+				JsonResult->SetNumberField(TEXT("meanBytes"), (double)Result.EncodedBytes / Frames.Num());
+				JsonResult->SetNumberField(TEXT("psnr"), PSNR);
+				JsonResult->SetNumberField(TEXT("ssim"), SSIM);
+				JsonResult->SetNumberField(TEXT("encodeMs"), Result.TotalEncodeMS / Frames.Num());
+				JsonResult->SetNumberField(TEXT("decodeMs"), Result.TotalDecodeMS / Frames.Num());
+				JsonResult->SetNumberField(TEXT("encodeFps"), Result.EncodeSeconds > 0 ? Frames.Num() / Result.EncodeSeconds : 0);
+				JsonResult->SetNumberField(TEXT("decodeFps"), Result.DecodeSeconds > 0 ? Frames.Num() / Result.DecodeSeconds : 0);
+				JsonResult->SetNumberField(TEXT("encodeMegapixelsPerSec"), EncodeMPix);
+				JsonResult->SetNumberField(TEXT("decodeMegapixelsPerSec"), DecodeMPix);
+				JsonResults.Add(MakeShareable(new FJsonValueObject(JsonResult)));
+			}
+		}
+	}
+
+	TSharedRef<FJsonObject> Results = MakeShareable(new FJsonObject);
+	Results->SetStringField(TEXT("frames"), FramesDir);
+	Results->SetNumberField(TEXT("frameCount"), Frames.Num());
+	Results->SetNumberField(TEXT("megapixels"), TotalPixels / 1000000.0);
+	Results->SetNumberField(TEXT("cores"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	Results->SetArrayField(TEXT("results"), JsonResults);
+
+	FString Json;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Results, Writer);
+
+	if (FFileHelper::SaveStringToFile(Json, *OutputFile) == false)
+	{
+		UE_LOG(LogRemoteSessionCodecBenchmark, Error, TEXT("Failed to write results to %s"), *OutputFile);
+		return 1;
+	}
+
+	UE_LOG(LogRemoteSessionCodecBenchmark, Display, TEXT("Results written to %s"), *OutputFile);
+
+	return 0;
+}
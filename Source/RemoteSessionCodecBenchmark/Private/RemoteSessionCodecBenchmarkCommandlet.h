@@ -0,0 +1,25 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RemoteSessionCodecBenchmarkCommandlet.generated.h"
+
+/*
+	Runs a folder of captured frames through each frame codec at a range of quality levels and thread counts, and reports
+	compression ratio, PSNR, SSIM, encode and decode times and throughput. Frames are encoded and decoded with the same
+	functions the host and client use, so the numbers match what a session would see.
+
+	UE4Editor-Cmd.exe MyProject -run=RemoteSessionCodecBenchmark -Frames=<folder> [-Codecs=jpg,png] [-Qualities=50,70,85,95]
+		[-Threads=1,2,4] [-MaxFrames=<count>] [-Output=<file>]
+*/
+UCLASS()
+class URemoteSessionCodecBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,31 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class RemoteSessionCodecBenchmark : ModuleRules
+{
+	public RemoteSessionCodecBenchmark(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateIncludePaths.AddRange(
+			new string[] {
+				"RemoteSessionCodecBenchmark/Private",
+				"RemoteSession"
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				"ImageWrapper",
+				"Json",
+				// frames are encoded and decoded with the same code the host and client use
+				"RemoteSession"
+			}
+		);
+	}
+}
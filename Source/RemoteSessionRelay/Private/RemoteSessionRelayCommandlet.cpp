@@ -0,0 +1,67 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "RemoteSessionRelayCommandlet.h"
+#include "RemoteSession.h"
+#include "RemoteSessionRelay.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ConfigCacheIni.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRemoteSessionRelay, Log, All);
+
+/* The relay works on its own thread, this is only how often we check whether to stop */
+static const float kRelayCommandletPollSeconds = 0.1f;
+
+URemoteSessionRelayCommandlet::URemoteSessionRelayCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 URemoteSessionRelayCommandlet::Main(const FString& Params)
+{
+	FString HostAddress;
+	if (FParse::Value(*Params, TEXT("Host="), HostAddress) == false)
+	{
+		UE_LOG(LogRemoteSessionRelay, Error, TEXT("Usage: -run=RemoteSessionRelay -Host=<host address> [-Port=<port to listen on>] [-Seconds=<time>]"));
+		return 1;
+	}
+
+	// the same default as -RemoteSessionRelay, so viewers find it in the same place
+	int32 HostPort = IRemoteSessionModule::kDefaultPort;
+	GConfig->GetInt(TEXT("RemoteSession"), TEXT("HostPort"), HostPort, GEngineIni);
+
+	int32 Port = HostPort + 1;
+	float Seconds = 0;
+
+	FParse::Value(*Params, TEXT("Port="), Port);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+
+	TUniquePtr<FRemoteSessionRelay> Relay = MakeUnique<FRemoteSessionRelay>(HostAddress, (uint16)Port);
+
+	if (Relay->Start() == false)
+	{
+		return 1;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	int32 NumViewers = 0;
+
+	while (GIsRequestingExit == false && (Seconds <= 0 || FPlatformTime::Seconds() - StartTime < Seconds))
+	{
+		FPlatformProcess::Sleep(kRelayCommandletPollSeconds);
+
+		const int32 NewNumViewers = Relay->GetNumViewers();
+
+		if (NewNumViewers != NumViewers)
+		{
+			UE_LOG(LogRemoteSessionRelay, Display, TEXT("%d viewers connected"), NewNumViewers);
+			NumViewers = NewNumViewers;
+		}
+	}
+
+	Relay = nullptr;
+	return 0;
+}
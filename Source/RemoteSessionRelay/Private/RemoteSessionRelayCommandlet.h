@@ -0,0 +1,23 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RemoteSessionRelayCommandlet.generated.h"
+
+/*
+	Runs a relay on its own, without a game or its world, so a machine can serve a host's frames to many viewers
+	for little more than the cost of the relay. Runs until it's stopped (e.g. Ctrl-C), or for Seconds if given.
+
+	UE4Editor-Cmd.exe MyProject -run=RemoteSessionRelay -Host=<host address> [-Port=<port to listen on>] [-Seconds=<time>]
+*/
+UCLASS()
+class URemoteSessionRelayCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	virtual int32 Main(const FString& Params) override;
+};
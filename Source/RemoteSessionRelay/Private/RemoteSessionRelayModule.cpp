@@ -0,0 +1,5 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, RemoteSessionRelay)
@@ -0,0 +1,30 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class RemoteSessionRelay : ModuleRules
+{
+	public RemoteSessionRelay(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PrivateIncludePaths.AddRange(
+			new string[] {
+				"RemoteSessionRelay/Private",
+				"RemoteSession/Private",
+				"RemoteSession"
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				// the relay itself, the same one remote.relay and -RemoteSessionRelay start
+				"RemoteSession"
+			}
+		);
+	}
+}